@@ -17,15 +17,59 @@
 
 #include "qgsgridfilewriter.h"
 #include "qgsinterpolator.h"
+#include "qgslogger.h"
 #include "qgsvectorlayer.h"
+#include "cpl_string.h"
 #include <QFile>
 #include <QFileInfo>
 #include <QProgressDialog>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrentMap>
+
+#if defined(GDAL_VERSION_NUM) && GDAL_VERSION_NUM >= 1800
+#define TO8F(x) (x).toUtf8().constData()
+#else
+#define TO8F(x) QFile::encodeName( x ).constData()
+#endif
+
+//block size of GeoTIFF output, rows are interpolated in bands of one row of blocks
+static const int sTileSize = 256;
+
+/**A row of the grid, interpolated by one thread*/
+struct QgsGridFileRow
+{
+  QgsInterpolator* interpolator;
+  double xMin;
+  double y;
+  double cellSizeX;
+  QVector<double> values;
+};
+
+static void interpolateRow( QgsGridFileRow& row )
+{
+  double currentXValue = row.xMin;
+  double interpolatedValue;
+  for ( int j = 0; j < row.values.size(); ++j )
+  {
+    if ( row.interpolator->interpolatePoint( currentXValue, row.y, interpolatedValue ) == 0 )
+    {
+      row.values[j] = interpolatedValue;
+    }
+    else
+    {
+      row.values[j] = -9999;
+    }
+    currentXValue += row.cellSizeX;
+  }
+}
 
 QgsGridFileWriter::QgsGridFileWriter( QgsInterpolator* i, QString outputPath, QgsRectangle extent, int nCols, int nRows , double cellSizeX, double cellSizeY )
     : mInterpolator( i ), mOutputFilePath( outputPath ), mInterpolationExtent( extent ), mNumColumns( nCols ), mNumRows( nRows )
-    , mCellSizeX( cellSizeX ), mCellSizeY( cellSizeY )
+    , mCellSizeX( cellSizeX ), mCellSizeY( cellSizeY ), mCompression( "DEFLATE" ), mBuildOverviews( true )
 {
+  QString suffix = QFileInfo( outputPath ).suffix().toLower();
+  mOutputFormat = ( suffix == "tif" || suffix == "tiff" ) ? GeoTiff : AsciiGrid;
 
 }
 
@@ -41,26 +85,37 @@ QgsGridFileWriter::~QgsGridFileWriter()
 
 int QgsGridFileWriter::writeFile( bool showProgressDialog )
 {
+  if ( !mInterpolator )
+  {
+    return 2;
+  }
+
   QFile outputFile( mOutputFilePath );
+  QTextStream outStream;
+  GDALDatasetH outputDataset = 0;
+  GDALRasterBandH outputBand = 0;
 
-  if ( !outputFile.open( QFile::WriteOnly ) )
+  if ( mOutputFormat == GeoTiff )
   {
-    return 1;
+    outputDataset = createGeoTiff();
+    if ( !outputDataset )
+    {
+      return 1;
+    }
+    outputBand = GDALGetRasterBand( outputDataset, 1 );
   }
-
-  if ( !mInterpolator )
+  else
   {
-    outputFile.remove();
-    return 2;
+    if ( !outputFile.open( QFile::WriteOnly ) )
+    {
+      return 1;
+    }
+    outStream.setDevice( &outputFile );
+    outStream.setRealNumberPrecision( 8 );
+    writeHeader( outStream );
   }
 
-  QTextStream outStream( &outputFile );
-  outStream.setRealNumberPrecision( 8 );
-  writeHeader( outStream );
-
   double currentYValue = mInterpolationExtent.yMaximum() - mCellSizeY / 2.0; //calculate value in the center of the cell
-  double currentXValue;
-  double interpolatedValue;
 
   QProgressDialog* progressDialog = 0;
   if ( showProgressDialog )
@@ -69,33 +124,107 @@ int QgsGridFileWriter::writeFile( bool showProgressDialog )
     progressDialog->setWindowModality( Qt::WindowModal );
   }
 
-  for ( int i = 0; i < mNumRows; ++i )
+  //rows are interpolated in bands, in parallel if the interpolator supports it, and written in order.
+  //GeoTIFF bands cover one row of blocks so that each block is compressed and written only once
+  bool concurrent = mInterpolator->prepareConcurrentInterpolation() && QThread::idealThreadCount() > 1;
+  int bandSize = concurrent ? 4 * QThread::idealThreadCount() : 1;
+  if ( mOutputFormat == GeoTiff )
   {
-    currentXValue = mInterpolationExtent.xMinimum() + mCellSizeX / 2.0; //calculate value in the center of the cell
-    for ( int j = 0; j < mNumColumns; ++j )
+    bandSize = sTileSize;
+  }
+  QVector<QgsGridFileRow> band;
+  QVector<float> blockBuffer;
+
+  int result = 0;
+  for ( int i = 0; i < mNumRows; i += bandSize )
+  {
+    band.resize( qMin( bandSize, mNumRows - i ) );
+    for ( int r = 0; r < band.size(); ++r )
+    {
+      QgsGridFileRow& row = band[r];
+      row.interpolator = mInterpolator;
+      row.xMin = mInterpolationExtent.xMinimum() + mCellSizeX / 2.0; //calculate value in the center of the cell
+      row.y = currentYValue;
+      row.cellSizeX = mCellSizeX;
+      row.values.resize( mNumColumns );
+      currentYValue -= mCellSizeY;
+    }
+
+    if ( concurrent )
+    {
+      QtConcurrent::blockingMap( band, interpolateRow );
+    }
+    else
     {
-      if ( mInterpolator->interpolatePoint( currentXValue, currentYValue, interpolatedValue ) == 0 )
+      for ( int r = 0; r < band.size(); ++r )
       {
-        outStream << interpolatedValue << " ";
+        interpolateRow( band[r] );
       }
-      else
+    }
+
+    if ( outputBand )
+    {
+      blockBuffer.resize( band.size() * mNumColumns );
+      float* value = blockBuffer.data();
+      for ( int r = 0; r < band.size(); ++r )
+      {
+        const QVector<double>& values = band.at( r ).values;
+        for ( int j = 0; j < mNumColumns; ++j )
+        {
+          *value++ = values[j];
+        }
+      }
+      if ( GDALRasterIO( outputBand, GF_Write, 0, i, mNumColumns, band.size(), blockBuffer.data(), mNumColumns, band.size(), GDT_Float32, 0, 0 ) != CE_None )
       {
-        outStream << "-9999 ";
+        QgsDebugMsg( QString( "Writing rows %1 to %2 failed: %3" ).arg( i ).arg( i + band.size() - 1 ).arg( CPLGetLastErrorMsg() ) );
+        result = 1;
+        break;
+      }
+    }
+    else
+    {
+      for ( int r = 0; r < band.size(); ++r )
+      {
+        const QVector<double>& values = band.at( r ).values;
+        for ( int j = 0; j < mNumColumns; ++j )
+        {
+          outStream << values[j] << " ";
+        }
+        outStream << endl;
       }
-      currentXValue += mCellSizeX;
     }
-    outStream << endl;
-    currentYValue -= mCellSizeY;
 
     if ( showProgressDialog )
     {
       if ( progressDialog->wasCanceled() )
       {
-        outputFile.remove();
-        return 3;
+        result = 3;
+        break;
       }
-      progressDialog->setValue( i );
+      progressDialog->setValue( i + band.size() - 1 );
+    }
+  }
+
+  delete progressDialog;
+
+  if ( outputDataset )
+  {
+    if ( result == 0 && mBuildOverviews )
+    {
+      createOverviews( outputDataset );
+    }
+    GDALClose( outputDataset );
+    if ( result != 0 )
+    {
+      GDALDeleteDataset( GDALGetDriverByName( "GTiff" ), TO8F( mOutputFilePath ) );
     }
+    return result;
+  }
+
+  if ( result != 0 )
+  {
+    outputFile.remove();
+    return result;
   }
 
   // create prj file
@@ -115,10 +244,80 @@ int QgsGridFileWriter::writeFile( bool showProgressDialog )
   prjStream << endl;
   prjFile.close();
 
-  delete progressDialog;
   return 0;
 }
 
+GDALDatasetH QgsGridFileWriter::createGeoTiff() const
+{
+  GDALAllRegister();
+  GDALDriverH driver = GDALGetDriverByName( "GTiff" );
+  if ( !driver )
+  {
+    return 0;
+  }
+
+  char **papszOptions = NULL;
+  papszOptions = CSLSetNameValue( papszOptions, "TILED", "YES" );
+  papszOptions = CSLSetNameValue( papszOptions, "BLOCKXSIZE", QString::number( sTileSize ).toLocal8Bit().data() );
+  papszOptions = CSLSetNameValue( papszOptions, "BLOCKYSIZE", QString::number( sTileSize ).toLocal8Bit().data() );
+  papszOptions = CSLSetNameValue( papszOptions, "BIGTIFF", "IF_SAFER" );
+  if ( !mCompression.isEmpty() )
+  {
+    papszOptions = CSLSetNameValue( papszOptions, "COMPRESS", mCompression.toLocal8Bit().data() );
+    if ( mCompression.compare( "DEFLATE", Qt::CaseInsensitive ) == 0 || mCompression.compare( "LZW", Qt::CaseInsensitive ) == 0 )
+    {
+      //floating point predictor
+      papszOptions = CSLSetNameValue( papszOptions, "PREDICTOR", "3" );
+    }
+  }
+
+  GDALDatasetH dataset = GDALCreate( driver, TO8F( mOutputFilePath ), mNumColumns, mNumRows, 1, GDT_Float32, papszOptions );
+  CSLDestroy( papszOptions );
+  if ( !dataset )
+  {
+    QgsDebugMsg( QString( "Creating %1 failed: %2" ).arg( mOutputFilePath ).arg( CPLGetLastErrorMsg() ) );
+    return 0;
+  }
+
+  double geoTransform[6];
+  geoTransform[0] = mInterpolationExtent.xMinimum();
+  geoTransform[1] = mCellSizeX;
+  geoTransform[2] = 0;
+  geoTransform[3] = mInterpolationExtent.yMaximum();
+  geoTransform[4] = 0;
+  geoTransform[5] = -mCellSizeY;
+  GDALSetGeoTransform( dataset, geoTransform );
+
+  QgsVectorLayer* vl = mInterpolator->layerData().first().vectorLayer;
+  if ( vl )
+  {
+    GDALSetProjection( dataset, vl->crs().toWkt().toLocal8Bit().data() );
+  }
+
+  GDALSetRasterNoDataValue( GDALGetRasterBand( dataset, 1 ), -9999 );
+  return dataset;
+}
+
+void QgsGridFileWriter::createOverviews( GDALDatasetH dataset ) const
+{
+  QVector<int> levels;
+  int level = 2;
+  while ( mNumColumns / ( level / 2 ) > sTileSize || mNumRows / ( level / 2 ) > sTileSize )
+  {
+    levels << level;
+    level *= 2;
+  }
+  if ( levels.isEmpty() )
+  {
+    return;
+  }
+
+  if ( GDALBuildOverviews( dataset, "AVERAGE", levels.size(), levels.data(), 0, NULL, GDALDummyProgress, NULL ) != CE_None )
+  {
+    QgsDebugMsg( QString( "Building overviews failed: %1" ).arg( CPLGetLastErrorMsg() ) );
+  }
+}
+
 int QgsGridFileWriter::writeHeader( QTextStream& outStream )
 {
   outStream << "NCOLS " << mNumColumns << endl;
@@ -21,14 +21,25 @@
 #include "qgsrectangle.h"
 #include <QString>
 #include <QTextStream>
+#include "gdal.h"
 
 class QgsInterpolator;
 
-/**A class that does interpolation to a grid and writes the results to an ascii grid*/
-//todo: extend such that writing to other file types is possible
+/**A class that does interpolation to a grid and writes the results to an ascii grid or to a
+  tiled and compressed GeoTIFF. The GeoTIFF output is written block by block, so the grid never
+  needs to be held in memory as a whole*/
 class ANALYSIS_EXPORT QgsGridFileWriter
 {
   public:
+    /**Output file formats
+      @note added in 2.4*/
+    enum OutputFormat
+    {
+      AsciiGrid, /**< ESRI ascii grid with a .prj file*/
+      GeoTiff /**< tiled Float32 GeoTIFF*/
+    };
+
+    /**Constructor. The output format is GeoTiff if outputPath ends with .tif or .tiff and AsciiGrid otherwise*/
     QgsGridFileWriter( QgsInterpolator* i, QString outputPath, QgsRectangle extent, int nCols, int nRows, double cellSizeX, double cellSizeY );
     ~QgsGridFileWriter();
 
@@ -38,10 +49,33 @@ class ANALYSIS_EXPORT QgsGridFileWriter
 
     int writeFile( bool showProgressDialog = false );
 
+    /**Sets the format of the output file
+      @note added in 2.4*/
+    void setOutputFormat( OutputFormat format ) { mOutputFormat = format; }
+    /**@note added in 2.4*/
+    OutputFormat outputFormat() const { return mOutputFormat; }
+
+    /**Sets the compression of GeoTIFF output (a value of the GDAL COMPRESS creation option, e.g. DEFLATE, LZW or NONE).
+      Default is DEFLATE
+      @note added in 2.4*/
+    void setCompression( const QString& compression ) { mCompression = compression; }
+    /**@note added in 2.4*/
+    QString compression() const { return mCompression; }
+
+    /**Sets whether overviews are built into GeoTIFF output. Default is true
+      @note added in 2.4*/
+    void setBuildOverviews( bool build ) { mBuildOverviews = build; }
+    /**@note added in 2.4*/
+    bool buildOverviews() const { return mBuildOverviews; }
+
   private:
 
     QgsGridFileWriter(); //forbidden
     int writeHeader( QTextStream& outStream );
+    /**Creates the GeoTIFF output dataset. Returns 0 in case of error*/
+    GDALDatasetH createGeoTiff() const;
+    /**Builds overview levels until the smallest one fits into a single tile*/
+    void createOverviews( GDALDatasetH dataset ) const;
 
     QgsInterpolator* mInterpolator;
     QString mOutputFilePath;
@@ -51,6 +85,10 @@ class ANALYSIS_EXPORT QgsGridFileWriter
 
     double mCellSizeX;
     double mCellSizeY;
+
+    OutputFormat mOutputFormat;
+    QString mCompression;
+    bool mBuildOverviews;
 };
 
 #endif
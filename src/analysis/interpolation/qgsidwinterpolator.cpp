@@ -18,13 +18,39 @@
 #include "qgsidwinterpolator.h"
 #include <cmath>
 #include <limits>
+#include <queue>
+#include <utility>
 
-QgsIDWInterpolator::QgsIDWInterpolator( const QList<LayerData>& layerData ): QgsInterpolator( layerData ), mDistanceCoefficient( 2.0 )
+QgsIDWInterpolator::QgsIDWInterpolator( const QList<LayerData>& layerData )
+    : QgsInterpolator( layerData )
+    , mDistanceCoefficient( 2.0 )
+    , mSearchMode( AllPoints )
+    , mNumberOfNeighbours( 12 )
+    , mSearchRadius( 0.0 )
+    , mPrepared( false )
+    , mIndexBuilt( false )
+    , mIndexXMin( 0.0 )
+    , mIndexYMin( 0.0 )
+    , mIndexCellSize( 1.0 )
+    , mIndexColumns( 0 )
+    , mIndexRows( 0 )
 {
 
 }
 
-QgsIDWInterpolator::QgsIDWInterpolator(): QgsInterpolator( QList<LayerData>() ), mDistanceCoefficient( 2.0 )
+QgsIDWInterpolator::QgsIDWInterpolator()
+    : QgsInterpolator( QList<LayerData>() )
+    , mDistanceCoefficient( 2.0 )
+    , mSearchMode( AllPoints )
+    , mNumberOfNeighbours( 12 )
+    , mSearchRadius( 0.0 )
+    , mPrepared( false )
+    , mIndexBuilt( false )
+    , mIndexXMin( 0.0 )
+    , mIndexYMin( 0.0 )
+    , mIndexCellSize( 1.0 )
+    , mIndexColumns( 0 )
+    , mIndexRows( 0 )
 {
 
 }
@@ -34,9 +60,25 @@ QgsIDWInterpolator::~QgsIDWInterpolator()
 
 }
 
+bool QgsIDWInterpolator::prepareConcurrentInterpolation()
+{
+  //mDataIsCached stays false if there are no vertices, so a separate flag stops the lazy caching
+  if ( !mDataIsCached && cacheBaseData() != 0 )
+  {
+    return false;
+  }
+  if ( mSearchMode != AllPoints && !mIndexBuilt )
+  {
+    buildIndex();
+  }
+  mPrepared = true;
+  return true;
+}
+
 int QgsIDWInterpolator::interpolatePoint( double x, double y, double& result )
 {
-  if ( !mDataIsCached )
+  //once prepared, interpolatePoint may run in several threads and must not modify the cache
+  if ( !mPrepared && !mDataIsCached )
   {
     cacheBaseData();
   }
@@ -47,19 +89,54 @@ int QgsIDWInterpolator::interpolatePoint( double x, double y, double& result )
   double sumCounter = 0;
   double sumDenominator = 0;
 
-  QVector<vertexData>::iterator vertex_it = mCachedBaseData.begin();
+  if ( mSearchMode == AllPoints )
+  {
+    QVector<vertexData>::const_iterator vertex_it = mCachedBaseData.constBegin();
 
-  for ( ; vertex_it != mCachedBaseData.end(); ++vertex_it )
+    for ( ; vertex_it != mCachedBaseData.constEnd(); ++vertex_it )
+    {
+      distance = sqrt(( vertex_it->x - x ) * ( vertex_it->x - x ) + ( vertex_it->y - y ) * ( vertex_it->y - y ) );
+      if (( distance - 0 ) < std::numeric_limits<double>::min() )
+      {
+        result = vertex_it->z;
+        return 0;
+      }
+      currentWeight = 1 / ( pow( distance, mDistanceCoefficient ) );
+      sumCounter += ( currentWeight * vertex_it->z );
+      sumDenominator += currentWeight;
+    }
+  }
+  else
   {
-    distance = sqrt(( vertex_it->x - x ) * ( vertex_it->x - x ) + ( vertex_it->y - y ) * ( vertex_it->y - y ) );
-    if (( distance - 0 ) < std::numeric_limits<double>::min() )
+    if ( !mPrepared && !mIndexBuilt )
     {
-      result = vertex_it->z;
-      return 0;
+      buildIndex();
+    }
+
+    QVector<int> points;
+    if ( mSearchMode == NearestNeighbours )
+    {
+      nearestNeighbours( x, y, mNumberOfNeighbours, points );
+    }
+    else
+    {
+      pointsInRadius( x, y, mSearchRadius, points );
+    }
+
+    QVector<int>::const_iterator point_it = points.constBegin();
+    for ( ; point_it != points.constEnd(); ++point_it )
+    {
+      const vertexData& vertex = mCachedBaseData.at( *point_it );
+      distance = sqrt( squaredDistance( *point_it, x, y ) );
+      if (( distance - 0 ) < std::numeric_limits<double>::min() )
+      {
+        result = vertex.z;
+        return 0;
+      }
+      currentWeight = 1 / ( pow( distance, mDistanceCoefficient ) );
+      sumCounter += ( currentWeight * vertex.z );
+      sumDenominator += currentWeight;
     }
-    currentWeight = 1 / ( pow( distance, mDistanceCoefficient ) );
-    sumCounter += ( currentWeight * vertex_it->z );
-    sumDenominator += currentWeight;
   }
 
   if ( sumDenominator == 0.0 )
@@ -70,3 +147,216 @@ int QgsIDWInterpolator::interpolatePoint( double x, double y, double& result )
   result = sumCounter / sumDenominator;
   return 0;
 }
+
+double QgsIDWInterpolator::squaredDistance( int point, double x, double y ) const
+{
+  const vertexData& vertex = mCachedBaseData.at( point );
+  return ( vertex.x - x ) * ( vertex.x - x ) + ( vertex.y - y ) * ( vertex.y - y );
+}
+
+void QgsIDWInterpolator::buildIndex()
+{
+  mIndexBuilt = true;
+  mIndexCellStart.clear();
+  mIndexPoints.clear();
+  mIndexColumns = 0;
+  mIndexRows = 0;
+
+  int numPoints = mCachedBaseData.size();
+  if ( numPoints == 0 )
+  {
+    return;
+  }
+
+  double xMin = std::numeric_limits<double>::max();
+  double yMin = std::numeric_limits<double>::max();
+  double xMax = -std::numeric_limits<double>::max();
+  double yMax = -std::numeric_limits<double>::max();
+  QVector<vertexData>::const_iterator vertex_it = mCachedBaseData.constBegin();
+  for ( ; vertex_it != mCachedBaseData.constEnd(); ++vertex_it )
+  {
+    xMin = qMin( xMin, vertex_it->x );
+    yMin = qMin( yMin, vertex_it->y );
+    xMax = qMax( xMax, vertex_it->x );
+    yMax = qMax( yMax, vertex_it->y );
+  }
+
+  // about two points per cell, points on a line are spread along it
+  double width = xMax - xMin;
+  double height = yMax - yMin;
+  double cellSize;
+  if ( width > 0 && height > 0 )
+  {
+    cellSize = sqrt( 2.0 * width * height / numPoints );
+  }
+  else
+  {
+    cellSize = qMax( width, height ) / qMax( 1, numPoints / 2 );
+  }
+  if ( !( cellSize > 0 ) )
+  {
+    cellSize = 1.0;
+  }
+
+  // very elongated extents would need too many cells
+  while (( width / cellSize + 1 ) * ( height / cellSize + 1 ) > 4.0 * numPoints + 16 )
+  {
+    cellSize *= 2;
+  }
+
+  mIndexXMin = xMin;
+  mIndexYMin = yMin;
+  mIndexCellSize = cellSize;
+  mIndexColumns = ( int )( width / cellSize ) + 1;
+  mIndexRows = ( int )( height / cellSize ) + 1;
+
+  // counting sort of the points by cell
+  QVector<int> pointCells( numPoints );
+  mIndexCellStart.fill( 0, mIndexColumns * mIndexRows + 1 );
+  for ( int i = 0; i < numPoints; ++i )
+  {
+    const vertexData& vertex = mCachedBaseData.at( i );
+    int column = qMin(( int )(( vertex.x - xMin ) / cellSize ), mIndexColumns - 1 );
+    int row = qMin(( int )(( vertex.y - yMin ) / cellSize ), mIndexRows - 1 );
+    pointCells[i] = row * mIndexColumns + column;
+    mIndexCellStart[ pointCells[i] + 1 ]++;
+  }
+  for ( int c = 0; c < mIndexColumns * mIndexRows; ++c )
+  {
+    mIndexCellStart[c + 1] += mIndexCellStart[c];
+  }
+
+  mIndexPoints.resize( numPoints );
+  QVector<int> cellFill = mIndexCellStart;
+  for ( int i = 0; i < numPoints; ++i )
+  {
+    mIndexPoints[ cellFill[ pointCells[i] ]++ ] = i;
+  }
+}
+
+void QgsIDWInterpolator::nearestNeighbours( double x, double y, int k, QVector<int>& points ) const
+{
+  points.clear();
+  k = qMin( k, mIndexPoints.size() );
+  if ( k <= 0 )
+  {
+    return;
+  }
+
+  // start at the cell closest to the location
+  double fx = ( x - mIndexXMin ) / mIndexCellSize;
+  double fy = ( y - mIndexYMin ) / mIndexCellSize;
+  int cx = ( int ) qBound( 0.0, floor( fx ), ( double )( mIndexColumns - 1 ) );
+  int cy = ( int ) qBound( 0.0, floor( fy ), ( double )( mIndexRows - 1 ) );
+
+  // max-heap of the k closest points found so far
+  std::priority_queue< std::pair<double, int> > closest;
+
+  for ( int r = 0; ; ++r )
+  {
+    // visit the cells of ring r around the start cell
+    int rowMin = qMax( cy - r, 0 );
+    int rowMax = qMin( cy + r, mIndexRows - 1 );
+    for ( int row = rowMin; row <= rowMax; ++row )
+    {
+      bool fullRow = row == cy - r || row == cy + r;
+      int step = fullRow ? 1 : 2 * r;
+      for ( int column = cx - r; column <= cx + r; column += step )
+      {
+        if ( column >= 0 && column < mIndexColumns )
+        {
+          int cell = row * mIndexColumns + column;
+          for ( int p = mIndexCellStart[cell]; p < mIndexCellStart[cell + 1]; ++p )
+          {
+            int point = mIndexPoints[p];
+            double d2 = squaredDistance( point, x, y );
+            if (( int ) closest.size() < k )
+            {
+              closest.push( std::make_pair( d2, point ) );
+            }
+            else if ( d2 < closest.top().first )
+            {
+              closest.pop();
+              closest.push( std::make_pair( d2, point ) );
+            }
+          }
+        }
+      }
+    }
+
+    // lower bound of the distance to points in cells outside of the searched block
+    double bound = std::numeric_limits<double>::max();
+    bool remaining = false;
+    if ( cx - r > 0 )
+    {
+      remaining = true;
+      bound = qMin( bound, x - ( mIndexXMin + ( cx - r ) * mIndexCellSize ) );
+    }
+    if ( cx + r < mIndexColumns - 1 )
+    {
+      remaining = true;
+      bound = qMin( bound, mIndexXMin + ( cx + r + 1 ) * mIndexCellSize - x );
+    }
+    if ( cy - r > 0 )
+    {
+      remaining = true;
+      bound = qMin( bound, y - ( mIndexYMin + ( cy - r ) * mIndexCellSize ) );
+    }
+    if ( cy + r < mIndexRows - 1 )
+    {
+      remaining = true;
+      bound = qMin( bound, mIndexYMin + ( cy + r + 1 ) * mIndexCellSize - y );
+    }
+
+    if ( !remaining )
+      break;
+    if (( int ) closest.size() == k && bound >= 0 && bound * bound >= closest.top().first )
+      break;
+  }
+
+  points.resize( closest.size() );
+  for ( int i = points.size() - 1; i >= 0; --i )
+  {
+    points[i] = closest.top().second;
+    closest.pop();
+  }
+}
+
+void QgsIDWInterpolator::pointsInRadius( double x, double y, double radius, QVector<int>& points ) const
+{
+  points.clear();
+  if ( !( radius > 0 ) || mIndexPoints.isEmpty() )
+  {
+    return;
+  }
+
+  double columnMin = floor(( x - radius - mIndexXMin ) / mIndexCellSize );
+  double columnMax = floor(( x + radius - mIndexXMin ) / mIndexCellSize );
+  double rowMin = floor(( y - radius - mIndexYMin ) / mIndexCellSize );
+  double rowMax = floor(( y + radius - mIndexYMin ) / mIndexCellSize );
+  if ( columnMax < 0 || rowMax < 0 || columnMin >= mIndexColumns || rowMin >= mIndexRows )
+  {
+    return;
+  }
+
+  int c0 = ( int ) qMax( columnMin, 0.0 );
+  int c1 = ( int ) qMin( columnMax, ( double )( mIndexColumns - 1 ) );
+  int r0 = ( int ) qMax( rowMin, 0.0 );
+  int r1 = ( int ) qMin( rowMax, ( double )( mIndexRows - 1 ) );
+
+  double radius2 = radius * radius;
+  for ( int row = r0; row <= r1; ++row )
+  {
+    for ( int column = c0; column <= c1; ++column )
+    {
+      int cell = row * mIndexColumns + column;
+      for ( int p = mIndexCellStart[cell]; p < mIndexCellStart[cell + 1]; ++p )
+      {
+        if ( squaredDistance( mIndexPoints[p], x, y ) <= radius2 )
+        {
+          points.append( mIndexPoints[p] );
+        }
+      }
+    }
+  }
+}
@@ -23,6 +23,15 @@
 class ANALYSIS_EXPORT QgsIDWInterpolator: public QgsInterpolator
 {
   public:
+    /**Describes which of the base data points are used to interpolate a value
+      @note added in 2.4*/
+    enum SearchMode
+    {
+      AllPoints,          //!< all points, the default
+      NearestNeighbours,  //!< the given number of points closest to the interpolated location
+      SearchRadius        //!< the points within the search radius of the interpolated location
+    };
+
     QgsIDWInterpolator( const QList<LayerData>& layerData );
     ~QgsIDWInterpolator();
 
@@ -35,14 +44,67 @@ class ANALYSIS_EXPORT QgsIDWInterpolator: public QgsInterpolator
 
     void setDistanceCoefficient( double p ) {mDistanceCoefficient = p;}
 
+    /**Sets which of the base data points are used to interpolate a value. The nearest
+      neighbour and search radius modes look up points in a grid index over the base data.
+      @note added in 2.4*/
+    void setSearchMode( SearchMode mode ) { mSearchMode = mode; mPrepared = false; }
+    SearchMode searchMode() const { return mSearchMode; }
+
+    /**Sets the number of points used in NearestNeighbours mode, the default is 12
+      @note added in 2.4*/
+    void setNumberOfNeighbours( int n ) { mNumberOfNeighbours = n; }
+    int numberOfNeighbours() const { return mNumberOfNeighbours; }
+
+    /**Sets the search radius (in map units) used in SearchRadius mode. Locations
+      without base data points within the radius are not interpolated.
+      @note added in 2.4*/
+    void setSearchRadius( double radius ) { mSearchRadius = radius; }
+    double searchRadius() const { return mSearchRadius; }
+
+    /**Caches the base data and builds the search index
+      @return false if the base data could not be cached
+      @note added in 2.4*/
+    bool prepareConcurrentInterpolation();
+
   private:
 
     QgsIDWInterpolator(); //forbidden
 
+    /**Builds the grid index over the cached base data*/
+    void buildIndex();
+
+    /**Collects the indices of the k nearest base data points, closest first*/
+    void nearestNeighbours( double x, double y, int k, QVector<int>& points ) const;
+
+    /**Collects the indices of the base data points within the radius*/
+    void pointsInRadius( double x, double y, double radius, QVector<int>& points ) const;
+
+    /**Returns the squared distance of a base data point*/
+    double squaredDistance( int point, double x, double y ) const;
+
     /**The parameter that sets how the values are weighted with distance.
        Smaller values mean sharper peaks at the data points. The default is a
        value of 2*/
     double mDistanceCoefficient;
+
+    SearchMode mSearchMode;
+    int mNumberOfNeighbours;
+    double mSearchRadius;
+
+    /**Set by prepareConcurrentInterpolation(), even if there is no base data. interpolatePoint()
+      does not modify the cache and the index afterwards*/
+    bool mPrepared;
+
+    /**Grid index: the points of cell c are mIndexPoints[mIndexCellStart[c]] to
+      mIndexPoints[mIndexCellStart[c + 1] - 1]*/
+    bool mIndexBuilt;
+    double mIndexXMin;
+    double mIndexYMin;
+    double mIndexCellSize;
+    int mIndexColumns;
+    int mIndexRows;
+    QVector<int> mIndexCellStart;
+    QVector<int> mIndexPoints;
 };
 
 #endif
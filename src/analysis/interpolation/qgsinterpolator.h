@@ -64,6 +64,12 @@ class ANALYSIS_EXPORT QgsInterpolator
        @return 0 in case of success*/
     virtual int interpolatePoint( double x, double y, double& result ) = 0;
 
+    /**Prepares the interpolator for calls of interpolatePoint() from several threads at
+       the same time, e.g. by caching the base data up front.
+       @return true if interpolatePoint() may be called concurrently, the default implementation returns false
+       @note added in 2.4*/
+    virtual bool prepareConcurrentInterpolation() { return false; }
+
     const QList<LayerData>& layerData() const { return mLayerData; }
 
   protected:
@@ -0,0 +1,838 @@
+/***************************************************************************
+  qgscontractionhierarchy.cpp
+  --------------------------------------
+  Date                 : May 2014
+  Copyright            : (C) 2014 by the QGIS project
+  Email                :
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgscontractionhierarchy.h"
+#include "qgsgraph.h"
+#include "qgsgraphsearchspace.h"
+#include "qgslogger.h"
+
+#include <QFile>
+#include <qnumeric.h>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <string.h>
+
+static const char sMagic[8] = { 'Q', 'G', 'S', 'C', 'H', 'G', 'R', 'F' };
+static const quint32 sVersion = 1;
+static const quint32 sByteOrderMark = 0x01020304;
+
+//! vertices settled by a witness search before it gives up and a shortcut is added
+static const int sWitnessSettleLimit = 500;
+//! smaller limit when only estimating the number of shortcuts for the contraction order
+static const int sSimulationSettleLimit = 50;
+
+/** Start of a serialized hierarchy, followed by the arrays listed in sectionOffsets() */
+struct QgsContractionHierarchyHeader
+{
+  char magic[8];
+  quint32 version;
+  quint32 byteOrder;
+  qint32 vertexCount;
+  qint32 arcCount;
+  qint32 shortcutCount;
+  qint32 upOutCount;
+  qint32 upInCount;
+  qint32 reserved;
+};
+
+enum QgsContractionHierarchySection
+{
+  SectionX,
+  SectionY,
+  SectionEdgeFrom,
+  SectionEdgeTo,
+  SectionShortcutChildren,
+  SectionUpOutOffsets,
+  SectionUpOut,
+  SectionUpInOffsets,
+  SectionUpIn,
+  SectionCount
+};
+
+//! byte offsets of the arrays, each aligned to 8 bytes. Returns the total size
+static qint64 sectionOffsets( const QgsContractionHierarchyHeader& header, int arcSize, qint64* offsets )
+{
+  qint64 edgeCount = ( qint64 ) header.arcCount + header.shortcutCount;
+  qint64 sizes[SectionCount];
+  sizes[SectionX] = header.vertexCount * ( qint64 ) sizeof( double );
+  sizes[SectionY] = sizes[SectionX];
+  sizes[SectionEdgeFrom] = edgeCount * sizeof( qint32 );
+  sizes[SectionEdgeTo] = sizes[SectionEdgeFrom];
+  sizes[SectionShortcutChildren] = 2 * ( qint64 ) header.shortcutCount * sizeof( qint32 );
+  sizes[SectionUpOutOffsets] = ( header.vertexCount + ( qint64 ) 1 ) * sizeof( qint32 );
+  sizes[SectionUpOut] = header.upOutCount * ( qint64 ) arcSize;
+  sizes[SectionUpInOffsets] = sizes[SectionUpOutOffsets];
+  sizes[SectionUpIn] = header.upInCount * ( qint64 ) arcSize;
+
+  qint64 offset = ( sizeof( QgsContractionHierarchyHeader ) + 7 ) & ~7;
+  for ( int i = 0; i < SectionCount; ++i )
+  {
+    offsets[i] = offset;
+    offset += ( sizes[i] + 7 ) & ~7;
+  }
+  return offset;
+}
+
+struct QgsContractionHierarchyWorkspace
+{
+  QgsGraphSearchSpace forward;
+  QgsGraphSearchSpace backward;
+};
+
+
+/** Contracts the vertices of a graph one by one, in the order of an edge difference heuristic */
+class QgsContractionHierarchyBuilder
+{
+  public:
+    struct BuildArc
+    {
+      int vertex;
+      int edge;
+      double cost;
+    };
+
+    QgsContractionHierarchyBuilder( int vertexCount )
+        : mOut( vertexCount ), mIn( vertexCount ), mUpOut( vertexCount ), mUpIn( vertexCount )
+        , mContracted( vertexCount, false ), mDeletedNeighbours( vertexCount, 0 ), mPriority( vertexCount, 0.0 )
+    {
+    }
+
+    void addArc( int from, int to, double cost )
+    {
+      int edge = mEdgeFrom.size();
+      mEdgeFrom.push_back( from );
+      mEdgeTo.push_back( to );
+      // loops are never part of a shortest path, of parallel arcs only the cheapest one is
+      if ( from != to && !hasCheaperArc( from, to, cost ) )
+        insertArc( from, to, edge, cost );
+    }
+
+    void contractAll()
+    {
+      int vertexCount = mOut.size();
+      QgsDAryHeap<4> queue;
+      for ( int v = 0; v < vertexCount; ++v )
+      {
+        mPriority[v] = priority( v );
+        queue.push( mPriority[v], v );
+      }
+
+      // queue entries are outdated if the vertex was contracted or got a new priority since
+      while ( !queue.isEmpty() )
+      {
+        int v = queue.top().vertex;
+        double key = queue.top().key;
+        queue.pop();
+        if ( mContracted[v] || key != mPriority[v] )
+          continue;
+
+        // lazy update: a vertex whose priority grew since it was queued goes back into the queue
+        double p = priority( v );
+        if ( p > key )
+        {
+          mPriority[v] = p;
+          queue.push( p, v );
+          continue;
+        }
+
+        std::vector<int> neighbours;
+        for ( size_t i = 0; i < mIn[v].size(); ++i )
+          neighbours.push_back( mIn[v][i].vertex );
+        for ( size_t i = 0; i < mOut[v].size(); ++i )
+          neighbours.push_back( mOut[v][i].vertex );
+
+        contract( v );
+
+        // the neighbours lost arcs and gained shortcuts
+        std::sort( neighbours.begin(), neighbours.end() );
+        neighbours.erase( std::unique( neighbours.begin(), neighbours.end() ), neighbours.end() );
+        for ( size_t i = 0; i < neighbours.size(); ++i )
+        {
+          int w = neighbours[i];
+          mPriority[w] = priority( w );
+          queue.push( mPriority[w], w );
+        }
+      }
+    }
+
+    std::vector< std::vector<BuildArc> > mOut;
+    std::vector< std::vector<BuildArc> > mIn;
+    std::vector< std::vector<BuildArc> > mUpOut;
+    std::vector< std::vector<BuildArc> > mUpIn;
+    std::vector<qint32> mEdgeFrom;
+    std::vector<qint32> mEdgeTo;
+    std::vector<qint32> mShortcutChildren;
+
+  private:
+    bool hasCheaperArc( int from, int to, double cost ) const
+    {
+      const std::vector<BuildArc>& arcs = mOut[from];
+      for ( size_t i = 0; i < arcs.size(); ++i )
+      {
+        if ( arcs[i].vertex == to )
+          return arcs[i].cost <= cost;
+      }
+      return false;
+    }
+
+    //! inserts an arc or replaces a more expensive one between the same vertices
+    void insertArc( int from, int to, int edge, double cost )
+    {
+      std::vector<BuildArc>& out = mOut[from];
+      std::vector<BuildArc>& in = mIn[to];
+      for ( size_t i = 0; i < out.size(); ++i )
+      {
+        if ( out[i].vertex == to )
+        {
+          out[i].edge = edge;
+          out[i].cost = cost;
+          for ( size_t j = 0; j < in.size(); ++j )
+          {
+            if ( in[j].vertex == from )
+            {
+              in[j].edge = edge;
+              in[j].cost = cost;
+            }
+          }
+          return;
+        }
+      }
+      BuildArc a;
+      a.edge = edge;
+      a.cost = cost;
+      a.vertex = to;
+      out.push_back( a );
+      a.vertex = from;
+      in.push_back( a );
+    }
+
+    static void removeArcsTo( std::vector<BuildArc>& arcs, int vertex )
+    {
+      size_t j = 0;
+      for ( size_t i = 0; i < arcs.size(); ++i )
+      {
+        if ( arcs[i].vertex != vertex )
+          arcs[j++] = arcs[i];
+      }
+      arcs.resize( j );
+    }
+
+    /**
+     * Dijkstra from start among the remaining vertices without the vertex being contracted,
+     * limited to paths cheaper than maxCost and to settleLimit settled vertices
+     */
+    void witnessSearch( int start, int excluded, double maxCost, int settleLimit )
+    {
+      QgsGraphSearchSpace& s = mWitness;
+      s.reset( mOut.size() );
+      s.reach( start, 0.0, -1 );
+      s.heap.push( 0.0, start );
+
+      int settled = 0;
+      while ( true )
+      {
+        s.skipSettled();
+        if ( s.heap.isEmpty() || s.heap.top().key > maxCost || ++settled > settleLimit )
+          break;
+
+        int v = s.heap.top().vertex;
+        s.heap.pop();
+        s.settle( v );
+
+        const std::vector<BuildArc>& arcs = mOut[v];
+        for ( size_t i = 0; i < arcs.size(); ++i )
+        {
+          int w = arcs[i].vertex;
+          if ( w == excluded || s.isSettled( w ) )
+            continue;
+          double cost = s.cost[v] + arcs[i].cost;
+          if ( !s.isReached( w ) || cost < s.cost[w] )
+          {
+            s.reach( w, cost, -1 );
+            s.heap.push( cost, w );
+          }
+        }
+      }
+    }
+
+    //! number of shortcuts needed to contract v, adds them unless simulate is set
+    int shortcuts( int v, bool simulate )
+    {
+      int count = 0;
+      const std::vector<BuildArc>& in = mIn[v];
+      const std::vector<BuildArc>& out = mOut[v];
+      for ( size_t i = 0; i < in.size(); ++i )
+      {
+        int u = in[i].vertex;
+        double maxCost = -1;
+        for ( size_t j = 0; j < out.size(); ++j )
+        {
+          if ( out[j].vertex != u )
+            maxCost = qMax( maxCost, in[i].cost + out[j].cost );
+        }
+        if ( maxCost < 0 )
+          continue;
+
+        witnessSearch( u, v, maxCost, simulate ? sSimulationSettleLimit : sWitnessSettleLimit );
+        for ( size_t j = 0; j < out.size(); ++j )
+        {
+          int w = out[j].vertex;
+          double cost = in[i].cost + out[j].cost;
+          if ( w == u || ( mWitness.isReached( w ) && mWitness.cost[w] <= cost ) )
+            continue;
+
+          ++count;
+          if ( simulate || hasCheaperArc( u, w, cost ) )
+            continue;
+
+          int edge = mEdgeFrom.size();
+          mEdgeFrom.push_back( u );
+          mEdgeTo.push_back( w );
+          mShortcutChildren.push_back( in[i].edge );
+          mShortcutChildren.push_back( out[j].edge );
+          insertArc( u, w, edge, cost );
+        }
+      }
+      return count;
+    }
+
+    double priority( int v )
+    {
+      return shortcuts( v, true ) - ( int )( mIn[v].size() + mOut[v].size() ) + mDeletedNeighbours[v];
+    }
+
+    void contract( int v )
+    {
+      shortcuts( v, false );
+
+      // the remaining neighbours are contracted later, i.e. are more important
+      mUpOut[v] = mOut[v];
+      mUpIn[v] = mIn[v];
+
+      for ( size_t i = 0; i < mIn[v].size(); ++i )
+      {
+        removeArcsTo( mOut[ mIn[v][i].vertex ], v );
+        ++mDeletedNeighbours[ mIn[v][i].vertex ];
+      }
+      for ( size_t i = 0; i < mOut[v].size(); ++i )
+      {
+        removeArcsTo( mIn[ mOut[v][i].vertex ], v );
+        ++mDeletedNeighbours[ mOut[v][i].vertex ];
+      }
+      std::vector<BuildArc>().swap( mOut[v] );
+      std::vector<BuildArc>().swap( mIn[v] );
+      mContracted[v] = true;
+    }
+
+    std::vector<bool> mContracted;
+    std::vector<int> mDeletedNeighbours;
+    std::vector<double> mPriority;
+    QgsGraphSearchSpace mWitness;
+};
+
+
+QgsContractionHierarchy::QgsContractionHierarchy()
+    : mFile( 0 ), mData( 0 ), mDataSize( 0 ), mHeader( 0 )
+    , mGridXMin( 0.0 ), mGridYMin( 0.0 ), mGridCellSize( 1.0 ), mGridColumns( 0 ), mGridRows( 0 )
+{
+}
+
+QgsContractionHierarchy::QgsContractionHierarchy( const QgsGraph* graph, int criterionNum )
+    : mFile( 0 ), mData( 0 ), mDataSize( 0 ), mHeader( 0 )
+    , mGridXMin( 0.0 ), mGridYMin( 0.0 ), mGridCellSize( 1.0 ), mGridColumns( 0 ), mGridRows( 0 )
+{
+  int vertexCount = graph->vertexCount();
+  QgsContractionHierarchyBuilder builder( vertexCount );
+  for ( int i = 0; i < graph->arcCount(); ++i )
+  {
+    const QgsGraphArc& arc = graph->arc( i );
+    double cost = arc.property( criterionNum ).toDouble();
+    if ( cost < 0 )
+    {
+      QgsDebugMsg( QString( "arc %1 has a negative cost" ).arg( i ) );
+      return;
+    }
+    builder.addArc( arc.outVertex(), arc.inVertex(), cost );
+  }
+  builder.contractAll();
+
+  QgsContractionHierarchyHeader header;
+  memcpy( header.magic, sMagic, sizeof( sMagic ) );
+  header.version = sVersion;
+  header.byteOrder = sByteOrderMark;
+  header.vertexCount = vertexCount;
+  header.arcCount = graph->arcCount();
+  header.shortcutCount = builder.mEdgeFrom.size() - graph->arcCount();
+  header.upOutCount = 0;
+  header.upInCount = 0;
+  header.reserved = 0;
+  for ( int v = 0; v < vertexCount; ++v )
+  {
+    header.upOutCount += builder.mUpOut[v].size();
+    header.upInCount += builder.mUpIn[v].size();
+  }
+
+  qint64 offsets[SectionCount];
+  qint64 size = sectionOffsets( header, sizeof( Arc ), offsets );
+  mBuffer.fill( 0.0, ( size + 7 ) / 8 );
+  char* data = ( char* ) mBuffer.data();
+
+  memcpy( data, &header, sizeof( header ) );
+  double* x = ( double* )( data + offsets[SectionX] );
+  double* y = ( double* )( data + offsets[SectionY] );
+  for ( int v = 0; v < vertexCount; ++v )
+  {
+    QgsPoint pt = graph->vertex( v ).point();
+    x[v] = pt.x();
+    y[v] = pt.y();
+  }
+  if ( !builder.mEdgeFrom.empty() )
+  {
+    memcpy( data + offsets[SectionEdgeFrom], &builder.mEdgeFrom[0], builder.mEdgeFrom.size() * sizeof( qint32 ) );
+    memcpy( data + offsets[SectionEdgeTo], &builder.mEdgeTo[0], builder.mEdgeTo.size() * sizeof( qint32 ) );
+  }
+  if ( !builder.mShortcutChildren.empty() )
+  {
+    memcpy( data + offsets[SectionShortcutChildren], &builder.mShortcutChildren[0], builder.mShortcutChildren.size() * sizeof( qint32 ) );
+  }
+
+  for ( int dir = 0; dir < 2; ++dir )
+  {
+    const std::vector< std::vector<QgsContractionHierarchyBuilder::BuildArc> >& lists = dir == 0 ? builder.mUpOut : builder.mUpIn;
+    qint32* arcOffsets = ( qint32* )( data + offsets[ dir == 0 ? SectionUpOutOffsets : SectionUpInOffsets ] );
+    Arc* arcs = ( Arc* )( data + offsets[ dir == 0 ? SectionUpOut : SectionUpIn ] );
+    int n = 0;
+    for ( int v = 0; v < vertexCount; ++v )
+    {
+      arcOffsets[v] = n;
+      for ( size_t i = 0; i < lists[v].size(); ++i, ++n )
+      {
+        arcs[n].vertex = lists[v][i].vertex;
+        arcs[n].edge = lists[v][i].edge;
+        arcs[n].cost = lists[v][i].cost;
+      }
+    }
+    arcOffsets[vertexCount] = n;
+  }
+
+  setData( data, size );
+}
+
+QgsContractionHierarchy::~QgsContractionHierarchy()
+{
+  qDeleteAll( mWorkspaces );
+  delete mFile;
+}
+
+QgsContractionHierarchy* QgsContractionHierarchy::fromFile( const QString& fileName )
+{
+  QFile* file = new QFile( fileName );
+  if ( !file->open( QIODevice::ReadOnly ) )
+  {
+    QgsDebugMsg( QString( "could not open %1" ).arg( fileName ) );
+    delete file;
+    return 0;
+  }
+
+  uchar* data = file->map( 0, file->size() );
+  if ( !data )
+  {
+    QgsDebugMsg( QString( "could not map %1" ).arg( fileName ) );
+    delete file;
+    return 0;
+  }
+
+  QgsContractionHierarchy* ch = new QgsContractionHierarchy();
+  ch->mFile = file;
+  if ( !ch->setData(( const char* ) data, file->size() ) )
+  {
+    QgsDebugMsg( QString( "%1 is not a valid contraction hierarchy" ).arg( fileName ) );
+    delete ch;
+    return 0;
+  }
+  return ch;
+}
+
+bool QgsContractionHierarchy::setData( const char* data, qint64 size )
+{
+  mHeader = 0;
+  if ( size < ( qint64 ) sizeof( QgsContractionHierarchyHeader ) )
+    return false;
+
+  const QgsContractionHierarchyHeader* header = ( const QgsContractionHierarchyHeader* ) data;
+  if ( memcmp( header->magic, sMagic, sizeof( sMagic ) ) != 0 || header->version != sVersion || header->byteOrder != sByteOrderMark )
+    return false;
+  if ( header->vertexCount < 0 || header->arcCount < 0 || header->shortcutCount < 0 || header->upOutCount < 0 || header->upInCount < 0 )
+    return false;
+
+  qint64 offsets[SectionCount];
+  if ( sectionOffsets( *header, sizeof( Arc ), offsets ) != size )
+    return false;
+
+  mData = data;
+  mDataSize = size;
+  mX = ( const double* )( data + offsets[SectionX] );
+  mY = ( const double* )( data + offsets[SectionY] );
+  mEdgeFrom = ( const qint32* )( data + offsets[SectionEdgeFrom] );
+  mEdgeTo = ( const qint32* )( data + offsets[SectionEdgeTo] );
+  mShortcutChildren = ( const qint32* )( data + offsets[SectionShortcutChildren] );
+  mUpOutOffsets = ( const qint32* )( data + offsets[SectionUpOutOffsets] );
+  mUpOut = ( const Arc* )( data + offsets[SectionUpOut] );
+  mUpInOffsets = ( const qint32* )( data + offsets[SectionUpInOffsets] );
+  mUpIn = ( const Arc* )( data + offsets[SectionUpIn] );
+
+  // the queries index the arrays without checks, so a corrupt file must be rejected here
+  int vertexCount = header->vertexCount;
+  qint64 edgeCount = ( qint64 ) header->arcCount + header->shortcutCount;
+  for ( int v = 0; v < vertexCount; ++v )
+  {
+    if ( !qIsFinite( mX[v] ) || !qIsFinite( mY[v] ) )
+      return false;
+  }
+  for ( qint64 e = 0; e < edgeCount; ++e )
+  {
+    if ( mEdgeFrom[e] < 0 || mEdgeFrom[e] >= vertexCount || mEdgeTo[e] < 0 || mEdgeTo[e] >= vertexCount )
+      return false;
+  }
+  // children of a shortcut are added before it, so unpacking always terminates
+  for ( qint64 i = 0; i < 2 * ( qint64 ) header->shortcutCount; ++i )
+  {
+    if ( mShortcutChildren[i] < 0 || mShortcutChildren[i] >= header->arcCount + i / 2 )
+      return false;
+  }
+  if ( !validArcs( mUpOutOffsets, mUpOut, header->upOutCount, vertexCount, edgeCount ) ||
+       !validArcs( mUpInOffsets, mUpIn, header->upInCount, vertexCount, edgeCount ) )
+    return false;
+
+  mHeader = header;
+  buildGrid();
+  return true;
+}
+
+bool QgsContractionHierarchy::validArcs( const qint32* offsets, const Arc* arcs, int arcCount, int vertexCount, qint64 edgeCount )
+{
+  if ( offsets[0] != 0 || offsets[vertexCount] != arcCount )
+    return false;
+  for ( int v = 0; v < vertexCount; ++v )
+  {
+    if ( offsets[v + 1] < offsets[v] )
+      return false;
+  }
+  for ( int i = 0; i < arcCount; ++i )
+  {
+    if ( arcs[i].vertex < 0 || arcs[i].vertex >= vertexCount || arcs[i].edge < 0 || arcs[i].edge >= edgeCount || !( arcs[i].cost >= 0.0 ) )
+      return false;
+  }
+  return true;
+}
+
+void QgsContractionHierarchy::buildGrid()
+{
+  int vertexCount = mHeader->vertexCount;
+  mGridOffsets.clear();
+  mGridVertices.clear();
+  if ( vertexCount == 0 )
+    return;
+
+  double xMin = mX[0], xMax = mX[0], yMin = mY[0], yMax = mY[0];
+  for ( int v = 1; v < vertexCount; ++v )
+  {
+    xMin = qMin( xMin, mX[v] );
+    xMax = qMax( xMax, mX[v] );
+    yMin = qMin( yMin, mY[v] );
+    yMax = qMax( yMax, mY[v] );
+  }
+
+  // about two vertices per cell if they are evenly spread
+  double width = qMax( xMax - xMin, 1E-9 );
+  double height = qMax( yMax - yMin, 1E-9 );
+  mGridCellSize = sqrt( width * height * 2.0 / vertexCount );
+  mGridCellSize = qMax( mGridCellSize, qMax( width, height ) / 4096 );
+  mGridXMin = xMin;
+  mGridYMin = yMin;
+  mGridColumns = qMin(( int )( width / mGridCellSize ) + 1, 4096 );
+  mGridRows = qMin(( int )( height / mGridCellSize ) + 1, 4096 );
+
+  // counting sort of the vertices by cell
+  mGridOffsets.fill( 0, mGridColumns * mGridRows + 1 );
+  QVector<int> vertexCells( vertexCount );
+  for ( int v = 0; v < vertexCount; ++v )
+  {
+    vertexCells[v] = gridCell( gridColumn( mX[v] ), gridRow( mY[v] ) );
+    ++mGridOffsets[ vertexCells[v] + 1 ];
+  }
+  for ( int c = 0; c < mGridColumns * mGridRows; ++c )
+    mGridOffsets[c + 1] += mGridOffsets[c];
+  mGridVertices.resize( vertexCount );
+  QVector<int> next = mGridOffsets;
+  for ( int v = 0; v < vertexCount; ++v )
+    mGridVertices[ next[ vertexCells[v] ]++ ] = v;
+}
+
+//! index of the cell containing a coordinate, clamped to the grid. Clamped before the conversion to int to avoid overflows
+static int gridIndex( double value, double min, double cellSize, int count )
+{
+  double index = floor(( value - min ) / cellSize );
+  if ( index < 0 )
+    return 0;
+  if ( index >= count - 1 )
+    return count - 1;
+  return ( int ) index;
+}
+
+int QgsContractionHierarchy::gridColumn( double x ) const
+{
+  return gridIndex( x, mGridXMin, mGridCellSize, mGridColumns );
+}
+
+int QgsContractionHierarchy::gridRow( double y ) const
+{
+  return gridIndex( y, mGridYMin, mGridCellSize, mGridRows );
+}
+
+bool QgsContractionHierarchy::writeToFile( const QString& fileName ) const
+{
+  if ( !mHeader )
+    return false;
+
+  QFile file( fileName );
+  if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+  {
+    QgsDebugMsg( QString( "could not open %1 for writing" ).arg( fileName ) );
+    return false;
+  }
+  return file.write( mData, mDataSize ) == mDataSize;
+}
+
+int QgsContractionHierarchy::vertexCount() const
+{
+  return mHeader ? mHeader->vertexCount : 0;
+}
+
+int QgsContractionHierarchy::arcCount() const
+{
+  return mHeader ? mHeader->arcCount : 0;
+}
+
+int QgsContractionHierarchy::shortcutCount() const
+{
+  return mHeader ? mHeader->shortcutCount : 0;
+}
+
+QgsPoint QgsContractionHierarchy::vertexPoint( int vertexIdx ) const
+{
+  if ( !isValidVertex( vertexIdx ) )
+    return QgsPoint();
+  return QgsPoint( mX[vertexIdx], mY[vertexIdx] );
+}
+
+int QgsContractionHierarchy::closestVertex( const QgsPoint& pt ) const
+{
+  if ( !mHeader || mGridVertices.isEmpty() || !qIsFinite( pt.x() ) || !qIsFinite( pt.y() ) )
+    return -1;
+
+  // search rings of cells around the cell of the point until no unvisited cell can be closer
+  double px = pt.x();
+  double py = pt.y();
+  int column = gridColumn( px );
+  int row = gridRow( py );
+  int closest = -1;
+  double minDist = std::numeric_limits<double>::max();
+  for ( int r = 0; ; ++r )
+  {
+    int c0 = column - r, c1 = column + r, r0 = row - r, r1 = row + r;
+    for ( int j = qMax( r0, 0 ); j <= qMin( r1, mGridRows - 1 ); ++j )
+    {
+      bool edgeRow = j == r0 || j == r1;
+      for ( int i = qMax( c0, 0 ); i <= qMin( c1, mGridColumns - 1 ); ++i )
+      {
+        if ( !edgeRow && i != c0 && i != c1 )
+          continue;
+        int cell = gridCell( i, j );
+        for ( int k = mGridOffsets[cell]; k < mGridOffsets[cell + 1]; ++k )
+        {
+          int v = mGridVertices[k];
+          double dx = mX[v] - px;
+          double dy = mY[v] - py;
+          double dist = dx * dx + dy * dy;
+          if ( dist < minDist || ( dist == minDist && v < closest ) )
+          {
+            minDist = dist;
+            closest = v;
+          }
+        }
+      }
+    }
+
+    // distance from the point to the cells outside of the searched block
+    double bound = std::numeric_limits<double>::max();
+    if ( c0 > 0 )
+      bound = qMin( bound, px - ( mGridXMin + c0 * mGridCellSize ) );
+    if ( c1 < mGridColumns - 1 )
+      bound = qMin( bound, mGridXMin + ( c1 + 1 ) * mGridCellSize - px );
+    if ( r0 > 0 )
+      bound = qMin( bound, py - ( mGridYMin + r0 * mGridCellSize ) );
+    if ( r1 < mGridRows - 1 )
+      bound = qMin( bound, mGridYMin + ( r1 + 1 ) * mGridCellSize - py );
+    if ( bound == std::numeric_limits<double>::max() || ( closest != -1 && bound * bound > minDist ) )
+      break;
+  }
+  return closest;
+}
+
+QgsContractionHierarchyWorkspace* QgsContractionHierarchy::acquireWorkspace() const
+{
+  QMutexLocker locker( &mWorkspaceMutex );
+  if ( mWorkspaces.isEmpty() )
+    return new QgsContractionHierarchyWorkspace();
+  return mWorkspaces.takeLast();
+}
+
+void QgsContractionHierarchy::releaseWorkspace( QgsContractionHierarchyWorkspace* ws ) const
+{
+  QMutexLocker locker( &mWorkspaceMutex );
+  mWorkspaces.append( ws );
+}
+
+void QgsContractionHierarchy::unpackEdge( int edge, QVector<int>& arcs ) const
+{
+  QVector<int> stack;
+  stack.append( edge );
+  while ( !stack.isEmpty() )
+  {
+    int e = stack.last();
+    stack.pop_back();
+    if ( e < mHeader->arcCount )
+    {
+      arcs.append( e );
+    }
+    else
+    {
+      const qint32* children = mShortcutChildren + 2 * ( e - mHeader->arcCount );
+      stack.append( children[1] );
+      stack.append( children[0] );
+    }
+  }
+}
+
+double QgsContractionHierarchy::shortestPath( int startVertexIdx, int stopVertexIdx, QVector<int>* resultArcs ) const
+{
+  if ( resultArcs )
+    resultArcs->clear();
+  if ( !isValidVertex( startVertexIdx ) || !isValidVertex( stopVertexIdx ) )
+  {
+    QgsDebugMsg( QString( "invalid vertex %1 or %2" ).arg( startVertexIdx ).arg( stopVertexIdx ) );
+    return std::numeric_limits<double>::infinity();
+  }
+  if ( startVertexIdx == stopVertexIdx )
+    return 0.0;
+
+  QgsContractionHierarchyWorkspace* ws = acquireWorkspace();
+  QgsGraphSearchSpace& f = ws->forward;
+  QgsGraphSearchSpace& b = ws->backward;
+  f.reset( vertexCount() );
+  b.reset( vertexCount() );
+
+  f.reach( startVertexIdx, 0.0, -1 );
+  f.heap.push( 0.0, startVertexIdx );
+  b.reach( stopVertexIdx, 0.0, -1 );
+  b.heap.push( 0.0, stopVertexIdx );
+
+  double best = std::numeric_limits<double>::infinity();
+  int meetingVertex = -1;
+
+  // both searches only go upwards and meet at the most important vertex of the path.
+  // Each one stops when it cannot improve the best path any more
+  bool forward = true;
+  while ( true )
+  {
+    f.skipSettled();
+    b.skipSettled();
+    bool forwardDone = f.heap.isEmpty() || f.heap.top().key >= best;
+    bool backwardDone = b.heap.isEmpty() || b.heap.top().key >= best;
+    if ( forwardDone && backwardDone )
+      break;
+    if ( forwardDone || backwardDone )
+      forward = backwardDone;
+
+    QgsGraphSearchSpace& s = forward ? f : b;
+    const QgsGraphSearchSpace& other = forward ? b : f;
+    const qint32* offsets = forward ? mUpOutOffsets : mUpInOffsets;
+    const Arc* arcs = forward ? mUpOut : mUpIn;
+    const qint32* stallOffsets = forward ? mUpInOffsets : mUpOutOffsets;
+    const Arc* stallArcs = forward ? mUpIn : mUpOut;
+
+    int v = s.heap.top().vertex;
+    s.heap.pop();
+    s.settle( v );
+    forward = !forward;
+
+    // stall on demand: a vertex reached cheaper from a more important vertex is not on a shortest
+    // path, so its arcs need not be searched
+    double cost = s.cost[v];
+    bool stalled = false;
+    for ( int i = stallOffsets[v]; i < stallOffsets[v + 1] && !stalled; ++i )
+    {
+      const Arc& arc = stallArcs[i];
+      stalled = s.isReached( arc.vertex ) && s.cost[ arc.vertex ] + arc.cost < cost;
+    }
+    if ( stalled )
+      continue;
+
+    for ( int i = offsets[v]; i < offsets[v + 1]; ++i )
+    {
+      const Arc& arc = arcs[i];
+      if ( s.isSettled( arc.vertex ) )
+        continue;
+      double newCost = cost + arc.cost;
+      if ( !s.isReached( arc.vertex ) || newCost < s.cost[ arc.vertex ] )
+      {
+        s.reach( arc.vertex, newCost, arc.edge );
+        s.heap.push( newCost, arc.vertex );
+      }
+      if ( other.isReached( arc.vertex ) && newCost + other.cost[ arc.vertex ] < best )
+      {
+        best = newCost + other.cost[ arc.vertex ];
+        meetingVertex = arc.vertex;
+      }
+    }
+  }
+
+  if ( resultArcs && meetingVertex != -1 )
+  {
+    QVector<int> edges;
+    int v = meetingVertex;
+    while ( f.parentArc[v] != -1 )
+    {
+      edges.append( f.parentArc[v] );
+      v = mEdgeFrom[ f.parentArc[v] ];
+    }
+    std::reverse( edges.begin(), edges.end() );
+    v = meetingVertex;
+    while ( b.parentArc[v] != -1 )
+    {
+      edges.append( b.parentArc[v] );
+      v = mEdgeTo[ b.parentArc[v] ];
+    }
+
+    foreach ( int edge, edges )
+      unpackEdge( edge, *resultArcs );
+  }
+
+  releaseWorkspace( ws );
+  return best;
+}
@@ -0,0 +1,170 @@
+/***************************************************************************
+  qgscontractionhierarchy.h
+  --------------------------------------
+  Date                 : May 2014
+  Copyright            : (C) 2014 by the QGIS project
+  Email                :
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSCONTRACTIONHIERARCHY_H
+#define QGSCONTRACTIONHIERARCHY_H
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include "qgspoint.h"
+
+class QFile;
+class QgsGraph;
+struct QgsContractionHierarchyHeader;
+struct QgsContractionHierarchyWorkspace;
+
+/**
+ * \ingroup networkanalysis
+ * \class QgsContractionHierarchy
+ * \brief Preprocessed graph for fast point to point shortest path queries.
+ *
+ * Building a contraction hierarchy orders the vertices by importance and adds shortcut arcs
+ * which skip less important vertices. A query then only searches upwards in the hierarchy from
+ * both ends and settles a few hundred vertices even on large road networks.
+ *
+ * The preprocessing is done once with the constructor and saved with writeToFile(). fromFile()
+ * maps a saved hierarchy into memory without parsing it, so it is ready for queries immediately.
+ * Files are written in the byte order of the machine and are not portable between architectures.
+ *
+ * Arc costs must not be negative. Query methods are const and may be called from several threads
+ * at the same time. Vertex and arc indexes are those of the source graph.
+ * @note added in 2.4
+ */
+class ANALYSIS_EXPORT QgsContractionHierarchy
+{
+  public:
+    /**
+     * Builds the contraction hierarchy of a graph. This is slow for large graphs
+     * @param graph source graph, not referenced after construction
+     * @param criterionNum index of arc property used as cost
+     */
+    QgsContractionHierarchy( const QgsGraph* graph, int criterionNum );
+    ~QgsContractionHierarchy();
+
+    /**
+     * Maps a hierarchy saved with writeToFile()
+     * @return the hierarchy or 0 if the file could not be read
+     */
+    static QgsContractionHierarchy* fromFile( const QString& fileName );
+
+    //! false if building or loading failed
+    bool isValid() const { return mHeader != 0; }
+
+    /**
+     * Saves the hierarchy
+     * @return true in case of success
+     */
+    bool writeToFile( const QString& fileName ) const;
+
+    //! number of vertices of the graph
+    int vertexCount() const;
+
+    //! number of arcs of the source graph
+    int arcCount() const;
+
+    //! number of shortcut arcs added by the preprocessing
+    int shortcutCount() const;
+
+    //! coordinates of a vertex
+    QgsPoint vertexPoint( int vertexIdx ) const;
+
+    //! index of the vertex closest to a point or -1 if the graph is empty. Uses a grid of the vertices
+    //! built when the hierarchy is created or loaded
+    int closestVertex( const QgsPoint& pt ) const;
+
+    /**
+     * Shortest path between two vertices
+     * @param startVertexIdx index of start vertex
+     * @param stopVertexIdx index of stop vertex
+     * @param resultArcs if not null, receives the arcs of the source graph along the path in order
+     * @return cost of the path or infinity if the stop vertex is not reachable
+     */
+    double shortestPath( int startVertexIdx, int stopVertexIdx, QVector<int>* resultArcs = 0 ) const;
+
+  private:
+    QgsContractionHierarchy();
+    QgsContractionHierarchy( const QgsContractionHierarchy& rh );
+    QgsContractionHierarchy& operator=( const QgsContractionHierarchy& rh );
+
+    //! arc of the upward graphs, as stored in the file
+    struct Arc
+    {
+      qint32 vertex; //!< other vertex of the arc
+      qint32 edge; //!< arc of the source graph or arcCount() + shortcut index
+      double cost;
+    };
+
+    /**
+     * Sets the array pointers into the serialized hierarchy
+     * @return false if the data is not a valid hierarchy
+     */
+    bool setData( const char* data, qint64 size );
+
+    //! checks that the offsets are ascending and the arcs reference existing vertices and edges
+    static bool validArcs( const qint32* offsets, const Arc* arcs, int arcCount, int vertexCount, qint64 edgeCount );
+
+    //! buckets the vertices into a grid for closestVertex()
+    void buildGrid();
+    int gridColumn( double x ) const;
+    int gridRow( double y ) const;
+    int gridCell( int column, int row ) const { return row * mGridColumns + column; }
+
+    bool isValidVertex( int idx ) const { return mHeader && idx >= 0 && idx < vertexCount(); }
+
+    //! appends the arcs of the source graph represented by an arc or shortcut
+    void unpackEdge( int edge, QVector<int>& arcs ) const;
+
+    QgsContractionHierarchyWorkspace* acquireWorkspace() const;
+    void releaseWorkspace( QgsContractionHierarchyWorkspace* ws ) const;
+
+    //! serialized hierarchy built by the constructor, doubles to keep the arrays aligned
+    QVector<double> mBuffer;
+    //! mapped file of a loaded hierarchy
+    QFile* mFile;
+    const char* mData;
+    qint64 mDataSize;
+
+    const QgsContractionHierarchyHeader* mHeader;
+    const double* mX;
+    const double* mY;
+    //! start and end vertex of each arc and shortcut
+    const qint32* mEdgeFrom;
+    const qint32* mEdgeTo;
+    //! the two arcs (or shortcuts) replaced by each shortcut
+    const qint32* mShortcutChildren;
+    //! arcs to more important vertices, by start vertex
+    const qint32* mUpOutOffsets;
+    const Arc* mUpOut;
+    //! arcs from more important vertices, by end vertex
+    const qint32* mUpInOffsets;
+    const Arc* mUpIn;
+
+    //! vertices sorted by grid cell, mGridOffsets has the start of each cell
+    QVector<int> mGridOffsets;
+    QVector<int> mGridVertices;
+    double mGridXMin;
+    double mGridYMin;
+    double mGridCellSize;
+    int mGridColumns;
+    int mGridRows;
+
+    mutable QMutex mWorkspaceMutex;
+    mutable QList<QgsContractionHierarchyWorkspace*> mWorkspaces;
+};
+
+#endif // QGSCONTRACTIONHIERARCHY_H
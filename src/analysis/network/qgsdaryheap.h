@@ -0,0 +1,104 @@
+/***************************************************************************
+  qgsdaryheap.h
+  --------------------------------------
+  Date                 : May 2014
+  Copyright            : (C) 2014 by the QGIS project
+  Email                :
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSDARYHEAP_H
+#define QGSDARYHEAP_H
+
+#include <vector>
+
+/**
+ * \ingroup networkanalysis
+ * \class QgsDAryHeap
+ * \brief Min-heap of (key, vertex) pairs with D children per node, used as priority queue by the
+ * shortest path searches.
+ *
+ * Entries are never updated in place. A search pushes a vertex again when its cost decreases and
+ * skips outdated entries when they are popped, which is faster than maintaining a position index.
+ * clear() keeps the allocated memory, so a heap can be reused across queries.
+ * @note added in 2.4
+ * @note not available in python bindings
+ */
+template <int D = 4>
+class QgsDAryHeap
+{
+  public:
+    struct Entry
+    {
+      double key;
+      int vertex;
+    };
+
+    bool isEmpty() const { return mEntries.empty(); }
+    int size() const { return ( int ) mEntries.size(); }
+    void clear() { mEntries.clear(); }
+
+    //! entry with the smallest key
+    const Entry& top() const { return mEntries.front(); }
+
+    void push( double key, int vertex )
+    {
+      Entry e;
+      e.key = key;
+      e.vertex = vertex;
+      mEntries.push_back( e );
+
+      //sift up
+      size_t i = mEntries.size() - 1;
+      while ( i > 0 )
+      {
+        size_t parent = ( i - 1 ) / D;
+        if ( mEntries[parent].key <= e.key )
+          break;
+        mEntries[i] = mEntries[parent];
+        i = parent;
+      }
+      mEntries[i] = e;
+    }
+
+    void pop()
+    {
+      Entry e = mEntries.back();
+      mEntries.pop_back();
+      size_t n = mEntries.size();
+      if ( n == 0 )
+        return;
+
+      //sift down
+      size_t i = 0;
+      while ( true )
+      {
+        size_t first = i * D + 1;
+        if ( first >= n )
+          break;
+        size_t last = first + D < n ? first + D : n;
+        size_t smallest = first;
+        for ( size_t c = first + 1; c < last; ++c )
+        {
+          if ( mEntries[c].key < mEntries[smallest].key )
+            smallest = c;
+        }
+        if ( e.key <= mEntries[smallest].key )
+          break;
+        mEntries[i] = mEntries[smallest];
+        i = smallest;
+      }
+      mEntries[i] = e;
+    }
+
+  private:
+    std::vector<Entry> mEntries;
+};
+
+#endif // QGSDARYHEAP_H
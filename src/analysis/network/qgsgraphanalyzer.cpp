@@ -18,11 +18,10 @@
 #include <limits>
 
 // QT includes
-#include <QMap>
 #include <QVector>
-#include <QPair>
 
 //QGIS-uncludes
+#include "qgsdaryheap.h"
 #include "qgsgraph.h"
 #include "qgsgraphanalyzer.h"
 
@@ -48,26 +47,26 @@ void QgsGraphAnalyzer::dijkstra( const QgsGraph* source, int startPointIdx, int
     resultTree->insert( resultTree->begin(), source->vertexCount(), -1 );
   }
 
-  // QMultiMap< cost, vertexIdx > not_begin
-  // I use it and not create any struct or class.
-  QMultiMap< double, int > not_begin;
-  QMultiMap< double, int >::iterator it;
+  // priority queue of ( cost, vertexIdx ), a vertex is queued again when its cost decreases
+  QgsDAryHeap<4> not_begin;
+  not_begin.push( 0.0, startPointIdx );
 
-  not_begin.insert( 0.0, startPointIdx );
-
-  while ( !not_begin.empty() )
+  while ( !not_begin.isEmpty() )
   {
-    it = not_begin.begin();
-    double curCost = it.key();
-    int curVertex = it.value();
-    not_begin.erase( it );
+    double curCost = not_begin.top().key;
+    int curVertex = not_begin.top().vertex;
+    not_begin.pop();
+
+    // skip outdated entries
+    if ( curCost > ( *result )[ curVertex ] )
+      continue;
 
     // edge index list
-    QgsGraphArcIdList l = source->vertex( curVertex ).outArc();
-    QgsGraphArcIdList::iterator arcIt;
-    for ( arcIt = l.begin(); arcIt != l.end(); ++arcIt )
+    const QgsGraphArcIdList l = source->vertex( curVertex ).outArc();
+    QgsGraphArcIdList::const_iterator arcIt;
+    for ( arcIt = l.constBegin(); arcIt != l.constEnd(); ++arcIt )
     {
-      const QgsGraphArc arc = source->arc( *arcIt );
+      const QgsGraphArc& arc = source->arc( *arcIt );
       double cost = arc.property( criterionNum ).toDouble() + curCost;
 
       if ( cost < ( *result )[ arc.inVertex()] )
@@ -77,7 +76,7 @@ void QgsGraphAnalyzer::dijkstra( const QgsGraph* source, int startPointIdx, int
         {
           ( *resultTree )[ arc.inVertex()] = *arcIt;
         }
-        not_begin.insert( cost, arc.inVertex() );
+        not_begin.push( cost, arc.inVertex() );
       }
     }
   }
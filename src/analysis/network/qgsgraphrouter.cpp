@@ -0,0 +1,442 @@
+/***************************************************************************
+  qgsgraphrouter.cpp
+  --------------------------------------
+  Date                 : May 2014
+  Copyright            : (C) 2014 by the QGIS project
+  Email                :
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgsgraphrouter.h"
+#include "qgsgraph.h"
+#include "qgsgraphsearchspace.h"
+#include "qgslogger.h"
+
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+struct QgsGraphRouterWorkspace
+{
+  QgsGraphSearchSpace forward;
+  QgsGraphSearchSpace backward;
+  //! targets of costs(), marked with the current base of the forward search
+  std::vector<unsigned int> targetMark;
+};
+
+QgsGraphRouter::QgsGraphRouter( const QgsGraph* graph, int criterionNum )
+    : mHeuristicFactor( 0.0 )
+{
+  int vertexCount = graph->vertexCount();
+  int arcCount = graph->arcCount();
+
+  mX.resize( vertexCount );
+  mY.resize( vertexCount );
+  for ( int i = 0; i < vertexCount; ++i )
+  {
+    QgsPoint pt = graph->vertex( i ).point();
+    mX[i] = pt.x();
+    mY[i] = pt.y();
+  }
+
+  mArcFrom.resize( arcCount );
+  mArcTo.resize( arcCount );
+  QVector<double> arcCost( arcCount );
+  mOutOffsets.fill( 0, vertexCount + 1 );
+  mInOffsets.fill( 0, vertexCount + 1 );
+
+  double minCostPerDistance = std::numeric_limits<double>::infinity();
+  bool negativeCost = false;
+  for ( int i = 0; i < arcCount; ++i )
+  {
+    const QgsGraphArc& arc = graph->arc( i );
+    mArcFrom[i] = arc.outVertex();
+    mArcTo[i] = arc.inVertex();
+    arcCost[i] = arc.property( criterionNum ).toDouble();
+    ++mOutOffsets[ mArcFrom[i] + 1 ];
+    ++mInOffsets[ mArcTo[i] + 1 ];
+
+    if ( arcCost[i] < 0 )
+    {
+      negativeCost = true;
+      continue;
+    }
+    double dx = mX[ mArcTo[i] ] - mX[ mArcFrom[i] ];
+    double dy = mY[ mArcTo[i] ] - mY[ mArcFrom[i] ];
+    double length = sqrt( dx * dx + dy * dy );
+    if ( length > 0 )
+      minCostPerDistance = qMin( minCostPerDistance, arcCost[i] / length );
+  }
+
+  if ( negativeCost )
+  {
+    QgsDebugMsg( "graph has arcs with negative costs, shortest paths may be wrong" );
+  }
+  else if ( minCostPerDistance < std::numeric_limits<double>::infinity() )
+  {
+    // cost >= factor * length holds for every arc, so by the triangle inequality also for paths.
+    // Slightly reduced to stay a lower bound despite rounding
+    mHeuristicFactor = minCostPerDistance * ( 1.0 - 1e-9 );
+  }
+
+  for ( int i = 0; i < vertexCount; ++i )
+  {
+    mOutOffsets[i + 1] += mOutOffsets[i];
+    mInOffsets[i + 1] += mInOffsets[i];
+  }
+
+  // counting sort of the arcs by start and by end vertex, keeps the order of the source graph
+  mOutArcs.resize( arcCount );
+  mInArcs.resize( arcCount );
+  QVector<int> outPos = mOutOffsets;
+  QVector<int> inPos = mInOffsets;
+  for ( int i = 0; i < arcCount; ++i )
+  {
+    CsrArc& out = mOutArcs[ outPos[ mArcFrom[i] ]++ ];
+    out.vertex = mArcTo[i];
+    out.arc = i;
+    out.cost = arcCost[i];
+
+    CsrArc& in = mInArcs[ inPos[ mArcTo[i] ]++ ];
+    in.vertex = mArcFrom[i];
+    in.arc = i;
+    in.cost = arcCost[i];
+  }
+}
+
+QgsGraphRouter::~QgsGraphRouter()
+{
+  qDeleteAll( mWorkspaces );
+}
+
+QgsGraphRouterWorkspace* QgsGraphRouter::acquireWorkspace() const
+{
+  QMutexLocker locker( &mWorkspaceMutex );
+  if ( mWorkspaces.isEmpty() )
+    return new QgsGraphRouterWorkspace();
+  return mWorkspaces.takeLast();
+}
+
+void QgsGraphRouter::releaseWorkspace( QgsGraphRouterWorkspace* ws ) const
+{
+  QMutexLocker locker( &mWorkspaceMutex );
+  mWorkspaces.append( ws );
+}
+
+double QgsGraphRouter::heuristic( int vertexIdx, double x, double y ) const
+{
+  double dx = mX[vertexIdx] - x;
+  double dy = mY[vertexIdx] - y;
+  return mHeuristicFactor * sqrt( dx * dx + dy * dy );
+}
+
+void QgsGraphRouter::runDijkstra( QgsGraphRouterWorkspace* ws, int startVertexIdx, int targetCount ) const
+{
+  QgsGraphSearchSpace& s = ws->forward;
+  const int* offsets = mOutOffsets.constData();
+  const CsrArc* arcs = mOutArcs.constData();
+
+  s.reach( startVertexIdx, 0.0, -1 );
+  s.heap.push( 0.0, startVertexIdx );
+
+  while ( true )
+  {
+    s.skipSettled();
+    if ( s.heap.isEmpty() )
+      break;
+
+    int v = s.heap.top().vertex;
+    s.heap.pop();
+    s.settle( v );
+
+    if ( targetCount > 0 && ws->targetMark[v] == s.base )
+    {
+      ws->targetMark[v] = 0;
+      if ( --targetCount == 0 )
+        break;
+    }
+
+    double cost = s.cost[v];
+    for ( int i = offsets[v]; i < offsets[v + 1]; ++i )
+    {
+      const CsrArc& arc = arcs[i];
+      if ( s.isSettled( arc.vertex ) )
+        continue;
+      double newCost = cost + arc.cost;
+      if ( !s.isReached( arc.vertex ) || newCost < s.cost[ arc.vertex ] )
+      {
+        s.reach( arc.vertex, newCost, arc.arc );
+        s.heap.push( newCost, arc.vertex );
+      }
+    }
+  }
+}
+
+void QgsGraphRouter::forwardPath( QgsGraphRouterWorkspace* ws, int vertexIdx, QVector<int>& arcs ) const
+{
+  const QgsGraphSearchSpace& s = ws->forward;
+  int v = vertexIdx;
+  while ( s.parentArc[v] != -1 )
+  {
+    arcs.append( s.parentArc[v] );
+    v = mArcFrom[ s.parentArc[v] ];
+  }
+  std::reverse( arcs.begin(), arcs.end() );
+}
+
+void QgsGraphRouter::dijkstra( int startVertexIdx, QVector<int>* resultTree, QVector<double>* resultCost ) const
+{
+  int n = vertexCount();
+  if ( resultTree )
+    resultTree->fill( -1, n );
+  if ( resultCost )
+    resultCost->fill( std::numeric_limits<double>::infinity(), n );
+  if ( !isValidVertex( startVertexIdx ) )
+  {
+    QgsDebugMsg( QString( "invalid start vertex %1" ).arg( startVertexIdx ) );
+    return;
+  }
+
+  QgsGraphRouterWorkspace* ws = acquireWorkspace();
+  ws->forward.reset( n );
+  runDijkstra( ws, startVertexIdx, 0 );
+
+  const QgsGraphSearchSpace& s = ws->forward;
+  for ( int i = 0; i < n; ++i )
+  {
+    if ( !s.isReached( i ) )
+      continue;
+    if ( resultTree )
+      ( *resultTree )[i] = s.parentArc[i];
+    if ( resultCost )
+      ( *resultCost )[i] = s.cost[i];
+  }
+  releaseWorkspace( ws );
+}
+
+double QgsGraphRouter::shortestPath( int startVertexIdx, int stopVertexIdx, QVector<int>* resultArcs ) const
+{
+  if ( resultArcs )
+    resultArcs->clear();
+  if ( !isValidVertex( startVertexIdx ) || !isValidVertex( stopVertexIdx ) )
+  {
+    QgsDebugMsg( QString( "invalid vertex %1 or %2" ).arg( startVertexIdx ).arg( stopVertexIdx ) );
+    return std::numeric_limits<double>::infinity();
+  }
+
+  QgsGraphRouterWorkspace* ws = acquireWorkspace();
+  QgsGraphSearchSpace& s = ws->forward;
+  s.reset( vertexCount() );
+  const int* offsets = mOutOffsets.constData();
+  const CsrArc* arcs = mOutArcs.constData();
+  double stopX = mX[ stopVertexIdx ];
+  double stopY = mY[ stopVertexIdx ];
+
+  // heap keys are cost + heuristic, the heuristic is consistent so each vertex is settled once
+  double result = std::numeric_limits<double>::infinity();
+  s.reach( startVertexIdx, 0.0, -1 );
+  s.heap.push( heuristic( startVertexIdx, stopX, stopY ), startVertexIdx );
+
+  while ( true )
+  {
+    s.skipSettled();
+    if ( s.heap.isEmpty() )
+      break;
+
+    int v = s.heap.top().vertex;
+    s.heap.pop();
+    s.settle( v );
+
+    double cost = s.cost[v];
+    if ( v == stopVertexIdx )
+    {
+      result = cost;
+      break;
+    }
+
+    for ( int i = offsets[v]; i < offsets[v + 1]; ++i )
+    {
+      const CsrArc& arc = arcs[i];
+      if ( s.isSettled( arc.vertex ) )
+        continue;
+      double newCost = cost + arc.cost;
+      if ( !s.isReached( arc.vertex ) || newCost < s.cost[ arc.vertex ] )
+      {
+        s.reach( arc.vertex, newCost, arc.arc );
+        s.heap.push( newCost + heuristic( arc.vertex, stopX, stopY ), arc.vertex );
+      }
+    }
+  }
+
+  if ( resultArcs && result < std::numeric_limits<double>::infinity() )
+    forwardPath( ws, stopVertexIdx, *resultArcs );
+
+  releaseWorkspace( ws );
+  return result;
+}
+
+double QgsGraphRouter::shortestPathBidirectional( int startVertexIdx, int stopVertexIdx, QVector<int>* resultArcs ) const
+{
+  if ( resultArcs )
+    resultArcs->clear();
+  if ( !isValidVertex( startVertexIdx ) || !isValidVertex( stopVertexIdx ) )
+  {
+    QgsDebugMsg( QString( "invalid vertex %1 or %2" ).arg( startVertexIdx ).arg( stopVertexIdx ) );
+    return std::numeric_limits<double>::infinity();
+  }
+  if ( startVertexIdx == stopVertexIdx )
+    return 0.0;
+
+  QgsGraphRouterWorkspace* ws = acquireWorkspace();
+  QgsGraphSearchSpace& f = ws->forward;
+  QgsGraphSearchSpace& b = ws->backward;
+  f.reset( vertexCount() );
+  b.reset( vertexCount() );
+
+  f.reach( startVertexIdx, 0.0, -1 );
+  f.heap.push( 0.0, startVertexIdx );
+  b.reach( stopVertexIdx, 0.0, -1 );
+  b.heap.push( 0.0, stopVertexIdx );
+
+  // best path found so far and the vertex where its two halves meet
+  double best = std::numeric_limits<double>::infinity();
+  int meetingVertex = -1;
+
+  while ( true )
+  {
+    f.skipSettled();
+    b.skipSettled();
+    if ( f.heap.isEmpty() || b.heap.isEmpty() )
+      break;
+    // no path through unsettled vertices can be shorter
+    if ( f.heap.top().key + b.heap.top().key >= best )
+      break;
+
+    // expand the direction with the smaller frontier
+    bool forward = f.heap.size() <= b.heap.size();
+    QgsGraphSearchSpace& s = forward ? f : b;
+    const QgsGraphSearchSpace& other = forward ? b : f;
+    const int* offsets = forward ? mOutOffsets.constData() : mInOffsets.constData();
+    const CsrArc* arcs = forward ? mOutArcs.constData() : mInArcs.constData();
+
+    int v = s.heap.top().vertex;
+    s.heap.pop();
+    s.settle( v );
+
+    double cost = s.cost[v];
+    for ( int i = offsets[v]; i < offsets[v + 1]; ++i )
+    {
+      const CsrArc& arc = arcs[i];
+      if ( s.isSettled( arc.vertex ) )
+        continue;
+      double newCost = cost + arc.cost;
+      if ( !s.isReached( arc.vertex ) || newCost < s.cost[ arc.vertex ] )
+      {
+        s.reach( arc.vertex, newCost, arc.arc );
+        s.heap.push( newCost, arc.vertex );
+      }
+      if ( other.isReached( arc.vertex ) && newCost + other.cost[ arc.vertex ] < best )
+      {
+        best = newCost + other.cost[ arc.vertex ];
+        meetingVertex = arc.vertex;
+      }
+    }
+  }
+
+  if ( resultArcs && meetingVertex != -1 )
+  {
+    forwardPath( ws, meetingVertex, *resultArcs );
+    int v = meetingVertex;
+    while ( b.parentArc[v] != -1 )
+    {
+      resultArcs->append( b.parentArc[v] );
+      v = mArcTo[ b.parentArc[v] ];
+    }
+  }
+
+  releaseWorkspace( ws );
+  return best;
+}
+
+QVector<double> QgsGraphRouter::costs( int startVertexIdx, const QVector<int>& targets ) const
+{
+  QVector<double> result( targets.size(), std::numeric_limits<double>::infinity() );
+  if ( !isValidVertex( startVertexIdx ) )
+  {
+    QgsDebugMsg( QString( "invalid start vertex %1" ).arg( startVertexIdx ) );
+    return result;
+  }
+
+  QgsGraphRouterWorkspace* ws = acquireWorkspace();
+  QgsGraphSearchSpace& s = ws->forward;
+  s.reset( vertexCount() );
+  if (( int ) ws->targetMark.size() != vertexCount() )
+    ws->targetMark.assign( vertexCount(), 0 );
+
+  int targetCount = 0;
+  foreach ( int target, targets )
+  {
+    if ( isValidVertex( target ) && ws->targetMark[ target ] != s.base )
+    {
+      ws->targetMark[ target ] = s.base;
+      ++targetCount;
+    }
+  }
+
+  if ( targetCount > 0 )
+    runDijkstra( ws, startVertexIdx, targetCount );
+
+  for ( int i = 0; i < targets.size(); ++i )
+  {
+    int target = targets[i];
+    if ( !isValidVertex( target ) )
+      continue;
+    // marks of targets not reached must not match a later query
+    ws->targetMark[ target ] = 0;
+    if ( s.isReached( target ) )
+      result[i] = s.cost[ target ];
+  }
+
+  releaseWorkspace( ws );
+  return result;
+}
+
+/** One row of a cost matrix, computed by one thread */
+struct QgsGraphCostRow
+{
+  const QgsGraphRouter* router;
+  int source;
+  const QVector<int>* targets;
+  QVector<double> costs;
+};
+
+static void computeCostRow( QgsGraphCostRow& row )
+{
+  row.costs = row.router->costs( row.source, *row.targets );
+}
+
+QVector< QVector<double> > QgsGraphRouter::costMatrix( const QVector<int>& sources, const QVector<int>& targets ) const
+{
+  QVector<QgsGraphCostRow> rows( sources.size() );
+  for ( int i = 0; i < sources.size(); ++i )
+  {
+    rows[i].router = this;
+    rows[i].source = sources[i];
+    rows[i].targets = &targets;
+  }
+
+  QtConcurrent::blockingMap( rows, computeCostRow );
+
+  QVector< QVector<double> > result( sources.size() );
+  for ( int i = 0; i < rows.size(); ++i )
+    result[i] = rows[i].costs;
+  return result;
+}
@@ -0,0 +1,148 @@
+/***************************************************************************
+  qgsgraphrouter.h
+  --------------------------------------
+  Date                 : May 2014
+  Copyright            : (C) 2014 by the QGIS project
+  Email                :
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSGRAPHROUTER_H
+#define QGSGRAPHROUTER_H
+
+#include <QList>
+#include <QMutex>
+#include <QVector>
+
+class QgsGraph;
+struct QgsGraphRouterWorkspace;
+
+/**
+ * \ingroup networkanalysis
+ * \class QgsGraphRouter
+ * \brief Shortest path queries on a compact copy of a QgsGraph.
+ *
+ * The constructor copies the topology, the vertex coordinates and one arc property (the cost)
+ * into compressed sparse row arrays, so queries do not touch QVariant properties or arc id lists.
+ * Point to point queries use A* with an Euclidean heuristic or a bidirectional search, many to many
+ * queries run one search per source in parallel.
+ *
+ * Arc costs must not be negative. All query methods are const and may be called from several
+ * threads at the same time. Vertex and arc indexes are those of the source graph.
+ * @note added in 2.4
+ */
+class ANALYSIS_EXPORT QgsGraphRouter
+{
+  public:
+    /**
+     * Builds the router
+     * @param graph source graph, not referenced after construction
+     * @param criterionNum index of arc property used as cost
+     */
+    QgsGraphRouter( const QgsGraph* graph, int criterionNum );
+    ~QgsGraphRouter();
+
+    //! number of vertices of the graph
+    int vertexCount() const { return mX.size(); }
+
+    //! number of arcs of the graph
+    int arcCount() const { return mArcFrom.size(); }
+
+    /**
+     * Factor of the A* heuristic, the largest value for which factor * (straight line distance)
+     * is a lower bound of the cost between two vertices. 0 if the heuristic is not usable,
+     * A* then behaves like dijkstra
+     */
+    double heuristicFactor() const { return mHeuristicFactor; }
+
+    /**
+     * Solves the one to all shortest path problem, same results as QgsGraphAnalyzer::dijkstra
+     * @param startVertexIdx index of start vertex
+     * @param resultTree resultTree[ vertexIndex ] is the inbound arc of the vertex on its shortest path or -1
+     * @param resultCost costs of the shortest paths, infinity for unreachable vertices
+     */
+    void dijkstra( int startVertexIdx, QVector<int>* resultTree, QVector<double>* resultCost ) const;
+
+    /**
+     * Shortest path between two vertices using A*
+     * @param startVertexIdx index of start vertex
+     * @param stopVertexIdx index of stop vertex
+     * @param resultArcs if not null, receives the arcs of the path in order
+     * @return cost of the path or infinity if the stop vertex is not reachable
+     */
+    double shortestPath( int startVertexIdx, int stopVertexIdx, QVector<int>* resultArcs = 0 ) const;
+
+    /**
+     * Shortest path between two vertices, searching from both ends at the same time.
+     * Does not depend on vertex coordinates, e.g. for costs unrelated to distance
+     * @param startVertexIdx index of start vertex
+     * @param stopVertexIdx index of stop vertex
+     * @param resultArcs if not null, receives the arcs of the path in order
+     * @return cost of the path or infinity if the stop vertex is not reachable
+     */
+    double shortestPathBidirectional( int startVertexIdx, int stopVertexIdx, QVector<int>* resultArcs = 0 ) const;
+
+    /**
+     * Costs of the shortest paths from one vertex to several others. The search stops as soon as
+     * all targets are reached
+     * @return costs in the order of targets, infinity for unreachable targets
+     */
+    QVector<double> costs( int startVertexIdx, const QVector<int>& targets ) const;
+
+    /**
+     * Costs of the shortest paths between all sources and all targets, one search per source
+     * distributed over the available cores
+     * @return one row of costs (in the order of targets) per source
+     */
+    QVector< QVector<double> > costMatrix( const QVector<int>& sources, const QVector<int>& targets ) const;
+
+  private:
+    QgsGraphRouter( const QgsGraphRouter& rh );
+    QgsGraphRouter& operator=( const QgsGraphRouter& rh );
+
+    //! arc in compressed sparse row storage
+    struct CsrArc
+    {
+      int vertex; //!< other vertex of the arc
+      int arc; //!< index of the arc in the source graph
+      double cost;
+    };
+
+    bool isValidVertex( int idx ) const { return idx >= 0 && idx < mX.size(); }
+    inline double heuristic( int vertexIdx, double x, double y ) const;
+
+    //! dijkstra from startVertexIdx, stops early when the vertices marked as targets are settled
+    void runDijkstra( QgsGraphRouterWorkspace* ws, int startVertexIdx, int targetCount ) const;
+    //! arcs from the start vertex of the forward search to vertexIdx
+    void forwardPath( QgsGraphRouterWorkspace* ws, int vertexIdx, QVector<int>& arcs ) const;
+
+    QgsGraphRouterWorkspace* acquireWorkspace() const;
+    void releaseWorkspace( QgsGraphRouterWorkspace* ws ) const;
+
+    //! outgoing arcs of vertex i are mOutArcs[ mOutOffsets[i] ] to mOutArcs[ mOutOffsets[i+1] - 1 ]
+    QVector<int> mOutOffsets;
+    QVector<CsrArc> mOutArcs;
+    //! incoming arcs, for backward searches
+    QVector<int> mInOffsets;
+    QVector<CsrArc> mInArcs;
+
+    //! start and end vertex per source arc
+    QVector<int> mArcFrom;
+    QVector<int> mArcTo;
+
+    QVector<double> mX;
+    QVector<double> mY;
+    double mHeuristicFactor;
+
+    //! search state is reused between queries, one workspace per concurrent query
+    mutable QMutex mWorkspaceMutex;
+    mutable QList<QgsGraphRouterWorkspace*> mWorkspaces;
+};
+
+#endif // QGSGRAPHROUTER_H
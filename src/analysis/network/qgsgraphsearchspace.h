@@ -0,0 +1,78 @@
+/***************************************************************************
+  qgsgraphsearchspace.h
+  --------------------------------------
+  Date                 : May 2014
+  Copyright            : (C) 2014 by the QGIS project
+  Email                :
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSGRAPHSEARCHSPACE_H
+#define QGSGRAPHSEARCHSPACE_H
+
+#include "qgsdaryheap.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/**
+ * State of one search direction. Vertex states are valid for the current query only if they are
+ * not older than base, so the arrays are not cleared between queries.
+ */
+struct QgsGraphSearchSpace
+{
+  QgsGraphSearchSpace() : base( 0 ) {}
+
+  void reset( int vertexCount )
+  {
+    if (( int ) state.size() != vertexCount )
+    {
+      cost.resize( vertexCount );
+      parentArc.resize( vertexCount );
+      state.assign( vertexCount, 0 );
+      base = 0;
+    }
+    if ( base >= std::numeric_limits<unsigned int>::max() - 3 )
+    {
+      std::fill( state.begin(), state.end(), 0 );
+      base = 0;
+    }
+    base += 2;
+    heap.clear();
+  }
+
+  bool isReached( int v ) const { return state[v] >= base; }
+  bool isSettled( int v ) const { return state[v] == base + 1; }
+
+  void reach( int v, double c, int arc )
+  {
+    cost[v] = c;
+    parentArc[v] = arc;
+    state[v] = base;
+  }
+
+  void settle( int v ) { state[v] = base + 1; }
+
+  //! removes entries of settled vertices from the top of the heap
+  void skipSettled()
+  {
+    while ( !heap.isEmpty() && isSettled( heap.top().vertex ) )
+      heap.pop();
+  }
+
+  std::vector<double> cost;
+  std::vector<int> parentArc;
+  //! base: reached, base + 1: settled, smaller: not reached in this query
+  std::vector<unsigned int> state;
+  unsigned int base;
+  QgsDAryHeap<4> heap;
+};
+
+#endif // QGSGRAPHSEARCHSPACE_H
@@ -28,6 +28,21 @@ QgsAspectFilter::~QgsAspectFilter()
 
 }
 
+//aspect in degrees clockwise from north from the derivatives
+static inline float aspectFromDerivatives( float derX, float derY, float outputNodataValue )
+{
+  if ( derX == outputNodataValue ||
+       derY == outputNodataValue ||
+       ( derX == 0.0 && derY == 0.0 ) )
+  {
+    return outputNodataValue;
+  }
+  else
+  {
+    return 180.0 + atan2( derX, derY ) * 180.0 / M_PI;
+  }
+}
+
 float QgsAspectFilter::processNineCellWindow(
   float* x11, float* x21, float* x31,
   float* x12, float* x22, float* x32,
@@ -35,16 +50,24 @@ float QgsAspectFilter::processNineCellWindow(
 {
   float derX = calcFirstDerX( x11, x21, x31, x12, x22, x32, x13, x23, x33 );
   float derY = calcFirstDerY( x11, x21, x31, x12, x22, x32, x13, x23, x33 );
+  return aspectFromDerivatives( derX, derY, mOutputNodataValue );
+}
 
-  if ( derX == mOutputNodataValue ||
-       derY == mOutputNodataValue ||
-       ( derX == 0.0 && derY == 0.0 ) )
-  {
-    return mOutputNodataValue;
-  }
-  else
+void QgsAspectFilter::processNineCellBlock( float* input, int inputStride, float* output, int outputStride, int nCols, int nRows )
+{
+  QVector<float> derX( nCols );
+  QVector<float> derY( nCols );
+  for ( int row = 0; row < nRows; ++row )
   {
-    return 180.0 + atan2( derX, derY ) * 180.0 / M_PI;
+    float* x1 = input + row * inputStride;
+    calcFirstDerivatives( x1, x1 + inputStride, x1 + 2 * inputStride, nCols, derX.data(), derY.data() );
+
+    const float* dx = derX.constData();
+    const float* dy = derY.constData();
+    float* resultLine = output + row * outputStride;
+    for ( int j = 0; j < nCols; ++j )
+    {
+      resultLine[j] = aspectFromDerivatives( dx[j], dy[j], mOutputNodataValue );
+    }
   }
 }
-
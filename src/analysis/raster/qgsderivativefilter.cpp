@@ -162,7 +162,32 @@ float QgsDerivativeFilter::calcFirstDerY( float* x11, float* x21, float* x31, fl
   return sum / ( weight * mCellSizeY * mZFactor );
 }
 
-
-
-
-
+void QgsDerivativeFilter::calcFirstDerivatives( float* x1, float* x2, float* x3, int nCols, float* derX, float* derY )
+{
+  double divisorX = 8 * mCellSizeX * mZFactor;
+  double divisorY = 8 * mCellSizeY * mZFactor;
+
+  for ( int j = 0; j < nCols; ++j, ++x1, ++x2, ++x3 )
+  {
+    if ( x1[0] != mInputNodataValue && x1[1] != mInputNodataValue && x1[2] != mInputNodataValue
+         && x2[0] != mInputNodataValue && x2[1] != mInputNodataValue && x2[2] != mInputNodataValue
+         && x3[0] != mInputNodataValue && x3[1] != mInputNodataValue && x3[2] != mInputNodataValue )
+    {
+      //same operations as the normal case of calcFirstDerX and calcFirstDerY
+      double sum = x1[2] - x1[0];
+      sum += 2 * ( x2[2] - x2[0] );
+      sum += x3[2] - x3[0];
+      derX[j] = sum / divisorX;
+
+      sum = x1[0] - x3[0];
+      sum += 2 * ( x1[1] - x3[1] );
+      sum += x1[2] - x3[2];
+      derY[j] = sum / divisorY;
+    }
+    else
+    {
+      derX[j] = calcFirstDerX( &x1[0], &x1[1], &x1[2], &x2[0], &x2[1], &x2[2], &x3[0], &x3[1], &x3[2] );
+      derY[j] = calcFirstDerY( &x1[0], &x1[1], &x1[2], &x2[0], &x2[1], &x2[2], &x3[0], &x3[1], &x3[2] );
+    }
+  }
+}
@@ -36,6 +36,18 @@ class ANALYSIS_EXPORT QgsDerivativeFilter : public QgsNineCellFilter
     float calcFirstDerX( float* x11, float* x21, float* x31, float* x12, float* x22, float* x32, float* x13, float* x23, float* x33 );
     /**Calculates the first order derivative in y-direction according to Horn (1981)*/
     float calcFirstDerY( float* x11, float* x21, float* x31, float* x12, float* x22, float* x32, float* x13, float* x23, float* x33 );
+    /**Calculates the derivatives in x- and y-direction for a row of cells of a block (see processNineCellBlock()).
+      Cells without nodata neighbours are calculated without branches, derivatives that can not be calculated are
+      set to the output nodata value
+      @param x1 row above, starting with the cell left of the first cell
+      @param x2 row of the cells, starting with the cell left of the first cell
+      @param x3 row below, starting with the cell left of the first cell
+      @param nCols number of cells
+      @param derX receives the derivatives in x-direction
+      @param derY receives the derivatives in y-direction
+      @note added in 2.4
+      @note not available in python bindings*/
+    void calcFirstDerivatives( float* x1, float* x2, float* x3, int nCols, float* derX, float* derY );
 };
 
 #endif // QGSDERIVATIVEFILTER_H
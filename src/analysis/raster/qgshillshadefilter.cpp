@@ -29,21 +29,15 @@ QgsHillshadeFilter::~QgsHillshadeFilter()
 {
 }
 
-float QgsHillshadeFilter::processNineCellWindow( float* x11, float* x21, float* x31,
-    float* x12, float* x22, float* x32,
-    float* x13, float* x23, float* x33 )
+//brightness (0 - 255) from the derivatives, light angles in radians
+static inline float hillshadeFromDerivatives( float derX, float derY, float zenith_rad, float azimuth_rad, float outputNodataValue )
 {
-  float derX = calcFirstDerX( x11, x21, x31, x12, x22, x32, x13, x23, x33 );
-  float derY = calcFirstDerY( x11, x21, x31, x12, x22, x32, x13, x23, x33 );
-
-  if ( derX == mOutputNodataValue || derY == mOutputNodataValue )
+  if ( derX == outputNodataValue || derY == outputNodataValue )
   {
-    return mOutputNodataValue;
+    return outputNodataValue;
   }
 
-  float zenith_rad = mLightAngle * M_PI / 180.0;
   float slope_rad = atan( sqrt( derX * derX + derY * derY ) );
-  float azimuth_rad = mLightAzimuth * M_PI / 180.0;
   float aspect_rad = 0;
   if ( derX == 0 && derY == 0 ) //aspect undefined, take a neutral value. Better solutions?
   {
@@ -55,3 +49,37 @@ float QgsHillshadeFilter::processNineCellWindow( float* x11, float* x21, float*
   }
   return qMax( 0.0, 255.0 * (( cos( zenith_rad ) * cos( slope_rad ) ) + ( sin( zenith_rad ) * sin( slope_rad ) * cos( azimuth_rad - aspect_rad ) ) ) );
 }
+
+float QgsHillshadeFilter::processNineCellWindow( float* x11, float* x21, float* x31,
+    float* x12, float* x22, float* x32,
+    float* x13, float* x23, float* x33 )
+{
+  float derX = calcFirstDerX( x11, x21, x31, x12, x22, x32, x13, x23, x33 );
+  float derY = calcFirstDerY( x11, x21, x31, x12, x22, x32, x13, x23, x33 );
+
+  float zenith_rad = mLightAngle * M_PI / 180.0;
+  float azimuth_rad = mLightAzimuth * M_PI / 180.0;
+  return hillshadeFromDerivatives( derX, derY, zenith_rad, azimuth_rad, mOutputNodataValue );
+}
+
+void QgsHillshadeFilter::processNineCellBlock( float* input, int inputStride, float* output, int outputStride, int nCols, int nRows )
+{
+  float zenith_rad = mLightAngle * M_PI / 180.0;
+  float azimuth_rad = mLightAzimuth * M_PI / 180.0;
+
+  QVector<float> derX( nCols );
+  QVector<float> derY( nCols );
+  for ( int row = 0; row < nRows; ++row )
+  {
+    float* x1 = input + row * inputStride;
+    calcFirstDerivatives( x1, x1 + inputStride, x1 + 2 * inputStride, nCols, derX.data(), derY.data() );
+
+    const float* dx = derX.constData();
+    const float* dy = derY.constData();
+    float* resultLine = output + row * outputStride;
+    for ( int j = 0; j < nCols; ++j )
+    {
+      resultLine[j] = hillshadeFromDerivatives( dx[j], dy[j], zenith_rad, azimuth_rad, mOutputNodataValue );
+    }
+  }
+}
@@ -16,9 +16,13 @@
  ***************************************************************************/
 
 #include "qgsninecellfilter.h"
+#include "qgslogger.h"
 #include "cpl_string.h"
 #include <QProgressDialog>
 #include <QFile>
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrentMap>
 
 #if defined(GDAL_VERSION_NUM) && GDAL_VERSION_NUM >= 1800
 #define TO8F(x) (x).toUtf8().constData()
@@ -26,6 +30,28 @@
 #define TO8F(x) QFile::encodeName( x ).constData()
 #endif
 
+//number of columns of a tile and maximum number of rows of a band
+static const int sTileSize = 256;
+//maximum number of cells of a band, limits the memory use for very wide rasters
+static const int sMaxBandCells = 4 * 1024 * 1024;
+
+/**A tile of a band, processed by one thread*/
+struct QgsNineCellFilterTile
+{
+  QgsNineCellFilter* filter;
+  float* input;
+  int inputStride;
+  float* output;
+  int outputStride;
+  int nCols;
+  int nRows;
+};
+
+static void processTile( QgsNineCellFilterTile& tile )
+{
+  tile.filter->processNineCellBlock( tile.input, tile.inputStride, tile.output, tile.outputStride, tile.nCols, tile.nRows );
+}
+
 QgsNineCellFilter::QgsNineCellFilter( const QString& inputFile, const QString& outputFile, const QString& outputFormat )
     : mInputFile( inputFile ), mOutputFile( outputFile ), mOutputFormat( outputFormat ), mCellSizeX( -1 ), mCellSizeY( -1 ),
     mInputNodataValue( -1 ), mOutputNodataValue( -1 ), mZFactor( 1.0 )
@@ -96,20 +122,25 @@ int QgsNineCellFilter::processRaster( QProgressDialog* p )
     return 6;
   }
 
-  //keep only three scanlines in memory at a time
-  float* scanLine1 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
-  float* scanLine2 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
-  float* scanLine3 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
-
-  float* resultLine = ( float * ) CPLMalloc( sizeof( float ) * xSize );
-
   if ( p )
   {
     p->setMaximum( ySize );
   }
 
-  //values outside the layer extent (if the 3x3 window is on the border) are sent to the processing method as (input) nodata values
-  for ( int i = 0; i < ySize; ++i )
+  //the input of a band has a border of one cell, values outside the layer extent (if the 3x3 window is on the border)
+  //are sent to the processing method as (input) nodata values
+  bool concurrent = supportsConcurrentProcessing() && QThread::idealThreadCount() > 1;
+  int bandRows = qBound( 1, sMaxBandCells / xSize, sTileSize );
+  int inputStride = xSize + 2;
+  QVector<float> input[2];
+  QVector<float> output[2];
+  QVector<QgsNineCellFilterTile> tiles;
+  int result = 0;
+
+  //the next band is read and the previous band written while the tiles of the current band are processed
+  int current = 0;
+  readBand( rasterBand, 0, qMin( bandRows, ySize ), xSize, ySize, input[current] );
+  for ( int i = 0; i < ySize; i += bandRows )
   {
     if ( p )
     {
@@ -121,56 +152,57 @@ int QgsNineCellFilter::processRaster( QProgressDialog* p )
       break;
     }
 
-    if ( i == 0 )
+    int nRows = qMin( bandRows, ySize - i );
+    output[current].resize( nRows * xSize );
+    tiles.clear();
+    for ( int col = 0; col < xSize; col += sTileSize )
     {
-      //fill scanline 1 with (input) nodata for the values above the first row and feed scanline2 with the first row
-      for ( int a = 0; a < xSize; ++a )
-      {
-        scanLine1[a] = mInputNodataValue;
-      }
-      GDALRasterIO( rasterBand, GF_Read, 0, 0, xSize, 1, scanLine2, xSize, 1, GDT_Float32, 0, 0 );
+      QgsNineCellFilterTile tile;
+      tile.filter = this;
+      tile.input = input[current].data() + col;
+      tile.inputStride = inputStride;
+      tile.output = output[current].data() + col;
+      tile.outputStride = xSize;
+      tile.nCols = qMin( sTileSize, xSize - col );
+      tile.nRows = nRows;
+      tiles.append( tile );
     }
-    else
+
+    QFuture<void> future;
+    if ( concurrent )
     {
-      //normally fetch only scanLine3 and release scanline 1 if we move forward one row
-      CPLFree( scanLine1 );
-      scanLine1 = scanLine2;
-      scanLine2 = scanLine3;
-      scanLine3 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
+      future = QtConcurrent::map( tiles, processTile );
     }
-
-    if ( i == ySize - 1 ) //fill the row below the bottom with nodata values
+    else
     {
-      for ( int a = 0; a < xSize; ++a )
+      for ( int t = 0; t < tiles.size(); ++t )
       {
-        scanLine3[a] = mInputNodataValue;
+        processTile( tiles[t] );
       }
     }
-    else
+
+    int previous = 1 - current;
+    if ( i > 0 && writeBand( outputRasterBand, i - bandRows, bandRows, xSize, output[previous] ) != 0 )
     {
-      GDALRasterIO( rasterBand, GF_Read, 0, i + 1, xSize, 1, scanLine3, xSize, 1, GDT_Float32, 0, 0 );
+      result = 8;
     }
+    if ( i + bandRows < ySize )
+    {
+      readBand( rasterBand, i + bandRows, qMin( bandRows, ySize - i - bandRows ), xSize, ySize, input[previous] );
+    }
+    future.waitForFinished();
 
-    for ( int j = 0; j < xSize; ++j )
+    if ( result != 0 )
     {
-      if ( j == 0 )
-      {
-        resultLine[j] = processNineCellWindow( &mInputNodataValue, &scanLine1[j], &scanLine1[j+1], &mInputNodataValue, &scanLine2[j],
-                                               &scanLine2[j+1], &mInputNodataValue, &scanLine3[j], &scanLine3[j+1] );
-      }
-      else if ( j == xSize - 1 )
-      {
-        resultLine[j] = processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &mInputNodataValue, &scanLine2[j-1], &scanLine2[j],
-                                               &mInputNodataValue, &scanLine3[j-1], &scanLine3[j], &mInputNodataValue );
-      }
-      else
-      {
-        resultLine[j] = processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &scanLine1[j+1], &scanLine2[j-1], &scanLine2[j],
-                                               &scanLine2[j+1], &scanLine3[j-1], &scanLine3[j], &scanLine3[j+1] );
-      }
+      break;
     }
 
-    GDALRasterIO( outputRasterBand, GF_Write, 0, i, xSize, 1, resultLine, xSize, 1, GDT_Float32, 0, 0 );
+    if ( i + bandRows >= ySize && writeBand( outputRasterBand, i, nRows, xSize, output[current] ) != 0 )
+    {
+      result = 8;
+      break;
+    }
+    current = previous;
   }
 
   if ( p )
@@ -178,24 +210,60 @@ int QgsNineCellFilter::processRaster( QProgressDialog* p )
     p->setValue( ySize );
   }
 
-  CPLFree( resultLine );
-  CPLFree( scanLine1 );
-  CPLFree( scanLine2 );
-  CPLFree( scanLine3 );
-
   GDALClose( inputDataset );
 
-  if ( p && p->wasCanceled() )
+  if (( p && p->wasCanceled() ) || result != 0 )
   {
     //delete the dataset without closing (because it is faster)
     GDALDeleteDataset( outputDriver, TO8F( mOutputFile ) );
-    return 7;
+    return result != 0 ? result : 7;
   }
   GDALClose( outputDataset );
 
   return 0;
 }
 
+void QgsNineCellFilter::processNineCellBlock( float* input, int inputStride, float* output, int outputStride, int nCols, int nRows )
+{
+  for ( int row = 0; row < nRows; ++row )
+  {
+    float* x1 = input + row * inputStride;
+    float* x2 = x1 + inputStride;
+    float* x3 = x2 + inputStride;
+    float* resultLine = output + row * outputStride;
+    for ( int j = 0; j < nCols; ++j )
+    {
+      resultLine[j] = processNineCellWindow( &x1[j], &x1[j+1], &x1[j+2], &x2[j], &x2[j+1], &x2[j+2], &x3[j], &x3[j+1], &x3[j+2] );
+    }
+  }
+}
+
+void QgsNineCellFilter::readBand( GDALRasterBandH rasterBand, int firstRow, int nRows, int xSize, int ySize, QVector<float>& values ) const
+{
+  //rows firstRow - 1 to firstRow + nRows, with one nodata column on each side
+  int inputStride = xSize + 2;
+  values.fill( mInputNodataValue, ( nRows + 2 ) * inputStride );
+
+  int readFirst = qMax( 0, firstRow - 1 );
+  int readLast = qMin( ySize - 1, firstRow + nRows );
+  float* start = values.data() + ( readFirst - firstRow + 1 ) * inputStride + 1;
+  if ( GDALRasterIO( rasterBand, GF_Read, 0, readFirst, xSize, readLast - readFirst + 1, start, xSize, readLast - readFirst + 1,
+                     GDT_Float32, 0, inputStride * sizeof( float ) ) != CE_None )
+  {
+    QgsDebugMsg( QString( "Reading rows %1 to %2 failed: %3" ).arg( readFirst ).arg( readLast ).arg( CPLGetLastErrorMsg() ) );
+  }
+}
+
+int QgsNineCellFilter::writeBand( GDALRasterBandH rasterBand, int firstRow, int nRows, int xSize, QVector<float>& values ) const
+{
+  if ( GDALRasterIO( rasterBand, GF_Write, 0, firstRow, xSize, nRows, values.data(), xSize, nRows, GDT_Float32, 0, 0 ) != CE_None )
+  {
+    QgsDebugMsg( QString( "Writing rows %1 to %2 failed: %3" ).arg( firstRow ).arg( firstRow + nRows - 1 ).arg( CPLGetLastErrorMsg() ) );
+    return 1;
+  }
+  return 0;
+}
+
 GDALDatasetH QgsNineCellFilter::openInputFile( int& nCellsX, int& nCellsY )
 {
   GDALDatasetH inputDataset = GDALOpen( TO8F( mInputFile ), GA_ReadOnly );
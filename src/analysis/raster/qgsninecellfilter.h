@@ -19,13 +19,17 @@
 #define QGSNINECELLFILTER_H
 
 #include <QString>
+#include <QVector>
 #include "gdal.h"
 
 class QProgressDialog;
 
 /**Base class for raster analysis methods that work with a 3x3 cell filter and calculate the value of each cell based on
 the cell value and the eight neighbour cells. Common examples are slope and aspect calculation in DEMs. Subclasses only implement
-the method that calculates the new value from the nine values. Everything else (reading file, writing file) is done by this subclass*/
+the method that calculates the new value from the nine values. Everything else (reading file, writing file) is done by this subclass.
+
+The raster is processed in bands of rows, which are split into tiles. If the filter supports it, the tiles of a band are
+calculated in parallel while the previous band is written and the next one is read*/
 
 class ANALYSIS_EXPORT QgsNineCellFilter
 {
@@ -57,6 +61,24 @@ class ANALYSIS_EXPORT QgsNineCellFilter
                                          float* x12, float* x22, float* x32,
                                          float* x13, float* x23, float* x33 ) = 0;
 
+    /**Calculates the output values of a block of cells. The default implementation calls processNineCellWindow() for
+      each cell, subclasses may override it with a loop that avoids the virtual call per cell
+      @param input the block with a border of one cell, starting with the cell above and left of the first cell of the block.
+      Cells outside of the raster have the input nodata value
+      @param inputStride number of values between the starts of two rows of input
+      @param output receives the values of the block
+      @param outputStride number of values between the starts of two rows of output
+      @param nCols number of columns of the block
+      @param nRows number of rows of the block
+      @note added in 2.4
+      @note not available in python bindings*/
+    virtual void processNineCellBlock( float* input, int inputStride, float* output, int outputStride, int nCols, int nRows );
+
+    /**Returns true if processNineCellWindow() and processNineCellBlock() may be called from several threads at the same time.
+      The default implementation returns false
+      @note added in 2.4*/
+    virtual bool supportsConcurrentProcessing() const { return false; }
+
   private:
     //default constructor forbidden. We need input file, output file and format obligatory
     QgsNineCellFilter();
@@ -70,6 +92,12 @@ class ANALYSIS_EXPORT QgsNineCellFilter
       @return the output dataset or NULL in case of error*/
     GDALDatasetH openOutputFile( GDALDatasetH inputDataset, GDALDriverH outputDriver );
 
+    /**Reads the rows of a band with a border of one cell as expected by processNineCellBlock()*/
+    void readBand( GDALRasterBandH rasterBand, int firstRow, int nRows, int xSize, int ySize, QVector<float>& values ) const;
+    /**Writes the rows of a band
+      @return 0 in case of success*/
+    int writeBand( GDALRasterBandH rasterBand, int firstRow, int nRows, int xSize, QVector<float>& values ) const;
+
   protected:
 
     QString mInputFile;
@@ -68,6 +68,22 @@ class ANALYSIS_EXPORT QgsRasterCalcNode
 
     Type type() const { return mType; }
 
+    /**Operator of an operator node
+      @note added in 2.4*/
+    Operator operatorType() const { return mOperator; }
+    /**Left (or only) operand of an operator node
+      @note added in 2.4*/
+    const QgsRasterCalcNode* left() const { return mLeft; }
+    /**Right operand of a binary operator node, 0 for one argument operators
+      @note added in 2.4*/
+    const QgsRasterCalcNode* right() const { return mRight; }
+    /**Value of a number node
+      @note added in 2.4*/
+    double number() const { return mNumber; }
+    /**Raster band reference of a raster node, e.g. "dem@1"
+      @note added in 2.4*/
+    QString rasterName() const { return mRasterName; }
+
     //set left node
     void setLeft( QgsRasterCalcNode* left ) { delete mLeft; mLeft = left; }
     void setRight( QgsRasterCalcNode* right ) { delete mRight; mRight = right; }
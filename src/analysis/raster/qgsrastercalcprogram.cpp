@@ -0,0 +1,588 @@
+/***************************************************************************
+                          qgsrastercalcprogram.cpp
+                          ------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsrastercalcprogram.h"
+#include "qgslogger.h"
+#include <cfloat>
+#include <cmath>
+
+//number of cells evaluated by one pass over the instructions. The scratch buffers of a pass stay in the cache
+static const int sChunkSize = 1024;
+
+//the operators below reproduce the arithmetic of QgsRasterMatrix. Operands are float values converted to double,
+//valid() is false for arguments giving a nodata result
+
+struct QgsRasterCalcPlus
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return static_cast<float>( a + b ); }
+};
+
+struct QgsRasterCalcMinus
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return static_cast<float>( a - b ); }
+};
+
+struct QgsRasterCalcMul
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return static_cast<float>( a * b ); }
+};
+
+struct QgsRasterCalcDiv
+{
+  static inline bool valid( double, double b ) { return b != 0; }
+  static inline float calc( double a, double b ) { return static_cast<float>( a / b ); }
+};
+
+//unlike QgsRasterMatrix, powers with a number operand are calculated in double precision too
+struct QgsRasterCalcPow
+{
+  static inline bool valid( double base, double power )
+  {
+    return !(( base == 0 && power < 0 ) || ( power < 0 && ( power - floor( power ) ) > 0 ) );
+  }
+  static inline float calc( double a, double b ) { return static_cast<float>( pow( a, b ) ); }
+};
+
+struct QgsRasterCalcEqual
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return a == b ? 1.0f : 0.0f; }
+};
+
+struct QgsRasterCalcNotEqual
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return a == b ? 0.0f : 1.0f; }
+};
+
+struct QgsRasterCalcGreaterThan
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return a > b ? 1.0f : 0.0f; }
+};
+
+struct QgsRasterCalcLesserThan
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return a < b ? 1.0f : 0.0f; }
+};
+
+struct QgsRasterCalcGreaterEqual
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return a >= b ? 1.0f : 0.0f; }
+};
+
+struct QgsRasterCalcLesserEqual
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return a <= b ? 1.0f : 0.0f; }
+};
+
+struct QgsRasterCalcAnd
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return a && b ? 1.0f : 0.0f; }
+};
+
+struct QgsRasterCalcOr
+{
+  static inline bool valid( double, double ) { return true; }
+  static inline float calc( double a, double b ) { return a || b ? 1.0f : 0.0f; }
+};
+
+struct QgsRasterCalcSqrt
+{
+  static inline bool valid( double a ) { return !( a < 0 ); }
+  static inline float calc( double a ) { return static_cast<float>( sqrt( a ) ); }
+};
+
+struct QgsRasterCalcSin
+{
+  static inline bool valid( double ) { return true; }
+  static inline float calc( double a ) { return static_cast<float>( sin( a ) ); }
+};
+
+struct QgsRasterCalcCos
+{
+  static inline bool valid( double ) { return true; }
+  static inline float calc( double a ) { return static_cast<float>( cos( a ) ); }
+};
+
+struct QgsRasterCalcTan
+{
+  static inline bool valid( double ) { return true; }
+  static inline float calc( double a ) { return static_cast<float>( tan( a ) ); }
+};
+
+struct QgsRasterCalcAsin
+{
+  static inline bool valid( double ) { return true; }
+  static inline float calc( double a ) { return static_cast<float>( asin( a ) ); }
+};
+
+struct QgsRasterCalcAcos
+{
+  static inline bool valid( double ) { return true; }
+  static inline float calc( double a ) { return static_cast<float>( acos( a ) ); }
+};
+
+struct QgsRasterCalcAtan
+{
+  static inline bool valid( double ) { return true; }
+  static inline float calc( double a ) { return static_cast<float>( atan( a ) ); }
+};
+
+struct QgsRasterCalcSign
+{
+  static inline bool valid( double ) { return true; }
+  static inline float calc( double a ) { return static_cast<float>( -a ); }
+};
+
+//nodata cells are left untouched, the result has the nodata value of the argument
+template<class Op> static void oneArgumentKernel( const float* values, double nodataValue, float* result, int n )
+{
+  float nodata = static_cast<float>( nodataValue );
+  for ( int i = 0; i < n; ++i )
+  {
+    double value = values[i];
+    if ( value == nodataValue )
+    {
+      result[i] = values[i];
+    }
+    else
+    {
+      result[i] = Op::valid( value ) ? Op::calc( value ) : nodata;
+    }
+  }
+}
+
+//two matrices or two numbers. The result has the nodata value of the first argument
+template<class Op> static void matrixMatrixKernel( const float* first, double firstNodata, const float* second, double secondNodata, float* result, int n )
+{
+  float nodata = static_cast<float>( firstNodata );
+  for ( int i = 0; i < n; ++i )
+  {
+    double value1 = first[i];
+    double value2 = second[i];
+    if ( value1 == firstNodata || value2 == secondNodata || !Op::valid( value1, value2 ) )
+    {
+      result[i] = nodata;
+    }
+    else
+    {
+      result[i] = Op::calc( value1, value2 );
+    }
+  }
+}
+
+//matrix and number. Nodata cells of the matrix are left untouched
+template<class Op> static void matrixNumberKernel( const float* first, double firstNodata, double value2, float* result, int n )
+{
+  float nodata = static_cast<float>( firstNodata );
+  for ( int i = 0; i < n; ++i )
+  {
+    double value1 = first[i];
+    if ( value1 == firstNodata )
+    {
+      result[i] = first[i];
+    }
+    else
+    {
+      result[i] = Op::valid( value1, value2 ) ? Op::calc( value1, value2 ) : nodata;
+    }
+  }
+}
+
+//number and matrix. The result has the nodata value of the matrix
+template<class Op> static void numberMatrixKernel( double value1, const float* second, double secondNodata, float* result, int n )
+{
+  float nodata = static_cast<float>( secondNodata );
+  for ( int i = 0; i < n; ++i )
+  {
+    double value2 = second[i];
+    if ( value2 == secondNodata || !Op::valid( value1, value2 ) )
+    {
+      result[i] = nodata;
+    }
+    else
+    {
+      result[i] = Op::calc( value1, value2 );
+    }
+  }
+}
+
+template<class Op> static void twoArgumentKernel( const float* first, bool firstIsNumber, double firstNodata,
+    const float* second, bool secondIsNumber, double secondNodata, float* result, int n )
+{
+  if ( firstIsNumber && !secondIsNumber )
+  {
+    numberMatrixKernel<Op>( first[0], second, secondNodata, result, n );
+  }
+  else if ( secondIsNumber && !firstIsNumber )
+  {
+    matrixNumberKernel<Op>( first, firstNodata, second[0], result, n );
+  }
+  else
+  {
+    matrixMatrixKernel<Op>( first, firstNodata, second, secondNodata, result, n );
+  }
+}
+
+static bool oneArgumentOperation( QgsRasterCalcNode::Operator op, const float* values, double nodataValue, float* result, int n )
+{
+  switch ( op )
+  {
+    case QgsRasterCalcNode::opSQRT:
+      oneArgumentKernel<QgsRasterCalcSqrt>( values, nodataValue, result, n );
+      break;
+    case QgsRasterCalcNode::opSIN:
+      oneArgumentKernel<QgsRasterCalcSin>( values, nodataValue, result, n );
+      break;
+    case QgsRasterCalcNode::opCOS:
+      oneArgumentKernel<QgsRasterCalcCos>( values, nodataValue, result, n );
+      break;
+    case QgsRasterCalcNode::opTAN:
+      oneArgumentKernel<QgsRasterCalcTan>( values, nodataValue, result, n );
+      break;
+    case QgsRasterCalcNode::opASIN:
+      oneArgumentKernel<QgsRasterCalcAsin>( values, nodataValue, result, n );
+      break;
+    case QgsRasterCalcNode::opACOS:
+      oneArgumentKernel<QgsRasterCalcAcos>( values, nodataValue, result, n );
+      break;
+    case QgsRasterCalcNode::opATAN:
+      oneArgumentKernel<QgsRasterCalcAtan>( values, nodataValue, result, n );
+      break;
+    case QgsRasterCalcNode::opSIGN:
+      oneArgumentKernel<QgsRasterCalcSign>( values, nodataValue, result, n );
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+static bool twoArgumentOperation( QgsRasterCalcNode::Operator op, const float* first, bool firstIsNumber, double firstNodata,
+                                  const float* second, bool secondIsNumber, double secondNodata, float* result, int n )
+{
+  switch ( op )
+  {
+    case QgsRasterCalcNode::opPLUS:
+      twoArgumentKernel<QgsRasterCalcPlus>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opMINUS:
+      twoArgumentKernel<QgsRasterCalcMinus>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opMUL:
+      twoArgumentKernel<QgsRasterCalcMul>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opDIV:
+      twoArgumentKernel<QgsRasterCalcDiv>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opPOW:
+      twoArgumentKernel<QgsRasterCalcPow>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opEQ:
+      twoArgumentKernel<QgsRasterCalcEqual>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opNE:
+      twoArgumentKernel<QgsRasterCalcNotEqual>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opGT:
+      twoArgumentKernel<QgsRasterCalcGreaterThan>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opLT:
+      twoArgumentKernel<QgsRasterCalcLesserThan>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opGE:
+      twoArgumentKernel<QgsRasterCalcGreaterEqual>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opLE:
+      twoArgumentKernel<QgsRasterCalcLesserEqual>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opAND:
+      twoArgumentKernel<QgsRasterCalcAnd>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    case QgsRasterCalcNode::opOR:
+      twoArgumentKernel<QgsRasterCalcOr>( first, firstIsNumber, firstNodata, second, secondIsNumber, secondNodata, result, n );
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+static bool isOneArgumentOperator( QgsRasterCalcNode::Operator op )
+{
+  switch ( op )
+  {
+    case QgsRasterCalcNode::opSQRT:
+    case QgsRasterCalcNode::opSIN:
+    case QgsRasterCalcNode::opCOS:
+    case QgsRasterCalcNode::opTAN:
+    case QgsRasterCalcNode::opASIN:
+    case QgsRasterCalcNode::opACOS:
+    case QgsRasterCalcNode::opATAN:
+    case QgsRasterCalcNode::opSIGN:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool isTwoArgumentOperator( QgsRasterCalcNode::Operator op )
+{
+  switch ( op )
+  {
+    case QgsRasterCalcNode::opPLUS:
+    case QgsRasterCalcNode::opMINUS:
+    case QgsRasterCalcNode::opMUL:
+    case QgsRasterCalcNode::opDIV:
+    case QgsRasterCalcNode::opPOW:
+    case QgsRasterCalcNode::opEQ:
+    case QgsRasterCalcNode::opNE:
+    case QgsRasterCalcNode::opGT:
+    case QgsRasterCalcNode::opLT:
+    case QgsRasterCalcNode::opGE:
+    case QgsRasterCalcNode::opLE:
+    case QgsRasterCalcNode::opAND:
+    case QgsRasterCalcNode::opOR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+QgsRasterCalcProgram::QgsRasterCalcProgram( const QgsRasterCalcNode* node, const QStringList& rasterRefs, const QVector<double>& nodataValues )
+    : mRasterRefs( rasterRefs )
+    , mNodataValues( nodataValues )
+    , mNumRegisters( 0 )
+    , mValid( false )
+{
+  mResult.kind = Operand::Number;
+  mResult.index = -1;
+  mResult.value = 0;
+  mResult.nodataValue = -FLT_MAX;
+
+  if ( mNodataValues.size() != mRasterRefs.size() )
+  {
+    QgsDebugMsg( "Number of nodata values does not match the number of raster references" );
+    return;
+  }
+
+  QList<int> freeRegisters;
+  mValid = compile( node, mResult, freeRegisters );
+  if ( !mValid )
+  {
+    mInstructions.clear();
+  }
+}
+
+bool QgsRasterCalcProgram::compile( const QgsRasterCalcNode* node, Operand& result, QList<int>& freeRegisters )
+{
+  if ( !node )
+  {
+    return false;
+  }
+
+  if ( node->type() == QgsRasterCalcNode::tNumber )
+  {
+    //same as the 1x1 matrix of QgsRasterCalcNode::calculate
+    result.kind = Operand::Number;
+    result.index = -1;
+    result.value = node->number();
+    result.nodataValue = -FLT_MAX;
+    return true;
+  }
+  else if ( node->type() == QgsRasterCalcNode::tRasterRef )
+  {
+    int index = mRasterRefs.indexOf( node->rasterName() );
+    if ( index < 0 )
+    {
+      QgsDebugMsg( QString( "Unknown raster reference %1" ).arg( node->rasterName() ) );
+      return false;
+    }
+    result.kind = Operand::Raster;
+    result.index = index;
+    result.value = 0;
+    result.nodataValue = mNodataValues.at( index );
+    return true;
+  }
+  else if ( node->type() != QgsRasterCalcNode::tOperator )
+  {
+    return false;
+  }
+
+  Operand first;
+  if ( !compile( node->left(), first, freeRegisters ) )
+  {
+    return false;
+  }
+
+  Instruction instruction;
+  instruction.op = node->operatorType();
+  instruction.first = first;
+  instruction.second = first;
+
+  if ( isOneArgumentOperator( instruction.op ) )
+  {
+    if ( first.kind == Operand::Number )
+    {
+      result = first;
+      oneArgumentOperation( instruction.op, &first.value, first.nodataValue, &result.value, 1 );
+      return true;
+    }
+    instruction.type = Instruction::OneArgument;
+    result.nodataValue = first.nodataValue;
+  }
+  else
+  {
+    Operand second;
+    if ( !isTwoArgumentOperator( instruction.op ) || !compile( node->right(), second, freeRegisters ) )
+    {
+      return false;
+    }
+
+    if ( first.kind == Operand::Number && second.kind == Operand::Number )
+    {
+      result = first;
+      return twoArgumentOperation( instruction.op, &first.value, true, first.nodataValue, &second.value, true, second.nodataValue, &result.value, 1 );
+    }
+
+    instruction.second = second;
+    instruction.type = Instruction::TwoArguments;
+    result.nodataValue = first.kind == Operand::Number ? second.nodataValue : first.nodataValue;
+
+    //a nodata number makes the whole result nodata
+    if (( first.kind == Operand::Number && first.value == second.nodataValue )
+        || ( second.kind == Operand::Number && second.value == second.nodataValue ) )
+    {
+      instruction.type = Instruction::Fill;
+      instruction.first.kind = Operand::Number;
+      instruction.first.index = -1;
+      instruction.first.value = static_cast<float>( result.nodataValue );
+    }
+  }
+
+  instruction.destination = allocateRegister( first, instruction.second, freeRegisters );
+  mInstructions.append( instruction );
+
+  result.kind = Operand::Register;
+  result.index = instruction.destination;
+  result.value = 0;
+  return true;
+}
+
+int QgsRasterCalcProgram::allocateRegister( const Operand& first, const Operand& second, QList<int>& freeRegisters )
+{
+  //the kernels work element by element, so the result may overwrite one of the arguments
+  if ( first.kind == Operand::Register )
+  {
+    if ( second.kind == Operand::Register && second.index != first.index )
+    {
+      freeRegisters.append( second.index );
+    }
+    return first.index;
+  }
+  if ( second.kind == Operand::Register )
+  {
+    return second.index;
+  }
+  if ( !freeRegisters.isEmpty() )
+  {
+    return freeRegisters.takeLast();
+  }
+  return mNumRegisters++;
+}
+
+const float* QgsRasterCalcProgram::operandData( const Operand& operand, const float* const* inputs, const float* registers, int offset ) const
+{
+  switch ( operand.kind )
+  {
+    case Operand::Raster:
+      return inputs[operand.index] + offset;
+    case Operand::Register:
+      return registers + operand.index * sChunkSize;
+    default:
+      return &operand.value;
+  }
+}
+
+void QgsRasterCalcProgram::evaluate( const float* const* inputs, int nCells, float* result, float resultNodataValue ) const
+{
+  if ( !mValid )
+  {
+    for ( int i = 0; i < nCells; ++i )
+    {
+      result[i] = resultNodataValue;
+    }
+    return;
+  }
+
+  QVector<float> registers( mNumRegisters * sChunkSize );
+  float* registerData = registers.data();
+
+  for ( int offset = 0; offset < nCells; offset += sChunkSize )
+  {
+    int n = qMin( sChunkSize, nCells - offset );
+
+    for ( int i = 0; i < mInstructions.size(); ++i )
+    {
+      const Instruction& instruction = mInstructions.at( i );
+      float* destination = registerData + instruction.destination * sChunkSize;
+      const float* first = operandData( instruction.first, inputs, registerData, offset );
+      switch ( instruction.type )
+      {
+        case Instruction::Fill:
+          for ( int j = 0; j < n; ++j )
+          {
+            destination[j] = first[0];
+          }
+          break;
+        case Instruction::OneArgument:
+          oneArgumentOperation( instruction.op, first, instruction.first.nodataValue, destination, n );
+          break;
+        case Instruction::TwoArguments:
+          twoArgumentOperation( instruction.op, first, instruction.first.kind == Operand::Number, instruction.first.nodataValue,
+                                operandData( instruction.second, inputs, registerData, offset ),
+                                instruction.second.kind == Operand::Number, instruction.second.nodataValue, destination, n );
+          break;
+      }
+    }
+
+    //replace the nodata values of the result with the output nodata value
+    const float* values = operandData( mResult, inputs, registerData, offset );
+    float* resultValues = result + offset;
+    if ( mResult.kind == Operand::Number )
+    {
+      float value = values[0] == mResult.nodataValue ? resultNodataValue : values[0];
+      for ( int j = 0; j < n; ++j )
+      {
+        resultValues[j] = value;
+      }
+    }
+    else
+    {
+      for ( int j = 0; j < n; ++j )
+      {
+        resultValues[j] = values[j] == mResult.nodataValue ? resultNodataValue : values[j];
+      }
+    }
+  }
+}
@@ -0,0 +1,103 @@
+/***************************************************************************
+                          qgsrastercalcprogram.h
+                          ----------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSRASTERCALCPROGRAM_H
+#define QGSRASTERCALCPROGRAM_H
+
+#include "qgsrastercalcnode.h"
+#include <QStringList>
+#include <QVector>
+
+/**A raster calculator expression compiled for the evaluation of many cells at once.
+  The expression tree is flattened into a list of element-wise instructions working on a
+  few scratch buffers. Numbers are folded at compile time and raster references read
+  directly from the input buffers, so evaluation does not allocate memory per node.
+  The results are the same as the ones of QgsRasterCalcNode::calculate, except for powers:
+  these are always calculated in double precision, while QgsRasterMatrix uses float precision
+  if an operand is a number, so results may differ in the last bit.
+  evaluate() is const and may be called from several threads at the same time.
+  @note added in 2.4
+  @note not available in python bindings*/
+class ANALYSIS_EXPORT QgsRasterCalcProgram
+{
+  public:
+    /**Compiles an expression tree
+      @param node parsed expression, not referenced after construction
+      @param rasterRefs raster band references in the order of the input buffers of evaluate()
+      @param nodataValues nodata value of each raster band reference*/
+    QgsRasterCalcProgram( const QgsRasterCalcNode* node, const QStringList& rasterRefs, const QVector<double>& nodataValues );
+
+    /**False if the expression references an unknown raster or contains an invalid operator*/
+    bool isValid() const { return mValid; }
+
+    /**Calculates the expression for a run of cells
+      @param inputs one buffer of nCells values for each raster band reference
+      @param nCells number of cells
+      @param result receives nCells values
+      @param resultNodataValue value written for nodata results*/
+    void evaluate( const float* const* inputs, int nCells, float* result, float resultNodataValue ) const;
+
+  private:
+    //! value read by an instruction
+    struct Operand
+    {
+      enum Kind
+      {
+        Number,
+        Raster,
+        Register
+      };
+
+      Kind kind;
+      //! raster reference or register index
+      int index;
+      //! value of a number
+      float value;
+      double nodataValue;
+    };
+
+    struct Instruction
+    {
+      enum Type
+      {
+        OneArgument,
+        TwoArguments,
+        Fill //!< sets the destination register to the value of the first operand
+      };
+
+      Type type;
+      QgsRasterCalcNode::Operator op;
+      Operand first;
+      Operand second;
+      int destination;
+    };
+
+    /**Appends the instructions of a node
+      @param result receives the operand holding the result of the node
+      @param freeRegisters registers which may be reused*/
+    bool compile( const QgsRasterCalcNode* node, Operand& result, QList<int>& freeRegisters );
+    int allocateRegister( const Operand& first, const Operand& second, QList<int>& freeRegisters );
+
+    const float* operandData( const Operand& operand, const float* const* inputs, const float* registers, int offset ) const;
+
+    QStringList mRasterRefs;
+    QVector<double> mNodataValues;
+    QVector<Instruction> mInstructions;
+    Operand mResult;
+    int mNumRegisters;
+    bool mValid;
+};
+
+#endif // QGSRASTERCALCPROGRAM_H
@@ -17,11 +17,14 @@
 
 #include "qgsrastercalculator.h"
 #include "qgsrastercalcnode.h"
+#include "qgsrastercalcprogram.h"
 #include "qgsrasterlayer.h"
-#include "qgsrastermatrix.h"
 #include "cpl_string.h"
 #include <QProgressDialog>
 #include <QFile>
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrentMap>
 
 #include "gdalwarper.h"
 #include <ogr_srs_api.h>
@@ -34,6 +37,28 @@
 #define TO8F(x)  QFile::encodeName( x ).constData()
 #endif
 
+//maximum number of cells of the input and output buffers of a block of rows
+static const int sMaxBlockCells = 8 * 1024 * 1024;
+//maximum number of rows of a block
+static const int sMaxBlockRows = 256;
+//number of cells calculated by one thread
+static const int sTileCells = 64 * 1024;
+
+/**Cells of a block of rows, calculated by one thread*/
+struct QgsRasterCalculatorTile
+{
+  const QgsRasterCalcProgram* program;
+  QVector<const float*> inputs;
+  float* output;
+  int nCells;
+  float nodataValue;
+};
+
+static void processTile( QgsRasterCalculatorTile& tile )
+{
+  tile.program->evaluate( tile.inputs.constData(), tile.nCells, tile.output, tile.nodataValue );
+}
+
 QgsRasterCalculator::QgsRasterCalculator( const QString& formulaString, const QString& outputFile, const QString& outputFormat,
     const QgsRectangle& outputExtent, int nOutputColumns, int nOutputRows, const QVector<QgsRasterCalculatorEntry>& rasterEntries ): mFormulaString( formulaString ), mOutputFile( outputFile ), mOutputFormat( outputFormat ),
     mOutputRectangle( outputExtent ), mNumOutputColumns( nOutputColumns ), mNumOutputRows( nOutputRows ), mRasterEntries( rasterEntries )
@@ -59,8 +84,9 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
   outputGeoTransform( targetGeoTransform );
 
   //open all input rasters for reading
-  QMap< QString, GDALRasterBandH > mInputRasterBands; //raster references and corresponding scanline data
-  QMap< QString, QgsRasterMatrix* > inputScanLineData; //stores raster references and corresponding scanline data
+  QStringList inputRefs; //raster references in the order of the input buffers
+  QVector< GDALRasterBandH > mInputRasterBands; //bands corresponding to the raster references
+  QVector< double > inputNodataValues;
   QVector< GDALDatasetH > mInputDatasets; //raster references and corresponding dataset
 
   QVector<QgsRasterCalculatorEntry>::const_iterator it = mRasterEntries.constBegin();
@@ -104,8 +130,22 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
     int nodataSuccess;
     double nodataValue = GDALGetRasterNoDataValue( inputRasterBand, &nodataSuccess );
 
-    mInputRasterBands.insert( it->ref, inputRasterBand );
-    inputScanLineData.insert( it->ref, new QgsRasterMatrix( mNumOutputColumns, 1, new float[mNumOutputColumns], nodataValue ) );
+    inputRefs.append( it->ref );
+    mInputRasterBands.append( inputRasterBand );
+    inputNodataValues.append( nodataValue );
+  }
+
+  //compile the expression for the evaluation of many cells at once
+  QgsRasterCalcProgram program( calcNode, inputRefs, inputNodataValues );
+  delete calcNode;
+  if ( !program.isValid() )
+  {
+    QVector< GDALDatasetH >::iterator datasetIt = mInputDatasets.begin();
+    for ( ; datasetIt != mInputDatasets.end(); ++ datasetIt )
+    {
+      GDALClose( *datasetIt );
+    }
+    return 4;
   }
 
   //open output dataset for writing
@@ -144,17 +184,23 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
   float outputNodataValue = -FLT_MAX;
   GDALSetRasterNoDataValue( outputRasterBand, outputNodataValue );
 
-  float* resultScanLine = ( float * ) CPLMalloc( sizeof( float ) * mNumOutputColumns );
-
   if ( p )
   {
     p->setMaximum( mNumOutputRows );
   }
 
-  QgsRasterMatrix resultMatrix;
-
-  //read / write line by line
-  for ( int i = 0; i < mNumOutputRows; ++i )
+  //the rows are processed in blocks. The next block is read and the previous one written
+  //while the tiles of the current block are calculated
+  bool concurrent = QThread::idealThreadCount() > 1;
+  int nInputs = mInputRasterBands.size();
+  int blockRows = qBound( 1, sMaxBlockCells / qMax( 1, mNumOutputColumns * ( nInputs + 1 ) ), sMaxBlockRows );
+  QVector<float> input[2];
+  QVector<float> output[2];
+  QVector<QgsRasterCalculatorTile> tiles;
+
+  int current = 0;
+  readInputRows( targetGeoTransform, mInputRasterBands, 0, qMin( blockRows, mNumOutputRows ), input[current] );
+  for ( int i = 0; i < mNumOutputRows; i += blockRows )
   {
     if ( p )
     {
@@ -166,56 +212,53 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
       break;
     }
 
-    //fill buffers
-    QMap< QString, QgsRasterMatrix* >::iterator bufferIt = inputScanLineData.begin();
-    for ( ; bufferIt != inputScanLineData.end(); ++bufferIt )
-    {
-      double sourceTransformation[6];
-      GDALRasterBandH sourceRasterBand = mInputRasterBands[bufferIt.key()];
-      GDALGetGeoTransform( GDALGetBandDataset( sourceRasterBand ), sourceTransformation );
-      //the function readRasterPart calls GDALRasterIO (and ev. does some conversion if raster transformations are not the same)
-      readRasterPart( targetGeoTransform, 0, i, mNumOutputColumns, 1, sourceTransformation, sourceRasterBand, bufferIt.value()->data() );
-    }
-
-    if ( calcNode->calculate( inputScanLineData, resultMatrix ) )
+    int nRows = qMin( blockRows, mNumOutputRows - i );
+    int nCells = nRows * mNumOutputColumns;
+    output[current].resize( nCells );
+    tiles.clear();
+    for ( int offset = 0; offset < nCells; offset += sTileCells )
     {
-      bool resultIsNumber = resultMatrix.isNumber();
-      float* calcData;
-
-      if ( resultIsNumber ) //scalar result. Insert number for every pixel
-      {
-        calcData = new float[mNumOutputColumns];
-        for ( int j = 0; j < mNumOutputColumns; ++j )
-        {
-          calcData[j] = resultMatrix.number();
-        }
-      }
-      else //result is real matrix
-      {
-        calcData = resultMatrix.data();
-      }
-
-      //replace all matrix nodata values with output nodatas
-      for ( int j = 0; j < mNumOutputColumns; ++j )
+      QgsRasterCalculatorTile tile;
+      tile.program = &program;
+      for ( int k = 0; k < nInputs; ++k )
       {
-        if ( calcData[j] == resultMatrix.nodataValue() )
-        {
-          calcData[j] = outputNodataValue;
-        }
+        tile.inputs.append( input[current].constData() + k * nCells + offset );
       }
+      tile.output = output[current].data() + offset;
+      tile.nCells = qMin( sTileCells, nCells - offset );
+      tile.nodataValue = outputNodataValue;
+      tiles.append( tile );
+    }
 
-      //write scanline to the dataset
-      if ( GDALRasterIO( outputRasterBand, GF_Write, 0, i, mNumOutputColumns, 1, calcData, mNumOutputColumns, 1, GDT_Float32, 0, 0 ) != CE_None )
+    QFuture<void> future;
+    if ( concurrent )
+    {
+      future = QtConcurrent::map( tiles, processTile );
+    }
+    else
+    {
+      for ( int t = 0; t < tiles.size(); ++t )
       {
-        qWarning( "RasterIO error!" );
+        processTile( tiles[t] );
       }
+    }
 
-      if ( resultIsNumber )
-      {
-        delete[] calcData;
-      }
+    int previous = 1 - current;
+    if ( i > 0 )
+    {
+      writeOutputRows( outputRasterBand, i - blockRows, blockRows, output[previous] );
     }
+    if ( i + blockRows < mNumOutputRows )
+    {
+      readInputRows( targetGeoTransform, mInputRasterBands, i + blockRows, qMin( blockRows, mNumOutputRows - i - blockRows ), input[previous] );
+    }
+    future.waitForFinished();
 
+    if ( i + blockRows >= mNumOutputRows )
+    {
+      writeOutputRows( outputRasterBand, i, nRows, output[current] );
+    }
+    current = previous;
   }
 
   if ( p )
@@ -224,14 +267,6 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
   }
 
   //close datasets and release memory
-  delete calcNode;
-  QMap< QString, QgsRasterMatrix* >::iterator bufferIt = inputScanLineData.begin();
-  for ( ; bufferIt != inputScanLineData.end(); ++bufferIt )
-  {
-    delete bufferIt.value();
-  }
-  inputScanLineData.clear();
-
   QVector< GDALDatasetH >::iterator datasetIt = mInputDatasets.begin();
   for ( ; datasetIt != mInputDatasets.end(); ++ datasetIt )
   {
@@ -245,7 +280,6 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
     return 3;
   }
   GDALClose( outputDataset );
-  CPLFree( resultScanLine );
   return 0;
 }
 
@@ -292,6 +326,28 @@ GDALDatasetH QgsRasterCalculator::openOutputFile( GDALDriverH outputDriver )
   return outputDataset;
 }
 
+void QgsRasterCalculator::readInputRows( double* targetGeotransform, const QVector<GDALRasterBandH>& inputBands, int firstRow, int nRows, QVector<float>& values )
+{
+  //the rows of each band are stored one band after the other
+  int nCells = nRows * mNumOutputColumns;
+  values.resize( inputBands.size() * nCells );
+  for ( int k = 0; k < inputBands.size(); ++k )
+  {
+    double sourceTransformation[6];
+    GDALGetGeoTransform( GDALGetBandDataset( inputBands[k] ), sourceTransformation );
+    //the function readRasterPart calls GDALRasterIO (and ev. does some conversion if raster transformations are not the same)
+    readRasterPart( targetGeotransform, 0, firstRow, mNumOutputColumns, nRows, sourceTransformation, inputBands[k], values.data() + k * nCells );
+  }
+}
+
+void QgsRasterCalculator::writeOutputRows( GDALRasterBandH outputBand, int firstRow, int nRows, QVector<float>& values )
+{
+  if ( GDALRasterIO( outputBand, GF_Write, 0, firstRow, mNumOutputColumns, nRows, values.data(), mNumOutputColumns, nRows, GDT_Float32, 0, 0 ) != CE_None )
+  {
+    qWarning( "RasterIO error!" );
+  }
+}
+
 void QgsRasterCalculator::readRasterPart( double* targetGeotransform, int xOffset, int yOffset, int nCols, int nRows, double* sourceTransform, GDALRasterBandH sourceBand, float* rasterBuffer )
 {
   //If dataset transform is the same as the requested transform, do a normal GDAL raster io
@@ -374,11 +430,11 @@ void QgsRasterCalculator::readRasterPart( double* targetGeotransform, int xOffse
       if ( sourceIndexX >= 0 && sourceIndexX < nSourcePixelsX
            && sourceIndexY >= 0 && sourceIndexY < nSourcePixelsY )
       {
-        rasterBuffer[j + i*nRows] = sourceRaster[ sourceIndexX  + nSourcePixelsX * sourceIndexY ];
+        rasterBuffer[j + i*nCols] = sourceRaster[ sourceIndexX  + nSourcePixelsX * sourceIndexY ];
       }
       else
       {
-        rasterBuffer[j + i*j] = nodataValue;
+        rasterBuffer[j + i*nCols] = nodataValue;
       }
       targetPixelX += targetGeotransform[1];
     }
@@ -78,6 +78,17 @@ class ANALYSIS_EXPORT QgsRasterCalculator
                          GDALRasterBandH sourceBand,
                          float* rasterBuffer );
 
+    /**Reads rows of all input bands into one buffer, the rows of each band after the ones of the previous band
+      @param targetGeotransform transformation parameters of the output raster
+      @param inputBands input bands in the order of the raster references of the calculation
+      @param firstRow first output row
+      @param nRows number of rows
+      @param values receives the pixel values*/
+    void readInputRows( double* targetGeotransform, const QVector<GDALRasterBandH>& inputBands, int firstRow, int nRows, QVector<float>& values );
+
+    /**Writes calculated rows to the output band*/
+    void writeOutputRows( GDALRasterBandH outputBand, int firstRow, int nRows, QVector<float>& values );
+
     /**Compares two geotransformations (six parameter double arrays*/
     bool transformationsEqual( double* t1, double* t2 ) const;
 
@@ -33,62 +33,84 @@ QgsRuggednessFilter::~QgsRuggednessFilter()
 
 }
 
-float QgsRuggednessFilter::processNineCellWindow( float* x11, float* x21, float* x31,
-    float* x12, float* x22, float* x32, float* x13, float* x23, float* x33 )
+//ruggedness index of a 3x3 window
+static inline float ruggedness( float x11, float x21, float x31, float x12, float x22, float x32, float x13, float x23, float x33,
+                                float inputNodataValue, float outputNodataValue )
 {
   //the formula would be that easy without nodata values...
   /*
-    //return *x22; //test: write the raster value of the middle cell
-    float diff1 = *x11 - *x22;
-    float diff2 = *x21 - *x22;
-    float diff3 = *x31 - *x22;
-    float diff4 = *x12 - *x22;
-    float diff5 = *x32 - *x22;
-    float diff6 = *x13 - *x22;
-    float diff7 = *x23 - *x22;
-    float diff8 = *x33 - *x22;
+    //return x22; //test: write the raster value of the middle cell
+    float diff1 = x11 - x22;
+    float diff2 = x21 - x22;
+    float diff3 = x31 - x22;
+    float diff4 = x12 - x22;
+    float diff5 = x32 - x22;
+    float diff6 = x13 - x22;
+    float diff7 = x23 - x22;
+    float diff8 = x33 - x22;
     return sqrt(diff1 * diff1 + diff2 * diff2 + diff3 * diff3 + diff4 * diff4 + diff5 * diff5 + diff6 * diff6 + diff7 * diff7 + diff8 * diff8);
    */
 
-  if ( *x22 == mInputNodataValue )
+  if ( x22 == inputNodataValue )
   {
-    return mOutputNodataValue;
+    return outputNodataValue;
   }
 
   double sum = 0;
-  if ( *x11 != mInputNodataValue )
+  if ( x11 != inputNodataValue )
   {
-    sum += ( *x11 - *x22 ) * ( *x11 - *x22 );
+    sum += ( x11 - x22 ) * ( x11 - x22 );
   }
-  if ( *x21 != mInputNodataValue )
+  if ( x21 != inputNodataValue )
   {
-    sum += ( *x21 - *x22 ) * ( *x21 - *x22 );
+    sum += ( x21 - x22 ) * ( x21 - x22 );
   }
-  if ( *x31 != mInputNodataValue )
+  if ( x31 != inputNodataValue )
   {
-    sum += ( *x31 - *x22 ) * ( *x31 - *x22 );
+    sum += ( x31 - x22 ) * ( x31 - x22 );
   }
-  if ( *x12 != mInputNodataValue )
+  if ( x12 != inputNodataValue )
   {
-    sum += ( *x12 - *x22 ) * ( *x12 - *x22 );
+    sum += ( x12 - x22 ) * ( x12 - x22 );
   }
-  if ( *x32 != mInputNodataValue )
+  if ( x32 != inputNodataValue )
   {
-    sum += ( *x32 - *x22 ) * ( *x32 - *x22 );
+    sum += ( x32 - x22 ) * ( x32 - x22 );
   }
-  if ( *x13 != mInputNodataValue )
+  if ( x13 != inputNodataValue )
   {
-    sum += ( *x13 - *x22 ) * ( *x13 - *x22 );
+    sum += ( x13 - x22 ) * ( x13 - x22 );
   }
-  if ( *x23 != mInputNodataValue )
+  if ( x23 != inputNodataValue )
   {
-    sum += ( *x23 - *x22 ) * ( *x23 - *x22 );
+    sum += ( x23 - x22 ) * ( x23 - x22 );
   }
-  if ( *x33 != mInputNodataValue )
+  if ( x33 != inputNodataValue )
   {
-    sum += ( *x33 - *x22 ) * ( *x33 - *x22 );
+    sum += ( x33 - x22 ) * ( x33 - x22 );
   }
 
   return sqrt( sum );
 }
 
+float QgsRuggednessFilter::processNineCellWindow( float* x11, float* x21, float* x31,
+    float* x12, float* x22, float* x32, float* x13, float* x23, float* x33 )
+{
+  return ruggedness( *x11, *x21, *x31, *x12, *x22, *x32, *x13, *x23, *x33, mInputNodataValue, mOutputNodataValue );
+}
+
+void QgsRuggednessFilter::processNineCellBlock( float* input, int inputStride, float* output, int outputStride, int nCols, int nRows )
+{
+  for ( int row = 0; row < nRows; ++row )
+  {
+    const float* x1 = input + row * inputStride;
+    const float* x2 = x1 + inputStride;
+    const float* x3 = x2 + inputStride;
+    float* resultLine = output + row * outputStride;
+    for ( int j = 0; j < nCols; ++j )
+    {
+      resultLine[j] = ruggedness( x1[j], x1[j+1], x1[j+2], x2[j], x2[j+1], x2[j+2], x3[j], x3[j+1], x3[j+2],
+                                  mInputNodataValue, mOutputNodataValue );
+    }
+  }
+}
@@ -35,6 +35,14 @@ class ANALYSIS_EXPORT QgsRuggednessFilter: public QgsNineCellFilter
                                  float* x12, float* x22, float* x32,
                                  float* x13, float* x23, float* x33 );
 
+    /**Calculates the ruggedness index of a block of cells without a virtual call per cell
+      @note added in 2.4
+      @note not available in python bindings*/
+    void processNineCellBlock( float* input, int inputStride, float* output, int outputStride, int nCols, int nRows );
+
+    //! the calculation does not modify the filter and can be done in parallel
+    bool supportsConcurrentProcessing() const { return true; }
+
   private:
     QgsRuggednessFilter();
 };
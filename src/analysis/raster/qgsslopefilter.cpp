@@ -28,17 +28,40 @@ QgsSlopeFilter::~QgsSlopeFilter()
 
 }
 
+//slope in degrees from the derivatives
+static inline float slopeFromDerivatives( float derX, float derY, float outputNodataValue )
+{
+  if ( derX == outputNodataValue || derY == outputNodataValue )
+  {
+    return outputNodataValue;
+  }
+
+  return atan( sqrt( derX * derX + derY * derY ) ) * 180.0 / M_PI;
+}
+
 float QgsSlopeFilter::processNineCellWindow( float* x11, float* x21, float* x31,
     float* x12, float* x22, float* x32, float* x13, float* x23, float* x33 )
 {
   float derX = calcFirstDerX( x11, x21, x31, x12, x22, x32, x13, x23, x33 );
   float derY = calcFirstDerY( x11, x21, x31, x12, x22, x32, x13, x23, x33 );
+  return slopeFromDerivatives( derX, derY, mOutputNodataValue );
+}
 
-  if ( derX == mOutputNodataValue || derY == mOutputNodataValue )
+void QgsSlopeFilter::processNineCellBlock( float* input, int inputStride, float* output, int outputStride, int nCols, int nRows )
+{
+  QVector<float> derX( nCols );
+  QVector<float> derY( nCols );
+  for ( int row = 0; row < nRows; ++row )
   {
-    return mOutputNodataValue;
-  }
+    float* x1 = input + row * inputStride;
+    calcFirstDerivatives( x1, x1 + inputStride, x1 + 2 * inputStride, nCols, derX.data(), derY.data() );
 
-  return atan( sqrt( derX * derX + derY * derY ) ) * 180.0 / M_PI;
+    const float* dx = derX.constData();
+    const float* dy = derY.constData();
+    float* resultLine = output + row * outputStride;
+    for ( int j = 0; j < nCols; ++j )
+    {
+      resultLine[j] = slopeFromDerivatives( dx[j], dy[j], mOutputNodataValue );
+    }
+  }
 }
-
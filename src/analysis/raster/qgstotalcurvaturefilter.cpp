@@ -28,21 +28,44 @@ QgsTotalCurvatureFilter::~QgsTotalCurvatureFilter()
 
 }
 
-float QgsTotalCurvatureFilter::processNineCellWindow( float* x11, float* x21, float* x31, float* x12,
-    float* x22, float* x32, float* x13, float* x23, float* x33 )
+//total curvature of a 3x3 window
+static inline float totalCurvature( float x11, float x21, float x31, float x12, float x22, float x32, float x13, float x23, float x33,
+                                    double cellSizeX, double cellSizeY, float inputNodataValue, float outputNodataValue )
 {
   //return nodata if one value is the nodata value
-  if ( *x11 == mInputNodataValue || *x21 == mInputNodataValue || *x31 == mInputNodataValue || *x12 == mInputNodataValue
-       || *x22 == mInputNodataValue || *x32 == mInputNodataValue || *x13 == mInputNodataValue || *x23 == mInputNodataValue
-       || *x33 == mInputNodataValue )
+  if ( x11 == inputNodataValue || x21 == inputNodataValue || x31 == inputNodataValue || x12 == inputNodataValue
+       || x22 == inputNodataValue || x32 == inputNodataValue || x13 == inputNodataValue || x23 == inputNodataValue
+       || x33 == inputNodataValue )
   {
-    return mOutputNodataValue;
+    return outputNodataValue;
   }
 
-  double cellSizeAvg = ( mCellSizeX + mCellSizeY ) / 2.0;
-  double dxx = ( *x32 - 2 * *x22 + *x12 ) / ( mCellSizeX * mCellSizeX );
-  double dyy = ( -*x11 + *x31 + *x13 - *x33 ) / ( 4 * cellSizeAvg * cellSizeAvg );
-  double dxy = ( *x21 - 2 * *x22 + *x23 ) / ( mCellSizeY * mCellSizeY );
+  double cellSizeAvg = ( cellSizeX + cellSizeY ) / 2.0;
+  double dxx = ( x32 - 2 * x22 + x12 ) / ( cellSizeX * cellSizeX );
+  double dyy = ( -x11 + x31 + x13 - x33 ) / ( 4 * cellSizeAvg * cellSizeAvg );
+  double dxy = ( x21 - 2 * x22 + x23 ) / ( cellSizeY * cellSizeY );
 
   return dxx*dxx + 2*dxy*dxy + dyy*dyy;
 }
+
+float QgsTotalCurvatureFilter::processNineCellWindow( float* x11, float* x21, float* x31, float* x12,
+    float* x22, float* x32, float* x13, float* x23, float* x33 )
+{
+  return totalCurvature( *x11, *x21, *x31, *x12, *x22, *x32, *x13, *x23, *x33, mCellSizeX, mCellSizeY, mInputNodataValue, mOutputNodataValue );
+}
+
+void QgsTotalCurvatureFilter::processNineCellBlock( float* input, int inputStride, float* output, int outputStride, int nCols, int nRows )
+{
+  for ( int row = 0; row < nRows; ++row )
+  {
+    const float* x1 = input + row * inputStride;
+    const float* x2 = x1 + inputStride;
+    const float* x3 = x2 + inputStride;
+    float* resultLine = output + row * outputStride;
+    for ( int j = 0; j < nCols; ++j )
+    {
+      resultLine[j] = totalCurvature( x1[j], x1[j+1], x1[j+2], x2[j], x2[j+1], x2[j+2], x3[j], x3[j+1], x3[j+2],
+                                      mCellSizeX, mCellSizeY, mInputNodataValue, mOutputNodataValue );
+    }
+  }
+}
@@ -25,7 +25,133 @@
 #include "qgsvectorfilewriter.h"
 #include "qgsvectordataprovider.h"
 #include "qgsdistancearea.h"
+#include "qgswkbview.h"
 #include <QProgressDialog>
+#include <QThread>
+#include <QtConcurrentMap>
+
+//number of features read and buffered at once
+static const int sBatchSize = 1024;
+//number of geometries merged by one task of a tree union
+static const int sUnionGroupSize = 64;
+
+struct QgsBufferFeature
+{
+  QgsGeometry* geometry;
+  double distance;
+  QgsAttributes attributes;
+};
+
+struct QgsDissolveGroup
+{
+  QgsAttributes attributes;
+  QList<QgsGeometry*> geometries;
+  QgsGeometry* dissolveGeometry;
+};
+
+//replaces the geometry of the feature by its buffer
+static void bufferGeometry( QgsBufferFeature& feature )
+{
+  QgsGeometry* buffered = feature.geometry->buffer( feature.distance, 5 );
+  delete feature.geometry;
+  feature.geometry = buffered;
+}
+
+//spreads the lower 16 bits of v to the even bits of the result
+static quint32 interleaveBits( quint32 v )
+{
+  v &= 0x0000ffff;
+  v = ( v | ( v << 8 ) ) & 0x00ff00ff;
+  v = ( v | ( v << 4 ) ) & 0x0f0f0f0f;
+  v = ( v | ( v << 2 ) ) & 0x33333333;
+  v = ( v | ( v << 1 ) ) & 0x55555555;
+  return v;
+}
+
+static bool keyLessThan( const QPair<quint32, QgsGeometry*>& p1, const QPair<quint32, QgsGeometry*>& p2 )
+{
+  return p1.first < p2.first;
+}
+
+//sorts the geometries along a z-order curve through a 65536 x 65536 grid, so neighbouring geometries end up in the same union group
+static void sortSpatially( QList<QgsGeometry*>& geometries )
+{
+  QVector<QgsPoint> centers;
+  QgsRectangle extent;
+  for ( int i = 0; i < geometries.size(); ++i )
+  {
+    QgsRectangle bbox = geometries[i]->boundingBox();
+    if ( i == 0 )
+    {
+      extent = bbox;
+    }
+    else
+    {
+      extent.combineExtentWith( &bbox );
+    }
+    centers.append( bbox.center() );
+  }
+
+  double scaleX = extent.width() > 0 ? 65535.0 / extent.width() : 0.0;
+  double scaleY = extent.height() > 0 ? 65535.0 / extent.height() : 0.0;
+  QVector< QPair<quint32, QgsGeometry*> > keys;
+  for ( int i = 0; i < geometries.size(); ++i )
+  {
+    quint32 x = ( quint32 )(( centers[i].x() - extent.xMinimum() ) * scaleX );
+    quint32 y = ( quint32 )(( centers[i].y() - extent.yMinimum() ) * scaleY );
+    keys.append( qMakePair( interleaveBits( x ) | ( interleaveBits( y ) << 1 ), geometries[i] ) );
+  }
+  qSort( keys.begin(), keys.end(), keyLessThan );
+
+  for ( int i = 0; i < keys.size(); ++i )
+  {
+    geometries[i] = keys[i].second;
+  }
+}
+
+//union of the geometries, deletes them
+static QgsGeometry* unionGroup( const QList<QgsGeometry*>& geometries )
+{
+  QgsGeometry* unionGeometry = QgsGeometry::unaryUnion( geometries );
+  qDeleteAll( geometries );
+  return unionGeometry;
+}
+
+/**Merges the geometries with a tree of cascaded unions and deletes them. Each level merges groups of
+  neighbouring geometries (in parallel if concurrent is true) until one group is left*/
+static QgsGeometry* treeUnion( QList<QgsGeometry*> geometries, bool concurrent )
+{
+  while ( geometries.size() > sUnionGroupSize )
+  {
+    sortSpatially( geometries );
+    QList< QList<QgsGeometry*> > groups;
+    for ( int i = 0; i < geometries.size(); i += sUnionGroupSize )
+    {
+      groups.append( geometries.mid( i, sUnionGroupSize ) );
+    }
+
+    if ( concurrent )
+    {
+      geometries = QtConcurrent::blockingMapped( groups, unionGroup );
+    }
+    else
+    {
+      geometries.clear();
+      for ( int i = 0; i < groups.size(); ++i )
+      {
+        geometries.append( unionGroup( groups[i] ) );
+      }
+    }
+    geometries.removeAll( 0 );
+  }
+  return unionGroup( geometries );
+}
+
+static void dissolveGroup( QgsDissolveGroup& group )
+{
+  group.dissolveGeometry = treeUnion( group.geometries, false );
+  group.geometries.clear();
+}
 
 bool QgsGeometryAnalyzer::simplify( QgsVectorLayer* layer,
                                     const QString& shapefileName,
@@ -357,26 +483,13 @@ QList<double> QgsGeometryAnalyzer::simpleMeasure( QgsGeometry* mpGeometry )
 double QgsGeometryAnalyzer::perimeterMeasure( QgsGeometry* geometry, QgsDistanceArea& measure )
 {
   double value = 0.00;
-  if ( geometry->isMultipart() )
-  {
-    QgsMultiPolygon poly = geometry->asMultiPolygon();
-    QgsMultiPolygon::iterator it;
-    QgsPolygon::iterator jt;
-    for ( it = poly.begin(); it != poly.end(); ++it )
-    {
-      for ( jt = it->begin(); jt != it->end(); ++jt )
-      {
-        value = value + measure.measure( QgsGeometry::fromPolyline( *jt ) );
-      }
-    }
-  }
-  else
+  QgsWkbView wkbView( geometry );
+  for ( QgsWkbView::const_iterator partIt = wkbView.begin(); partIt != wkbView.end(); ++partIt )
   {
-    QgsPolygon::iterator jt;
-    QgsPolygon poly = geometry->asPolygon();
-    for ( jt = poly.begin(); jt != poly.end(); ++jt )
+    QgsWkbPart part = *partIt;
+    for ( QgsWkbPart::const_iterator ringIt = part.begin(); ringIt != part.end(); ++ringIt )
     {
-      value = value + measure.measure( QgsGeometry::fromPolyline( *jt ) );
+      value = value + measure.measureLine( *ringIt );
     }
   }
   return value;
@@ -604,149 +717,97 @@ bool QgsGeometryAnalyzer::dissolve( QgsVectorLayer* layer, const QString& shapef
   {
     return false;
   }
-  bool useField = false;
-  if ( uniqueIdField == -1 )
-  {
-    uniqueIdField = 0;
-  }
-  else
-  {
-    useField = true;
-  }
+  bool useField = uniqueIdField != -1;
 
   QGis::WkbType outputType = dp->geometryType();
   const QgsCoordinateReferenceSystem crs = layer->crs();
 
   QgsVectorFileWriter vWriter( shapefileName, dp->encoding(), layer->pendingFields(), outputType, &crs );
-  QgsFeature currentFeature;
-  QMultiMap<QString, QgsFeatureId> map;
 
+  QgsFeatureRequest request;
+  int featureCount = layer->featureCount();
+  //take only selection
   if ( onlySelectedFeatures )
   {
-    //use QgsVectorLayer::featureAtId
-    const QgsFeatureIds selection = layer->selectedFeaturesIds();
-    QgsFeatureIds::const_iterator it = selection.constBegin();
-    for ( ; it != selection.constEnd(); ++it )
-    {
-      if ( !layer->getFeatures( QgsFeatureRequest().setFilterFid( *it ) ).nextFeature( currentFeature ) )
-      {
-        continue;
-      }
-      map.insert( currentFeature.attribute( uniqueIdField ).toString(), currentFeature.id() );
-    }
+    request.setFilterFids( layer->selectedFeaturesIds() );
+    featureCount = layer->selectedFeatureCount();
   }
-  else
+
+  if ( p )
   {
-    QgsFeatureIterator fit = layer->getFeatures();
-    while ( fit.nextFeature( currentFeature ) )
-    {
-      map.insert( currentFeature.attribute( uniqueIdField ).toString(), currentFeature.id() );
-    }
+    p->setMaximum( featureCount );
   }
 
-  QgsGeometry *dissolveGeometry = 0; //dissolve geometry
-  QMultiMap<QString, QgsFeatureId>::const_iterator jt = map.constBegin();
-  QgsFeature outputFeature;
-  while ( jt != map.constEnd() )
+  //the features are grouped by the unique id (or all in one group), the output has the attributes of the first feature of a group
+  QMap<QString, QgsDissolveGroup> groups;
+  QgsFeatureIterator fit = layer->getFeatures( request );
+  QgsFeature currentFeature;
+  int processedFeatures = 0;
+  while ( fit.nextFeature( currentFeature ) )
   {
-    QString currentKey = jt.key();
-    int processedFeatures = 0;
-    bool first = true;
-    //take only selection
-    if ( onlySelectedFeatures )
+    if ( p )
     {
-      //use QgsVectorLayer::featureAtId
-      const QgsFeatureIds selection = layer->selectedFeaturesIds();
-      if ( p )
-      {
-        p->setMaximum( selection.size() );
-      }
-      while ( jt != map.constEnd() && ( jt.key() == currentKey || !useField ) )
-      {
-        if ( p && p->wasCanceled() )
-        {
-          break;
-        }
-        if ( selection.contains( jt.value() ) )
-        {
-          if ( p )
-          {
-            p->setValue( processedFeatures );
-          }
-          if ( !layer->getFeatures( QgsFeatureRequest().setFilterFid( jt.value() ) ).nextFeature( currentFeature ) )
-          {
-            continue;
-          }
-          if ( first )
-          {
-            outputFeature.setAttributes( currentFeature.attributes() );
-            first = false;
-          }
-          dissolveFeature( currentFeature, processedFeatures, &dissolveGeometry );
-          ++processedFeatures;
-        }
-        ++jt;
-      }
+      p->setValue( processedFeatures );
     }
-    //take all features
-    else
+
+    if ( p && p->wasCanceled() )
     {
-      int featureCount = layer->featureCount();
-      if ( p )
-      {
-        p->setMaximum( featureCount );
-      }
-      while ( jt != map.constEnd() && ( jt.key() == currentKey || !useField ) )
-      {
-        if ( p )
-        {
-          p->setValue( processedFeatures );
-        }
+      break;
+    }
+    ++processedFeatures;
 
-        if ( p && p->wasCanceled() )
-        {
-          break;
-        }
-        if ( !layer->getFeatures( QgsFeatureRequest().setFilterFid( jt.value() ) ).nextFeature( currentFeature ) )
-        {
-          continue;
-        }
-        {
-          outputFeature.setAttributes( currentFeature.attributes() );
-          first = false;
-        }
-        dissolveFeature( currentFeature, processedFeatures, &dissolveGeometry );
-        ++processedFeatures;
-        ++jt;
-      }
+    if ( !currentFeature.geometry() )
+    {
+      continue;
     }
-    outputFeature.setGeometry( dissolveGeometry );
-    vWriter.addFeature( outputFeature );
-  }
-  return true;
-}
 
-void QgsGeometryAnalyzer::dissolveFeature( QgsFeature& f, int nProcessedFeatures, QgsGeometry** dissolveGeometry )
-{
-  QgsGeometry* featureGeometry = f.geometry();
+    QString key = useField ? currentFeature.attribute( uniqueIdField ).toString() : QString();
+    QMap<QString, QgsDissolveGroup>::iterator groupIt = groups.find( key );
+    if ( groupIt == groups.end() )
+    {
+      QgsDissolveGroup group;
+      group.attributes = currentFeature.attributes();
+      group.dissolveGeometry = 0;
+      groupIt = groups.insert( key, group );
+    }
+    groupIt->geometries.append( currentFeature.geometryAndOwnership() );
+  }
 
-  if ( !featureGeometry )
+  //the geometries of a group are merged with cascaded unions instead of combining them one by one.
+  //A single group is split up for the threads, otherwise the groups are merged in parallel
+  bool concurrent = QThread::idealThreadCount() > 1;
+  QVector<QgsDissolveGroup> groupList = groups.values().toVector();
+  groups.clear();
+  if ( groupList.size() == 1 )
   {
-    return;
+    groupList[0].dissolveGeometry = treeUnion( groupList[0].geometries, concurrent );
+    groupList[0].geometries.clear();
   }
-
-  if ( nProcessedFeatures == 0 )
+  else if ( concurrent )
   {
-    size_t geomSize = featureGeometry->wkbSize();
-    *dissolveGeometry = new QgsGeometry();
-    unsigned char* wkb = new unsigned char[geomSize];
-    memcpy( wkb, featureGeometry->asWkb(), geomSize );
-    ( *dissolveGeometry )->fromWkb( wkb, geomSize );
+    QtConcurrent::blockingMap( groupList, dissolveGroup );
   }
   else
   {
-    *dissolveGeometry = ( *dissolveGeometry )->combine( featureGeometry );
+    for ( int i = 0; i < groupList.size(); ++i )
+    {
+      dissolveGroup( groupList[i] );
+    }
+  }
+
+  for ( int i = 0; i < groupList.size(); ++i )
+  {
+    if ( !groupList[i].dissolveGeometry )
+    {
+      continue;
+    }
+
+    QgsFeature outputFeature;
+    outputFeature.setAttributes( groupList[i].attributes );
+    outputFeature.setGeometry( groupList[i].dissolveGeometry );
+    vWriter.addFeature( outputFeature );
   }
+  return true;
 }
 
 bool QgsGeometryAnalyzer::buffer( QgsVectorLayer* layer, const QString& shapefileName, double bufferDistance,
@@ -771,142 +832,120 @@ bool QgsGeometryAnalyzer::buffer( QgsVectorLayer* layer, const QString& shapefil
   const QgsCoordinateReferenceSystem crs = layer->crs();
 
   QgsVectorFileWriter vWriter( shapefileName, dp->encoding(), layer->pendingFields(), outputType, &crs );
-  QgsFeature currentFeature;
-  QgsGeometry *dissolveGeometry = 0; //dissolve geometry (if dissolve enabled)
 
+  QgsFeatureRequest request;
+  int featureCount = layer->featureCount();
   //take only selection
   if ( onlySelectedFeatures )
   {
-    //use QgsVectorLayer::featureAtId
-    const QgsFeatureIds selection = layer->selectedFeaturesIds();
+    request.setFilterFids( layer->selectedFeaturesIds() );
+    featureCount = layer->selectedFeatureCount();
+  }
+
+  if ( p )
+  {
+    p->setMaximum( featureCount );
+  }
+
+  //features are read in batches, the features of a batch are buffered in parallel and written (or merged) by this thread
+  bool concurrent = QThread::idealThreadCount() > 1;
+  QgsFeatureIterator fit = layer->getFeatures( request );
+  QgsFeature currentFeature;
+  QVector<QgsBufferFeature> batch;
+  QList<QgsGeometry*> dissolveGeometries; //union of the buffers of each batch (if dissolve enabled)
+  int processedFeatures = 0;
+  bool moreFeatures = true;
+
+  while ( moreFeatures )
+  {
     if ( p )
     {
-      p->setMaximum( selection.size() );
+      p->setValue( processedFeatures );
     }
 
-    int processedFeatures = 0;
-    QgsFeatureIds::const_iterator it = selection.constBegin();
-    for ( ; it != selection.constEnd(); ++it )
+    if ( p && p->wasCanceled() )
     {
-      if ( p )
-      {
-        p->setValue( processedFeatures );
-      }
+      break;
+    }
 
-      if ( p && p->wasCanceled() )
-      {
-        break;
-      }
-      if ( !layer->getFeatures( QgsFeatureRequest().setFilterFid( *it ) ).nextFeature( currentFeature ) )
+    batch.clear();
+    while ( batch.size() < sBatchSize && ( moreFeatures = fit.nextFeature( currentFeature ) ) )
+    {
+      ++processedFeatures;
+      if ( !currentFeature.geometry() )
       {
         continue;
       }
-      bufferFeature( currentFeature, processedFeatures, &vWriter, dissolve, &dissolveGeometry, bufferDistance, bufferDistanceField );
-      ++processedFeatures;
+
+      QgsBufferFeature feature;
+      feature.distance = bufferDistanceField == -1 ? bufferDistance : currentFeature.attribute( bufferDistanceField ).toDouble();
+      feature.attributes = currentFeature.attributes();
+      feature.geometry = currentFeature.geometryAndOwnership();
+      batch.append( feature );
     }
 
-    if ( p )
+    if ( concurrent )
     {
-      p->setValue( selection.size() );
+      QtConcurrent::blockingMap( batch, bufferGeometry );
     }
-  }
-  //take all features
-  else
-  {
-    QgsFeatureIterator fit = layer->getFeatures();
-
-    int featureCount = layer->featureCount();
-    if ( p )
+    else
     {
-      p->setMaximum( featureCount );
+      for ( int i = 0; i < batch.size(); ++i )
+      {
+        bufferGeometry( batch[i] );
+      }
     }
-    int processedFeatures = 0;
 
-    while ( fit.nextFeature( currentFeature ) )
+    QList<QgsGeometry*> buffers;
+    for ( int i = 0; i < batch.size(); ++i )
     {
-      if ( p )
+      if ( !batch[i].geometry )
       {
-        p->setValue( processedFeatures );
+        continue;
       }
-      if ( p && p->wasCanceled() )
+
+      if ( dissolve )
       {
-        break;
+        buffers.append( batch[i].geometry );
+        continue;
       }
-      bufferFeature( currentFeature, processedFeatures, &vWriter, dissolve, &dissolveGeometry, bufferDistance, bufferDistanceField );
-      ++processedFeatures;
+
+      QgsFeature newFeature;
+      newFeature.setGeometry( batch[i].geometry );
+      newFeature.setAttributes( batch[i].attributes );
+      vWriter.addFeature( newFeature );
     }
-    if ( p )
+
+    if ( !buffers.isEmpty() )
     {
-      p->setValue( featureCount );
+      QgsGeometry* batchGeometry = treeUnion( buffers, concurrent );
+      if ( batchGeometry )
+      {
+        dissolveGeometries.append( batchGeometry );
+      }
     }
   }
 
+  if ( p )
+  {
+    p->setValue( featureCount );
+  }
+
   if ( dissolve )
   {
-    QgsFeature dissolveFeature;
+    QgsGeometry* dissolveGeometry = treeUnion( dissolveGeometries, concurrent );
     if ( !dissolveGeometry )
     {
       QgsDebugMsg( "no dissolved geometry - should not happen" );
       return false;
     }
+    QgsFeature dissolveFeature;
     dissolveFeature.setGeometry( dissolveGeometry );
     vWriter.addFeature( dissolveFeature );
   }
   return true;
 }
 
-void QgsGeometryAnalyzer::bufferFeature( QgsFeature& f, int nProcessedFeatures, QgsVectorFileWriter* vfw, bool dissolve,
-    QgsGeometry** dissolveGeometry, double bufferDistance, int bufferDistanceField )
-{
-  double currentBufferDistance;
-  QgsGeometry* featureGeometry = f.geometry();
-  QgsGeometry* tmpGeometry = 0;
-  QgsGeometry* bufferGeometry = 0;
-
-  if ( !featureGeometry )
-  {
-    return;
-  }
-
-  //create buffer
-  if ( bufferDistanceField == -1 )
-  {
-    currentBufferDistance = bufferDistance;
-  }
-  else
-  {
-    currentBufferDistance = f.attribute( bufferDistanceField ).toDouble();
-  }
-  bufferGeometry = featureGeometry->buffer( currentBufferDistance, 5 );
-
-  if ( dissolve )
-  {
-    if ( nProcessedFeatures == 0 )
-    {
-      *dissolveGeometry = bufferGeometry;
-    }
-    else
-    {
-      tmpGeometry = *dissolveGeometry;
-      *dissolveGeometry = ( *dissolveGeometry )->combine( bufferGeometry );
-      delete tmpGeometry;
-      delete bufferGeometry;
-    }
-  }
-  else //dissolve
-  {
-    QgsFeature newFeature;
-    newFeature.setGeometry( bufferGeometry );
-    newFeature.setAttributes( f.attributes() );
-
-    //add it to vector file writer
-    if ( vfw )
-    {
-      vfw->addFeature( newFeature );
-    }
-  }
-}
-
 bool QgsGeometryAnalyzer::eventLayer( QgsVectorLayer* lineLayer, QgsVectorLayer* eventLayer, int lineField, int eventField, QList<int>& unlocatedFeatureIds, const QString& outputLayer,
                                       const QString& outputFormat, int locationField1, int locationField2, int offsetField, double offsetScale,
                                       bool forceSingleGeometry, QgsVectorDataProvider* memoryProvider, QProgressDialog* p )
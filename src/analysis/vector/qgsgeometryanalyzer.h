@@ -66,7 +66,8 @@ class ANALYSIS_EXPORT QgsGeometryAnalyzer
       @note: added in version 1.4*/
     bool extent( QgsVectorLayer* layer, const QString& shapefileName, bool onlySelectedFeatures = false, QProgressDialog* p = 0 );
 
-    /**Create buffers for a vector layer and write it to a new shape file
+    /**Create buffers for a vector layer and write it to a new shape file.
+      The features are buffered in parallel. If dissolve is true, the buffers are merged with cascaded unions
       @param layer input vector layer
       @param shapefileName path to the output shp
       @param bufferDistance distance for buffering (if no buffer field is specified)
@@ -89,7 +90,9 @@ class ANALYSIS_EXPORT QgsGeometryAnalyzer
     bool convexHull( QgsVectorLayer* layer, const QString& shapefileName, bool onlySelectedFeatures = false,
                      int uniqueIdField = -1, QProgressDialog* p = 0 );
 
-    /**Dissolve a vector layer and write it to a new shape file
+    /**Dissolve a vector layer and write it to a new shape file.
+      The geometries with the same unique id are merged with cascaded unions (groups are merged in parallel).
+      The dissolved feature gets the attributes of the first feature of its group
       @param layer input vector layer
       @param shapefileName path to the output shp
       @param onlySelectedFeatures if true, only selected features are considered, else all the features
@@ -135,13 +138,8 @@ class ANALYSIS_EXPORT QgsGeometryAnalyzer
     void simplifyFeature( QgsFeature& f, QgsVectorFileWriter* vfw, double tolerance );
     /**Helper function to get the cetroid of an individual feature*/
     void centroidFeature( QgsFeature& f, QgsVectorFileWriter* vfw );
-    /**Helper function to buffer an individual feature*/
-    void bufferFeature( QgsFeature& f, int nProcessedFeatures, QgsVectorFileWriter* vfw, bool dissolve, QgsGeometry** dissolveGeometry,
-                        double bufferDistance, int bufferDistanceField );
     /**Helper function to get the convex hull of feature(s)*/
     void convexFeature( QgsFeature& f, int nProcessedFeatures, QgsGeometry** dissolveGeometry );
-    /**Helper function to dissolve feature(s)*/
-    void dissolveFeature( QgsFeature& f, int nProcessedFeatures, QgsGeometry** dissolveGeometry );
 
     //helper functions for event layer
     void addEventLayerFeature( QgsFeature& feature, QgsGeometry* geom, QgsGeometry* lineGeom, QgsVectorFileWriter* fileWriter, QgsFeatureList& memoryFeatures, int offsetField = -1, double offsetScale = 1.0,
@@ -25,160 +25,431 @@
 #include "qgsvectorfilewriter.h"
 #include "qgsvectordataprovider.h"
 #include "qgsdistancearea.h"
+#include <QFuture>
 #include <QProgressDialog>
+#include <QThread>
+#include <QtConcurrentMap>
 
-bool QgsOverlayAnalyzer::intersection( QgsVectorLayer* layerA, QgsVectorLayer* layerB,
-                                       const QString& shapefileName, bool onlySelectedFeatures,
-                                       QProgressDialog* p )
+#include <math.h>
+
+//number of features of layer A read and intersected at once
+static const int sBatchSize = 1024;
+//maximum number of features of layer A intersected by one task
+static const int sPartitionSize = 64;
+//average number of layer B features per grid cell
+static const int sFeaturesPerCell = 4;
+//maximum number of grid columns and rows
+static const int sMaxGridSize = 2048;
+
+struct QgsOverlayFeature
 {
-  if ( !layerA && !layerB )
+  QgsGeometry* geometry;
+  QgsAttributes attributes;
+  //grid cell of the bounding box center (only used for features of layer A)
+  int cell;
+};
+
+/**Uniform grid over the bounding boxes of the layer B features. It is not modified while the
+  partitions are intersected, so it can be queried from several threads at once*/
+class QgsOverlayGrid
+{
+  public:
+    QgsOverlayGrid(): mCols( 0 ), mRows( 0 ), mCellWidth( 0 ), mCellHeight( 0 ) {}
+
+    void build( const QVector<QgsRectangle>& boxes, const QgsRectangle& extent );
+
+    const QgsRectangle& extent() const { return mExtent; }
+
+    //! index of the cell containing the point (points outside of the grid are clamped to the border cells)
+    int cell( const QgsPoint& point ) const { return row( point.y() ) * mCols + column( point.x() ); }
+
+    //! appends the indices of all boxes intersecting rect (each one once) in ascending order
+    void candidates( const QgsRectangle& rect, QVector<int>& result ) const;
+
+  private:
+    int column( double x ) const { return mCellWidth > 0 ? qBound( 0, ( int )(( x - mExtent.xMinimum() ) / mCellWidth ), mCols - 1 ) : 0; }
+    int row( double y ) const { return mCellHeight > 0 ? qBound( 0, ( int )(( y - mExtent.yMinimum() ) / mCellHeight ), mRows - 1 ) : 0; }
+
+    QgsRectangle mExtent;
+    int mCols;
+    int mRows;
+    double mCellWidth;
+    double mCellHeight;
+    QVector< QVector<int> > mCells;
+    QVector<QgsRectangle> mBoxes;
+};
+
+void QgsOverlayGrid::build( const QVector<QgsRectangle>& boxes, const QgsRectangle& extent )
+{
+  mBoxes = boxes;
+  mExtent = extent;
+
+  int nCells = qMax( 1, boxes.size() / sFeaturesPerCell );
+  double width = extent.width();
+  double height = extent.height();
+  if ( width > 0 && height > 0 )
   {
-    return false;
+    mCols = qBound( 1, ( int ) ceil( sqrt( nCells * width / height ) ), sMaxGridSize );
+    mRows = qBound( 1, ( int ) ceil(( double ) nCells / mCols ), sMaxGridSize );
   }
-
-  QgsVectorDataProvider* dpA = layerA->dataProvider();
-  QgsVectorDataProvider* dpB = layerB->dataProvider();
-  if ( !dpA && !dpB )
+  else
   {
-    return false;
+    mCols = width > 0 ? qMin( nCells, sMaxGridSize ) : 1;
+    mRows = height > 0 ? qMin( nCells, sMaxGridSize ) : 1;
   }
+  mCellWidth = width / mCols;
+  mCellHeight = height / mRows;
 
-  QGis::WkbType outputType = dpA->geometryType();
-  const QgsCoordinateReferenceSystem crs = layerA->crs();
-  QgsFields fieldsA = layerA->pendingFields();
-  QgsFields fieldsB = layerB->pendingFields();
-  combineFieldLists( fieldsA, fieldsB );
+  mCells.clear();
+  mCells.resize( mCols * mRows );
+  for ( int i = 0; i < mBoxes.size(); ++i )
+  {
+    const QgsRectangle& box = mBoxes[i];
+    int col1 = column( box.xMaximum() );
+    int row1 = row( box.yMaximum() );
+    for ( int r = row( box.yMinimum() ); r <= row1; ++r )
+    {
+      for ( int c = column( box.xMinimum() ); c <= col1; ++c )
+      {
+        mCells[r * mCols + c].append( i );
+      }
+    }
+  }
+}
 
-  QgsVectorFileWriter vWriter( shapefileName, dpA->encoding(), fieldsA, outputType, &crs );
-  QgsFeature currentFeature;
-  QgsSpatialIndex index;
+void QgsOverlayGrid::candidates( const QgsRectangle& rect, QVector<int>& result ) const
+{
+  if ( mBoxes.isEmpty() || !mExtent.intersects( rect ) )
+  {
+    return;
+  }
 
-  //take only selection
-  if ( onlySelectedFeatures )
+  int col1 = column( rect.xMaximum() );
+  int row1 = row( rect.yMaximum() );
+  for ( int r = row( rect.yMinimum() ); r <= row1; ++r )
   {
-    const QgsFeatureIds selectionB = layerB->selectedFeaturesIds();
-    QgsFeatureIds::const_iterator it = selectionB.constBegin();
-    for ( ; it != selectionB.constEnd(); ++it )
+    for ( int c = column( rect.xMinimum() ); c <= col1; ++c )
     {
-      if ( !layerB->getFeatures( QgsFeatureRequest().setFilterFid( *it ) ).nextFeature( currentFeature ) )
+      const QVector<int>& cell = mCells[r * mCols + c];
+      for ( int i = 0; i < cell.size(); ++i )
       {
-        continue;
+        const QgsRectangle& box = mBoxes[cell[i]];
+        if ( !box.intersects( rect ) )
+        {
+          continue;
+        }
+
+        //boxes covering several cells are only reported in the cell containing the lower left corner of the intersection
+        if ( column( qMax( box.xMinimum(), rect.xMinimum() ) ) != c || row( qMax( box.yMinimum(), rect.yMinimum() ) ) != r )
+        {
+          continue;
+        }
+        result.append( cell[i] );
       }
-      index.insertFeature( currentFeature );
     }
-    //use QgsVectorLayer::featureAtId
-    const QgsFeatureIds selectionA = layerA->selectedFeaturesIds();
-    if ( p )
+  }
+  qSort( result );
+}
+
+struct QgsOverlayLayer
+{
+  ~QgsOverlayLayer()
+  {
+    for ( int i = 0; i < features.size(); ++i )
+    {
+      delete features[i].geometry;
+    }
+  }
+
+  QVector<QgsOverlayFeature> features;
+  QgsOverlayGrid grid;
+};
+
+struct QgsOverlayPartition
+{
+  const QgsOverlayLayer* overlay;
+  QVector<QgsOverlayFeature> features;
+  QgsFeatureList result;
+};
+
+//computes the envelopes of the geometry and of all its parts and rings. GEOS computes them lazily
+//when they are first used, which must not happen while several threads read the geometry
+static void computeEnvelopes( const GEOSGeometry* geos )
+{
+  GEOSGeom_destroy( GEOSEnvelope( geos ) );
+
+  int type = GEOSGeomTypeId( geos );
+  if ( type == GEOS_POLYGON )
+  {
+    computeEnvelopes( GEOSGetExteriorRing( geos ) );
+    for ( int i = 0; i < GEOSGetNumInteriorRings( geos ); ++i )
     {
-      p->setMaximum( selectionA.size() );
+      computeEnvelopes( GEOSGetInteriorRingN( geos, i ) );
     }
-    QgsFeature currentFeature;
-    int processedFeatures = 0;
-    it = selectionA.constBegin();
-    for ( ; it != selectionA.constEnd(); ++it )
+  }
+  else if ( type == GEOS_MULTIPOINT || type == GEOS_MULTILINESTRING || type == GEOS_MULTIPOLYGON || type == GEOS_GEOMETRYCOLLECTION )
+  {
+    for ( int i = 0; i < GEOSGetNumGeometries( geos ); ++i )
     {
-      if ( p )
-      {
-        p->setValue( processedFeatures );
-      }
+      computeEnvelopes( GEOSGetGeometryN( geos, i ) );
+    }
+  }
+}
 
-      if ( p && p->wasCanceled() )
-      {
-        break;
-      }
-      if ( !layerA->getFeatures( QgsFeatureRequest().setFilterFid( *it ) ).nextFeature( currentFeature ) )
-      {
-        continue;
-      }
-      intersectFeature( currentFeature, &vWriter, layerB, &index );
-      ++processedFeatures;
+static void loadOverlayLayer( QgsFeatureIterator fit, QgsOverlayLayer& overlay )
+{
+  QVector<QgsRectangle> boxes;
+  QgsRectangle extent;
+  QgsFeature f;
+  while ( fit.nextFeature( f ) )
+  {
+    QgsGeometry* featureGeometry = f.geometry();
+    if ( !featureGeometry || !featureGeometry->asGeos() )
+    {
+      continue;
     }
 
-    if ( p )
+    QgsRectangle bbox = featureGeometry->boundingBox();
+    if ( boxes.isEmpty() )
     {
-      p->setValue( selectionA.size() );
+      extent = bbox;
     }
+    else
+    {
+      extent.combineExtentWith( &bbox );
+    }
+    boxes.append( bbox );
+
+    //the geometries are shared by all threads, so they must not change while they are read. Only the GEOS
+    //geometry is kept (the WKB is not needed for the intersections) and its envelopes are computed in advance
+    QgsOverlayFeature feature;
+    feature.geometry = new QgsGeometry();
+    feature.geometry->fromGeos( GEOSGeom_clone( featureGeometry->asGeos() ) );
+    computeEnvelopes( feature.geometry->asGeos() );
+    feature.attributes = f.attributes();
+    feature.cell = -1;
+    overlay.features.append( feature );
   }
-  //take all features
-  else
+  overlay.grid.build( boxes, extent );
+}
+
+static bool cellLessThan( const QgsOverlayFeature& f1, const QgsOverlayFeature& f2 )
+{
+  return f1.cell < f2.cell;
+}
+
+//reads the next batch of layer A features and splits it into partitions of neighbouring features
+static bool readPartitions( QgsFeatureIterator& fit, const QgsOverlayLayer& overlay, QVector<QgsOverlayPartition>& partitions, int& nFeatures )
+{
+  QVector<QgsOverlayFeature> batch;
+  QgsFeature f;
+  bool moreFeatures = true;
+  while ( batch.size() < sBatchSize && ( moreFeatures = fit.nextFeature( f ) ) )
+  {
+    ++nFeatures;
+
+    QgsGeometry* featureGeometry = f.geometry();
+    if ( !featureGeometry )
+    {
+      continue;
+    }
+
+    QgsRectangle bbox = featureGeometry->boundingBox();
+    if ( !overlay.grid.extent().intersects( bbox ) )
+    {
+      continue;
+    }
+
+    QgsOverlayFeature feature;
+    feature.geometry = f.geometryAndOwnership();
+    feature.attributes = f.attributes();
+    feature.cell = overlay.grid.cell( bbox.center() );
+    batch.append( feature );
+  }
+
+  //features of the same cell mostly intersect the same layer B features
+  qStableSort( batch.begin(), batch.end(), cellLessThan );
+
+  for ( int i = 0; i < batch.size(); ++i )
   {
-    QgsFeatureIterator fit = layerB->getFeatures();
-    while ( fit.nextFeature( currentFeature ) )
+    if ( partitions.isEmpty() || partitions.last().features.size() >= sPartitionSize )
     {
-      index.insertFeature( currentFeature );
+      QgsOverlayPartition partition;
+      partition.overlay = &overlay;
+      partitions.append( partition );
     }
+    partitions.last().features.append( batch[i] );
+  }
+  return moreFeatures;
+}
 
-    int featureCount = layerA->featureCount();
-    if ( p )
+static void intersectPartition( QgsOverlayPartition& partition )
+{
+  const QgsOverlayLayer& overlay = *partition.overlay;
+  QVector<int> candidates;
+  for ( int i = 0; i < partition.features.size(); ++i )
+  {
+    const QgsOverlayFeature& feature = partition.features[i];
+    candidates.clear();
+    overlay.grid.candidates( feature.geometry->boundingBox(), candidates );
+    if ( candidates.isEmpty() )
     {
-      p->setMaximum( featureCount );
+      continue;
     }
-    int processedFeatures = 0;
 
-    fit = layerA->getFeatures();
+    //the geometry is tested against all candidates, so its segments are indexed once
+    if ( candidates.size() > 1 )
+    {
+      feature.geometry->prepareGeometry();
+    }
 
-    QgsFeature currentFeature;
-    while ( fit.nextFeature( currentFeature ) )
+    for ( int j = 0; j < candidates.size(); ++j )
     {
-      if ( p )
+      const QgsOverlayFeature& overlayFeature = overlay.features[candidates[j]];
+      if ( !feature.geometry->intersects( overlayFeature.geometry ) )
       {
-        p->setValue( processedFeatures );
+        continue;
       }
-      if ( p && p->wasCanceled() )
+
+      QgsGeometry* intersectGeometry = feature.geometry->intersection( overlayFeature.geometry );
+      if ( !intersectGeometry )
       {
-        break;
+        continue;
       }
-      intersectFeature( currentFeature, &vWriter, layerB, &index );
-      ++processedFeatures;
+
+      partition.result.append( QgsFeature() );
+      QgsFeature& outFeature = partition.result.last();
+      outFeature.setGeometry( intersectGeometry );
+      QgsAttributes attributes = feature.attributes;
+      attributes += overlayFeature.attributes;
+      outFeature.setAttributes( attributes );
     }
-    if ( p )
+  }
+}
+
+//writes the results of the partitions (if vfw is not 0) and deletes the partitions
+static void writePartitions( QVector<QgsOverlayPartition>& partitions, QgsVectorFileWriter* vfw )
+{
+  for ( int i = 0; i < partitions.size(); ++i )
+  {
+    QgsOverlayPartition& partition = partitions[i];
+    if ( vfw )
+    {
+      for ( QgsFeatureList::iterator it = partition.result.begin(); it != partition.result.end(); ++it )
+      {
+        vfw->addFeature( *it );
+      }
+    }
+
+    for ( int j = 0; j < partition.features.size(); ++j )
     {
-      p->setValue( featureCount );
+      delete partition.features[j].geometry;
     }
   }
-  return true;
+  partitions.clear();
 }
 
-void QgsOverlayAnalyzer::intersectFeature( QgsFeature& f, QgsVectorFileWriter* vfw,
-    QgsVectorLayer* vl, QgsSpatialIndex* index )
+bool QgsOverlayAnalyzer::intersection( QgsVectorLayer* layerA, QgsVectorLayer* layerB,
+                                       const QString& shapefileName, bool onlySelectedFeatures,
+                                       QProgressDialog* p )
 {
-  QgsGeometry* featureGeometry = f.geometry();
-  QgsGeometry* intersectGeometry = 0;
-  QgsFeature overlayFeature;
+  if ( !layerA && !layerB )
+  {
+    return false;
+  }
 
-  if ( !featureGeometry )
+  QgsVectorDataProvider* dpA = layerA->dataProvider();
+  QgsVectorDataProvider* dpB = layerB->dataProvider();
+  if ( !dpA && !dpB )
   {
-    return;
+    return false;
+  }
+
+  QGis::WkbType outputType = dpA->geometryType();
+  const QgsCoordinateReferenceSystem crs = layerA->crs();
+  QgsFields fieldsA = layerA->pendingFields();
+  QgsFields fieldsB = layerB->pendingFields();
+  combineFieldLists( fieldsA, fieldsB );
+
+  QgsVectorFileWriter vWriter( shapefileName, dpA->encoding(), fieldsA, outputType, &crs );
+
+  QgsFeatureRequest requestA;
+  QgsFeatureRequest requestB;
+  int featureCount = layerA->featureCount();
+  //take only selection
+  if ( onlySelectedFeatures )
+  {
+    requestA.setFilterFids( layerA->selectedFeaturesIds() );
+    requestB.setFilterFids( layerB->selectedFeaturesIds() );
+    featureCount = layerA->selectedFeatureCount();
   }
 
-  QList<QgsFeatureId> intersects;
-  intersects = index->intersects( featureGeometry->boundingBox() );
-  QList<QgsFeatureId>::const_iterator it = intersects.constBegin();
-  QgsFeature outFeature;
-  for ( ; it != intersects.constEnd(); ++it )
+  //layer B is kept in memory, its geometries and grid are shared by the threads
+  QgsOverlayLayer overlay;
+  loadOverlayLayer( layerB->getFeatures( requestB ), overlay );
+
+  if ( p )
+  {
+    p->setMaximum( featureCount );
+  }
+
+  bool concurrent = QThread::idealThreadCount() > 1;
+  QgsFeatureIterator fit = layerA->getFeatures( requestA );
+  QVector<QgsOverlayPartition> partitions[2];
+  int processedFeatures = 0;
+
+  //the next batch is read and the results of the previous batch are written while the partitions of the current batch
+  //are intersected. Only this thread accesses the vector file writer
+  int current = 0;
+  bool moreFeatures = true;
+  while ( moreFeatures && partitions[current].isEmpty() )
   {
-    if ( !vl->getFeatures( QgsFeatureRequest().setFilterFid( *it ) ).nextFeature( overlayFeature ) )
+    moreFeatures = readPartitions( fit, overlay, partitions[current], processedFeatures );
+  }
+  while ( !partitions[current].isEmpty() )
+  {
+    if ( p )
     {
-      continue;
+      p->setValue( processedFeatures );
     }
 
-    if ( featureGeometry->intersects( overlayFeature.geometry() ) )
+    if ( p && p->wasCanceled() )
     {
-      intersectGeometry = featureGeometry->intersection( overlayFeature.geometry() );
-
-      outFeature.setGeometry( intersectGeometry );
-      QgsAttributes attributesA = f.attributes();
-      QgsAttributes attributesB = overlayFeature.attributes();
-      combineAttributeMaps( attributesA, attributesB );
-      outFeature.setAttributes( attributesA );
+      break;
+    }
 
-      //add it to vector file writer
-      if ( vfw )
+    QFuture<void> future;
+    if ( concurrent )
+    {
+      future = QtConcurrent::map( partitions[current], intersectPartition );
+    }
+    else
+    {
+      for ( int i = 0; i < partitions[current].size(); ++i )
       {
-        vfw->addFeature( outFeature );
+        intersectPartition( partitions[current][i] );
       }
     }
+
+    int previous = 1 - current;
+    writePartitions( partitions[previous], &vWriter );
+    while ( moreFeatures && partitions[previous].isEmpty() )
+    {
+      moreFeatures = readPartitions( fit, overlay, partitions[previous], processedFeatures );
+    }
+    future.waitForFinished();
+    current = previous;
+  }
+
+  //results of the last batch (the current batch is empty or has not been processed because of cancelation)
+  writePartitions( partitions[1 - current], &vWriter );
+  writePartitions( partitions[current], 0 );
+
+  if ( p )
+  {
+    p->setValue( featureCount );
   }
+  return true;
 }
 
 void QgsOverlayAnalyzer::combineFieldLists( QgsFields& fieldListA, const QgsFields& fieldListB )
@@ -201,9 +472,3 @@ void QgsOverlayAnalyzer::combineFieldLists( QgsFields& fieldListA, const QgsFiel
     names.append( field.name() );
   }
 }
-
-void QgsOverlayAnalyzer::combineAttributeMaps( QgsAttributes& attributesA, const QgsAttributes& attributesB )
-{
-  attributesA += attributesB;
-}
-
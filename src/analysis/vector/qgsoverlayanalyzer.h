@@ -20,7 +20,6 @@
 
 #include "qgsvectorlayer.h"
 #include "qgsfield.h"
-#include "qgsspatialindex.h"
 #include "qgsfeature.h"
 #include "qgsgeometry.h"
 #include "qgsfield.h"
@@ -38,7 +37,12 @@ class ANALYSIS_EXPORT QgsOverlayAnalyzer
 {
   public:
 
-    /**Perform an intersection on two input vector layers and write output to a new shape file
+    /**Perform an intersection on two input vector layers and write output to a new shape file.
+      Layer B is kept in memory and indexed with a spatial grid. Layer A is read in batches, which
+      are partitioned by grid cell and intersected on all processor cores while the results of the
+      previous batch are written to the shape file.
+      @note all geometries and attributes of layer B (or its selection) have to fit into memory. The
+      geometries are held as GEOS geometries only (three doubles per vertex, plus one object per part and ring).
       @param layerA input vector layer
       @param layerB input vector layer
       @param shapefileName path to the output shp
@@ -52,8 +56,6 @@ class ANALYSIS_EXPORT QgsOverlayAnalyzer
   private:
 
     void combineFieldLists( QgsFields& fieldListA, const QgsFields& fieldListB );
-    void intersectFeature( QgsFeature& f, QgsVectorFileWriter* vfw, QgsVectorLayer* dp, QgsSpatialIndex* index );
-    void combineAttributeMaps( QgsAttributes& attributesA, const QgsAttributes& attributesB );
 };
 
 #endif //QGSVECTORANALYZER
@@ -17,12 +17,22 @@
 
 #include "qgszonalstatistics.h"
 #include "qgsgeometry.h"
+#include "qgslogger.h"
 #include "qgsvectordataprovider.h"
 #include "qgsvectorlayer.h"
 #include "gdal.h"
 #include "cpl_string.h"
+#include <QCache>
+#include <QMutex>
 #include <QProgressDialog>
 #include <QFile>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <math.h>
 
 #if defined(GDAL_VERSION_NUM) && GDAL_VERSION_NUM >= 1800
 #define TO8F(x) (x).toUtf8().constData()
@@ -30,12 +40,360 @@
 #define TO8F(x) QFile::encodeName( x ).constData()
 #endif
 
+//maximum size of the raster block cache in bytes
+static const int sBlockCacheSize = 64 * 1024 * 1024;
+//number of features read from the layer and processed in parallel at once
+static const int sBatchSize = 256;
+
+/**Cache of raster blocks, read as float and shared by the threads computing the zones.
+  Neighbouring zones usually cover the same blocks, which are then read only once*/
+class QgsZonalStatisticsBlockCache
+{
+  public:
+    QgsZonalStatisticsBlockCache( GDALRasterBandH band )
+        : mBand( band )
+        , mXSize( GDALGetRasterBandXSize( band ) )
+        , mYSize( GDALGetRasterBandYSize( band ) )
+        , mBlocks( sBlockCacheSize )
+    {
+      GDALGetBlockSize( band, &mBlockXSize, &mBlockYSize );
+      if ( mBlockXSize <= 0 || mBlockYSize <= 0 )
+      {
+        mBlockXSize = mXSize;
+        mBlockYSize = 1;
+      }
+      mBlocksX = ( mXSize + mBlockXSize - 1 ) / mBlockXSize;
+    }
+
+    int blockXSize() const { return mBlockXSize; }
+    int blockYSize() const { return mBlockYSize; }
+
+    /**Values of a block with a line length of blockXSize(). Empty if reading failed*/
+    QVector<float> block( int blockX, int blockY )
+    {
+      QMutexLocker locker( &mMutex );
+      qint64 key = ( qint64 )blockY * mBlocksX + blockX;
+      QVector<float>* cached = mBlocks.object( key );
+      if ( cached )
+      {
+        return *cached;
+      }
+
+      //edge blocks are read partially, GDAL would return zeros outside of the raster
+      int xOff = blockX * mBlockXSize;
+      int yOff = blockY * mBlockYSize;
+      int width = qMin( mBlockXSize, mXSize - xOff );
+      int height = qMin( mBlockYSize, mYSize - yOff );
+      QVector<float> values( mBlockXSize * mBlockYSize );
+      if ( GDALRasterIO( mBand, GF_Read, xOff, yOff, width, height, values.data(), width, height, GDT_Float32,
+                         sizeof( float ), mBlockXSize * sizeof( float ) ) != CE_None )
+      {
+        QgsDebugMsg( QString( "Reading block %1,%2 failed: %3" ).arg( blockX ).arg( blockY ).arg( CPLGetLastErrorMsg() ) );
+        values.clear();
+      }
+      mBlocks.insert( key, new QVector<float>( values ), qMax( 1, values.size() * ( int )sizeof( float ) ) );
+      return values;
+    }
+
+  private:
+    GDALRasterBandH mBand;
+    int mXSize;
+    int mYSize;
+    int mBlockXSize;
+    int mBlockYSize;
+    int mBlocksX;
+    QMutex mMutex;
+    QCache<qint64, QVector<float> > mBlocks;
+};
+
+/**Raster and options shared by all zones*/
+struct QgsZonalStatisticsRaster
+{
+  QgsZonalStatisticsBlockCache* cache;
+  double xMin;
+  double yMax;
+  double cellSizeX;
+  double cellSizeY;
+  bool hasNodata;
+  float nodata;
+  bool keepValues;
+  int histogramBins;
+  double histogramMinimum;
+  double histogramMaximum;
+
+  bool isValid( float value ) const
+  {
+    return !qIsNaN( value ) && !( hasNodata && value == nodata );
+  }
+};
+
+/**Accumulated statistics of a zone, cells may be weighted by their covered fraction*/
+struct QgsZonalStatisticsValues
+{
+  double count;
+  double sum;
+  double mean;
+  double m2;
+  double min;
+  double max;
+  //! cell values and weights for the median, weights are only stored after a cell with a weight other than 1
+  QVector<float> values;
+  QVector<float> weights;
+  QVector<double> histogram;
+
+  void reset( const QgsZonalStatisticsRaster& raster )
+  {
+    count = sum = mean = m2 = 0;
+    min = max = 0;
+    values.clear();
+    weights.clear();
+    histogram.fill( 0, raster.histogramBins );
+  }
+
+  void add( const QgsZonalStatisticsRaster& raster, float value, double weight )
+  {
+    if ( count == 0 || value < min )
+      min = value;
+    if ( count == 0 || value > max )
+      max = value;
+
+    //weighted variance after West (1979)
+    count += weight;
+    sum += value * weight;
+    double delta = value - mean;
+    mean += delta * weight / count;
+    m2 += weight * delta * ( value - mean );
+
+    if ( raster.keepValues )
+    {
+      if ( weight != 1.0 && weights.isEmpty() )
+        weights.fill( 1.0, values.size() );
+      values.append( value );
+      if ( !weights.isEmpty() )
+        weights.append( weight );
+    }
+
+    if ( raster.histogramBins > 0 && value >= raster.histogramMinimum && value <= raster.histogramMaximum )
+    {
+      int bin = ( int )(( value - raster.histogramMinimum ) / ( raster.histogramMaximum - raster.histogramMinimum ) * raster.histogramBins );
+      histogram[ qMin( bin, raster.histogramBins - 1 )] += weight;
+    }
+  }
+
+  //! weighted median, the mean of the two middle values if the weights are split exactly in half
+  double median() const
+  {
+    QVector<int> order( values.size() );
+    for ( int i = 0; i < order.size(); ++i )
+      order[i] = i;
+    std::sort( order.begin(), order.end(), ValueLessThan( values ) );
+
+    double half = 0;
+    for ( int i = 0; i < values.size(); ++i )
+      half += weights.isEmpty() ? 1.0 : weights[i];
+    half /= 2.0;
+
+    double cumulated = 0;
+    for ( int i = 0; i < order.size(); ++i )
+    {
+      cumulated += weights.isEmpty() ? 1.0 : weights[ order[i] ];
+      if ( cumulated > half )
+        return values[ order[i] ];
+      if ( cumulated == half && i + 1 < order.size() )
+        return ( values[ order[i] ] + values[ order[i + 1] ] ) / 2.0;
+    }
+    return order.isEmpty() ? 0 : values[ order.last()];
+  }
+
+  struct ValueLessThan
+  {
+    ValueLessThan( const QVector<float>& v ) : values( v ) {}
+    bool operator()( int a, int b ) const { return values[a] < values[b]; }
+    const QVector<float>& values;
+  };
+};
+
+/**A feature and the window of cells covering its bounding box, computed by one thread*/
+struct QgsZonalStatisticsZone
+{
+  QgsFeatureId id;
+  QgsGeometry* geometry;
+  //! rings of all parts, for the scanline fill
+  QgsPolygon rings;
+  int offsetX;
+  int offsetY;
+  int nCellsX;
+  int nCellsY;
+  const QgsZonalStatisticsRaster* raster;
+  QgsZonalStatisticsValues stats;
+};
+
+//first row or column index whose cell center is greater than position (in cell units from the window start)
+static int firstCellAfter( double position, int nCells )
+{
+  double cell = floor( position - 0.5 ) + 1;
+  return ( int )qBound( 0.0, cell, ( double )nCells );
+}
+
+/**Rasterises the zone with an even-odd scanline fill of the cell centers and accumulates the covered cells.
+  Only the cells in the spans of each row are read, block by block*/
+static void statisticsFromScanlines( QgsZonalStatisticsZone& zone )
+{
+  const QgsZonalStatisticsRaster& raster = *zone.raster;
+  zone.stats.reset( raster );
+
+  double windowXMin = raster.xMin + zone.offsetX * raster.cellSizeX;
+  double windowYMax = raster.yMax - zone.offsetY * raster.cellSizeY;
+
+  //x positions where the boundary crosses the center line of each row
+  QVector< QVector<double> > crossings( zone.nCellsY );
+  foreach ( const QgsPolyline& ring, zone.rings )
+  {
+    for ( int i = 0; i < ring.size(); ++i )
+    {
+      const QgsPoint& a = ring[ i == 0 ? ring.size() - 1 : i - 1 ];
+      const QgsPoint& b = ring[i];
+      double yMin = qMin( a.y(), b.y() );
+      double yMax = qMax( a.y(), b.y() );
+      if ( yMin == yMax )
+      {
+        continue;
+      }
+
+      //rows with yMin <= center < yMax, the range is widened by one row against rounding and checked exactly
+      int firstRow = qMax( 0, firstCellAfter(( windowYMax - yMax ) / raster.cellSizeY, zone.nCellsY ) - 1 );
+      int lastRow = qMin( zone.nCellsY - 1, firstCellAfter(( windowYMax - yMin ) / raster.cellSizeY, zone.nCellsY ) );
+      for ( int row = firstRow; row <= lastRow; ++row )
+      {
+        double centerY = windowYMax - ( row + 0.5 ) * raster.cellSizeY;
+        if ( centerY < yMin || centerY >= yMax )
+        {
+          continue;
+        }
+        crossings[row].append( a.x() + ( centerY - a.y() ) * ( b.x() - a.x() ) / ( b.y() - a.y() ) );
+      }
+    }
+  }
+
+  int blockXSize = raster.cache->blockXSize();
+  int blockYSize = raster.cache->blockYSize();
+  int firstBlockX = zone.offsetX / blockXSize;
+  int nBlocksX = ( zone.offsetX + zone.nCellsX - 1 ) / blockXSize - firstBlockX + 1;
+  QVector< QVector<float> > blocks( nBlocksX );
+  QVector<bool> blockRead( nBlocksX );
+  int currentBlockY = -1;
+
+  for ( int row = 0; row < zone.nCellsY; ++row )
+  {
+    QVector<double>& rowCrossings = crossings[row];
+    if ( rowCrossings.size() < 2 )
+    {
+      continue;
+    }
+    std::sort( rowCrossings.begin(), rowCrossings.end() );
+
+    int rasterRow = zone.offsetY + row;
+    if ( rasterRow / blockYSize != currentBlockY )
+    {
+      currentBlockY = rasterRow / blockYSize;
+      blockRead.fill( false );
+    }
+    int blockRowOffset = ( rasterRow % blockYSize ) * blockXSize;
+
+    for ( int i = 0; i + 1 < rowCrossings.size(); i += 2 )
+    {
+      int col = firstCellAfter(( rowCrossings[i] - windowXMin ) / raster.cellSizeX, zone.nCellsX );
+      int endCol = firstCellAfter(( rowCrossings[i + 1] - windowXMin ) / raster.cellSizeX, zone.nCellsX );
+      //a center exactly on the closing crossing is outside
+      if ( endCol > 0 && windowXMin + ( endCol - 0.5 ) * raster.cellSizeX >= rowCrossings[i + 1] )
+      {
+        --endCol;
+      }
+
+      while ( col < endCol )
+      {
+        int rasterCol = zone.offsetX + col;
+        int blockIdx = rasterCol / blockXSize - firstBlockX;
+        int spanEnd = qMin( endCol, ( blockIdx + firstBlockX + 1 ) * blockXSize - zone.offsetX );
+        if ( !blockRead[blockIdx] )
+        {
+          blocks[blockIdx] = raster.cache->block( blockIdx + firstBlockX, currentBlockY );
+          blockRead[blockIdx] = true;
+        }
+
+        const QVector<float>& block = blocks[blockIdx];
+        if ( !block.isEmpty() )
+        {
+          const float* value = block.constData() + blockRowOffset + rasterCol % blockXSize;
+          for ( int c = col; c < spanEnd; ++c, ++value )
+          {
+            if ( raster.isValid( *value ) )
+            {
+              zone.stats.add( raster, *value, 1.0 );
+            }
+          }
+        }
+        col = spanEnd;
+      }
+    }
+  }
+}
+
+/**Statistics with precise pixel - polygon intersection, each cell is weighted by the fraction covered by the polygon (slow).
+  Uses GEOS and must be called from the main thread*/
+static void statisticsFromPreciseIntersection( QgsZonalStatisticsZone& zone )
+{
+  const QgsZonalStatisticsRaster& raster = *zone.raster;
+  zone.stats.reset( raster );
+
+  int blockXSize = raster.cache->blockXSize();
+  int blockYSize = raster.cache->blockYSize();
+  double hCellSizeX = raster.cellSizeX / 2.0;
+  double hCellSizeY = raster.cellSizeY / 2.0;
+  double pixelArea = raster.cellSizeX * raster.cellSizeY;
+
+  double currentY = raster.yMax - zone.offsetY * raster.cellSizeY - hCellSizeY;
+  for ( int row = zone.offsetY; row < zone.offsetY + zone.nCellsY; ++row )
+  {
+    double currentX = raster.xMin + zone.offsetX * raster.cellSizeX + hCellSizeX;
+    for ( int col = zone.offsetX; col < zone.offsetX + zone.nCellsX; ++col )
+    {
+      QVector<float> block = raster.cache->block( col / blockXSize, row / blockYSize );
+      float value = block.isEmpty() ? 0 : block[( row % blockYSize ) * blockXSize + col % blockXSize ];
+      if ( !block.isEmpty() && raster.isValid( value ) )
+      {
+        QgsGeometry* pixelRectGeometry = QgsGeometry::fromRect( QgsRectangle( currentX - hCellSizeX, currentY - hCellSizeY, currentX + hCellSizeX, currentY + hCellSizeY ) );
+        if ( pixelRectGeometry )
+        {
+          QgsGeometry *intersectGeometry = pixelRectGeometry->intersection( zone.geometry );
+          if ( intersectGeometry )
+          {
+            double intersectionArea = intersectGeometry->area();
+            if ( intersectionArea > 0.0 )
+            {
+              zone.stats.add( raster, value, intersectionArea / pixelArea );
+            }
+            delete intersectGeometry;
+          }
+          delete pixelRectGeometry;
+        }
+      }
+      currentX += raster.cellSizeX;
+    }
+    currentY -= raster.cellSizeY;
+  }
+}
+
 QgsZonalStatistics::QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QString& rasterFile, const QString& attributePrefix, int rasterBand )
     : mRasterFilePath( rasterFile )
     , mRasterBand( rasterBand )
     , mPolygonLayer( polygonLayer )
     , mAttributePrefix( attributePrefix )
     , mInputNodataValue( -1 )
+    , mStatistics( Default )
+    , mHistogramBins( 10 )
+    , mHistogramMinimum( 0 )
+    , mHistogramMaximum( 0 )
 {
 
 }
@@ -43,6 +401,10 @@ QgsZonalStatistics::QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QStr
 QgsZonalStatistics::QgsZonalStatistics()
     : mRasterBand( 0 )
     , mPolygonLayer( 0 )
+    , mStatistics( Default )
+    , mHistogramBins( 10 )
+    , mHistogramMinimum( 0 )
+    , mHistogramMaximum( 0 )
 {
 
 }
@@ -52,6 +414,13 @@ QgsZonalStatistics::~QgsZonalStatistics()
 
 }
 
+void QgsZonalStatistics::setHistogramBins( int bins, double minimum, double maximum )
+{
+  mHistogramBins = qMax( 1, bins );
+  mHistogramMinimum = minimum;
+  mHistogramMaximum = maximum;
+}
+
 int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
 {
   if ( !mPolygonLayer || mPolygonLayer->geometryType() != QGis::Polygon )
@@ -85,7 +454,8 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
     GDALClose( inputDataset );
     return 5;
   }
-  mInputNodataValue = GDALGetRasterNoDataValue( rasterBand, NULL );
+  int hasNodata = 0;
+  mInputNodataValue = GDALGetRasterNoDataValue( rasterBand, &hasNodata );
 
   //get geometry info about raster layer
   int nCellsXGDAL = GDALGetRasterXSize( inputDataset );
@@ -109,27 +479,72 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
   QgsRectangle rasterBBox( geoTransform[0], geoTransform[3] - ( nCellsYGDAL * cellsizeY ),
                            geoTransform[0] + ( nCellsXGDAL * cellsizeX ), geoTransform[3] );
 
-  //add the new count, sum, mean fields to the provider
+  //add the new statistics fields to the provider
+  static const Statistic statisticList[] = { Count, Sum, Mean, Min, Max, StDev, Median, Histogram };
+  static const char* statisticNames[] = { "count", "sum", "mean", "min", "max", "stdev", "median", "hist" };
+  const int nStatistics = sizeof( statisticList ) / sizeof( statisticList[0] );
+
   QList<QgsField> newFieldList;
-  QString countFieldName = getUniqueFieldName( mAttributePrefix + "count" );
-  QString sumFieldName = getUniqueFieldName( mAttributePrefix + "sum" );
-  QString meanFieldName = getUniqueFieldName( mAttributePrefix + "mean" );
-  QgsField countField( countFieldName, QVariant::Double, "double precision" );
-  QgsField sumField( sumFieldName, QVariant::Double, "double precision" );
-  QgsField meanField( meanFieldName, QVariant::Double, "double precision" );
-  newFieldList.push_back( countField );
-  newFieldList.push_back( sumField );
-  newFieldList.push_back( meanField );
+  QStringList fieldNames;
+  for ( int i = 0; i < nStatistics; ++i )
+  {
+    if ( !( mStatistics & statisticList[i] ) )
+    {
+      continue;
+    }
+    QString fieldName = getUniqueFieldName( mAttributePrefix + statisticNames[i] );
+    fieldNames << fieldName;
+    if ( statisticList[i] == Histogram )
+    {
+      newFieldList.push_back( QgsField( fieldName, QVariant::String, "string", 254 ) );
+    }
+    else
+    {
+      newFieldList.push_back( QgsField( fieldName, QVariant::Double, "double precision" ) );
+    }
+  }
   vectorProvider->addAttributes( newFieldList );
 
-  //index of the new fields
-  int countIndex = vectorProvider->fieldNameIndex( countFieldName );
-  int sumIndex = vectorProvider->fieldNameIndex( sumFieldName );
-  int meanIndex = vectorProvider->fieldNameIndex( meanFieldName );
+  //index of the new fields, -1 for statistics not calculated
+  int fieldIndex[nStatistics];
+  for ( int i = 0, field = 0; i < nStatistics; ++i )
+  {
+    fieldIndex[i] = -1;
+    if ( !( mStatistics & statisticList[i] ) )
+    {
+      continue;
+    }
+    fieldIndex[i] = vectorProvider->fieldNameIndex( fieldNames.at( field++ ) );
+    if ( fieldIndex[i] == -1 )
+    {
+      GDALClose( inputDataset );
+      return 8;
+    }
+  }
 
-  if ( countIndex == -1 || sumIndex == -1 || meanIndex == -1 )
+  QgsZonalStatisticsBlockCache blockCache( rasterBand );
+  QgsZonalStatisticsRaster raster;
+  raster.cache = &blockCache;
+  raster.xMin = rasterBBox.xMinimum();
+  raster.yMax = rasterBBox.yMaximum();
+  raster.cellSizeX = cellsizeX;
+  raster.cellSizeY = cellsizeY;
+  raster.hasNodata = hasNodata;
+  raster.nodata = mInputNodataValue;
+  raster.keepValues = mStatistics & Median;
+  raster.histogramBins = 0;
+  if ( mStatistics & Histogram )
   {
-    return 8;
+    raster.histogramBins = mHistogramBins;
+    raster.histogramMinimum = mHistogramMinimum;
+    raster.histogramMaximum = mHistogramMaximum;
+    if ( mHistogramMinimum >= mHistogramMaximum )
+    {
+      double minMax[2];
+      GDALComputeRasterMinMax( rasterBand, FALSE, minMax );
+      raster.histogramMinimum = minMax[0];
+      raster.histogramMaximum = minMax[1];
+    }
   }
 
   //progress dialog
@@ -139,18 +554,18 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
     p->setMaximum( featureCount );
   }
 
+  bool concurrent = QThread::idealThreadCount() > 1;
 
-  //iterate over each polygon
+  //features are read in batches, the zones of a batch are calculated in parallel and written at once
   QgsFeatureRequest request;
   request.setSubsetOfAttributes( QgsAttributeList() );
   QgsFeatureIterator fi = vectorProvider->getFeatures( request );
   QgsFeature f;
-  double count = 0;
-  double sum = 0;
-  double mean = 0;
   int featureCounter = 0;
+  bool moreFeatures = true;
+  QVector<QgsZonalStatisticsZone> zones;
 
-  while ( fi.nextFeature( f ) )
+  while ( moreFeatures )
   {
     if ( p )
     {
@@ -162,67 +577,135 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
       break;
     }
 
-    QgsGeometry* featureGeometry = f.geometry();
-    if ( !featureGeometry )
+    zones.clear();
+    while ( zones.size() < sBatchSize && ( moreFeatures = fi.nextFeature( f ) ) )
     {
       ++featureCounter;
-      continue;
-    }
 
-    QgsRectangle featureRect = featureGeometry->boundingBox().intersect( &rasterBBox );
-    if ( featureRect.isEmpty() )
-    {
-      ++featureCounter;
-      continue;
-    }
+      QgsGeometry* featureGeometry = f.geometry();
+      if ( !featureGeometry )
+      {
+        continue;
+      }
 
-    int offsetX, offsetY, nCellsX, nCellsY;
-    if ( cellInfoForBBox( rasterBBox, featureRect, cellsizeX, cellsizeY, offsetX, offsetY, nCellsX, nCellsY ) != 0 )
-    {
-      ++featureCounter;
-      continue;
-    }
+      QgsRectangle featureRect = featureGeometry->boundingBox().intersect( &rasterBBox );
+      if ( featureRect.isEmpty() )
+      {
+        continue;
+      }
 
-    //avoid access to cells outside of the raster (may occur because of rounding)
-    if (( offsetX + nCellsX ) > nCellsXGDAL )
-    {
-      nCellsX = nCellsXGDAL - offsetX;
-    }
-    if (( offsetY + nCellsY ) > nCellsYGDAL )
-    {
-      nCellsY = nCellsYGDAL - offsetY;
-    }
+      QgsZonalStatisticsZone zone;
+      if ( cellInfoForBBox( rasterBBox, featureRect, cellsizeX, cellsizeY, zone.offsetX, zone.offsetY, zone.nCellsX, zone.nCellsY ) != 0 )
+      {
+        continue;
+      }
 
-    statisticsFromMiddlePointTest( rasterBand, featureGeometry, offsetX, offsetY, nCellsX, nCellsY, cellsizeX, cellsizeY,
-                                   rasterBBox, sum, count );
+      //avoid access to cells outside of the raster (may occur because of rounding)
+      if (( zone.offsetX + zone.nCellsX ) > nCellsXGDAL )
+      {
+        zone.nCellsX = nCellsXGDAL - zone.offsetX;
+      }
+      if (( zone.offsetY + zone.nCellsY ) > nCellsYGDAL )
+      {
+        zone.nCellsY = nCellsYGDAL - zone.offsetY;
+      }
+      if ( zone.nCellsX <= 0 || zone.nCellsY <= 0 )
+      {
+        continue;
+      }
 
-    if ( count <= 1 )
-    {
-      //the cell resolution is probably larger than the polygon area. We switch to precise pixel - polygon intersection in this case
-      statisticsFromPreciseIntersection( rasterBand, featureGeometry, offsetX, offsetY, nCellsX, nCellsY, cellsizeX, cellsizeY,
-                                         rasterBBox, sum, count );
+      if ( featureGeometry->isMultipart() )
+      {
+        foreach ( const QgsPolygon& part, featureGeometry->asMultiPolygon() )
+        {
+          zone.rings += part;
+        }
+      }
+      else
+      {
+        zone.rings = featureGeometry->asPolygon();
+      }
+      zone.id = f.id();
+      zone.geometry = f.geometryAndOwnership();
+      zone.raster = &raster;
+      zones.append( zone );
     }
 
-
-    if ( count == 0 )
+    if ( concurrent )
     {
-      mean = 0;
+      QtConcurrent::blockingMap( zones, statisticsFromScanlines );
     }
     else
     {
-      mean = sum / count;
+      for ( int i = 0; i < zones.size(); ++i )
+      {
+        statisticsFromScanlines( zones[i] );
+      }
     }
 
-    //write the statistics value to the vector data provider
     QgsChangedAttributesMap changeMap;
-    QgsAttributeMap changeAttributeMap;
-    changeAttributeMap.insert( countIndex, QVariant( count ) );
-    changeAttributeMap.insert( sumIndex, QVariant( sum ) );
-    changeAttributeMap.insert( meanIndex, QVariant( mean ) );
-    changeMap.insert( f.id(), changeAttributeMap );
-    vectorProvider->changeAttributeValues( changeMap );
+    for ( int i = 0; i < zones.size(); ++i )
+    {
+      QgsZonalStatisticsZone& zone = zones[i];
+      if ( zone.stats.count <= 1 )
+      {
+        //the cell resolution is probably larger than the polygon area. We switch to precise pixel - polygon intersection in this case
+        statisticsFromPreciseIntersection( zone );
+      }
+
+      const QgsZonalStatisticsValues& stats = zone.stats;
+      bool empty = stats.count == 0;
+      QStringList histogram;
+      foreach ( double binCount, stats.histogram )
+      {
+        histogram << QString::number( binCount );
+      }
+
+      QgsAttributeMap changeAttributeMap;
+      for ( int j = 0; j < nStatistics; ++j )
+      {
+        if ( fieldIndex[j] == -1 )
+        {
+          continue;
+        }
 
-    ++featureCounter;
+        QVariant value;
+        switch ( statisticList[j] )
+        {
+          case Count:
+            value = stats.count;
+            break;
+          case Sum:
+            value = stats.sum;
+            break;
+          case Mean:
+            value = empty ? 0.0 : stats.sum / stats.count;
+            break;
+          case Min:
+            value = empty ? QVariant( QVariant::Double ) : stats.min;
+            break;
+          case Max:
+            value = empty ? QVariant( QVariant::Double ) : stats.max;
+            break;
+          case StDev:
+            value = empty ? QVariant( QVariant::Double ) : sqrt( stats.m2 / stats.count );
+            break;
+          case Median:
+            value = empty ? QVariant( QVariant::Double ) : stats.median();
+            break;
+          case Histogram:
+            value = histogram.join( "," );
+            break;
+          default:
+            break;
+        }
+        changeAttributeMap.insert( fieldIndex[j], value );
+      }
+      changeMap.insert( zone.id, changeAttributeMap );
+      delete zone.geometry;
+    }
+    //write the statistics values to the vector data provider
+    vectorProvider->changeAttributeValues( changeMap );
   }
 
   if ( p )
@@ -265,110 +748,6 @@ int QgsZonalStatistics::cellInfoForBBox( const QgsRectangle& rasterBBox, const Q
   return 0;
 }
 
-void QgsZonalStatistics::statisticsFromMiddlePointTest( void* band, QgsGeometry* poly, int pixelOffsetX,
-    int pixelOffsetY, int nCellsX, int nCellsY, double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count )
-{
-  double cellCenterX, cellCenterY;
-
-  float* scanLine = ( float * ) CPLMalloc( sizeof( float ) * nCellsX );
-  cellCenterY = rasterBBox.yMaximum() - pixelOffsetY * cellSizeY - cellSizeY / 2;
-  count = 0;
-  sum = 0;
-
-  const GEOSGeometry* polyGeos = poly->asGeos();
-  if ( !polyGeos )
-  {
-    return;
-  }
-
-  const GEOSPreparedGeometry* polyGeosPrepared = GEOSPrepare( poly->asGeos() );
-  if ( !polyGeosPrepared )
-  {
-    return;
-  }
-
-  GEOSCoordSequence* cellCenterCoords = 0;
-  GEOSGeometry* currentCellCenter = 0;
-
-  for ( int i = 0; i < nCellsY; ++i )
-  {
-    if ( GDALRasterIO( band, GF_Read, pixelOffsetX, pixelOffsetY + i, nCellsX, 1, scanLine, nCellsX, 1, GDT_Float32, 0, 0 )
-         != CPLE_None )
-    {
-      continue;
-    }
-    cellCenterX = rasterBBox.xMinimum() + pixelOffsetX * cellSizeX + cellSizeX / 2;
-    for ( int j = 0; j < nCellsX; ++j )
-    {
-      GEOSGeom_destroy( currentCellCenter );
-      cellCenterCoords = GEOSCoordSeq_create( 1, 2 );
-      GEOSCoordSeq_setX( cellCenterCoords, 0, cellCenterX );
-      GEOSCoordSeq_setY( cellCenterCoords, 0, cellCenterY );
-      currentCellCenter = GEOSGeom_createPoint( cellCenterCoords );
-
-      if ( scanLine[j] != mInputNodataValue ) //don't consider nodata values
-      {
-        if ( GEOSPreparedContains( polyGeosPrepared, currentCellCenter ) )
-        {
-          if ( !qIsNaN( scanLine[j] ) )
-          {
-            sum += scanLine[j];
-          }
-          ++count;
-        }
-      }
-      cellCenterX += cellSizeX;
-    }
-    cellCenterY -= cellSizeY;
-  }
-  CPLFree( scanLine );
-  GEOSPreparedGeom_destroy( polyGeosPrepared );
-}
-
-void QgsZonalStatistics::statisticsFromPreciseIntersection( void* band, QgsGeometry* poly, int pixelOffsetX,
-    int pixelOffsetY, int nCellsX, int nCellsY, double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count )
-{
-  sum = 0;
-  count = 0;
-  double currentY = rasterBBox.yMaximum() - pixelOffsetY * cellSizeY - cellSizeY / 2;
-  float* pixelData = ( float * ) CPLMalloc( sizeof( float ) );
-  QgsGeometry* pixelRectGeometry = 0;
-
-  double hCellSizeX = cellSizeX / 2.0;
-  double hCellSizeY = cellSizeY / 2.0;
-  double pixelArea = cellSizeX * cellSizeY;
-  double weight = 0;
-
-  for ( int row = 0; row < nCellsY; ++row )
-  {
-    double currentX = rasterBBox.xMinimum() + cellSizeX / 2.0 + pixelOffsetX * cellSizeX;
-    for ( int col = 0; col < nCellsX; ++col )
-    {
-      GDALRasterIO( band, GF_Read, pixelOffsetX + col, pixelOffsetY + row, nCellsX, 1, pixelData, 1, 1, GDT_Float32, 0, 0 );
-      pixelRectGeometry = QgsGeometry::fromRect( QgsRectangle( currentX - hCellSizeX, currentY - hCellSizeY, currentX + hCellSizeX, currentY + hCellSizeY ) );
-      if ( pixelRectGeometry )
-      {
-        //intersection
-        QgsGeometry *intersectGeometry = pixelRectGeometry->intersection( poly );
-        if ( intersectGeometry )
-        {
-          double intersectionArea = intersectGeometry->area();
-          if ( intersectionArea >= 0.0 )
-          {
-            weight = intersectionArea / pixelArea;
-            count += weight;
-            sum += *pixelData * weight;
-          }
-          delete intersectGeometry;
-        }
-      }
-      currentX += cellSizeX;
-    }
-    currentY -= cellSizeY;
-  }
-  CPLFree( pixelData );
-}
-
 QString QgsZonalStatistics::getUniqueFieldName( QString fieldName )
 {
   QgsVectorDataProvider* dp = mPolygonLayer->dataProvider();
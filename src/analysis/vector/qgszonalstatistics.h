@@ -25,13 +25,49 @@ class QgsGeometry;
 class QgsVectorLayer;
 class QProgressDialog;
 
-/**A class that calculates raster statistics (count, sum, mean) for a polygon or multipolygon layer and appends the results as attributes*/
+/**A class that calculates raster statistics (count, sum, mean and optionally min, max, standard deviation,
+  median and histogram) for a polygon or multipolygon layer and appends the results as attributes.
+
+  Each polygon is rasterised with a scanline fill into the cells whose center lies inside it. The raster is read
+  in its native blocks through a cache shared by neighbouring zones, and the zones are processed in parallel.
+  Polygons covering at most one cell center are intersected precisely with the cells and the statistics
+  are weighted by the covered fraction of each cell*/
 class ANALYSIS_EXPORT QgsZonalStatistics
 {
   public:
+    /**Statistics appended as attributes
+      @note added in 2.4*/
+    enum Statistic
+    {
+      Count = 1,
+      Sum = 2,
+      Mean = 4,
+      Min = 8,
+      Max = 16,
+      StDev = 32, //!< population standard deviation
+      Median = 64,
+      Histogram = 128, //!< comma separated counts of the histogram bins, see setHistogramBins()
+      Default = Count | Sum | Mean,
+      All = Count | Sum | Mean | Min | Max | StDev | Median | Histogram
+    };
+    Q_DECLARE_FLAGS( Statistics, Statistic )
+
     QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QString& rasterFile, const QString& attributePrefix = "", int rasterBand = 1 );
     ~QgsZonalStatistics();
 
+    /**Sets the statistics to calculate (defaults to count, sum and mean)
+      @note added in 2.4*/
+    void setStatistics( Statistics stats ) { mStatistics = stats; }
+    /**@note added in 2.4*/
+    Statistics statistics() const { return mStatistics; }
+
+    /**Sets the bins of the histogram statistic. Values outside of the range are not counted.
+      If minimum is not smaller than maximum, the range of the whole raster band is used
+      @note added in 2.4*/
+    void setHistogramBins( int bins, double minimum = 0, double maximum = 0 );
+    /**@note added in 2.4*/
+    int histogramBins() const { return mHistogramBins; }
+
     /**Starts the calculation
       @return 0 in case of success*/
     int calculateStatistics( QProgressDialog* p );
@@ -43,17 +79,6 @@ class ANALYSIS_EXPORT QgsZonalStatistics
     int cellInfoForBBox( const QgsRectangle& rasterBBox, const QgsRectangle& featureBBox, double cellSizeX, double cellSizeY,
                          int& offsetX, int& offsetY, int& nCellsX, int& nCellsY ) const;
 
-    /**Returns statistics by considering the pixels where the center point is within the polygon (fast)*/
-    void statisticsFromMiddlePointTest( void* band, QgsGeometry* poly, int pixelOffsetX, int pixelOffsetY, int nCellsX, int nCellsY,
-                                        double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count );
-
-    void statisticsFromMiddlePointTest_improved( void* band, QgsGeometry* poly, int pixelOffsetX, int pixelOffsetY, int nCellsX, int nCellsY,
-        double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count );
-
-    /**Returns statistics with precise pixel - polygon intersection test (slow) */
-    void statisticsFromPreciseIntersection( void* band, QgsGeometry* poly, int pixelOffsetX, int pixelOffsetY, int nCellsX, int nCellsY,
-                                            double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count );
-
     QString getUniqueFieldName( QString fieldName );
 
     QString mRasterFilePath;
@@ -63,6 +88,12 @@ class ANALYSIS_EXPORT QgsZonalStatistics
     QString mAttributePrefix;
     /**The nodata value of the input layer*/
     float mInputNodataValue;
+    Statistics mStatistics;
+    int mHistogramBins;
+    double mHistogramMinimum;
+    double mHistogramMaximum;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS( QgsZonalStatistics::Statistics )
+
 #endif // QGSZONALSTATISTICS_H
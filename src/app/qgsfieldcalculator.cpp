@@ -171,6 +171,9 @@ void QgsFieldCalculator::accept()
     return;
   }
 
+  // evaluated once per feature - use the compiled form
+  exp.compile();
+
   //go through all the features and change the new attribute
   QgsFeature feature;
   bool calculationSuccess = true;
@@ -133,6 +133,9 @@ void QgsMapToolSelectUtils::setSelectFeatures( QgsMapCanvas* canvas,
 
   QgsFeatureIterator fit = vlayer->getFeatures( QgsFeatureRequest().setFilterRect( selectGeomTrans.boundingBox() ).setFlags( QgsFeatureRequest::ExactIntersect ).setSubsetOfAttributes( QgsAttributeList() ) );
 
+  //the selection geometry is tested against every feature in its bounding box
+  selectGeomTrans.prepareGeometry();
+
   QgsFeatureIds newSelectedFeatures;
   QgsFeature f;
   QgsFeatureId closestFeatureId = 0;
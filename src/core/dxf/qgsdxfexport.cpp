@@ -24,6 +24,7 @@
 #include "qgsfillsymbollayerv2.h"
 #include "qgslinesymbollayerv2.h"
 #include "qgsvectorlayer.h"
+#include "qgswkbview.h"
 #include <QIODevice>
 
 //dxf color palette
@@ -816,8 +817,7 @@ void QgsDxfExport::writePoint( const QgsPoint& pt, const QString& layer, int col
   }
 }
 
-void QgsDxfExport::writePolyline( const QgsPolyline& line, const QString& layer, const QString& lineStyleName, int color,
-                                  double width, bool polygon )
+void QgsDxfExport::writePolylineHeader( const QString& layer, const QString& lineStyleName, int color, double width, bool polygon )
 {
   writeGroup( 0, "POLYLINE" );
   writeGroup( 8, layer );
@@ -831,6 +831,12 @@ void QgsDxfExport::writePolyline( const QgsPolyline& line, const QString& layer,
     writeGroup( 40, width );
     writeGroup( 41, width );
   }
+}
+
+void QgsDxfExport::writePolyline( const QgsPolyline& line, const QString& layer, const QString& lineStyleName, int color,
+                                  double width, bool polygon )
+{
+  writePolylineHeader( layer, lineStyleName, color, width, polygon );
 
   QgsPolyline::const_iterator lineIt = line.constBegin();
   for ( ; lineIt != line.constEnd(); ++lineIt )
@@ -841,6 +847,20 @@ void QgsDxfExport::writePolyline( const QgsPolyline& line, const QString& layer,
   writeGroup( 0, "SEQEND" );
 }
 
+void QgsDxfExport::writePolyline( const QgsWkbRing& line, const QString& layer, const QString& lineStyleName, int color,
+                                  double width, bool polygon )
+{
+  writePolylineHeader( layer, lineStyleName, color, width, polygon );
+
+  QgsWkbRing::const_iterator lineIt = line.begin();
+  for ( ; lineIt != line.end(); ++lineIt )
+  {
+    writeVertex( *lineIt, layer );
+  }
+
+  writeGroup( 0, "SEQEND" );
+}
+
 void QgsDxfExport::writeLine( const QgsPoint& pt1, const QgsPoint& pt2, const QString& layer, const QString& lineStyleName, int color, double width )
 {
   QgsPolyline line( 2 );
@@ -960,65 +980,31 @@ void QgsDxfExport::addFeature( const QgsSymbolV2RenderContext& ctx, const QStrin
     {
       lineStyleName = lineStyleFromSymbolLayer( symbolLayer );
     }
-    QGis::WkbType geometryType = geom->wkbType();
-
-    //single point
-    if ( geometryType == QGis::WKBPoint || geometryType == QGis::WKBPoint25D )
-    {
-      writePoint( geom->asPoint(), layer, c, fet, symbolLayer, symbol );
-    }
 
-    //multipoint
-    if ( geometryType == QGis::WKBMultiPoint || geometryType == QGis::WKBMultiPoint25D )
+    //write the parts and rings straight from the WKB
+    QgsWkbView wkbView( geom );
+    for ( QgsWkbView::const_iterator partIt = wkbView.begin(); partIt != wkbView.end(); ++partIt )
     {
-      QgsMultiPoint multiPoint = geom->asMultiPoint();
-      QgsMultiPoint::const_iterator it = multiPoint.constBegin();
-      for ( ; it != multiPoint.constEnd(); ++it )
+      QgsWkbPart part = *partIt;
+      switch ( part.type() )
       {
-        writePoint( *it, layer, c, fet, symbolLayer, symbol );
-      }
-    }
-
-    //single line
-    if ( geometryType == QGis::WKBLineString || geometryType == QGis::WKBLineString25D )
-    {
-      writePolyline( geom->asPolyline(), layer, lineStyleName, c, width, false );
-    }
+        case QGis::Point:
+          writePoint( part.ring().vertex( 0 ), layer, c, fet, symbolLayer, symbol );
+          break;
 
-    //multiline
-    if ( geometryType == QGis::WKBMultiLineString || geometryType == QGis::WKBMultiLineString25D )
-    {
-      QgsMultiPolyline multiLine = geom->asMultiPolyline();
-      QgsMultiPolyline::const_iterator lIt = multiLine.constBegin();
-      for ( ; lIt != multiLine.constEnd(); ++lIt )
-      {
-        writePolyline( *lIt, layer, lineStyleName, c, width, false );
-      }
-    }
+        case QGis::Line:
+          writePolyline( part.ring(), layer, lineStyleName, c, width, false );
+          break;
 
-    //polygon
-    if ( geometryType == QGis::WKBPolygon || geometryType == QGis::WKBPolygon25D )
-    {
-      QgsPolygon polygon = geom->asPolygon();
-      QgsPolygon::const_iterator polyIt = polygon.constBegin();
-      for ( ; polyIt != polygon.constEnd(); ++polyIt ) //iterate over rings
-      {
-        writePolyline( *polyIt, layer, lineStyleName, c, width, true );
-      }
-    }
+        case QGis::Polygon:
+          for ( QgsWkbPart::const_iterator ringIt = part.begin(); ringIt != part.end(); ++ringIt ) //iterate over rings
+          {
+            writePolyline( *ringIt, layer, lineStyleName, c, width, true );
+          }
+          break;
 
-    //multipolygon or polygon
-    if ( geometryType == QGis::WKBMultiPolygon || geometryType == QGis::WKBMultiPolygon25D )
-    {
-      QgsMultiPolygon mp = geom->asMultiPolygon();
-      QgsMultiPolygon::const_iterator mpIt = mp.constBegin();
-      for ( ; mpIt != mp.constEnd(); ++mpIt )
-      {
-        QgsPolygon::const_iterator polyIt = mpIt->constBegin();
-        for ( ; polyIt != mpIt->constEnd(); ++polyIt )
-        {
-          writePolyline( *polyIt, layer, lineStyleName, c, width, true );
-        }
+        default:
+          break;
       }
     }
   }
@@ -27,6 +27,7 @@
 class QgsMapLayer;
 class QgsPoint;
 class QgsSymbolLayerV2;
+class QgsWkbRing;
 class QIODevice;
 
 class CORE_EXPORT QgsDxfExport
@@ -76,6 +77,12 @@ class CORE_EXPORT QgsDxfExport
     void writePolyline( const QgsPolyline& line, const QString& layer, const QString& lineStyleName, int color,
                         double width = -1, bool polygon = false );
 
+    /**Writes a polyline from vertices in WKB (without copying them)
+      @note added in 2.4
+      @note not available in python bindings*/
+    void writePolyline( const QgsWkbRing& line, const QString& layer, const QString& lineStyleName, int color,
+                        double width = -1, bool polygon = false );
+
     void writeSolid( const QString& layer, int color, const QgsPoint& pt1, const QgsPoint& pt2, const QgsPoint& pt3, const QgsPoint& pt4 );
 
     //write line (as a polyline)
@@ -126,6 +133,8 @@ class CORE_EXPORT QgsDxfExport
 
     void writePoint( const QgsPoint& pt, const QString& layer, int color, const QgsFeature* f, const QgsSymbolLayerV2* symbolLayer, const QgsSymbolV2* symbol );
     void writeVertex( const QgsPoint& pt, const QString& layer );
+    //writes the POLYLINE entity before the vertices
+    void writePolylineHeader( const QString& layer, const QString& lineStyleName, int color, double width, bool polygon );
     void writeDefaultLinestyles();
     void writeSymbolLayerLinestyle( const QgsSymbolLayerV2* symbolLayer );
     void writeLinestyle( const QString& styleName, const QVector<qreal>& pattern, QgsSymbolV2::OutputUnit u );
@@ -15,11 +15,15 @@
 
 #include "qgscachedfeatureiterator.h"
 #include "qgsvectorlayercache.h"
+#include "qgscolumnarfeaturestore.h"
 
 QgsCachedFeatureIterator::QgsCachedFeatureIterator( QgsVectorLayerCache *vlCache, QgsFeatureRequest featureRequest, QgsFeatureIds featureIds )
     : QgsAbstractFeatureIterator( featureRequest )
     , mFeatureIds( featureIds )
     , mVectorLayerCache( vlCache )
+    , mUseFeatureStore( vlCache->mFullCache )
+    , mAllRows( false )
+    , mRow( 0 )
 {
   mFeatureIdIterator = featureIds.constBegin();
 
@@ -30,6 +34,9 @@ QgsCachedFeatureIterator::QgsCachedFeatureIterator( QgsVectorLayerCache *vlCache
 QgsCachedFeatureIterator::QgsCachedFeatureIterator( QgsVectorLayerCache *vlCache, QgsFeatureRequest featureRequest )
     : QgsAbstractFeatureIterator( featureRequest )
     , mVectorLayerCache( vlCache )
+    , mUseFeatureStore( vlCache->mFullCache )
+    , mAllRows( false )
+    , mRow( 0 )
 {
   switch ( featureRequest.filterType() )
   {
@@ -42,6 +49,14 @@ QgsCachedFeatureIterator::QgsCachedFeatureIterator( QgsVectorLayerCache *vlCache
       break;
 
     default:
+      if ( mUseFeatureStore )
+      {
+        // scan the storage instead of collecting the ids
+        mAllRows = true;
+        if ( mVectorLayerCache->mFeatureStore->count() == 0 )
+          close();
+        return;
+      }
       mFeatureIds = mVectorLayerCache->mCache.keys().toSet();
       break;
   }
@@ -57,6 +72,9 @@ bool QgsCachedFeatureIterator::fetchFeature( QgsFeature& f )
   if ( mClosed )
     return false;
 
+  if ( mUseFeatureStore )
+    return fetchStoredFeature( f );
+
   while ( mFeatureIdIterator != mFeatureIds.constEnd() )
   {
     f = QgsFeature( *mVectorLayerCache->mCache[*mFeatureIdIterator]->feature() );
@@ -68,9 +86,48 @@ bool QgsCachedFeatureIterator::fetchFeature( QgsFeature& f )
   return false;
 }
 
+bool QgsCachedFeatureIterator::fetchStoredFeature( QgsFeature& f )
+{
+  const QgsColumnarFeatureStore* store = mVectorLayerCache->mFeatureStore;
+
+  // only build what the request needs
+  bool fetchGeometry = !( mRequest.flags() & QgsFeatureRequest::NoGeometry ) || mRequest.filterType() == QgsFeatureRequest::FilterRect;
+  const QgsAttributeList* attributes = 0;
+  if (( mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes ) && mRequest.filterType() != QgsFeatureRequest::FilterExpression )
+    attributes = &mRequest.subsetOfAttributes();
+
+  if ( mAllRows )
+  {
+    while ( mRow < store->count() )
+    {
+      store->featureAt( mRow++, f, fetchGeometry, attributes );
+      if ( mRequest.acceptFeature( f ) )
+        return true;
+    }
+  }
+  else
+  {
+    while ( mFeatureIdIterator != mFeatureIds.constEnd() )
+    {
+      int row = store->row( *mFeatureIdIterator );
+      ++mFeatureIdIterator;
+      if ( row < 0 )
+        continue;
+
+      store->featureAt( row, f, fetchGeometry, attributes );
+      if ( mRequest.acceptFeature( f ) )
+        return true;
+    }
+  }
+
+  close();
+  return false;
+}
+
 bool QgsCachedFeatureIterator::rewind()
 {
   mFeatureIdIterator = mFeatureIds.constBegin();
+  mRow = 0;
   return true;
 }
 
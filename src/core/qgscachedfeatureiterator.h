@@ -85,9 +85,19 @@ class CORE_EXPORT QgsCachedFeatureIterator : public QgsAbstractFeatureIterator
     virtual bool nextFeatureFilterFids( QgsFeature& f ) { return fetchFeature( f ); }
 
   private:
+    //! fetch next feature from the columnar storage of a full cache
+    bool fetchStoredFeature( QgsFeature& f );
+
     QgsFeatureIds mFeatureIds;
     QgsVectorLayerCache* mVectorLayerCache;
     QgsFeatureIds::ConstIterator mFeatureIdIterator;
+
+    //! whether features come from the columnar storage
+    bool mUseFeatureStore;
+    //! whether all stored features are returned (in storage order)
+    bool mAllRows;
+    //! next row of the storage
+    int mRow;
 };
 
 /**
@@ -0,0 +1,562 @@
+/***************************************************************************
+    qgscolumnarfeaturestore.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgscolumnarfeaturestore.h"
+#include "qgsgeometry.h"
+
+// geometries are appended to a chunk until it reaches this size
+static const int sWkbChunkSize = 64 * 1024 * 1024;
+
+QgsColumnarFeatureStore::QgsColumnarFeatureStore()
+    : mWkbUnused( 0 )
+{
+}
+
+void QgsColumnarFeatureStore::reset( const QgsFields& fields, const QgsAttributeList& attributes )
+{
+  mFields = fields;
+  mColumns = QVector<Column>( fields.count() );
+
+  foreach ( int idx, attributes )
+  {
+    if ( !fields.exists( idx ) )
+      continue;
+
+    Column& column = mColumns[idx];
+    column.type = fields[idx].type();
+    switch ( column.type )
+    {
+      case QVariant::Int:
+        column.storage = Column::Int;
+        break;
+      case QVariant::LongLong:
+        column.storage = Column::LongLong;
+        break;
+      case QVariant::Double:
+        column.storage = Column::Double;
+        break;
+      case QVariant::String:
+        column.storage = Column::String;
+        break;
+      default:
+        column.storage = Column::Variant;
+        break;
+    }
+  }
+
+  clear();
+}
+
+void QgsColumnarFeatureStore::clear()
+{
+  for ( int i = 0; i < mColumns.size(); ++i )
+  {
+    Column& column = mColumns[i];
+    column.ints.clear();
+    column.longLongs.clear();
+    column.doubles.clear();
+    column.strings.clear();
+    column.variants.clear();
+    column.nulls.clear();
+  }
+
+  mFids.clear();
+  mRows.clear();
+
+  mWkbChunks.clear();
+  mWkbChunk.clear();
+  mWkbOffset.clear();
+  mWkbSize.clear();
+  mWkbUnused = 0;
+}
+
+void QgsColumnarFeatureStore::reserve( int count )
+{
+  mFids.reserve( count );
+  mRows.reserve( count );
+  mWkbChunk.reserve( count );
+  mWkbOffset.reserve( count );
+  mWkbSize.reserve( count );
+
+  for ( int i = 0; i < mColumns.size(); ++i )
+  {
+    Column& column = mColumns[i];
+    switch ( column.storage )
+    {
+      case Column::NotStored:
+        break;
+      case Column::Int:
+        column.ints.reserve( count );
+        break;
+      case Column::LongLong:
+        column.longLongs.reserve( count );
+        break;
+      case Column::Double:
+        column.doubles.reserve( count );
+        break;
+      case Column::String:
+        column.strings.reserve( count );
+        break;
+      case Column::Variant:
+        column.variants.reserve( count );
+        break;
+    }
+  }
+}
+
+QgsFeatureIds QgsColumnarFeatureStore::featureIds() const
+{
+  QgsFeatureIds fids;
+  fids.reserve( mFids.size() );
+  foreach ( QgsFeatureId fid, mFids )
+    fids.insert( fid );
+  return fids;
+}
+
+void QgsColumnarFeatureStore::insert( const QgsFeature& feature )
+{
+  const QgsAttributes& attrs = feature.attributes();
+
+  int row = mRows.value( feature.id(), -1 );
+  if ( row >= 0 )
+  {
+    for ( int i = 0; i < mColumns.size(); ++i )
+      setValue( mColumns[i], row, i < attrs.size() ? attrs[i] : QVariant() );
+    setGeometryAt( row, feature.geometry() );
+    return;
+  }
+
+  row = mFids.size();
+  mFids.append( feature.id() );
+  mRows.insert( feature.id(), row );
+
+  for ( int i = 0; i < mColumns.size(); ++i )
+    appendValue( mColumns[i], i < attrs.size() ? attrs[i] : QVariant() );
+
+  appendGeometry( feature.geometry() );
+}
+
+bool QgsColumnarFeatureStore::remove( QgsFeatureId fid )
+{
+  int row = mRows.value( fid, -1 );
+  if ( row < 0 )
+    return false;
+
+  mRows.remove( fid );
+  mWkbUnused += mWkbSize[row];
+
+  // fill the gap with the last row
+  int last = mFids.size() - 1;
+  if ( row != last )
+  {
+    for ( int i = 0; i < mColumns.size(); ++i )
+      moveValue( mColumns[i], last, row );
+
+    mFids[row] = mFids[last];
+    mRows[mFids[row]] = row;
+
+    mWkbChunk[row] = mWkbChunk[last];
+    mWkbOffset[row] = mWkbOffset[last];
+    mWkbSize[row] = mWkbSize[last];
+  }
+
+  for ( int i = 0; i < mColumns.size(); ++i )
+    truncate( mColumns[i], last );
+
+  mFids.resize( last );
+  mWkbChunk.resize( last );
+  mWkbOffset.resize( last );
+  mWkbSize.resize( last );
+
+  if ( mFids.isEmpty() )
+  {
+    mWkbChunks.clear();
+    mWkbUnused = 0;
+  }
+  else
+  {
+    compactGeometries();
+  }
+
+  return true;
+}
+
+bool QgsColumnarFeatureStore::feature( QgsFeatureId fid, QgsFeature& feature ) const
+{
+  int row = mRows.value( fid, -1 );
+  if ( row < 0 )
+    return false;
+
+  featureAt( row, feature );
+  return true;
+}
+
+void QgsColumnarFeatureStore::featureAt( int row, QgsFeature& feature, bool fetchGeometry, const QgsAttributeList* attributes ) const
+{
+  feature.setFeatureId( mFids[row] );
+  feature.setFields( &mFields );
+  feature.setValid( true );
+
+  QgsAttributes attrs( mColumns.size() );
+  if ( attributes )
+  {
+    foreach ( int idx, *attributes )
+    {
+      if ( idx >= 0 && idx < mColumns.size() )
+        attrs[idx] = value( mColumns[idx], row );
+    }
+  }
+  else
+  {
+    for ( int i = 0; i < mColumns.size(); ++i )
+      attrs[i] = value( mColumns[i], row );
+  }
+  feature.setAttributes( attrs );
+
+  int size = mWkbSize[row];
+  if ( fetchGeometry && size > 0 )
+  {
+    unsigned char* wkb = new unsigned char[size];
+    memcpy( wkb, mWkbChunks[mWkbChunk[row]].constData() + mWkbOffset[row], size );
+    feature.setGeometryAndOwnership( wkb, size );
+  }
+  else
+  {
+    feature.setGeometry( ( QgsGeometry* ) 0 );
+  }
+}
+
+QVariant QgsColumnarFeatureStore::attribute( int row, int field ) const
+{
+  if ( row < 0 || row >= mFids.size() || field < 0 || field >= mColumns.size() )
+    return QVariant();
+
+  return value( mColumns[field], row );
+}
+
+bool QgsColumnarFeatureStore::setAttribute( QgsFeatureId fid, int field, const QVariant& value )
+{
+  int row = mRows.value( fid, -1 );
+  if ( row < 0 || field < 0 || field >= mColumns.size() )
+    return false;
+
+  setValue( mColumns[field], row, value );
+  return true;
+}
+
+bool QgsColumnarFeatureStore::setGeometry( QgsFeatureId fid, const QgsGeometry& geometry )
+{
+  int row = mRows.value( fid, -1 );
+  if ( row < 0 )
+    return false;
+
+  setGeometryAt( row, &geometry );
+  return true;
+}
+
+void QgsColumnarFeatureStore::deleteAttribute( int field )
+{
+  if ( field < 0 || field >= mColumns.size() )
+    return;
+
+  mColumns.remove( field );
+  mFields.remove( field );
+}
+
+qint64 QgsColumnarFeatureStore::memoryUsage() const
+{
+  qint64 bytes = mFids.capacity() * sizeof( QgsFeatureId );
+  // hash node with key, value and next pointer
+  bytes += mRows.size() * ( sizeof( QgsFeatureId ) + sizeof( int ) + 2 * sizeof( void* ) );
+  bytes += ( mWkbChunk.capacity() + mWkbOffset.capacity() + mWkbSize.capacity() ) * sizeof( int );
+
+  foreach ( const QByteArray& chunk, mWkbChunks )
+    bytes += chunk.capacity();
+
+  foreach ( const Column& column, mColumns )
+  {
+    bytes += column.nulls.size() / 8;
+    bytes += column.ints.capacity() * sizeof( int );
+    bytes += column.longLongs.capacity() * sizeof( qlonglong );
+    bytes += column.doubles.capacity() * sizeof( double );
+    bytes += column.variants.capacity() * sizeof( QVariant );
+    bytes += column.strings.capacity() * sizeof( QString );
+    foreach ( const QString& str, column.strings )
+      bytes += str.capacity() * sizeof( QChar );
+  }
+
+  return bytes;
+}
+
+bool QgsColumnarFeatureStore::fits( const Column& column, const QVariant& value )
+{
+  switch ( column.storage )
+  {
+    case Column::Int:
+      return value.type() == QVariant::Int;
+    case Column::LongLong:
+      return value.type() == QVariant::LongLong;
+    case Column::Double:
+      return value.type() == QVariant::Double;
+    case Column::String:
+      return value.type() == QVariant::String;
+    case Column::NotStored:
+    case Column::Variant:
+      break;
+  }
+  return true;
+}
+
+void QgsColumnarFeatureStore::demote( Column& column )
+{
+  // values of unexpected type (e.g. from edits) are kept as they are
+  int stored = 0;
+  switch ( column.storage )
+  {
+    case Column::Int:
+      stored = column.ints.size();
+      break;
+    case Column::LongLong:
+      stored = column.longLongs.size();
+      break;
+    case Column::Double:
+      stored = column.doubles.size();
+      break;
+    case Column::String:
+      stored = column.strings.size();
+      break;
+    case Column::NotStored:
+    case Column::Variant:
+      return;
+  }
+
+  // the row being appended may not have a value yet
+  QVector<QVariant> variants( column.nulls.size() );
+  for ( int i = 0; i < stored; ++i )
+    variants[i] = value( column, i );
+
+  column.ints.clear();
+  column.longLongs.clear();
+  column.doubles.clear();
+  column.strings.clear();
+  column.variants = variants;
+  column.nulls.fill( false );
+  column.storage = Column::Variant;
+}
+
+void QgsColumnarFeatureStore::appendValue( Column& column, const QVariant& value )
+{
+  if ( column.storage == Column::NotStored )
+    return;
+
+  int row = column.nulls.size();
+  column.nulls.resize( row + 1 );
+  setValue( column, row, value );
+}
+
+void QgsColumnarFeatureStore::setValue( Column& column, int row, const QVariant& value )
+{
+  if ( column.storage == Column::NotStored )
+    return;
+
+  // typed storage keeps NULL as a flag, the variant storage as the value itself
+  bool isNull = value.isNull() && column.storage != Column::Variant;
+  if ( !isNull && !fits( column, value ) )
+    demote( column );
+
+  column.nulls.setBit( row, isNull );
+
+  switch ( column.storage )
+  {
+    case Column::Int:
+      if ( row == column.ints.size() )
+        column.ints.append( 0 );
+      column.ints[row] = isNull ? 0 : value.toInt();
+      break;
+    case Column::LongLong:
+      if ( row == column.longLongs.size() )
+        column.longLongs.append( 0 );
+      column.longLongs[row] = isNull ? 0 : value.toLongLong();
+      break;
+    case Column::Double:
+      if ( row == column.doubles.size() )
+        column.doubles.append( 0 );
+      column.doubles[row] = isNull ? 0 : value.toDouble();
+      break;
+    case Column::String:
+      if ( row == column.strings.size() )
+        column.strings.append( QString() );
+      column.strings[row] = isNull ? QString() : value.toString();
+      break;
+    case Column::Variant:
+      if ( row == column.variants.size() )
+        column.variants.append( QVariant() );
+      column.variants[row] = value;
+      break;
+    case Column::NotStored:
+      break;
+  }
+}
+
+QVariant QgsColumnarFeatureStore::value( const Column& column, int row )
+{
+  if ( column.storage == Column::NotStored )
+    return QVariant();
+
+  if ( column.nulls.testBit( row ) )
+    return QVariant( column.type );
+
+  switch ( column.storage )
+  {
+    case Column::Int:
+      return column.ints[row];
+    case Column::LongLong:
+      return column.longLongs[row];
+    case Column::Double:
+      return column.doubles[row];
+    case Column::String:
+      return column.strings[row];
+    case Column::Variant:
+      return column.variants[row];
+    case Column::NotStored:
+      break;
+  }
+  return QVariant();
+}
+
+void QgsColumnarFeatureStore::moveValue( Column& column, int from, int to )
+{
+  if ( column.storage == Column::NotStored )
+    return;
+
+  column.nulls.setBit( to, column.nulls.testBit( from ) );
+
+  switch ( column.storage )
+  {
+    case Column::Int:
+      column.ints[to] = column.ints[from];
+      break;
+    case Column::LongLong:
+      column.longLongs[to] = column.longLongs[from];
+      break;
+    case Column::Double:
+      column.doubles[to] = column.doubles[from];
+      break;
+    case Column::String:
+      column.strings[to] = column.strings[from];
+      break;
+    case Column::Variant:
+      column.variants[to] = column.variants[from];
+      break;
+    case Column::NotStored:
+      break;
+  }
+}
+
+void QgsColumnarFeatureStore::truncate( Column& column, int count )
+{
+  if ( column.storage == Column::NotStored )
+    return;
+
+  column.nulls.truncate( count );
+
+  switch ( column.storage )
+  {
+    case Column::Int:
+      column.ints.resize( count );
+      break;
+    case Column::LongLong:
+      column.longLongs.resize( count );
+      break;
+    case Column::Double:
+      column.doubles.resize( count );
+      break;
+    case Column::String:
+      column.strings.resize( count );
+      break;
+    case Column::Variant:
+      column.variants.resize( count );
+      break;
+    case Column::NotStored:
+      break;
+  }
+}
+
+void QgsColumnarFeatureStore::appendGeometry( const QgsGeometry* geometry )
+{
+  mWkbChunk.append( 0 );
+  mWkbOffset.append( 0 );
+  mWkbSize.append( 0 );
+  setGeometryAt( mWkbSize.size() - 1, geometry );
+}
+
+void QgsColumnarFeatureStore::setGeometryAt( int row, const QgsGeometry* geometry )
+{
+  // the old WKB stays in its chunk until the next compaction
+  mWkbUnused += mWkbSize[row];
+  mWkbChunk[row] = 0;
+  mWkbOffset[row] = 0;
+  mWkbSize[row] = 0;
+
+  if ( geometry && geometry->wkbSize() > 0 )
+  {
+    const unsigned char* wkb = geometry->asWkb();
+    int size = geometry->wkbSize();
+
+    if ( mWkbChunks.isEmpty() || ( !mWkbChunks.last().isEmpty() && mWkbChunks.last().size() + size > sWkbChunkSize ) )
+      mWkbChunks.append( QByteArray() );
+
+    QByteArray& chunk = mWkbChunks.last();
+    mWkbChunk[row] = mWkbChunks.size() - 1;
+    mWkbOffset[row] = chunk.size();
+    mWkbSize[row] = size;
+    chunk.append(( const char* ) wkb, size );
+  }
+
+  compactGeometries();
+}
+
+void QgsColumnarFeatureStore::compactGeometries()
+{
+  // only worth it once most of the memory is unused
+  if ( mWkbUnused < 1024 * 1024 )
+    return;
+
+  qint64 total = 0;
+  foreach ( const QByteArray& chunk, mWkbChunks )
+    total += chunk.size();
+
+  if ( mWkbUnused * 2 < total )
+    return;
+
+  QList<QByteArray> chunks;
+  for ( int row = 0; row < mWkbSize.size(); ++row )
+  {
+    int size = mWkbSize[row];
+    if ( size == 0 )
+      continue;
+
+    if ( chunks.isEmpty() || ( !chunks.last().isEmpty() && chunks.last().size() + size > sWkbChunkSize ) )
+      chunks.append( QByteArray() );
+
+    QByteArray& chunk = chunks.last();
+    chunk.append( mWkbChunks[mWkbChunk[row]].constData() + mWkbOffset[row], size );
+    mWkbChunk[row] = chunks.size() - 1;
+    mWkbOffset[row] = chunk.size() - size;
+  }
+
+  mWkbChunks = chunks;
+  mWkbUnused = 0;
+}
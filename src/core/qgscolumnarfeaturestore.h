@@ -0,0 +1,165 @@
+/***************************************************************************
+    qgscolumnarfeaturestore.h
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSCOLUMNARFEATURESTORE_H
+#define QGSCOLUMNARFEATURESTORE_H
+
+#include "qgsfeature.h"
+#include "qgsfield.h"
+
+#include <QBitArray>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+/** \ingroup core
+ * Compact in-memory storage of features with the same fields.
+ *
+ * Attributes are kept in typed arrays per field and geometries as WKB in a few
+ * large contiguous buffers, features are addressed by row or by feature id. Compared
+ * to a list of QgsFeature objects this needs a fraction of the memory and scans
+ * of a single field only touch the memory of that field.
+ *
+ * Rows are not stable: removing a feature moves the last row in its place.
+ *
+ * @note added in 2.4
+ * @note not available in python bindings
+ */
+class CORE_EXPORT QgsColumnarFeatureStore
+{
+  public:
+    QgsColumnarFeatureStore();
+
+    /**
+     * Removes all features and sets up the columns.
+     *
+     * @param fields     The fields of the stored features
+     * @param attributes The attributes to store, other attributes are returned as invalid values
+     */
+    void reset( const QgsFields& fields, const QgsAttributeList& attributes );
+
+    /** Removes all features, keeps the columns */
+    void clear();
+
+    /** Reserves memory for the given number of features */
+    void reserve( int count );
+
+    /** Returns the number of stored features */
+    int count() const { return mFids.size(); }
+
+    /** Returns the row of the feature or -1 if it is not stored */
+    int row( QgsFeatureId fid ) const { return mRows.value( fid, -1 ); }
+
+    /** Returns the feature id of the row */
+    QgsFeatureId featureId( int row ) const { return mFids[row]; }
+
+    bool contains( QgsFeatureId fid ) const { return mRows.contains( fid ); }
+
+    /** Returns ids of all stored features */
+    QgsFeatureIds featureIds() const;
+
+    /** Adds the feature or replaces the stored feature with the same id */
+    void insert( const QgsFeature& feature );
+
+    /** Removes the feature, returns false if it is not stored */
+    bool remove( QgsFeatureId fid );
+
+    /** Reads the feature with the given id, returns false if it is not stored */
+    bool feature( QgsFeatureId fid, QgsFeature& feature ) const;
+
+    /**
+     * Reads the feature of a row.
+     *
+     * @param row           The row to read
+     * @param feature       The feature to fill
+     * @param fetchGeometry Whether the geometry is needed
+     * @param attributes    The attributes to read or NULL to read all stored attributes
+     */
+    void featureAt( int row, QgsFeature& feature, bool fetchGeometry = true, const QgsAttributeList* attributes = 0 ) const;
+
+    /** Returns a stored attribute value without building the feature */
+    QVariant attribute( int row, int field ) const;
+
+    /** Changes an attribute of a stored feature */
+    bool setAttribute( QgsFeatureId fid, int field, const QVariant& value );
+
+    /** Changes the geometry of a stored feature */
+    bool setGeometry( QgsFeatureId fid, const QgsGeometry& geometry );
+
+    /** Removes a field, the following fields move one position forward */
+    void deleteAttribute( int field );
+
+    /** Returns the approximate number of bytes used by the stored features */
+    qint64 memoryUsage() const;
+
+  private:
+    struct Column
+    {
+      //! how values are stored
+      enum Storage
+      {
+        NotStored,
+        Int,
+        LongLong,
+        Double,
+        String,
+        Variant
+      };
+
+      Column() : storage( NotStored ), type( QVariant::Invalid ) {}
+
+      Storage storage;
+      //! type of NULL values
+      QVariant::Type type;
+      QVector<int> ints;
+      QVector<qlonglong> longLongs;
+      QVector<double> doubles;
+      QVector<QString> strings;
+      QVector<QVariant> variants;
+      QBitArray nulls;
+    };
+
+    static bool fits( const Column& column, const QVariant& value );
+    static void demote( Column& column );
+    static void appendValue( Column& column, const QVariant& value );
+    static void setValue( Column& column, int row, const QVariant& value );
+    static QVariant value( const Column& column, int row );
+    static void moveValue( Column& column, int from, int to );
+    static void truncate( Column& column, int count );
+
+    void appendGeometry( const QgsGeometry* geometry );
+    void setGeometryAt( int row, const QgsGeometry* geometry );
+    void compactGeometries();
+
+    QgsFields mFields;
+    QVector<Column> mColumns;
+
+    QVector<QgsFeatureId> mFids;
+    QHash<QgsFeatureId, int> mRows;
+
+    //! WKB of all geometries, split in chunks to stay within QByteArray limits
+    QList<QByteArray> mWkbChunks;
+    //! chunk of the geometry of each row
+    QVector<int> mWkbChunk;
+    //! offset of the geometry of each row in its chunk
+    QVector<int> mWkbOffset;
+    //! size of the geometry of each row, 0 if there is no geometry
+    QVector<int> mWkbSize;
+    //! bytes in the chunks not used by any row
+    qint64 mWkbUnused;
+};
+
+#endif // QGSCOLUMNARFEATURESTORE_H
@@ -24,8 +24,15 @@
 #include <QDomNode>
 #include <QDomElement>
 #include <QApplication>
+#include <QHash>
+#include <QMutex>
 #include <QPolygonF>
+#include <QRunnable>
+#include <QSemaphore>
 #include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
 #include <QVector>
 
 extern "C"
@@ -37,6 +44,11 @@ extern "C"
 // if defined shows all information about transform to stdout
 // #define COORDINATE_TRANSFORM_VERBOSE
 
+// PROJ contexts, which allow to use PROJ from several threads, are available since 4.8
+#if defined(PJ_VERSION) && PJ_VERSION >= 480
+#define HAVE_PJ_CONTEXT
+#endif
+
 QgsCoordinateTransform::QgsCoordinateTransform()
     : QObject()
     , mInitialisedFlag( false )
@@ -209,6 +221,8 @@ void QgsCoordinateTransform::initialise()
 
   mSourceProjection = pj_init_plus( sourceProjString.toUtf8() );
   mDestinationProjection = pj_init_plus( destProjString.toUtf8() );
+  mSourceProjString = sourceProjString;
+  mDestinationProjString = destProjString;
 
 #ifdef COORDINATE_TRANSFORM_VERBOSE
   QgsDebugMsg( "From proj : " + mSourceCRS.toProj4() );
@@ -391,7 +405,7 @@ void QgsCoordinateTransform::transformPolygon( QPolygonF& poly, TransformDirecti
 
   try
   {
-    transformCoords( nVertices, x.data(), y.data(), z.data(), direction );
+    transformCoordsBatch( nVertices, x.data(), y.data(), z.data(), direction );
   }
   catch ( const QgsCsException & )
   {
@@ -424,7 +438,7 @@ void QgsCoordinateTransform::transformInPlace(
 
   try
   {
-    transformCoords( x.size(), &x[0], &y[0], &z[0], direction );
+    transformCoordsBatch( x.size(), x.data(), y.data(), z.data(), direction );
   }
   catch ( const QgsCsException & )
   {
@@ -712,6 +726,207 @@ void QgsCoordinateTransform::transformCoords( const int& numPoints, double *x, d
 #endif
 }
 
+// Batch transforms
+//
+// Every thread doing batch transforms keeps its own PROJ context and the projections
+// it has created for it, keyed by their definition. Transforms with identical
+// definitions - including datum shift grids - therefore share the projections of a
+// thread, the grid files themselves are loaded only once by PROJ for all contexts.
+
+#ifdef HAVE_PJ_CONTEXT
+
+//! minimum number of points transformed by a thread
+static const int sMinimumBatchChunkSize = 4096;
+
+class QgsProjThreadContext
+{
+  public:
+    QgsProjThreadContext() : mContext( pj_ctx_alloc() ) {}
+
+    ~QgsProjThreadContext()
+    {
+      clear();
+      pj_ctx_free( mContext );
+    }
+
+    projPJ projection( const QString& definition )
+    {
+      QHash<QString, projPJ>::const_iterator it = mProjections.constFind( definition );
+      if ( it != mProjections.constEnd() )
+        return it.value();
+
+      // keep the cache small, a thread rarely uses more than a few transforms
+      if ( mProjections.size() >= 32 )
+        clear();
+
+      projPJ pj = pj_init_plus_ctx( mContext, definition.toUtf8() );
+      if ( pj )
+        mProjections.insert( definition, pj );
+      return pj;
+    }
+
+    int errorNumber() const { return pj_ctx_get_errno( mContext ); }
+
+  private:
+    void clear()
+    {
+      foreach ( projPJ pj, mProjections )
+        pj_free( pj );
+      mProjections.clear();
+    }
+
+    projCtx mContext;
+    QHash<QString, projPJ> mProjections;
+};
+
+static QThreadStorage<QgsProjThreadContext*> sProjThreadContexts;
+
+//! threads of batch transforms, separate from the global pool whose threads may wait for batches
+Q_GLOBAL_STATIC( QThreadPool, transformThreadPool )
+
+struct QgsTransformChunk
+{
+  QString sourceDefinition;
+  QString destDefinition;
+  int numPoints;
+  double* x;
+  double* y;
+  double* z;
+  //! PROJ error number, 0 on success
+  int result;
+};
+
+static void transformChunk( QgsTransformChunk& chunk )
+{
+  if ( !sProjThreadContexts.hasLocalData() )
+    sProjThreadContexts.setLocalData( new QgsProjThreadContext() );
+  QgsProjThreadContext* context = sProjThreadContexts.localData();
+
+  projPJ source = context->projection( chunk.sourceDefinition );
+  projPJ dest = context->projection( chunk.destDefinition );
+  if ( !source || !dest )
+  {
+    chunk.result = context->errorNumber() != 0 ? context->errorNumber() : -1;
+    return;
+  }
+
+  // convert lat/long to radians and back as transformCoords() does
+  if ( pj_is_latlong( source ) )
+  {
+    for ( int i = 0; i < chunk.numPoints; ++i )
+    {
+      chunk.x[i] *= DEG_TO_RAD;
+      chunk.y[i] *= DEG_TO_RAD;
+      chunk.z[i] *= DEG_TO_RAD;
+    }
+  }
+
+  chunk.result = pj_transform( source, dest, chunk.numPoints, 0, chunk.x, chunk.y, chunk.z );
+
+  if ( chunk.result == 0 && pj_is_latlong( dest ) )
+  {
+    for ( int i = 0; i < chunk.numPoints; ++i )
+    {
+      chunk.x[i] *= RAD_TO_DEG;
+      chunk.y[i] *= RAD_TO_DEG;
+      chunk.z[i] *= RAD_TO_DEG;
+    }
+  }
+}
+
+class QgsTransformChunkRunnable : public QRunnable
+{
+  public:
+    QgsTransformChunkRunnable( QgsTransformChunk& chunk, QSemaphore& done )
+        : mChunk( chunk )
+        , mDone( done )
+    {}
+
+    void run()
+    {
+      transformChunk( mChunk );
+      mDone.release();
+    }
+
+  private:
+    QgsTransformChunk& mChunk;
+    QSemaphore& mDone;
+};
+
+#else
+
+//! without contexts PROJ calls must not run concurrently
+Q_GLOBAL_STATIC( QMutex, transformMutex )
+
+#endif // HAVE_PJ_CONTEXT
+
+void QgsCoordinateTransform::transformCoordsBatch( int numPoints, double *x, double *y, double *z, TransformDirection direction ) const
+{
+  if ( mShortCircuit || !mInitialisedFlag || numPoints <= 0 )
+    return;
+
+#ifdef HAVE_PJ_CONTEXT
+  int numChunks = qBound( 1, numPoints / sMinimumBatchChunkSize, QThread::idealThreadCount() );
+  int chunkSize = numPoints / numChunks;
+
+  QVector<QgsTransformChunk> chunks( numChunks );
+  for ( int i = 0; i < numChunks; ++i )
+  {
+    QgsTransformChunk& chunk = chunks[i];
+    chunk.sourceDefinition = direction == ForwardTransform ? mSourceProjString : mDestinationProjString;
+    chunk.destDefinition = direction == ForwardTransform ? mDestinationProjString : mSourceProjString;
+    chunk.numPoints = i == numChunks - 1 ? numPoints - i * chunkSize : chunkSize;
+    chunk.x = x + i * chunkSize;
+    chunk.y = y + i * chunkSize;
+    chunk.z = z + i * chunkSize;
+    chunk.result = 0;
+  }
+
+  // the calling thread transforms the first chunk itself
+  QSemaphore done;
+  for ( int i = 1; i < numChunks; ++i )
+  {
+    transformThreadPool()->start( new QgsTransformChunkRunnable( chunks[i], done ) );
+  }
+  transformChunk( chunks[0] );
+  done.acquire( numChunks - 1 );
+
+  int projResult = 0;
+  foreach ( const QgsTransformChunk& chunk, chunks )
+  {
+    if ( chunk.result != 0 )
+    {
+      projResult = chunk.result;
+      break;
+    }
+  }
+
+  if ( projResult != 0 )
+  {
+    QString dir = ( direction == ForwardTransform ) ? tr( "forward transform" ) : tr( "inverse transform" );
+
+    QString msg = tr( "%1 of %2 points\n"
+                      "PROJ.4: %3 +to %4\n"
+                      "Error: %5" )
+                  .arg( dir )
+                  .arg( numPoints )
+                  .arg( mSourceCRS.toProj4() ).arg( mDestCRS.toProj4() )
+                  .arg( QString::fromUtf8( pj_strerrno( projResult ) ) );
+
+    QgsDebugMsg( "Projection failed emitting invalid transform signal: " + msg );
+
+    emit invalidTransformInput();
+
+    QgsDebugMsg( "throwing exception" );
+
+    throw QgsCsException( msg );
+  }
+#else
+  QMutexLocker locker( transformMutex() );
+  transformCoords( numPoints, x, y, z, direction );
+#endif
+}
+
 bool QgsCoordinateTransform::readXML( QDomNode & theNode )
 {
 
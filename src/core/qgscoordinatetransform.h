@@ -194,6 +194,19 @@ class CORE_EXPORT QgsCoordinateTransform : public QObject
      */
     void transformCoords( const int &numPoint, double *x, double *y, double *z, TransformDirection direction = ForwardTransform ) const;
 
+    /*! Transform a large array of coordinates to a different Coordinate System.
+     * The arrays are split into chunks which are transformed in parallel by a pool
+     * of worker threads, each with its own PROJ context. Unlike transformCoords()
+     * this method may be called from several threads at the same time.
+     * @param numPoints number of coordinates in arrays
+     * @param x array of x coordinates to transform
+     * @param y array of y coordinates to transform
+     * @param z array of z coordinates to transform
+     * @param direction TransformDirection (defaults to ForwardTransform)
+     * @note added in 2.4
+     */
+    void transformCoordsBatch( int numPoints, double *x, double *y, double *z, TransformDirection direction = ForwardTransform ) const;
+
     /*!
      * Flag to indicate whether the coordinate systems have been initialised
      * @return true if initialised, otherwise false
@@ -284,6 +297,13 @@ class CORE_EXPORT QgsCoordinateTransform : public QObject
      */
     projPJ mDestinationProjection;
 
+    /*!
+     * Proj4 definitions of the source and destination projections, used to set up
+     * the projections of the threads doing batch transforms
+     */
+    QString mSourceProjString;
+    QString mDestinationProjString;
+
     int mSourceDatumTransform;
     int mDestinationDatumTransform;
 
@@ -26,6 +26,7 @@
 #include "qgscoordinatereferencesystem.h"
 #include "qgsgeometry.h"
 #include "qgsdistancearea.h"
+#include "qgswkbview.h"
 #include "qgsapplication.h"
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
@@ -260,68 +261,34 @@ double QgsDistanceArea::measure( QgsGeometry* geometry )
   if ( !geometry )
     return 0.0;
 
-  const unsigned char* wkb = geometry->asWkb();
-  if ( !wkb )
+  QgsWkbView wkbView( geometry );
+  if ( !wkbView.isValid() )
     return 0.0;
 
-  QgsConstWkbPtr wkbPtr( wkb + 1 );
-
-  QGis::WkbType wkbType;
-  wkbPtr >> wkbType;
-
   double res, resTotal = 0;
-  int count, i;
 
   // measure distance or area based on what is the type of geometry
-  bool hasZptr = false;
-
-  switch ( wkbType )
-  {
-    case QGis::WKBLineString25D:
-      hasZptr = true;
-    case QGis::WKBLineString:
-      measureLine( wkb, &res, hasZptr );
-      QgsDebugMsg( "returning " + QString::number( res ) );
-      return res;
-
-    case QGis::WKBMultiLineString25D:
-      hasZptr = true;
-    case QGis::WKBMultiLineString:
-      wkbPtr >> count;
-      for ( i = 0; i < count; i++ )
+  switch ( wkbView.type() )
+  {
+    case QGis::Line:
+      for ( QgsWkbView::const_iterator partIt = wkbView.begin(); partIt != wkbView.end(); ++partIt )
       {
-        wkbPtr = measureLine( wkbPtr, &res, hasZptr );
-        resTotal += res;
+        resTotal += measureLine(( *partIt ).ring() );
       }
       QgsDebugMsg( "returning " + QString::number( resTotal ) );
       return resTotal;
 
-    case QGis::WKBPolygon25D:
-      hasZptr = true;
-    case QGis::WKBPolygon:
-      measurePolygon( wkb, &res, 0, hasZptr );
-      QgsDebugMsg( "returning " + QString::number( res ) );
-      return res;
-
-    case QGis::WKBMultiPolygon25D:
-      hasZptr = true;
-    case QGis::WKBMultiPolygon:
-      wkbPtr >> count;
-      for ( i = 0; i < count; i++ )
+    case QGis::Polygon:
+      for ( QgsWkbView::const_iterator partIt = wkbView.begin(); partIt != wkbView.end(); ++partIt )
       {
-        wkbPtr = measurePolygon( wkbPtr, &res, 0, hasZptr );
-        if ( !wkbPtr )
-        {
-          QgsDebugMsg( "measurePolygon returned 0" );
-          break;
-        }
+        measurePolygon( *partIt, &res, 0 );
         resTotal += res;
       }
       QgsDebugMsg( "returning " + QString::number( resTotal ) );
       return resTotal;
 
     default:
-      QgsDebugMsg( QString( "measure: unexpected geometry type: %1" ).arg( wkbType ) );
+      QgsDebugMsg( QString( "measure: unexpected geometry type: %1" ).arg( wkbView.wkbType() ) );
       return 0;
   }
 }
@@ -331,54 +298,28 @@ double QgsDistanceArea::measurePerimeter( QgsGeometry* geometry )
   if ( !geometry )
     return 0.0;
 
-  const unsigned char* wkb = geometry->asWkb();
-  if ( !wkb )
+  QgsWkbView wkbView( geometry );
+  if ( !wkbView.isValid() )
     return 0.0;
 
-  QgsConstWkbPtr wkbPtr( wkb + 1 );
-  QGis::WkbType wkbType;
-  wkbPtr >> wkbType;
-
   double res = 0.0, resTotal = 0.0;
-  int count, i;
 
-  // measure distance or area based on what is the type of geometry
-  bool hasZptr = false;
-
-  switch ( wkbType )
+  switch ( wkbView.type() )
   {
-    case QGis::WKBLineString25D:
-    case QGis::WKBLineString:
-    case QGis::WKBMultiLineString25D:
-    case QGis::WKBMultiLineString:
+    case QGis::Line:
       return 0.0;
 
-    case QGis::WKBPolygon25D:
-      hasZptr = true;
-    case QGis::WKBPolygon:
-      measurePolygon( wkb, 0, &res, hasZptr );
-      QgsDebugMsg( "returning " + QString::number( res ) );
-      return res;
-
-    case QGis::WKBMultiPolygon25D:
-      hasZptr = true;
-    case QGis::WKBMultiPolygon:
-      wkbPtr >> count;
-      for ( i = 0; i < count; i++ )
+    case QGis::Polygon:
+      for ( QgsWkbView::const_iterator partIt = wkbView.begin(); partIt != wkbView.end(); ++partIt )
       {
-        wkbPtr = measurePolygon( wkbPtr, 0, &res, hasZptr );
-        if ( !wkbPtr )
-        {
-          QgsDebugMsg( "measurePolygon returned 0" );
-          break;
-        }
+        measurePolygon( *partIt, 0, &res );
         resTotal += res;
       }
       QgsDebugMsg( "returning " + QString::number( resTotal ) );
       return resTotal;
 
     default:
-      QgsDebugMsg( QString( "measure: unexpected geometry type: %1" ).arg( wkbType ) );
+      QgsDebugMsg( QString( "measure: unexpected geometry type: %1" ).arg( wkbView.wkbType() ) );
       return 0;
   }
 }
@@ -386,29 +327,53 @@ double QgsDistanceArea::measurePerimeter( QgsGeometry* geometry )
 
 const unsigned char* QgsDistanceArea::measureLine( const unsigned char* feature, double* area, bool hasZptr )
 {
-  QgsConstWkbPtr wkbPtr( feature + 1 + sizeof( int ) );
-  int nPoints;
-  wkbPtr >> nPoints;
+  Q_UNUSED( hasZptr );
 
-  QList<QgsPoint> points;
-  double x, y;
+  QgsWkbPart line( feature );
+  *area = measureLine( line.ring() );
+  return line.wkbEnd();
+}
 
-  QgsDebugMsg( "This feature WKB has " + QString::number( nPoints ) + " points" );
-  // Extract the points from the WKB format into the vector
-  for ( int i = 0; i < nPoints; ++i )
+double QgsDistanceArea::measureLine( const QgsWkbRing& ring )
+{
+  if ( ring.vertexCount() < 2 )
+    return 0;
+
+  double total = 0;
+  QgsPoint p1, p2;
+
+  try
   {
-    wkbPtr >> x >> y;
-    if ( hasZptr )
+    QgsWkbRing::const_iterator it = ring.begin();
+    if ( mEllipsoidalMode && ( mEllipsoid != GEO_NONE ) )
+      p1 = mCoordTransform->transform( *it );
+    else
+      p1 = *it;
+
+    for ( ++it; it != ring.end(); ++it )
     {
-      // totally ignore Z value
-      wkbPtr += sizeof( double );
+      if ( mEllipsoidalMode && ( mEllipsoid != GEO_NONE ) )
+      {
+        p2 = mCoordTransform->transform( *it );
+        total += computeDistanceBearing( p1, p2 );
+      }
+      else
+      {
+        p2 = *it;
+        total += measureLine( p1, p2 );
+      }
+
+      p1 = p2;
     }
 
-    points.append( QgsPoint( x, y ) );
+    return total;
+  }
+  catch ( QgsCsException &cse )
+  {
+    Q_UNUSED( cse );
+    QgsMessageLog::logMessage( QObject::tr( "Caught a coordinate system exception while trying to transform a point. Unable to calculate line length." ) );
+    return 0.0;
   }
-
-  *area = measureLine( points );
-  return wkbPtr;
 }
 
 double QgsDistanceArea::measureLine( const QList<QgsPoint> &points )
@@ -491,28 +456,27 @@ double QgsDistanceArea::measureLine( const QgsPoint &p1, const QgsPoint &p2 )
 
 const unsigned char *QgsDistanceArea::measurePolygon( const unsigned char* feature, double* area, double* perimeter, bool hasZptr )
 {
+  Q_UNUSED( hasZptr );
+
   if ( !feature )
   {
     QgsDebugMsg( "no feature to measure" );
     return 0;
   }
 
-  QgsConstWkbPtr wkbPtr( feature + 1 + sizeof( int ) );
-
-  // get number of rings in the polygon
-  int numRings;
-  wkbPtr >> numRings;
-
-  if ( numRings == 0 )
+  QgsWkbPart polygon( feature );
+  if ( polygon.ringCount() == 0 )
   {
     QgsDebugMsg( "no rings to measure" );
     return 0;
   }
 
-  // Set pointer to the first ring
-  QList<QgsPoint> points;
-  QgsPoint pnt;
-  double x, y;
+  measurePolygon( polygon, area, perimeter );
+  return polygon.wkbEnd();
+}
+
+void QgsDistanceArea::measurePolygon( const QgsWkbPart& polygon, double* area, double* perimeter )
+{
   if ( area )
     *area = 0;
   if ( perimeter )
@@ -520,58 +484,31 @@ const unsigned char *QgsDistanceArea::measurePolygon( const unsigned char* featu
 
   try
   {
-    for ( int idx = 0; idx < numRings; idx++ )
+    for ( QgsWkbPart::const_iterator ringIt = polygon.begin(); ringIt != polygon.end(); ++ringIt )
     {
-      int nPoints;
-      wkbPtr >> nPoints;
+      QgsWkbRing ring = *ringIt;
+      if ( ring.vertexCount() <= 2 )
+        continue;
 
-      // Extract the points from the WKB and store in a pair of
-      // vectors.
-      for ( int jdx = 0; jdx < nPoints; jdx++ )
+      if ( area )
       {
-        wkbPtr >> x >> y;
-        if ( hasZptr )
+        double areaTmp = computeRingArea( ring );
+        if ( ringIt.index() == 0 )
         {
-          // totally ignore Z value
-          wkbPtr += sizeof( double );
+          // exterior ring
+          *area += areaTmp;
         }
-
-        pnt = QgsPoint( x, y );
-
-        if ( mEllipsoidalMode && ( mEllipsoid != GEO_NONE ) )
+        else
         {
-          pnt = mCoordTransform->transform( pnt );
+          *area -= areaTmp; // interior rings
         }
-        points.append( pnt );
       }
 
-      if ( points.size() > 2 )
+      if ( perimeter && ringIt.index() == 0 )
       {
-        if ( area )
-        {
-          double areaTmp = computePolygonArea( points );
-          if ( idx == 0 )
-          {
-            // exterior ring
-            *area += areaTmp;
-          }
-          else
-          {
-            *area -= areaTmp; // interior rings
-          }
-        }
-
-        if ( perimeter )
-        {
-          if ( idx == 0 )
-          {
-            // exterior ring
-            *perimeter += measureLine( points );
-          }
-        }
+        // exterior ring
+        *perimeter += measureLine( ring );
       }
-
-      points.clear();
     }
   }
   catch ( QgsCsException &cse )
@@ -579,8 +516,6 @@ const unsigned char *QgsDistanceArea::measurePolygon( const unsigned char* featu
     Q_UNUSED( cse );
     QgsMessageLog::logMessage( QObject::tr( "Caught a coordinate system exception while trying to transform a point. Unable to calculate polygon area or perimeter." ) );
   }
-
-  return wkbPtr;
 }
 
 
@@ -773,7 +708,7 @@ void QgsDistanceArea::computeAreaInit()
 
 double QgsDistanceArea::computePolygonArea( const QList<QgsPoint>& points )
 {
-  double x1, y1, x2, y2, dx, dy;
+  double x1, y1, x2, y2;
   double Qbar1, Qbar2;
   double area;
 
@@ -799,19 +734,34 @@ double QgsDistanceArea::computePolygonArea( const QList<QgsPoint>& points )
     y2 = DEG2RAD( points[i].y() );
     Qbar2 = getQbar( y2 );
 
-    if ( x1 > x2 )
-      while ( x1 - x2 > M_PI )
-        x2 += m_TwoPI;
-    else if ( x2 > x1 )
-      while ( x2 - x1 > M_PI )
-        x1 += m_TwoPI;
+    addEllipsoidalAreaEdge( x1, y1, Qbar1, x2, y2, Qbar2, area );
+  }
+
+  return ellipsoidalArea( area );
+}
 
-    dx = x2 - x1;
-    area += dx * ( m_Qp - getQ( y2 ) );
+void QgsDistanceArea::addEllipsoidalAreaEdge( double x1, double y1, double Qbar1, double& x2, double y2, double Qbar2, double& area )
+{
+  double dx, dy;
+
+  if ( x1 > x2 )
+    while ( x1 - x2 > M_PI )
+      x2 += m_TwoPI;
+  else if ( x2 > x1 )
+    while ( x2 - x1 > M_PI )
+      x1 += m_TwoPI;
+
+  dx = x2 - x1;
+  area += dx * ( m_Qp - getQ( y2 ) );
+
+  if (( dy = y2 - y1 ) != 0.0 )
+    area += dx * getQ( y2 ) - ( dx / dy ) * ( Qbar2 - Qbar1 );
+}
+
+double QgsDistanceArea::ellipsoidalArea( double edgeSum )
+{
+  double area = edgeSum;
 
-    if (( dy = y2 - y1 ) != 0.0 )
-      area += dx * getQ( y2 ) - ( dx / dy ) * ( Qbar2 - Qbar1 );
-  }
   if (( area *= m_AE ) < 0.0 )
     area = -area;
 
@@ -828,6 +778,52 @@ double QgsDistanceArea::computePolygonArea( const QList<QgsPoint>& points )
   return area;
 }
 
+double QgsDistanceArea::computeRingArea( const QgsWkbRing& ring )
+{
+  int n = ring.vertexCount();
+  QgsWkbRing::const_iterator begin = ring.begin(), end = ring.end();
+
+  if (( ! mEllipsoidalMode ) || ( mEllipsoid == GEO_NONE ) )
+  {
+    // same as computePolygonFlatArea, without copying the vertices
+    double area = 0.0;
+    for ( QgsWkbRing::const_iterator it = begin; it != end; ++it )
+    {
+      QgsWkbRing::const_iterator next = it + 1;
+      if ( next == end )
+        next = begin;
+      area = area + it.x() * next.y() - next.x() * it.y();
+    }
+    area = area / 2.0;
+    return qAbs( area );
+  }
+
+  double x1, y1, x2, y2;
+  double Qbar1, Qbar2;
+  double area = 0.0;
+
+  QgsPoint p = mCoordTransform->transform( ring.vertex( n - 1 ) );
+  x2 = DEG2RAD( p.x() );
+  y2 = DEG2RAD( p.y() );
+  Qbar2 = getQbar( y2 );
+
+  for ( QgsWkbRing::const_iterator it = begin; it != end; ++it )
+  {
+    x1 = x2;
+    y1 = y2;
+    Qbar1 = Qbar2;
+
+    p = mCoordTransform->transform( *it );
+    x2 = DEG2RAD( p.x() );
+    y2 = DEG2RAD( p.y() );
+    Qbar2 = getQbar( y2 );
+
+    addEllipsoidalAreaEdge( x1, y1, Qbar1, x2, y2, Qbar2, area );
+  }
+
+  return ellipsoidalArea( area );
+}
+
 double QgsDistanceArea::computePolygonFlatArea( const QList<QgsPoint>& points )
 {
   // Normal plane area calculations.
@@ -20,6 +20,8 @@
 #include "qgscoordinatetransform.h"
 
 class QgsGeometry;
+class QgsWkbPart;
+class QgsWkbRing;
 
 /** \ingroup core
 General purpose distance and area calculator.
@@ -98,6 +100,11 @@ class CORE_EXPORT QgsDistanceArea
     //! measures line with one segment
     double measureLine( const QgsPoint& p1, const QgsPoint& p2 );
 
+    /** measures line given as vertices in WKB (the vertices are not copied)
+      @note added in 2.4
+      @note not available in python bindings */
+    double measureLine( const QgsWkbRing& ring );
+
     //! measures polygon area
     double measurePolygon( const QList<QgsPoint>& points );
 
@@ -114,6 +121,8 @@ class CORE_EXPORT QgsDistanceArea
     const unsigned char* measureLine( const unsigned char* feature, double* area, bool hasZptr = false );
     //! measures polygon area and perimeter, vertices are extracted from WKB
     const unsigned char* measurePolygon( const unsigned char* feature, double* area, double* perimeter, bool hasZptr = false );
+    //! measures polygon area and perimeter (of the exterior ring) of a polygon in WKB
+    void measurePolygon( const QgsWkbPart& polygon, double* area, double* perimeter );
 
     /**
       calculates distance from two points on ellipsoid
@@ -138,6 +147,14 @@ class CORE_EXPORT QgsDistanceArea
 
     double computePolygonFlatArea( const QList<QgsPoint>& points );
 
+    //! calculates area of a polygon ring in WKB (on ellipsoid or flat like computePolygonFlatArea)
+    double computeRingArea( const QgsWkbRing& ring );
+
+    //! adds the contribution of the edge from x1, y1 to x2, y2 (radians) to the ellipsoidal polygon area, unwraps x2 relative to x1
+    void addEllipsoidalAreaEdge( double x1, double y1, double Qbar1, double& x2, double y2, double Qbar2, double& area );
+    //! scales the sum of the edge contributions to the ellipsoidal polygon area
+    double ellipsoidalArea( double edgeSum );
+
     /**
       precalculates some values
       (must be called always when changing ellipsoid)
@@ -21,6 +21,8 @@
 #include <QDate>
 #include <QRegExp>
 #include <QColor>
+#include <QSet>
+#include <QVector>
 #include <QUuid>
 
 #include <math.h>
@@ -1704,8 +1706,112 @@ int QgsExpression::functionCount()
 }
 
 
+///////////////////////////////////////////////
+// compiled expressions
+
+/** Flat instruction stream created from the expression tree by QgsExpression::compile().
+ * Intermediate values live on a stack which is reused between evaluations. Whatever
+ * the compiler does not lower itself is delegated to the tree nodes, so the results
+ * and evaluation errors are the same as with the interpreter.
+ */
+class QgsExpression::Program
+{
+  public:
+    Program() : mDepth( 0 ), mMaxDepth( 0 ) {}
+
+    //! lower the tree - the nodes have to stay alive while the program is used
+    bool compile( QgsExpression* parent, Node* root );
+
+    //! evaluate the program for a (non-null) feature
+    QVariant run( QgsExpression* parent, const QgsFeature* f );
+
+  private:
+    enum OpCode
+    {
+      opLiteral,        // push constant
+      opColumn,         // push attribute
+      opNode,           // push result of an interpreted node
+      opUnary,          // apply unary operator node to the top value
+      opBinary,         // apply binary operator node to the two top values
+      opCompareNum,     // push comparison of attribute with a numeric constant
+      opCompareStr,     // push comparison of attribute with a string constant
+      opMatch,          // match top value with precompiled LIKE / ~ pattern
+      opIn,             // look up top value in a literal IN list
+      opAnd,            // combine two top values
+      opOr,             // combine two top values
+      opAndJump,        // jump if top value is false (right operand cannot fail)
+      opOrJump,         // jump if top value is true (right operand cannot fail)
+      opJumpIfNull,     // function argument is NULL: drop arguments, push NULL and jump
+      opCall,           // call function with arguments from the stack
+      opJumpIfNotTrue,  // pop CASE condition, jump unless it is true
+      opJump
+    };
+
+    struct Instruction
+    {
+      OpCode code;
+      int op;        // operator
+      int index;     // column, constant, node, function or lookup table index
+      int extra;     // fallback node, constant index or argument count
+      int target;    // jump target
+      bool swapped;  // constant is the left operand of the comparison
+      double value;  // numeric constant
+    };
+
+    struct Matcher
+    {
+      QRegExp regexp;
+      bool exact;    // LIKE needs full match, ~ any match
+      bool negate;
+    };
+
+    struct InList
+    {
+      QVector<double> numbers;    // items that are double-safe
+      QSet<QString> numberStrings;
+      QSet<QString> strings;      // other items
+      bool hasNull;
+      bool notIn;
+    };
+
+    bool compileNode( QgsExpression* parent, Node* node );
+    bool compileBinary( QgsExpression* parent, NodeBinaryOperator* node );
+    bool compileComparison( QgsExpression* parent, NodeBinaryOperator* node );
+    bool compileIn( QgsExpression* parent, NodeInOperator* node );
+    bool compileFunction( QgsExpression* parent, NodeFunction* node );
+    bool compileCondition( QgsExpression* parent, NodeCondition* node );
+
+    int addInstruction( OpCode code, int stackChange );
+    void emitLiteral( const QVariant& value );
+    void emitNode( Node* node );
+
+    //! evaluate a constant subtree, returns false if it is not constant or fails
+    static bool constantValue( QgsExpression* parent, Node* node, QVariant& value );
+    //! true if the subtree does not depend on the feature or on function calls
+    static bool isConstant( Node* node );
+    //! true if evaluating the subtree may raise an evaluation error
+    static bool canFail( Node* node );
+    //! true if the subtree always evaluates to 0, 1 or NULL
+    static bool isBoolean( Node* node );
+    //! true if the subtree is a boolean that cannot fail, i.e. skipping it cannot hide an evaluation error
+    static bool canSkip( Node* node );
+
+    QVector<Instruction> mCode;
+    QVector<QVariant> mConstants;
+    QVector<Node*> mNodes;
+    QVector<Function*> mFunctions;
+    QVector<Matcher> mMatchers;
+    QVector<InList> mInLists;
+
+    QVector<QVariant> mStack;
+    int mDepth;
+    int mMaxDepth;
+};
+
+
 QgsExpression::QgsExpression( const QString& expr )
-    : mRowNumber( 0 )
+    : mProgram( 0 )
+    , mRowNumber( 0 )
     , mScale( 0 )
     , mExp( expr )
     , mCalc( 0 )
@@ -1719,6 +1825,7 @@ QgsExpression::QgsExpression( const QString& expr )
 QgsExpression::~QgsExpression()
 {
   delete mCalc;
+  delete mProgram;
   delete mRootNode;
 }
 
@@ -1771,6 +1878,11 @@ void QgsExpression::setGeomCalculator( const QgsDistanceArea &calc )
 bool QgsExpression::prepare( const QgsFields& fields )
 {
   mEvalErrorString = QString();
+
+  // column indexes may change - the program has to be compiled again
+  delete mProgram;
+  mProgram = 0;
+
   if ( !mRootNode )
   {
     mEvalErrorString = QObject::tr( "No root node! Parsing failed?" );
@@ -1789,6 +1901,10 @@ QVariant QgsExpression::evaluate( const QgsFeature* f )
     return QVariant();
   }
 
+  // the program reads attributes by index, without feature use the interpreter
+  if ( mProgram && f )
+    return mProgram->run( this, f );
+
   return mRootNode->eval( this, f );
 }
 
@@ -1803,6 +1919,49 @@ QVariant QgsExpression::evaluate( const QgsFeature* f, const QgsFields& fields )
   return evaluate( f );
 }
 
+QVariantList QgsExpression::evaluateBatch( const QgsFeatureList& features )
+{
+  QVariantList results;
+  results.reserve( features.size() );
+
+  QString firstError;
+  for ( QgsFeatureList::const_iterator it = features.constBegin(); it != features.constEnd(); ++it )
+  {
+    results.append( evaluate( &( *it ) ) );
+    if ( hasEvalError() && firstError.isNull() )
+      firstError = mEvalErrorString;
+  }
+
+  mEvalErrorString = firstError;
+  return results;
+}
+
+bool QgsExpression::compile()
+{
+  delete mProgram;
+  mProgram = 0;
+
+  if ( !mRootNode )
+    return false;
+
+  // constant folding evaluates parts of the tree - do not leak errors from there
+  QString savedError = mEvalErrorString;
+
+  Program* program = new Program();
+  bool res = program->compile( this, mRootNode );
+  mEvalErrorString = savedError;
+
+  if ( !res )
+  {
+    QgsDebugMsg( "expression could not be compiled: " + dump() );
+    delete program;
+    return false;
+  }
+
+  mProgram = program;
+  return true;
+}
+
 QString QgsExpression::dump() const
 {
   if ( !mRootNode )
@@ -1914,6 +2073,11 @@ QVariant QgsExpression::NodeUnaryOperator::eval( QgsExpression* parent, const Qg
   QVariant val = mOperand->eval( parent, f );
   ENSURE_NO_EVAL_ERROR;
 
+  return evalValue( parent, val );
+}
+
+QVariant QgsExpression::NodeUnaryOperator::evalValue( QgsExpression* parent, const QVariant& val )
+{
   switch ( mOp )
   {
     case uoNot:
@@ -1956,6 +2120,11 @@ QVariant QgsExpression::NodeBinaryOperator::eval( QgsExpression* parent, const Q
   QVariant vR = mOpRight->eval( parent, f );
   ENSURE_NO_EVAL_ERROR;
 
+  return evalValues( parent, vL, vR );
+}
+
+QVariant QgsExpression::NodeBinaryOperator::evalValues( QgsExpression* parent, const QVariant& vL, const QVariant& vR )
+{
   switch ( mOp )
   {
     case boPlus:
@@ -2121,20 +2290,25 @@ QVariant QgsExpression::NodeBinaryOperator::eval( QgsExpression* parent, const Q
   return QVariant();
 }
 
-bool QgsExpression::NodeBinaryOperator::compare( double diff )
+static bool compareDiff( QgsExpression::BinaryOperator op, double diff )
 {
-  switch ( mOp )
+  switch ( op )
   {
-    case boEQ: return diff == 0;
-    case boNE: return diff != 0;
-    case boLT: return diff < 0;
-    case boGT: return diff > 0;
-    case boLE: return diff <= 0;
-    case boGE: return diff >= 0;
+    case QgsExpression::boEQ: return diff == 0;
+    case QgsExpression::boNE: return diff != 0;
+    case QgsExpression::boLT: return diff < 0;
+    case QgsExpression::boGT: return diff > 0;
+    case QgsExpression::boLE: return diff <= 0;
+    case QgsExpression::boGE: return diff >= 0;
     default: Q_ASSERT( false ); return false;
   }
 }
 
+bool QgsExpression::NodeBinaryOperator::compare( double diff )
+{
+  return compareDiff( mOp, diff );
+}
+
 int QgsExpression::NodeBinaryOperator::computeInt( int x, int y )
 {
   switch ( mOp )
@@ -2526,3 +2700,724 @@ QString QgsExpression::group( QString name )
   //unchanged
   return gGroups.value( name, name );
 }
+
+///////////////////////////////////////////////
+// compiled expressions
+
+// get TVL value of the variant without reporting conversion errors
+static bool peekTVLValue( const QVariant& value, TVL& tvl )
+{
+  if ( value.isNull() )
+  {
+    tvl = Unknown;
+    return true;
+  }
+
+  if ( value.type() == QVariant::Int )
+  {
+    tvl = value.toInt() != 0 ? True : False;
+    return true;
+  }
+
+  bool ok;
+  double x = value.toDouble( &ok );
+  if ( !ok )
+    return false;
+  tvl = x != 0 ? True : False;
+  return true;
+}
+
+bool QgsExpression::Program::compile( QgsExpression* parent, Node* root )
+{
+  if ( !compileNode( parent, root ) )
+    return false;
+
+  Q_ASSERT( mDepth == 1 );
+  mStack.resize( mMaxDepth );
+  return true;
+}
+
+QVariant QgsExpression::Program::run( QgsExpression* parent, const QgsFeature* f )
+{
+  QVariant* stack = mStack.data();
+  int sp = 0;
+
+  const Instruction* code = mCode.constData();
+  const int count = mCode.size();
+  for ( int pc = 0; pc < count; ++pc )
+  {
+    const Instruction& ins = code[pc];
+    switch ( ins.code )
+    {
+      case opLiteral:
+        stack[sp++] = mConstants.at( ins.index );
+        break;
+
+      case opColumn:
+        stack[sp++] = f->attribute( ins.index );
+        break;
+
+      case opNode:
+        stack[sp++] = mNodes[ins.index]->eval( parent, f );
+        ENSURE_NO_EVAL_ERROR;
+        break;
+
+      case opUnary:
+        stack[sp - 1] = static_cast<NodeUnaryOperator*>( mNodes[ins.index] )->evalValue( parent, stack[sp - 1] );
+        ENSURE_NO_EVAL_ERROR;
+        break;
+
+      case opBinary:
+        --sp;
+        stack[sp - 1] = static_cast<NodeBinaryOperator*>( mNodes[ins.index] )->evalValues( parent, stack[sp - 1], stack[sp] );
+        ENSURE_NO_EVAL_ERROR;
+        break;
+
+      case opCompareNum:
+      {
+        QVariant v = f->attribute( ins.index );
+        if ( v.isNull() )
+        {
+          stack[sp++] = TVL_Unknown;
+        }
+        else if ( v.type() == QVariant::Double || v.type() == QVariant::Int )
+        {
+          double x = v.toDouble();
+          double diff = ins.swapped ? ins.value - x : x - ins.value;
+          stack[sp++] = compareDiff(( BinaryOperator ) ins.op, diff ) ? TVL_True : TVL_False;
+        }
+        else
+        {
+          // strings and other types follow the generic conversion rules
+          stack[sp++] = mNodes[ins.extra]->eval( parent, f );
+          ENSURE_NO_EVAL_ERROR;
+        }
+        break;
+      }
+
+      case opCompareStr:
+      {
+        QVariant v = f->attribute( ins.index );
+        if ( v.isNull() )
+        {
+          stack[sp++] = TVL_Unknown;
+        }
+        else
+        {
+          QString s = mConstants.at( ins.extra ).toString();
+          int diff = ins.swapped ? QString::compare( s, v.toString() ) : QString::compare( v.toString(), s );
+          stack[sp++] = compareDiff(( BinaryOperator ) ins.op, diff ) ? TVL_True : TVL_False;
+        }
+        break;
+      }
+
+      case opMatch:
+      {
+        QVariant& v = stack[sp - 1];
+        if ( v.isNull() )
+        {
+          v = TVL_Unknown;
+        }
+        else
+        {
+          Matcher& m = mMatchers[ins.index];
+          QString str = v.toString();
+          bool matches = m.exact ? m.regexp.exactMatch( str ) : m.regexp.indexIn( str ) != -1;
+          if ( m.negate )
+            matches = !matches;
+          v = matches ? TVL_True : TVL_False;
+        }
+        break;
+      }
+
+      case opIn:
+      {
+        QVariant& v = stack[sp - 1];
+        if ( v.isNull() )
+        {
+          v = TVL_Unknown;
+          break;
+        }
+
+        const InList& in = mInLists[ins.index];
+        QString str = v.toString();
+        bool found = in.strings.contains( str );
+        if ( !found )
+        {
+          if ( isDoubleSafe( v ) )
+            found = in.numbers.contains( v.toDouble() );
+          else
+            found = in.numberStrings.contains( str );
+        }
+
+        if ( found )
+          v = in.notIn ? TVL_False : TVL_True;
+        else if ( in.hasNull )
+          v = TVL_Unknown;
+        else
+          v = in.notIn ? TVL_True : TVL_False;
+        break;
+      }
+
+      case opAnd:
+      case opOr:
+      {
+        --sp;
+        TVL tvlL = getTVLValue( stack[sp - 1], parent ), tvlR = getTVLValue( stack[sp], parent );
+        ENSURE_NO_EVAL_ERROR;
+        stack[sp - 1] = tvl2variant( ins.code == opAnd ? AND[tvlL][tvlR] : OR[tvlL][tvlR] );
+        break;
+      }
+
+      case opAndJump:
+      case opOrJump:
+      {
+        TVL tvl;
+        if ( peekTVLValue( stack[sp - 1], tvl ) && tvl == ( ins.code == opAndJump ? False : True ) )
+        {
+          stack[sp - 1] = ins.code == opAndJump ? TVL_False : TVL_True;
+          pc = ins.target - 1;
+        }
+        break;
+      }
+
+      case opJumpIfNull:
+        if ( stack[sp - 1].isNull() )
+        {
+          sp -= ins.extra;
+          stack[sp++] = QVariant();
+          pc = ins.target - 1;
+        }
+        break;
+
+      case opCall:
+      {
+        QVariantList args;
+        for ( int i = sp - ins.extra; i < sp; ++i )
+          args.append( stack[i] );
+        sp -= ins.extra;
+        stack[sp++] = mFunctions[ins.index]->func( args, f, parent );
+        ENSURE_NO_EVAL_ERROR;
+        break;
+      }
+
+      case opJumpIfNotTrue:
+      {
+        TVL tvl = getTVLValue( stack[--sp], parent );
+        ENSURE_NO_EVAL_ERROR;
+        if ( tvl != True )
+          pc = ins.target - 1;
+        break;
+      }
+
+      case opJump:
+        pc = ins.target - 1;
+        break;
+    }
+  }
+
+  Q_ASSERT( sp == 1 );
+  return stack[0];
+}
+
+int QgsExpression::Program::addInstruction( OpCode code, int stackChange )
+{
+  Instruction ins;
+  ins.code = code;
+  ins.op = 0;
+  ins.index = -1;
+  ins.extra = -1;
+  ins.target = -1;
+  ins.swapped = false;
+  ins.value = 0;
+  mCode.append( ins );
+
+  mDepth += stackChange;
+  mMaxDepth = qMax( mMaxDepth, mDepth );
+  return mCode.size() - 1;
+}
+
+void QgsExpression::Program::emitLiteral( const QVariant& value )
+{
+  int i = addInstruction( opLiteral, 1 );
+  mCode[i].index = mConstants.size();
+  mConstants.append( value );
+}
+
+void QgsExpression::Program::emitNode( Node* node )
+{
+  int i = addInstruction( opNode, 1 );
+  mCode[i].index = mNodes.size();
+  mNodes.append( node );
+}
+
+bool QgsExpression::Program::compileNode( QgsExpression* parent, Node* node )
+{
+  // fold constant subtrees - unless they fail, the error is then reported during evaluation
+  QVariant value;
+  if ( node->nodeType() != ntLiteral && constantValue( parent, node, value ) )
+  {
+    emitLiteral( value );
+    return true;
+  }
+
+  switch ( node->nodeType() )
+  {
+    case ntLiteral:
+      emitLiteral( static_cast<NodeLiteral*>( node )->value() );
+      return true;
+
+    case ntColumnRef:
+    {
+      int idx = static_cast<NodeColumnRef*>( node )->index();
+      if ( idx < 0 )
+        return false; // not prepared
+      int i = addInstruction( opColumn, 1 );
+      mCode[i].index = idx;
+      return true;
+    }
+
+    case ntUnaryOperator:
+    {
+      NodeUnaryOperator* n = static_cast<NodeUnaryOperator*>( node );
+      if ( !compileNode( parent, n->operand() ) )
+        return false;
+      int i = addInstruction( opUnary, 0 );
+      mCode[i].index = mNodes.size();
+      mNodes.append( n );
+      return true;
+    }
+
+    case ntBinaryOperator:
+      return compileBinary( parent, static_cast<NodeBinaryOperator*>( node ) );
+
+    case ntInOperator:
+      return compileIn( parent, static_cast<NodeInOperator*>( node ) );
+
+    case ntFunction:
+      return compileFunction( parent, static_cast<NodeFunction*>( node ) );
+
+    case ntCondition:
+      return compileCondition( parent, static_cast<NodeCondition*>( node ) );
+  }
+
+  return false;
+}
+
+bool QgsExpression::Program::compileBinary( QgsExpression* parent, NodeBinaryOperator* node )
+{
+  switch ( node->op() )
+  {
+    case boAnd:
+    case boOr:
+    {
+      if ( !compileNode( parent, node->opLeft() ) )
+        return false;
+
+      // the interpreter evaluates both operands - skip the right one
+      // only if that cannot hide an evaluation error
+      int jump = -1;
+      if ( canSkip( node->opRight() ) )
+        jump = addInstruction( node->op() == boAnd ? opAndJump : opOrJump, 0 );
+
+      if ( !compileNode( parent, node->opRight() ) )
+        return false;
+      addInstruction( node->op() == boAnd ? opAnd : opOr, -1 );
+
+      if ( jump >= 0 )
+        mCode[jump].target = mCode.size();
+      return true;
+    }
+
+    case boEQ:
+    case boNE:
+    case boLE:
+    case boGE:
+    case boLT:
+    case boGT:
+      if ( compileComparison( parent, node ) )
+        return true;
+      break;
+
+    case boRegexp:
+    case boLike:
+    case boNotLike:
+    case boILike:
+    case boNotILike:
+    {
+      QVariant pattern;
+      if ( !constantValue( parent, node->opRight(), pattern ) || pattern.isNull() )
+        break;
+
+      if ( !compileNode( parent, node->opLeft() ) )
+        return false;
+
+      BinaryOperator op = node->op();
+      Matcher m;
+      m.exact = op != boRegexp;
+      m.negate = op == boNotLike || op == boNotILike;
+      if ( m.exact )
+      {
+        // change from LIKE syntax to regexp
+        QString esc_regexp = QRegExp::escape( pattern.toString() );
+        esc_regexp.replace( "%", ".*" );
+        esc_regexp.replace( "_", "." );
+        m.regexp = QRegExp( esc_regexp, op == boLike || op == boNotLike ? Qt::CaseSensitive : Qt::CaseInsensitive );
+      }
+      else
+      {
+        m.regexp = QRegExp( pattern.toString() );
+      }
+
+      int i = addInstruction( opMatch, 0 );
+      mCode[i].index = mMatchers.size();
+      mMatchers.append( m );
+      return true;
+    }
+
+    default:
+      break;
+  }
+
+  // generic case: operands on the stack, the node applies the operator
+  if ( !compileNode( parent, node->opLeft() ) || !compileNode( parent, node->opRight() ) )
+    return false;
+
+  int i = addInstruction( opBinary, -1 );
+  mCode[i].index = mNodes.size();
+  mNodes.append( node );
+  return true;
+}
+
+bool QgsExpression::Program::compileComparison( QgsExpression* parent, NodeBinaryOperator* node )
+{
+  // typed fast path for comparisons of a column with a constant
+  NodeColumnRef* column = 0;
+  QVariant value;
+  bool swapped = false;
+  if ( node->opLeft()->nodeType() == ntColumnRef && constantValue( parent, node->opRight(), value ) )
+  {
+    column = static_cast<NodeColumnRef*>( node->opLeft() );
+  }
+  else if ( node->opRight()->nodeType() == ntColumnRef && constantValue( parent, node->opLeft(), value ) )
+  {
+    column = static_cast<NodeColumnRef*>( node->opRight() );
+    swapped = true;
+  }
+
+  if ( !column || column->index() < 0 || value.isNull() )
+    return false;
+
+  int i;
+  if ( value.type() == QVariant::Int || value.type() == QVariant::Double )
+  {
+    i = addInstruction( opCompareNum, 1 );
+    mCode[i].value = value.toDouble();
+    mCode[i].extra = mNodes.size();
+    mNodes.append( node );
+  }
+  else if ( !isDoubleSafe( value ) )
+  {
+    // never numeric - the comparison is always done on strings
+    i = addInstruction( opCompareStr, 1 );
+    mCode[i].extra = mConstants.size();
+    mConstants.append( value.toString() );
+  }
+  else
+  {
+    return false;
+  }
+
+  mCode[i].op = node->op();
+  mCode[i].index = column->index();
+  mCode[i].swapped = swapped;
+  return true;
+}
+
+bool QgsExpression::Program::compileIn( QgsExpression* parent, NodeInOperator* node )
+{
+  if ( node->list()->count() == 0 )
+  {
+    emitLiteral( node->isNotIn() ? TVL_True : TVL_False );
+    return true;
+  }
+
+  InList in;
+  in.hasNull = false;
+  in.notIn = node->isNotIn();
+  foreach ( Node* n, node->list()->list() )
+  {
+    QVariant value;
+    if ( !constantValue( parent, n, value ) )
+    {
+      // items are evaluated lazily - leave that to the interpreter
+      emitNode( node );
+      return true;
+    }
+
+    if ( value.isNull() )
+    {
+      in.hasNull = true;
+    }
+    else if ( isDoubleSafe( value ) )
+    {
+      in.numbers.append( value.toDouble() );
+      in.numberStrings.insert( value.toString() );
+    }
+    else
+    {
+      in.strings.insert( value.toString() );
+    }
+  }
+
+  if ( !compileNode( parent, node->node() ) )
+    return false;
+
+  int i = addInstruction( opIn, 0 );
+  mCode[i].index = mInLists.size();
+  mInLists.append( in );
+  return true;
+}
+
+bool QgsExpression::Program::compileFunction( QgsExpression* parent, NodeFunction* node )
+{
+  Function* fd = Functions()[node->fnIndex()];
+
+  // all "normal" functions return NULL when any parameter is NULL (coalesce is abnormal)
+  bool nullPropagates = fd->name() != "coalesce";
+
+  QList<int> nullJumps;
+  int count = 0;
+  if ( node->args() )
+  {
+    foreach ( Node* n, node->args()->list() )
+    {
+      if ( !compileNode( parent, n ) )
+        return false;
+      ++count;
+
+      if ( nullPropagates )
+      {
+        int i = addInstruction( opJumpIfNull, 0 );
+        mCode[i].extra = count;
+        nullJumps << i;
+      }
+    }
+  }
+
+  int i = addInstruction( opCall, 1 - count );
+  mCode[i].index = mFunctions.size();
+  mCode[i].extra = count;
+  mFunctions.append( fd );
+
+  foreach ( int j, nullJumps )
+    mCode[j].target = mCode.size();
+  return true;
+}
+
+bool QgsExpression::Program::compileCondition( QgsExpression* parent, NodeCondition* node )
+{
+  QList<int> endJumps;
+  foreach ( WhenThen* cond, node->conditions() )
+  {
+    if ( !compileNode( parent, cond->mWhenExp ) )
+      return false;
+    int next = addInstruction( opJumpIfNotTrue, -1 );
+
+    if ( !compileNode( parent, cond->mThenExp ) )
+      return false;
+    // the result stays on the stack, the next branch starts without it
+    endJumps << addInstruction( opJump, -1 );
+
+    mCode[next].target = mCode.size();
+  }
+
+  if ( node->elseExp() )
+  {
+    if ( !compileNode( parent, node->elseExp() ) )
+      return false;
+  }
+  else
+  {
+    // return NULL if no condition is matching
+    emitLiteral( QVariant() );
+  }
+
+  foreach ( int j, endJumps )
+    mCode[j].target = mCode.size();
+  return true;
+}
+
+bool QgsExpression::Program::constantValue( QgsExpression* parent, Node* node, QVariant& value )
+{
+  if ( !isConstant( node ) )
+    return false;
+
+  parent->setEvalErrorString( QString() );
+  value = node->eval( parent, 0 );
+  bool ok = !parent->hasEvalError();
+  parent->setEvalErrorString( QString() );
+  return ok;
+}
+
+bool QgsExpression::Program::isConstant( Node* node )
+{
+  switch ( node->nodeType() )
+  {
+    case ntLiteral:
+      return true;
+
+    case ntUnaryOperator:
+      return isConstant( static_cast<NodeUnaryOperator*>( node )->operand() );
+
+    case ntBinaryOperator:
+    {
+      NodeBinaryOperator* n = static_cast<NodeBinaryOperator*>( node );
+      return isConstant( n->opLeft() ) && isConstant( n->opRight() );
+    }
+
+    case ntInOperator:
+    {
+      NodeInOperator* n = static_cast<NodeInOperator*>( node );
+      if ( !isConstant( n->node() ) )
+        return false;
+      foreach ( Node* item, n->list()->list() )
+      {
+        if ( !isConstant( item ) )
+          return false;
+      }
+      return true;
+    }
+
+    case ntCondition:
+    {
+      NodeCondition* n = static_cast<NodeCondition*>( node );
+      foreach ( WhenThen* cond, n->conditions() )
+      {
+        if ( !isConstant( cond->mWhenExp ) || !isConstant( cond->mThenExp ) )
+          return false;
+      }
+      return !n->elseExp() || isConstant( n->elseExp() );
+    }
+
+    case ntColumnRef:
+    case ntFunction: // may depend on the feature, row number or be non-deterministic
+      return false;
+  }
+
+  return false;
+}
+
+bool QgsExpression::Program::canFail( Node* node )
+{
+  switch ( node->nodeType() )
+  {
+    case ntLiteral:
+    case ntColumnRef:
+      return false;
+
+    case ntUnaryOperator:
+    {
+      NodeUnaryOperator* n = static_cast<NodeUnaryOperator*>( node );
+      return n->op() != uoNot || canFail( n->operand() ) || !isBoolean( n->operand() );
+    }
+
+    case ntBinaryOperator:
+    {
+      NodeBinaryOperator* n = static_cast<NodeBinaryOperator*>( node );
+      bool operandsFail = canFail( n->opLeft() ) || canFail( n->opRight() );
+      switch ( n->op() )
+      {
+        case boAnd:
+        case boOr:
+          return !canSkip( n->opLeft() ) || !canSkip( n->opRight() );
+
+        case boEQ:
+        case boNE:
+        case boLE:
+        case boGE:
+        case boLT:
+        case boGT:
+        case boIs:
+        case boIsNot:
+        case boRegexp:
+        case boLike:
+        case boNotLike:
+        case boILike:
+        case boNotILike:
+        case boConcat:
+          return operandsFail;
+
+        default: // arithmetic conversions may fail
+          return true;
+      }
+    }
+
+    case ntInOperator:
+    {
+      NodeInOperator* n = static_cast<NodeInOperator*>( node );
+      if ( canFail( n->node() ) )
+        return true;
+      foreach ( Node* item, n->list()->list() )
+      {
+        if ( canFail( item ) )
+          return true;
+      }
+      return false;
+    }
+
+    case ntFunction:
+    case ntCondition:
+      return true;
+  }
+
+  return true;
+}
+
+bool QgsExpression::Program::canSkip( Node* node )
+{
+  // converting any other value to a boolean may fail
+  return !canFail( node ) && isBoolean( node );
+}
+
+bool QgsExpression::Program::isBoolean( Node* node )
+{
+  switch ( node->nodeType() )
+  {
+    case ntLiteral:
+    {
+      QVariant v = static_cast<NodeLiteral*>( node )->value();
+      return v.isNull() || v.type() == QVariant::Int || v.type() == QVariant::Double;
+    }
+
+    case ntUnaryOperator:
+      return static_cast<NodeUnaryOperator*>( node )->op() == uoNot;
+
+    case ntBinaryOperator:
+    {
+      switch ( static_cast<NodeBinaryOperator*>( node )->op() )
+      {
+        case boPlus:
+        case boMinus:
+        case boMul:
+        case boDiv:
+        case boMod:
+        case boPow:
+        case boConcat:
+          return false;
+        default:
+          return true;
+      }
+    }
+
+    case ntInOperator:
+      return true;
+
+    case ntColumnRef:
+    case ntFunction:
+    case ntCondition:
+      return false;
+  }
+
+  return false;
+}
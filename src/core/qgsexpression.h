@@ -23,6 +23,7 @@
 #include <QDomDocument>
 
 #include "qgsfield.h"
+#include "qgsfeature.h"
 #include "qgsdistancearea.h"
 
 class QgsFeature;
@@ -71,6 +72,8 @@ There is no special (three-value) 'boolean' type: true/false is represented as
 
 For better performance with many evaluations you may first call prepare(fields) function
 to find out indices of columns and then repeatedly call evaluate(feature).
+Calling compile() after prepare() additionally lowers the expression tree into a flat
+instruction stream which is then used by evaluate(feature) and evaluateBatch(features).
 
 Type conversion: operators and functions that expect arguments to be of particular
 type automatically convert the arguments to that type, e.g. sin('2.1') will convert
@@ -103,8 +106,21 @@ class CORE_EXPORT QgsExpression
     const Node* rootNode() const { return mRootNode; }
 
     //! Get the expression ready for evaluation - find out column indexes.
+    //! @note any program created by an earlier compile() call is discarded
     bool prepare( const QgsFields &fields );
 
+    //! Compile the prepared expression into a flat instruction stream
+    //! (constant subexpressions are folded, AND / OR short-circuit and comparisons of
+    //! columns with literals use typed fast paths). Results are the same as with
+    //! the tree interpreter. Returns false if the expression could not be compiled.
+    //! @note prepare() has to be called successfully before calling this method
+    //! @note added in 2.4
+    bool compile();
+
+    //! Returns true if compile() succeeded since the last call to prepare()
+    //! @note added in 2.4
+    bool isCompiled() const { return mProgram != 0; }
+
     //! Get list of columns referenced by the expression
     QStringList referencedColumns();
     //! Returns true if the expression uses feature geometry for some computation
@@ -129,6 +145,13 @@ class CORE_EXPORT QgsExpression
     //! @note this method does not expect that prepare() has been called on this instance
     inline QVariant evaluate( const QgsFeature& f, const QgsFields& fields ) { return evaluate( &f, fields ); }
 
+    //! Evaluate the expression for each of the features and return the results in the same order.
+    //! Features for which the evaluation fails get a NULL result, the first error is kept
+    //! in evalErrorString().
+    //! @note prepare() (and optionally compile()) should be called before calling this method
+    //! @note added in 2.4
+    QVariantList evaluateBatch( const QgsFeatureList& features );
+
     //! Returns true if an error occurred when evaluating last input
     bool hasEvalError() const { return !mEvalErrorString.isNull(); }
     //! Returns evaluation error
@@ -413,6 +436,10 @@ class CORE_EXPORT QgsExpression
         virtual QVariant eval( QgsExpression* parent, const QgsFeature* f );
         virtual QString dump() const;
 
+        //! apply the operator to an already evaluated operand
+        //! @note added in 2.4
+        QVariant evalValue( QgsExpression* parent, const QVariant& val );
+
         virtual QStringList referencedColumns() const { return mOperand->referencedColumns(); }
         virtual bool needsGeometry() const { return mOperand->needsGeometry(); }
         virtual void accept( Visitor& v ) const { v.visit( *this ); }
@@ -437,6 +464,10 @@ class CORE_EXPORT QgsExpression
         virtual QVariant eval( QgsExpression* parent, const QgsFeature* f );
         virtual QString dump() const;
 
+        //! apply the operator to already evaluated operands
+        //! @note added in 2.4
+        QVariant evalValues( QgsExpression* parent, const QVariant& vL, const QVariant& vR );
+
         virtual QStringList referencedColumns() const { return mOpLeft->referencedColumns() + mOpRight->referencedColumns(); }
         virtual bool needsGeometry() const { return mOpLeft->needsGeometry() || mOpRight->needsGeometry(); }
         virtual void accept( Visitor& v ) const { v.visit( *this ); }
@@ -530,6 +561,9 @@ class CORE_EXPORT QgsExpression
         NodeColumnRef( QString name ) : mName( name ), mIndex( -1 ) {}
 
         QString name() const { return mName; }
+        //! index of the column found by prepare(), -1 if not resolved
+        //! @note added in 2.4
+        int index() const { return mIndex; }
 
         virtual NodeType nodeType() const { return ntColumnRef; }
         virtual bool prepare( QgsExpression* parent, const QgsFields &fields );
@@ -564,6 +598,11 @@ class CORE_EXPORT QgsExpression
         NodeCondition( WhenThenList* conditions, Node* elseExp = NULL ) : mConditions( *conditions ), mElseExp( elseExp ) { delete conditions; }
         ~NodeCondition() { delete mElseExp; qDeleteAll( mConditions ); }
 
+        //! @note added in 2.4
+        const WhenThenList& conditions() const { return mConditions; }
+        //! @note added in 2.4
+        Node* elseExp() const { return mElseExp; }
+
         virtual NodeType nodeType() const { return ntCondition; }
         virtual QVariant eval( QgsExpression* parent, const QgsFeature* f );
         virtual bool prepare( QgsExpression* parent, const QgsFields &fields );
@@ -603,11 +642,15 @@ class CORE_EXPORT QgsExpression
 
   protected:
     // internally used to create an empty expression
-    QgsExpression() : mRootNode( 0 ), mRowNumber( 0 ), mCalc( 0 ) {}
+    QgsExpression() : mRootNode( 0 ), mProgram( 0 ), mRowNumber( 0 ), mCalc( 0 ) {}
 
     void initGeomCalculator();
 
+    // compiled form of the expression (see compile())
+    class Program;
+
     Node* mRootNode;
+    Program* mProgram;
 
     QString mParserErrorString;
     QString mEvalErrorString;
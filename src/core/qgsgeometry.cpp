@@ -40,6 +40,24 @@ email                : morb at ozemail dot com dot au
 
 #define DEFAULT_QUADRANT_SEGMENTS 8
 
+// number of predicates evaluated with a geometry as first operand before it is prepared
+#define PREPARE_AFTER_RELOPS 2
+
+#if defined(GEOS_VERSION_MAJOR) && defined(GEOS_VERSION_MINOR) && \
+    ((GEOS_VERSION_MAJOR>3) || ((GEOS_VERSION_MAJOR==3) && (GEOS_VERSION_MINOR>=1)))
+#define HAVE_GEOS_PREPARED
+#define GEOS_PREPARED_OP_3_1(op) op
+#else
+#define GEOS_PREPARED_OP_3_1(op) 0
+#endif
+
+#if defined(GEOS_VERSION_MAJOR) && defined(GEOS_VERSION_MINOR) && \
+    ((GEOS_VERSION_MAJOR>3) || ((GEOS_VERSION_MAJOR==3) && (GEOS_VERSION_MINOR>=3)))
+#define GEOS_PREPARED_OP_3_3(op) op
+#else
+#define GEOS_PREPARED_OP_3_3(op) 0
+#endif
+
 #define CATCH_GEOS(r) \
   catch (GEOSException &e) \
   { \
@@ -47,32 +65,13 @@ email                : morb at ozemail dot com dot au
     return r; \
   }
 
+// GEOS operations also run in worker threads, so the exception must not share any state
 class GEOSException
 {
   public:
     GEOSException( QString theMsg )
+        : msg( theMsg )
     {
-      if ( theMsg == "Unknown exception thrown"  && lastMsg.isNull() )
-      {
-        msg = theMsg;
-      }
-      else
-      {
-        msg = theMsg;
-        lastMsg = msg;
-      }
-    }
-
-    // copy constructor
-    GEOSException( const GEOSException &rhs )
-    {
-      *this = rhs;
-    }
-
-    ~GEOSException()
-    {
-      if ( lastMsg == msg )
-        lastMsg = QString::null;
     }
 
     QString what()
@@ -82,11 +81,8 @@ class GEOSException
 
   private:
     QString msg;
-    static QString lastMsg;
 };
 
-QString GEOSException::lastMsg;
-
 static void throwGEOSException( const char *fmt, ... )
 {
   va_list ap;
@@ -193,6 +189,8 @@ QgsGeometry::QgsGeometry()
     , mGeos( 0 )
     , mDirtyWkb( false )
     , mDirtyGeos( false )
+    , mPreparedGeos( 0 )
+    , mRelOpCount( 0 )
 {
 }
 
@@ -201,6 +199,8 @@ QgsGeometry::QgsGeometry( QgsGeometry const & rhs )
     , mGeometrySize( rhs.mGeometrySize )
     , mDirtyWkb( rhs.mDirtyWkb )
     , mDirtyGeos( rhs.mDirtyGeos )
+    , mPreparedGeos( 0 )
+    , mRelOpCount( 0 )
 {
   if ( mGeometrySize && rhs.mGeometry )
   {
@@ -222,6 +222,8 @@ QgsGeometry::~QgsGeometry()
   if ( mGeometry )
     delete [] mGeometry;
 
+  resetPreparedGeos();
+
   if ( mGeos )
     GEOSGeom_destroy( mGeos );
 
@@ -557,6 +559,7 @@ QgsGeometry & QgsGeometry::operator=( QgsGeometry const & rhs )
   mGeometrySize    = rhs.mGeometrySize;
 
   // deep-copy the GEOS Geometry if appropriate
+  resetPreparedGeos();
   GEOSGeom_destroy( mGeos );
   mGeos = rhs.mGeos ? GEOSGeom_clone( rhs.mGeos ) : 0;
 
@@ -584,6 +587,7 @@ void QgsGeometry::fromWkb( unsigned char *wkb, size_t length )
 
   if ( mGeos )
   {
+    resetPreparedGeos();
     GEOSGeom_destroy( mGeos );
     mGeos = 0;
   }
@@ -624,6 +628,62 @@ const GEOSGeometry* QgsGeometry::asGeos() const
   return mGeos;
 }
 
+bool QgsGeometry::prepareGeometry() const
+{
+  return asPreparedGeos() != 0;
+}
+
+bool QgsGeometry::isPrepared() const
+{
+  return mPreparedGeos && !mDirtyGeos;
+}
+
+const GEOSPreparedGeometry* QgsGeometry::asPreparedGeos() const
+{
+#ifdef HAVE_GEOS_PREPARED
+  if ( !exportWkbToGeos() || !mGeos )
+  {
+    return 0;
+  }
+
+  if ( !mPreparedGeos )
+  {
+    try
+    {
+      mPreparedGeos = GEOSPrepare( mGeos );
+    }
+    catch ( GEOSException &e )
+    {
+      QgsMessageLog::logMessage( QObject::tr( "Exception: %1" ).arg( e.what() ), QObject::tr( "GEOS" ) );
+      mPreparedGeos = 0;
+    }
+  }
+  return mPreparedGeos;
+#else
+  return 0;
+#endif
+}
+
+void QgsGeometry::resetPreparedGeos() const
+{
+#ifdef HAVE_GEOS_PREPARED
+  if ( mPreparedGeos )
+  {
+    GEOSPreparedGeom_destroy( mPreparedGeos );
+    mPreparedGeos = 0;
+  }
+#endif
+  mRelOpCount = 0;
+}
+
+const GEOSPreparedGeometry* QgsGeometry::preparedGeosForRelOp() const
+{
+  if ( !mPreparedGeos && ++mRelOpCount < PREPARE_AFTER_RELOPS )
+  {
+    return 0;
+  }
+  return asPreparedGeos();
+}
 
 QGis::WkbType QgsGeometry::wkbType() const
 {
@@ -686,6 +746,7 @@ void QgsGeometry::fromGeos( GEOSGeometry *geos )
 
   if ( mGeos )
   {
+    resetPreparedGeos();
     GEOSGeom_destroy( mGeos );
     mGeos = 0;
   }
@@ -2409,6 +2470,7 @@ int QgsGeometry::addRing( const QList<QgsPoint>& ring )
 
   if ( wkbType() == QGis::WKBPolygon )
   {
+    resetPreparedGeos();
     GEOSGeom_destroy( mGeos );
     mGeos = newPolygon;
   }
@@ -2421,6 +2483,7 @@ int QgsGeometry::addRing( const QList<QgsPoint>& ring )
       newPolygons << ( i == j ? newPolygon : GEOSGeom_clone( polygonList[j] ) );
     }
 
+    resetPreparedGeos();
     GEOSGeom_destroy( mGeos );
     mGeos = createGeosCollection( GEOS_MULTIPOLYGON, newPolygons );
   }
@@ -2612,6 +2675,7 @@ int QgsGeometry::addPart( GEOSGeometry *newPart )
   }
   GEOSGeom_destroy( newPart );
 
+  resetPreparedGeos();
   GEOSGeom_destroy( mGeos );
 
   mGeos = createGeosCollection( geosType, parts );
@@ -2962,6 +3026,7 @@ int QgsGeometry::reshapeGeometry( const QList<QgsPoint>& reshapeWithLine )
     GEOSGeom_destroy( reshapeLineGeos );
     if ( reshapedGeometry )
     {
+      resetPreparedGeos();
       GEOSGeom_destroy( mGeos );
       mGeos = reshapedGeometry;
       mDirtyWkb = true;
@@ -3015,6 +3080,7 @@ int QgsGeometry::reshapeGeometry( const QList<QgsPoint>& reshapeWithLine )
 
     if ( reshapeTookPlace )
     {
+      resetPreparedGeos();
       GEOSGeom_destroy( mGeos );
       mGeos = newMultiGeom;
       mDirtyWkb = true;
@@ -3061,6 +3127,7 @@ int QgsGeometry::makeDifference( QgsGeometry* other )
       //check if multitype before and after
       bool multiType = isMultipart();
 
+      resetPreparedGeos();
       mGeos = GEOSDifference( mGeos, other->mGeos );
       mDirtyWkb = true;
 
@@ -3329,24 +3396,7 @@ bool QgsGeometry::intersects( const QgsRectangle& r ) const
 
 bool QgsGeometry::intersects( const QgsGeometry* geometry ) const
 {
-  if ( !geometry )
-    return false;
-
-  try // geos might throw exception on error
-  {
-    // ensure that both geometries have geos geometry
-    exportWkbToGeos();
-    geometry->exportWkbToGeos();
-
-    if ( !mGeos || !geometry->mGeos )
-    {
-      QgsDebugMsg( "GEOS geometry not available!" );
-      return false;
-    }
-
-    return GEOSIntersects( mGeos, geometry->mGeos );
-  }
-  CATCH_GEOS( false )
+  return geosRelOp( GEOSIntersects, GEOS_PREPARED_OP_3_1( GEOSPreparedIntersects ), this, geometry );
 }
 
 bool QgsGeometry::contains( const QgsPoint* p ) const
@@ -3372,7 +3422,13 @@ bool QgsGeometry::contains( const QgsPoint* p ) const
   try
   {
     geosPoint = createGeosPoint( *p );
-    returnval = GEOSContains( mGeos, geosPoint );
+#ifdef HAVE_GEOS_PREPARED
+    const GEOSPreparedGeometry *prepared = preparedGeosForRelOp();
+    if ( prepared )
+      returnval = GEOSPreparedContains( prepared, geosPoint );
+    else
+#endif
+      returnval = GEOSContains( mGeos, geosPoint );
   }
   catch ( GEOSException &e )
   {
@@ -3388,6 +3444,7 @@ bool QgsGeometry::contains( const QgsPoint* p ) const
 
 bool QgsGeometry::geosRelOp(
   char( *op )( const GEOSGeometry*, const GEOSGeometry * ),
+  char( *preparedOp )( const GEOSPreparedGeometry*, const GEOSGeometry * ),
   const QgsGeometry *a,
   const QgsGeometry *b )
 {
@@ -3405,6 +3462,12 @@ bool QgsGeometry::geosRelOp(
       QgsDebugMsg( "GEOS geometry not available!" );
       return false;
     }
+
+    // the prepared geometry is created once a geometry is tested against several others
+    const GEOSPreparedGeometry *prepared = preparedOp ? a->preparedGeosForRelOp() : 0;
+    if ( prepared )
+      return preparedOp( prepared, b->mGeos );
+
     return op( a->mGeos, b->mGeos );
   }
   CATCH_GEOS( false )
@@ -3412,37 +3475,37 @@ bool QgsGeometry::geosRelOp(
 
 bool QgsGeometry::contains( const QgsGeometry* geometry ) const
 {
-  return geosRelOp( GEOSContains, this, geometry );
+  return geosRelOp( GEOSContains, GEOS_PREPARED_OP_3_1( GEOSPreparedContains ), this, geometry );
 }
 
 bool QgsGeometry::disjoint( const QgsGeometry* geometry ) const
 {
-  return geosRelOp( GEOSDisjoint, this, geometry );
+  return geosRelOp( GEOSDisjoint, GEOS_PREPARED_OP_3_3( GEOSPreparedDisjoint ), this, geometry );
 }
 
 bool QgsGeometry::equals( const QgsGeometry* geometry ) const
 {
-  return geosRelOp( GEOSEquals, this, geometry );
+  return geosRelOp( GEOSEquals, 0, this, geometry );
 }
 
 bool QgsGeometry::touches( const QgsGeometry* geometry ) const
 {
-  return geosRelOp( GEOSTouches, this, geometry );
+  return geosRelOp( GEOSTouches, GEOS_PREPARED_OP_3_3( GEOSPreparedTouches ), this, geometry );
 }
 
 bool QgsGeometry::overlaps( const QgsGeometry* geometry ) const
 {
-  return geosRelOp( GEOSOverlaps, this, geometry );
+  return geosRelOp( GEOSOverlaps, GEOS_PREPARED_OP_3_3( GEOSPreparedOverlaps ), this, geometry );
 }
 
 bool QgsGeometry::within( const QgsGeometry* geometry ) const
 {
-  return geosRelOp( GEOSWithin, this, geometry );
+  return geosRelOp( GEOSWithin, GEOS_PREPARED_OP_3_3( GEOSPreparedWithin ), this, geometry );
 }
 
 bool QgsGeometry::crosses( const QgsGeometry* geometry ) const
 {
-  return geosRelOp( GEOSCrosses, this, geometry );
+  return geosRelOp( GEOSCrosses, GEOS_PREPARED_OP_3_3( GEOSPreparedCrosses ), this, geometry );
 }
 
 QString QgsGeometry::exportToWkt() const
@@ -3883,6 +3946,7 @@ bool QgsGeometry::exportWkbToGeos() const
 
   if ( mGeos )
   {
+    resetPreparedGeos();
     GEOSGeom_destroy( mGeos );
     mGeos = 0;
   }
@@ -4589,6 +4653,7 @@ int QgsGeometry::splitLinearGeometry( GEOSGeometry *splitLine, QList<QgsGeometry
 
   if ( lineGeoms.size() > 0 )
   {
+    resetPreparedGeos();
     GEOSGeom_destroy( mGeos );
     mGeos = lineGeoms[0];
     mDirtyWkb = true;
@@ -4687,6 +4752,7 @@ int QgsGeometry::splitPolygonGeometry( GEOSGeometry* splitLine, QList<QgsGeometr
   }
   else if ( testedGeometries.size() > 0 ) //split successfull
   {
+    resetPreparedGeos();
     GEOSGeom_destroy( mGeos );
     mGeos = testedGeometries[0];
     mDirtyWkb = true;
@@ -5645,6 +5711,170 @@ QgsGeometry* QgsGeometry::combine( QgsGeometry* geometry )
   CATCH_GEOS( new QgsGeometry( *this ) ) //return this geometry if union not possible
 }
 
+// union of all geometries, takes ownership of the geometries
+static GEOSGeometry* unaryUnionGeos( QVector<GEOSGeometry*> geoms )
+{
+#if defined(GEOS_VERSION_MAJOR) && defined(GEOS_VERSION_MINOR) && \
+    ((GEOS_VERSION_MAJOR>3) || ((GEOS_VERSION_MAJOR==3) && (GEOS_VERSION_MINOR>=3)))
+  GEOSGeometry* collection = createGeosCollection( GEOS_GEOMETRYCOLLECTION, geoms );
+  if ( !collection )
+  {
+    for ( int i = 0; i < geoms.size(); ++i )
+      GEOSGeom_destroy( geoms[i] );
+    return 0;
+  }
+
+  GEOSGeometry* unionGeom = 0;
+  try
+  {
+    unionGeom = GEOSUnaryUnion( collection );
+  }
+  catch ( GEOSException & )
+  {
+    GEOSGeom_destroy( collection );
+    throw;
+  }
+  GEOSGeom_destroy( collection );
+  return unionGeom;
+#else
+  // pairwise unions in a balanced tree, so every vertex is only part of log(n) unions
+  while ( geoms.size() > 1 )
+  {
+    QVector<GEOSGeometry*> merged;
+    int i = 0;
+    try
+    {
+      for ( ; i < geoms.size(); i += 2 )
+      {
+        if ( i + 1 == geoms.size() )
+        {
+          merged << geoms[i];
+          break;
+        }
+
+        GEOSGeometry* unionGeom = GEOSUnion( geoms[i], geoms[i + 1] );
+        if ( unionGeom )
+        {
+          GEOSGeom_destroy( geoms[i] );
+          merged << unionGeom;
+        }
+        else
+        {
+          merged << geoms[i];
+        }
+        GEOSGeom_destroy( geoms[i + 1] );
+      }
+    }
+    catch ( GEOSException & )
+    {
+      // the geometries before i are merged, the others are still owned by geoms
+      for ( int j = 0; j < merged.size(); ++j )
+        GEOSGeom_destroy( merged[j] );
+      for ( int j = i; j < geoms.size(); ++j )
+        GEOSGeom_destroy( geoms[j] );
+      throw;
+    }
+    geoms = merged;
+  }
+  return geoms.isEmpty() ? 0 : geoms[0];
+#endif
+}
+
+// union of the geometries one by one, skipping the ones that cannot be merged like
+// repeated combine() calls do, takes ownership of the geometries
+static GEOSGeometry* sequentialUnionGeos( QVector<GEOSGeometry*> geoms )
+{
+  GEOSGeometry* unionGeom = 0;
+  for ( int i = 0; i < geoms.size(); ++i )
+  {
+    if ( !unionGeom )
+    {
+      unionGeom = geoms[i];
+      continue;
+    }
+
+    try
+    {
+      GEOSGeometry* mergedGeom = GEOSUnion( unionGeom, geoms[i] );
+      if ( mergedGeom )
+      {
+        GEOSGeom_destroy( unionGeom );
+        unionGeom = mergedGeom;
+      }
+    }
+    catch ( GEOSException &e )
+    {
+      QgsMessageLog::logMessage( QObject::tr( "Exception: %1" ).arg( e.what() ), QObject::tr( "GEOS" ) );
+      // an invalid first geometry would make every union fail, replace it
+      if ( GEOSisValid( unionGeom ) != 1 )
+      {
+        qSwap( unionGeom, geoms[i] );
+      }
+    }
+    GEOSGeom_destroy( geoms[i] );
+  }
+  return unionGeom;
+}
+
+QgsGeometry* QgsGeometry::unaryUnion( const QList<QgsGeometry*>& geometryList )
+{
+  QVector<const GEOSGeometry*> sources;
+  bool lines = false;
+  foreach ( QgsGeometry* geometry, geometryList )
+  {
+    if ( !geometry )
+      continue;
+
+    const GEOSGeometry* geos = geometry->asGeos();
+    if ( !geos )
+      continue;
+
+    if ( sources.isEmpty() )
+      lines = geometry->type() == QGis::Line;
+
+    sources << geos;
+  }
+
+  if ( sources.isEmpty() )
+    return 0;
+
+  QVector<GEOSGeometry*> geoms;
+  for ( int i = 0; i < sources.size(); ++i )
+    geoms << GEOSGeom_clone( sources[i] );
+
+  try
+  {
+    GEOSGeometry* unionGeom = 0;
+    try
+    {
+      unionGeom = unaryUnionGeos( geoms );
+    }
+    catch ( GEOSException &e )
+    {
+      // a single invalid geometry makes the cascaded union fail, keep the union of the others
+      QgsMessageLog::logMessage( QObject::tr( "Exception: %1" ).arg( e.what() ), QObject::tr( "GEOS" ) );
+      geoms.clear();
+      for ( int i = 0; i < sources.size(); ++i )
+        geoms << GEOSGeom_clone( sources[i] );
+      unionGeom = sequentialUnionGeos( geoms );
+    }
+    if ( !unionGeom )
+      return 0;
+
+    if ( lines )
+    {
+      GEOSGeometry* mergedGeom = GEOSLineMerge( unionGeom );
+      if ( mergedGeom )
+      {
+        GEOSGeom_destroy( unionGeom );
+        unionGeom = mergedGeom;
+      }
+    }
+    return fromGeosGeom( unionGeom );
+  }
+  CATCH_GEOS( 0 )
+}
+
 QgsGeometry* QgsGeometry::difference( QgsGeometry* geometry )
 {
   if ( !geometry )
@@ -5965,7 +6195,7 @@ bool QgsGeometry::isGeosValid()
 
 bool QgsGeometry::isGeosEqual( QgsGeometry &g )
 {
-  return geosRelOp( GEOSEquals, this, &g );
+  return geosRelOp( GEOSEquals, 0, this, &g );
 }
 
 bool QgsGeometry::isGeosEmpty()
@@ -29,6 +29,11 @@ email                : morb at ozemail dot com dot au
 #define GEOSCoordSequence struct GEOSCoordSeq_t
 #endif
 
+#if defined(GEOS_VERSION_MAJOR) && defined(GEOS_VERSION_MINOR) && \
+    ((GEOS_VERSION_MAJOR<3) || ((GEOS_VERSION_MAJOR==3) && (GEOS_VERSION_MINOR<1)))
+#define GEOSPreparedGeometry struct GEOSPrepGeom_t
+#endif
+
 #include "qgspoint.h"
 #include "qgscoordinatetransform.h"
 #include "qgsfeature.h"
@@ -134,6 +139,27 @@ class CORE_EXPORT QgsGeometry
       */
     const GEOSGeometry* asGeos() const;
 
+    /**Prepares the GEOS geometry for repeated spatial predicates. The prepared geometry indexes its segments,
+      so intersects, contains, disjoint, touches, overlaps, within and crosses with this geometry as first operand
+      are much faster when it is tested against many other geometries. It is kept until the geometry is modified.
+      Geometries are prepared automatically when they are used in a second predicate, so calling this is
+      only needed to prepare them in advance.
+      @return false if the geometry could not be prepared (or GEOS is older than 3.1)
+      @note added in 2.4
+      */
+    bool prepareGeometry() const;
+
+    /**Returns true if the geometry has a prepared GEOS geometry (see prepareGeometry())
+      @note added in 2.4
+      */
+    bool isPrepared() const;
+
+    /**Returns the prepared GEOS geometry, prepares it if necessary. QgsGeometry keeps ownership, don't delete the returned object!
+        @note added in 2.4
+        @note not available in python bindings
+      */
+    const GEOSPreparedGeometry* asPreparedGeos() const;
+
     /** Returns type of wkb (point / linestring / polygon etc.) */
     QGis::WkbType wkbType() const;
 
@@ -379,6 +405,14 @@ class CORE_EXPORT QgsGeometry
      * @note this operation is not called union since its a reserved word in C++.*/
     QgsGeometry* combine( QgsGeometry* geometry );
 
+    /** Returns the union of all geometries of the list (or 0 if the list contains no valid geometry).
+     * The geometries are merged in one cascaded union, which is much faster than combining them one by one.
+     * If the cascaded union fails, e.g. because of an invalid geometry, they are combined one by one and
+     * geometries that cannot be merged are left out.
+     * @note added in 2.4
+     */
+    static QgsGeometry* unaryUnion( const QList<QgsGeometry*>& geometryList );
+
     /** Returns a geometry representing the points making up this geometry that do not make up other. */
     QgsGeometry* difference( QgsGeometry* geometry );
 
@@ -508,6 +542,12 @@ class CORE_EXPORT QgsGeometry
     /** If the geometry has been set  since the last conversion to GEOS **/
     mutable bool mDirtyGeos;
 
+    /** cached prepared version of mGeos (references mGeos) */
+    mutable const GEOSPreparedGeometry* mPreparedGeos;
+
+    /** Number of predicates evaluated with the current mGeos as first operand */
+    mutable int mRelOpCount;
+
 
     // Private functions
 
@@ -521,6 +561,14 @@ class CORE_EXPORT QgsGeometry
      */
     bool exportGeosToWkb() const;
 
+    /** Destroys the prepared geometry. Must be called before mGeos is destroyed or replaced */
+    void resetPreparedGeos() const;
+
+    /** Returns the prepared geometry for a predicate with this geometry as first operand. The geometry
+        is prepared once it is used in a second predicate. Returns 0 if it is not (yet) prepared
+        and mGeos has to be used instead */
+    const GEOSPreparedGeometry* preparedGeosForRelOp() const;
+
     /** Insert a new vertex before the given vertex index (first number is index 0)
      *  in the given GEOS Coordinate Sequence.
      *  If the requested vertex number is greater
@@ -612,6 +660,7 @@ class CORE_EXPORT QgsGeometry
     QgsPolygon asPolygon( QgsConstWkbPtr &wkbPtr, bool hasZValue ) const;
 
     static bool geosRelOp( char( *op )( const GEOSGeometry*, const GEOSGeometry * ),
+                           char( *preparedOp )( const GEOSPreparedGeometry*, const GEOSGeometry * ),
                            const QgsGeometry* a, const QgsGeometry* b );
 
     /**Returns < 0 if point(x/y) is left of the line x1,y1 -> x1,y2*/
@@ -2,6 +2,10 @@
 
 #include "qgsvectorlayereditbuffer.h"
 
+#include <QSettings>
+
+#include <cmath>
+
 QgsGeometryCache::QgsGeometryCache()
 {
 }
@@ -36,3 +40,317 @@ void QgsGeometryCache::deleteCachedGeometries()
   mCachedGeometries.clear();
   mCachedGeometriesRect = QgsRectangle();
 }
+
+
+// -------------------------------------------------------------------------
+
+// iterates over the features of a multi-resolution cache entry
+class QgsMultiResolutionGeometryCacheIterator : public QgsAbstractFeatureIterator
+{
+  public:
+    QgsMultiResolutionGeometryCacheIterator( QgsMultiResolutionGeometryCache::EntryPtr entry, const QgsFeatureRequest& request )
+        : QgsAbstractFeatureIterator( request )
+        , mEntry( entry )
+        , mRow( 0 )
+    {
+    }
+
+    bool rewind()
+    {
+      mRow = 0;
+      return true;
+    }
+
+    bool close()
+    {
+      mClosed = true;
+      return true;
+    }
+
+  protected:
+    bool fetchFeature( QgsFeature& f )
+    {
+      if ( mClosed )
+        return false;
+
+      bool filterRect = mRequest.filterType() == QgsFeatureRequest::FilterRect;
+      bool fetchGeometry = !( mRequest.flags() & QgsFeatureRequest::NoGeometry );
+      const QgsAttributeList* attributes = 0;
+      if (( mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes ) && mRequest.filterType() != QgsFeatureRequest::FilterExpression )
+        attributes = &mRequest.subsetOfAttributes();
+
+      const QgsColumnarFeatureStore& store = mEntry->features;
+      while ( mRow < store.count() )
+      {
+        int row = mRow++;
+        if ( filterRect && !mEntry->boundingBoxes[row].intersects( mRequest.filterRect() ) )
+          continue;
+
+        store.featureAt( row, f, fetchGeometry, attributes );
+        if ( mRequest.filterType() == QgsFeatureRequest::FilterFid && f.id() != mRequest.filterFid() )
+          continue;
+
+        return true;
+      }
+
+      close();
+      return false;
+    }
+
+  private:
+    QgsMultiResolutionGeometryCache::EntryPtr mEntry;
+    int mRow;
+};
+
+
+// streams the features of a source iterator and collects them in a new cache entry
+class QgsMultiResolutionGeometryCacheFillIterator : public QgsAbstractFeatureIterator
+{
+  public:
+    QgsMultiResolutionGeometryCacheFillIterator( QgsMultiResolutionGeometryCache* cache, const QString& layerId, int generation, int band,
+        const QStringList& attributes, QgsMultiResolutionGeometryCache::Entry* entry,
+        const QgsFeatureIterator& source, const QgsRectangle& filterRect )
+        : QgsAbstractFeatureIterator( QgsFeatureRequest() )
+        , mCache( cache )
+        , mLayerId( layerId )
+        , mGeneration( generation )
+        , mBand( band )
+        , mAttributes( attributes )
+        , mEntry( entry )
+        , mSource( source )
+        , mFilterRect( filterRect )
+    {
+    }
+
+    ~QgsMultiResolutionGeometryCacheFillIterator()
+    {
+      close();
+    }
+
+    bool rewind()
+    {
+      // the source is only iterated once
+      return false;
+    }
+
+    bool close()
+    {
+      if ( mClosed )
+        return false;
+
+      if ( mEntry )
+      {
+        // not all features have been collected
+        mCache->abandonEntry( mLayerId, mBand, mAttributes );
+        delete mEntry;
+        mEntry = 0;
+      }
+
+      mSource.close();
+      mClosed = true;
+      return true;
+    }
+
+  protected:
+    bool fetchFeature( QgsFeature& f )
+    {
+      if ( mClosed )
+        return false;
+
+      while ( mSource.nextFeature( f ) )
+      {
+        if ( !f.geometry() )
+          continue;
+
+        QgsRectangle bbox = f.geometry()->boundingBox();
+        mEntry->features.insert( f );
+        mEntry->boundingBoxes.append( bbox );
+
+        if ( bbox.intersects( mFilterRect ) )
+          return true;
+      }
+
+      mCache->insertEntry( mLayerId, mGeneration, mBand, mAttributes, mEntry );
+      mEntry = 0;
+      close();
+      return false;
+    }
+
+  private:
+    QgsMultiResolutionGeometryCache* mCache;
+    QString mLayerId;
+    int mGeneration;
+    int mBand;
+    QStringList mAttributes;
+    QgsMultiResolutionGeometryCache::Entry* mEntry;
+    QgsFeatureIterator mSource;
+    QgsRectangle mFilterRect;
+};
+
+
+QgsMultiResolutionGeometryCache* QgsMultiResolutionGeometryCache::instance()
+{
+  static QgsMultiResolutionGeometryCache sInstance;
+  return &sInstance;
+}
+
+QgsMultiResolutionGeometryCache::QgsMultiResolutionGeometryCache()
+    : mSize( 0 )
+    , mUseCounter( 0 )
+{
+  QSettings settings;
+  mMaximumSize = ( qint64 ) settings.value( "/qgis/simplifiedGeometryCacheSize", 256 ).toInt() * 1024 * 1024;
+}
+
+int QgsMultiResolutionGeometryCache::band( double tolerance )
+{
+  return ( int ) floor( log( tolerance ) / log( 2.0 ) );
+}
+
+double QgsMultiResolutionGeometryCache::bandTolerance( int band )
+{
+  return pow( 2.0, band );
+}
+
+QString QgsMultiResolutionGeometryCache::key( const QString& layerId, int band, const QStringList& attributes )
+{
+  QStringList attrs = attributes;
+  attrs.sort();
+  return layerId + "|" + QString::number( band ) + "|" + attrs.join( "," );
+}
+
+int QgsMultiResolutionGeometryCache::generation( const QString& layerId ) const
+{
+  QMutexLocker locker( &mMutex );
+  return mGenerations.value( layerId, 0 );
+}
+
+QgsMultiResolutionGeometryCache::EntryPtr QgsMultiResolutionGeometryCache::entry( const QString& layerId, int band, const QStringList& attributes, const QgsRectangle& extent )
+{
+  QMutexLocker locker( &mMutex );
+
+  // finer geometries are good enough too
+  for ( int b = band; b >= band - 1; --b )
+  {
+    QHash<QString, Slot>::iterator it = mSlots.find( key( layerId, b, attributes ) );
+    if ( it != mSlots.end() && it->entry->extent.contains( extent ) )
+    {
+      it->lastUse = ++mUseCounter;
+      return it->entry;
+    }
+  }
+
+  return EntryPtr();
+}
+
+QgsMultiResolutionGeometryCache::EntryPtr QgsMultiResolutionGeometryCache::insertEntry( const QString& layerId, int generation, int band, const QStringList& attributes, Entry* entry )
+{
+  EntryPtr ptr( entry );
+
+  QMutexLocker locker( &mMutex );
+
+  QString k = key( layerId, band, attributes );
+  mReserved.remove( k );
+
+  // the layer has changed while the entry was built
+  if ( generation != mGenerations.value( layerId, 0 ) )
+    return ptr;
+
+  qint64 bytes = entry->features.memoryUsage() + entry->boundingBoxes.capacity() * sizeof( QgsRectangle );
+  if ( bytes > mMaximumSize )
+    return ptr;
+
+  if ( mSlots.contains( k ) )
+    mSize -= mSlots[k].bytes;
+
+  Slot slot;
+  slot.layerId = layerId;
+  slot.entry = ptr;
+  slot.bytes = bytes;
+  slot.lastUse = ++mUseCounter;
+  mSlots.insert( k, slot );
+  mSize += bytes;
+
+  trim();
+
+  return ptr;
+}
+
+bool QgsMultiResolutionGeometryCache::reserveEntry( const QString& layerId, int band, const QStringList& attributes )
+{
+  QMutexLocker locker( &mMutex );
+
+  QString k = key( layerId, band, attributes );
+  if ( mReserved.contains( k ) )
+    return false;
+
+  mReserved.insert( k );
+  return true;
+}
+
+void QgsMultiResolutionGeometryCache::abandonEntry( const QString& layerId, int band, const QStringList& attributes )
+{
+  QMutexLocker locker( &mMutex );
+  mReserved.remove( key( layerId, band, attributes ) );
+}
+
+QgsFeatureIterator QgsMultiResolutionGeometryCache::fillEntry( const QString& layerId, int generation, int band, const QStringList& attributes,
+    Entry* entry, const QgsFeatureIterator& source, const QgsRectangle& filterRect )
+{
+  return QgsFeatureIterator( new QgsMultiResolutionGeometryCacheFillIterator( this, layerId, generation, band, attributes, entry, source, filterRect ) );
+}
+
+QgsFeatureIterator QgsMultiResolutionGeometryCache::getFeatures( EntryPtr entry, const QgsFeatureRequest& request )
+{
+  return QgsFeatureIterator( new QgsMultiResolutionGeometryCacheIterator( entry, request ) );
+}
+
+void QgsMultiResolutionGeometryCache::invalidate( const QString& layerId )
+{
+  QMutexLocker locker( &mMutex );
+
+  mGenerations[layerId] = mGenerations.value( layerId, 0 ) + 1;
+
+  QHash<QString, Slot>::iterator it = mSlots.begin();
+  while ( it != mSlots.end() )
+  {
+    if ( it->layerId == layerId )
+    {
+      mSize -= it->bytes;
+      it = mSlots.erase( it );
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+void QgsMultiResolutionGeometryCache::setMaximumSize( qint64 bytes )
+{
+  QMutexLocker locker( &mMutex );
+  mMaximumSize = bytes;
+  trim();
+}
+
+qint64 QgsMultiResolutionGeometryCache::size() const
+{
+  QMutexLocker locker( &mMutex );
+  return mSize;
+}
+
+void QgsMultiResolutionGeometryCache::trim()
+{
+  while ( mSize > mMaximumSize && !mSlots.isEmpty() )
+  {
+    QHash<QString, Slot>::iterator oldest = mSlots.begin();
+    for ( QHash<QString, Slot>::iterator it = mSlots.begin(); it != mSlots.end(); ++it )
+    {
+      if ( it->lastUse < oldest->lastUse )
+        oldest = it;
+    }
+
+    mSize -= oldest->bytes;
+    mSlots.erase( oldest );
+  }
+}
@@ -3,9 +3,16 @@
 
 #include "qgsgeometry.h"
 #include "qgsfeature.h"
+#include "qgsfeatureiterator.h"
+#include "qgscolumnarfeaturestore.h"
 #include "qgsrectangle.h"
 
+#include <QHash>
 #include <QMap>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
 
 class CORE_EXPORT QgsGeometryCache
 {
@@ -41,4 +48,106 @@ class CORE_EXPORT QgsGeometryCache
 
 };
 
+
+/** \ingroup core
+ * Cache of geometries simplified for rendering, shared by all renderers of a layer.
+ *
+ * Geometries are kept for scale bands: a band covers a factor of two of the simplification
+ * tolerance and its geometries are simplified with the smallest tolerance of the band, so they
+ * are never coarser than requested. An entry holds the features of a layer within an extent
+ * for one band and one set of attributes. The cache is thread safe, entries are immutable
+ * once inserted.
+ *
+ * @note added in 2.4
+ * @note not available in python bindings
+ */
+class CORE_EXPORT QgsMultiResolutionGeometryCache
+{
+  public:
+    //! Features of a layer within an extent, simplified for one scale band
+    struct Entry
+    {
+      //! area for which the entry holds all features
+      QgsRectangle extent;
+      QgsColumnarFeatureStore features;
+      //! bounding boxes of the simplified geometries by row of the feature store
+      QVector<QgsRectangle> boundingBoxes;
+    };
+
+    typedef QSharedPointer<const Entry> EntryPtr;
+
+    static QgsMultiResolutionGeometryCache* instance();
+
+    //! returns scale band for simplification tolerance (in layer units)
+    static int band( double tolerance );
+
+    //! returns tolerance used to simplify geometries of a band
+    static double bandTolerance( int band );
+
+    //! returns generation of the layer's data. Entries built for an older generation are not stored.
+    int generation( const QString& layerId ) const;
+
+    //! returns entry covering the extent or null pointer. An entry of the next finer band may be returned.
+    EntryPtr entry( const QString& layerId, int band, const QStringList& attributes, const QgsRectangle& extent );
+
+    //! stores an entry (takes ownership) and returns it. Replaces the entry with the same key and ends its reservation.
+    EntryPtr insertEntry( const QString& layerId, int generation, int band, const QStringList& attributes, Entry* entry );
+
+    /** Reserves the key of an entry for a renderer that is going to build it. Returns false if another
+     * renderer is already building an entry with the key, so that concurrent renderers (e.g. tiles of
+     * the same map) do not replace each other's entries.
+     */
+    bool reserveEntry( const QString& layerId, int band, const QStringList& attributes );
+
+    //! ends the reservation of a key without storing an entry
+    void abandonEntry( const QString& layerId, int band, const QStringList& attributes );
+
+    /** Returns iterator over the features of source which intersect filterRect. All features of source are
+     * collected in entry (takes ownership) while they are iterated. Once source is exhausted, the entry is
+     * stored with insertEntry(). If the iterator is closed earlier, the entry is dropped and the reservation ends.
+     */
+    QgsFeatureIterator fillEntry( const QString& layerId, int generation, int band, const QStringList& attributes,
+                                  Entry* entry, const QgsFeatureIterator& source, const QgsRectangle& filterRect );
+
+    //! returns iterator over cached features, supports rectangle filter, attribute subset and NoGeometry flag
+    static QgsFeatureIterator getFeatures( EntryPtr entry, const QgsFeatureRequest& request );
+
+    //! drops all entries of the layer, to be called whenever its data or fields change
+    void invalidate( const QString& layerId );
+
+    //! set maximum memory used by the cache in bytes
+    void setMaximumSize( qint64 bytes );
+
+    qint64 maximumSize() const { return mMaximumSize; }
+
+    //! returns memory used by the cached entries in bytes
+    qint64 size() const;
+
+  protected:
+    QgsMultiResolutionGeometryCache();
+
+  private:
+    struct Slot
+    {
+      QString layerId;
+      EntryPtr entry;
+      qint64 bytes;
+      quint64 lastUse;
+    };
+
+    static QString key( const QString& layerId, int band, const QStringList& attributes );
+
+    //! drop least recently used entries until the cache fits into its size limit
+    void trim();
+
+    mutable QMutex mMutex;
+    QHash<QString, Slot> mSlots;
+    QHash<QString, int> mGenerations;
+    //! keys of the entries being built
+    QSet<QString> mReserved;
+    qint64 mSize;
+    qint64 mMaximumSize;
+    quint64 mUseCounter;
+};
+
 #endif // QGSGEOMETRYCACHE_H
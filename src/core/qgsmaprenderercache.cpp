@@ -1,10 +1,16 @@
 
 #include "qgsmaprenderercache.h"
 
+#include <QPainter>
+
+#include "qgis.h"
 #include "qgsmaplayerregistry.h"
 #include "qgsmaplayer.h"
 
 QgsMapRendererCache::QgsMapRendererCache()
+    : mMaxMemory( Q_INT64_C( 256 ) * 1024 * 1024 )
+    , mMemoryUsage( 0 )
+    , mUseCounter( 0 )
 {
   clear();
 }
@@ -30,6 +36,7 @@ void QgsMapRendererCache::clearInternal()
     }
   }
   mCachedImages.clear();
+  mMemoryUsage = 0;
 }
 
 bool QgsMapRendererCache::init( QgsRectangle extent, double scale )
@@ -41,9 +48,7 @@ bool QgsMapRendererCache::init( QgsRectangle extent, double scale )
        scale == mScale )
     return true;
 
-  clearInternal();
-
-  // set new params
+  // set new params - images of the old ones are kept for partial reuse
   mExtent = extent;
   mScale = scale;
 
@@ -53,20 +58,145 @@ bool QgsMapRendererCache::init( QgsRectangle extent, double scale )
 void QgsMapRendererCache::setCacheImage( QString layerId, const QImage& img )
 {
   QMutexLocker lock( &mMutex );
-  mCachedImages[layerId] = img;
 
-  // connect to the layer to listen to layer's repaintRequested() signals
-  QgsMapLayer* layer = QgsMapLayerRegistry::instance()->mapLayer( layerId );
-  if ( layer )
+  QList<CacheEntry>& entries = mCachedImages[layerId];
+  bool connectLayer = entries.isEmpty();
+
+  // replace image of the same parameters if there is one already
+  for ( int i = 0; i < entries.count(); ++i )
   {
-    connect( layer, SIGNAL( repaintRequested() ), this, SLOT( layerRequestedRepaint() ) );
+    if ( entries[i].extent == mExtent && entries[i].scale == mScale )
+    {
+      mMemoryUsage -= entries[i].image.byteCount();
+      entries.removeAt( i );
+      break;
+    }
   }
+
+  CacheEntry entry;
+  entry.image = img;
+  entry.extent = mExtent;
+  entry.scale = mScale;
+  entry.lastUsed = ++mUseCounter;
+  entries.append( entry );
+  mMemoryUsage += img.byteCount();
+
+  if ( connectLayer )
+  {
+    // connect to the layer to listen to layer's repaintRequested() signals
+    QgsMapLayer* layer = QgsMapLayerRegistry::instance()->mapLayer( layerId );
+    if ( layer )
+    {
+      connect( layer, SIGNAL( repaintRequested() ), this, SLOT( layerRequestedRepaint() ) );
+    }
+  }
+
+  evictInternal();
 }
 
 QImage QgsMapRendererCache::cacheImage( QString layerId )
 {
   QMutexLocker lock( &mMutex );
-  return mCachedImages.value( layerId );
+
+  QMap<QString, QList<CacheEntry> >::iterator it = mCachedImages.find( layerId );
+  if ( it == mCachedImages.end() )
+    return QImage();
+
+  for ( QList<CacheEntry>::iterator eit = it->begin(); eit != it->end(); ++eit )
+  {
+    if ( eit->extent == mExtent && eit->scale == mScale )
+    {
+      eit->lastUsed = ++mUseCounter;
+      return eit->image;
+    }
+  }
+  return QImage();
+}
+
+QImage QgsMapRendererCache::partialCacheImage( QString layerId, const QgsRectangle& extent, const QSize& size, QList<QRect>& exposedRects )
+{
+  exposedRects.clear();
+
+  if ( size.isEmpty() || extent.isEmpty() )
+    return QImage();
+
+  QRect outputRect( QPoint( 0, 0 ), size );
+  double mupp = extent.width() / size.width();
+
+  QImage cachedImage;
+  QPoint offset; // position of the cached image within the output
+  QRect validRect; // part of the output covered by the cached image
+
+  mMutex.lock();
+
+  // pick the image that covers the largest part of the requested extent
+  QList<CacheEntry>& entries = mCachedImages[layerId];
+  CacheEntry* bestEntry = 0;
+  int bestArea = 0;
+  for ( QList<CacheEntry>::iterator it = entries.begin(); it != entries.end(); ++it )
+  {
+    if ( it->image.isNull() || !qgsDoubleNearSig( it->scale, mScale ) )
+      continue;
+
+    double entryMupp = it->extent.width() / it->image.width();
+    if ( !qgsDoubleNearSig( entryMupp, mupp, 6 ) )
+      continue;
+
+    // only whole-pixel shifts can be reused without resampling
+    double dx = ( it->extent.xMinimum() - extent.xMinimum() ) / mupp;
+    double dy = ( extent.yMaximum() - it->extent.yMaximum() ) / mupp;
+    if ( qAbs( dx - qRound( dx ) ) > 0.01 || qAbs( dy - qRound( dy ) ) > 0.01 )
+      continue;
+
+    QPoint entryOffset( qRound( dx ), qRound( dy ) );
+    QRect rect = QRect( entryOffset, it->image.size() ).intersected( outputRect );
+    int area = rect.width() * rect.height();
+    if ( !rect.isEmpty() && area > bestArea )
+    {
+      bestEntry = &*it;
+      bestArea = area;
+      offset = entryOffset;
+      validRect = rect;
+    }
+  }
+
+  if ( bestEntry )
+  {
+    bestEntry->lastUsed = ++mUseCounter;
+    cachedImage = bestEntry->image;
+  }
+  else if ( entries.isEmpty() )
+    mCachedImages.remove( layerId );
+
+  mMutex.unlock();
+
+  if ( cachedImage.isNull() )
+    return QImage();
+
+  QImage img( size, QImage::Format_ARGB32_Premultiplied );
+  if ( img.isNull() )
+    return QImage();
+  img.fill( 0 );
+
+  QPainter painter( &img );
+  painter.setCompositionMode( QPainter::CompositionMode_Source );
+  painter.drawImage( offset, cachedImage );
+  painter.end();
+
+  // parts of the output not covered by the cached image: full-width strips above and below,
+  // then the remaining parts on the left and right side
+  QList<QRect> rects;
+  rects << QRect( 0, 0, size.width(), validRect.top() );
+  rects << QRect( 0, validRect.bottom() + 1, size.width(), size.height() - validRect.bottom() - 1 );
+  rects << QRect( 0, validRect.top(), validRect.left(), validRect.height() );
+  rects << QRect( validRect.right() + 1, validRect.top(), size.width() - validRect.right() - 1, validRect.height() );
+  foreach ( QRect rect, rects )
+  {
+    if ( !rect.isEmpty() )
+      exposedRects << rect;
+  }
+
+  return img;
 }
 
 void QgsMapRendererCache::layerRequestedRepaint()
@@ -80,6 +210,8 @@ void QgsMapRendererCache::clearCacheImage( QString layerId )
 {
   QMutexLocker lock( &mMutex );
 
+  foreach ( const CacheEntry& entry, mCachedImages.value( layerId ) )
+    mMemoryUsage -= entry.image.byteCount();
   mCachedImages.remove( layerId );
 
   QgsMapLayer* layer = QgsMapLayerRegistry::instance()->mapLayer( layerId );
@@ -88,3 +220,50 @@ void QgsMapRendererCache::clearCacheImage( QString layerId )
     disconnect( layer, SIGNAL( repaintRequested() ), this, SLOT( layerRequestedRepaint() ) );
   }
 }
+
+void QgsMapRendererCache::setMaxMemory( qint64 bytes )
+{
+  QMutexLocker lock( &mMutex );
+  mMaxMemory = bytes;
+  evictInternal();
+}
+
+void QgsMapRendererCache::evictInternal()
+{
+  while ( mMemoryUsage > mMaxMemory )
+  {
+    // find the least recently used image
+    QString lruLayerId;
+    int lruIndex = -1;
+    unsigned int lruUse = 0;
+    for ( QMap<QString, QList<CacheEntry> >::const_iterator it = mCachedImages.constBegin(); it != mCachedImages.constEnd(); ++it )
+    {
+      for ( int i = 0; i < it->count(); ++i )
+      {
+        if ( lruIndex == -1 || it->at( i ).lastUsed < lruUse )
+        {
+          lruLayerId = it.key();
+          lruIndex = i;
+          lruUse = it->at( i ).lastUsed;
+        }
+      }
+    }
+
+    if ( lruIndex == -1 )
+      break;
+
+    QList<CacheEntry>& entries = mCachedImages[lruLayerId];
+    mMemoryUsage -= entries[lruIndex].image.byteCount();
+    entries.removeAt( lruIndex );
+    if ( entries.isEmpty() )
+    {
+      mCachedImages.remove( lruLayerId );
+
+      QgsMapLayer* layer = QgsMapLayerRegistry::instance()->mapLayer( lruLayerId );
+      if ( layer )
+      {
+        disconnect( layer, SIGNAL( repaintRequested() ), this, SLOT( layerRequestedRepaint() ) );
+      }
+    }
+  }
+}
@@ -3,7 +3,9 @@
 
 #include <QMap>
 #include <QImage>
+#include <QList>
 #include <QMutex>
+#include <QRect>
 
 #include "qgsrectangle.h"
 
@@ -15,7 +17,12 @@
  * the cache listens to repaintRequested() signals from layer. If triggered, the cache
  * removes the rendered image (and disconnects from the layer).
  *
- * The class is thread-safe (multiple classes can access the same instance safely). 
+ * Images are kept together with the extent and scale they were rendered for, so images
+ * of previous extents stay available: after a pan the still valid part of an old image
+ * can be reused with partialCacheImage() and only the newly exposed parts need to be rendered.
+ * The total size of cached images is limited - least recently used images get evicted first.
+ *
+ * The class is thread-safe (multiple classes can access the same instance safely).
  *
  * @note added in 2.4
  */
@@ -29,7 +36,8 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
     //! invalidate the cache contents
     void clear();
 
-    //! initialize cache: set new parameters and erase cache if parameters have changed
+    //! initialize cache: set new parameters for which images are stored and looked up.
+    //! Images of other extents and scales are kept (until evicted) for partial reuse.
     //! @return flag whether the parameters are the same as last time
     bool init( QgsRectangle extent, double scale );
 
@@ -39,9 +47,26 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
     //! get cached image for the specified layer ID. Returns null image if it is not cached.
     QImage cacheImage( QString layerId );
 
+    //! get image for the specified layer ID assembled from an image cached for another extent
+    //! at the same scale (e.g. before panning). The parts of the image that could not be taken
+    //! from the cache are transparent and returned in exposedRects (in pixels).
+    //! Returns null image if there is no usable image in the cache.
+    //! @note added in 2.4
+    QImage partialCacheImage( QString layerId, const QgsRectangle& extent, const QSize& size, QList<QRect>& exposedRects );
+
     //! remove layer from the cache
     void clearCacheImage( QString layerId );
 
+    //! set maximal memory (in bytes) occupied by cached images
+    //! @note added in 2.4
+    void setMaxMemory( qint64 bytes );
+    //! return maximal memory (in bytes) occupied by cached images
+    //! @note added in 2.4
+    qint64 maxMemory() const { return mMaxMemory; }
+    //! return memory (in bytes) currently occupied by cached images
+    //! @note added in 2.4
+    qint64 memoryUsage() const { return mMemoryUsage; }
+
   protected slots:
     //! remove layer (that emitted the signal) from the cache
     void layerRequestedRepaint();
@@ -50,11 +75,26 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
     //! invalidate cache contents (without locking)
     void clearInternal();
 
+    //! remove least recently used images until the memory limit is respected (without locking)
+    void evictInternal();
+
+    struct CacheEntry
+    {
+      QImage image;
+      QgsRectangle extent;
+      double scale;
+      unsigned int lastUsed;
+    };
+
   protected:
     QMutex mMutex;
     QgsRectangle mExtent;
     double mScale;
-    QMap<QString, QImage> mCachedImages;
+    QMap<QString, QList<CacheEntry> > mCachedImages;
+    qint64 mMaxMemory;
+    qint64 mMemoryUsage;
+    //! incremented on each access to provide LRU ordering
+    unsigned int mUseCounter;
 };
 
 
@@ -14,8 +14,13 @@
 #include "qgsmaplayerrenderer.h"
 #include "qgsmaprenderercache.h"
 #include "qgspallabeling.h"
+#include "qgsvectorlayer.h"
 #include "qgsvectorlayerrenderer.h"
 
+//! extra margin (in pixels) around partially rendered vector layers (tiles, exposed parts)
+//! so that symbols of features just outside of the rendered part still get drawn into it
+#define RENDER_MARGIN_PIXELS 32
+
 
 QgsMapRendererJob::QgsMapRendererJob( const QgsMapSettings& settings )
     : mSettings( settings )
@@ -77,6 +82,7 @@ void QgsMapRendererSequentialJob::start()
   mRenderingStart.start();
 
   mErrors.clear();
+  mLayerStatistics.clear();
 
   QgsDebugMsg( "SEQUENTIAL START" );
 
@@ -146,6 +152,7 @@ void QgsMapRendererSequentialJob::internalFinished()
   mLabelingResults = mInternalJob->takeLabelingResults();
 
   mErrors = mInternalJob->errors();
+  mLayerStatistics = mInternalJob->layerStatistics();
 
   // now we are in a slot called from mInternalJob - do not delete it immediately
   // so the class is still valid when the execution returns to the class
@@ -191,6 +198,7 @@ void QgsMapRendererCustomPainterJob::start()
   mActive = true;
 
   mErrors.clear();
+  mLayerStatistics.clear();
 
   QgsDebugMsg( "QPAINTER run!" );
 
@@ -335,12 +343,19 @@ void QgsMapRendererCustomPainterJob::doRender()
     }
 
     if ( !job.cached )
+    {
+      QTime layerTime;
+      layerTime.start();
       job.renderer->render();
+      job.renderingTime = layerTime.elapsed();
+      job.featureCount = renderedFeatureCount( job.renderer );
+      job.finished = !job.context.renderingStopped();
+    }
 
     if ( job.img )
     {
       // If we flattened this layer for alternate blend modes, composite it now
-      mPainter->drawImage( 0, 0, *job.img );
+      mPainter->drawImage( job.offset, *job.img );
     }
 
   }
@@ -595,9 +610,15 @@ LayerRenderJobs QgsMapRendererJob::prepareJobs( QPainter* painter, QgsPalLabelin
     layerJobs.append( LayerRenderJob() );
     LayerRenderJob& job = layerJobs.last();
     job.cached = false;
+    job.partial = false;
     job.img = 0;
     job.blendMode = ml->blendMode();
     job.layerId = ml->id();
+    job.renderingTime = 0;
+    job.featureCount = -1;
+    job.finished = false;
+    job.pendingTiles = 0;
+    job.offset = QPoint( 0, 0 );
 
     job.context = QgsRenderContext::fromMapSettings( mSettings );
     job.context.setPainter( painter );
@@ -609,44 +630,26 @@ LayerRenderJobs QgsMapRendererJob::prepareJobs( QPainter* painter, QgsPalLabelin
     if ( mCache && !mCache->cacheImage( ml->id() ).isNull() )
     {
       job.cached = true;
+      job.finished = true;
       job.img = new QImage( mCache->cacheImage( ml->id() ) );
       job.renderer = 0;
       job.context.setPainter( 0 );
       continue;
     }
 
-    // If we are drawing with an alternative blending mode then we need to render to a separate image
-    // before compositing this on the map. This effectively flattens the layer and prevents
-    // blending occuring between objects on the layer
-    if ( mCache || !painter || needTemporaryImage( ml ) )
+    // maybe at least part of the image is cached (e.g. after panning) - render just the rest
+    if ( mCache )
     {
-      // Flattened image for drawing when a blending mode is set
-      QImage * mypFlattenedImage = 0;
-      mypFlattenedImage = new QImage( mSettings.outputSize().width(),
-                                      mSettings.outputSize().height(), QImage::Format_ARGB32_Premultiplied );
-      if ( mypFlattenedImage->isNull() )
-      {
-        mErrors.append( Error( layerId, "Insufficient memory for image " + QString::number( mSettings.outputSize().width() ) + "x" + QString::number( mSettings.outputSize().height() ) ) );
-        delete mypFlattenedImage;
-        layerJobs.removeLast();
+      QList<QRect> exposedRects;
+      QImage partialImage = mCache->partialCacheImage( ml->id(), mSettings.visibleExtent(), mSettings.outputSize(), exposedRects );
+      if ( !partialImage.isNull() && preparePartialJobs( layerJobs, ml, painter, partialImage, exposedRects ) )
         continue;
-      }
-      mypFlattenedImage->fill( 0 );
-
-      job.img = mypFlattenedImage;
-      QPainter* mypPainter = new QPainter( job.img );
-      mypPainter->setRenderHint( QPainter::Antialiasing, mSettings.testFlag( QgsMapSettings::Antialiasing ) );
-      job.context.setPainter( mypPainter );
     }
 
-    job.renderer = ml->createMapRenderer( job.context );
-
-    if ( mRequestedGeomCacheForLayers.contains( ml->id() ) )
+    if ( !prepareJobRenderer( job, ml, painter, mSettings.outputSize() ) )
     {
-      if ( QgsVectorLayerRenderer* vlr = dynamic_cast<QgsVectorLayerRenderer*>( job.renderer ) )
-      {
-        vlr->setGeometryCachePointer( &mGeometryCaches[ ml->id()] );
-      }
+      layerJobs.removeLast();
+      continue;
     }
 
 #if 0
@@ -664,17 +667,173 @@ LayerRenderJobs QgsMapRendererJob::prepareJobs( QPainter* painter, QgsPalLabelin
 
 
 
+bool QgsMapRendererJob::prepareJobRenderer( LayerRenderJob& job, QgsMapLayer* ml, QPainter* painter, const QSize& imageSize )
+{
+  // If we are drawing with an alternative blending mode then we need to render to a separate image
+  // before compositing this on the map. This effectively flattens the layer and prevents
+  // blending occuring between objects on the layer
+  if ( mCache || !painter || needTemporaryImage( ml ) )
+  {
+    // Flattened image for drawing when a blending mode is set
+    QImage * mypFlattenedImage = 0;
+    mypFlattenedImage = new QImage( imageSize.width(),
+                                    imageSize.height(), QImage::Format_ARGB32_Premultiplied );
+    if ( mypFlattenedImage->isNull() )
+    {
+      mErrors.append( Error( job.layerId, "Insufficient memory for image " + QString::number( imageSize.width() ) + "x" + QString::number( imageSize.height() ) ) );
+      delete mypFlattenedImage;
+      return false;
+    }
+    mypFlattenedImage->fill( 0 );
+
+    job.img = mypFlattenedImage;
+    QPainter* mypPainter = new QPainter( job.img );
+    mypPainter->setRenderHint( QPainter::Antialiasing, mSettings.testFlag( QgsMapSettings::Antialiasing ) );
+    job.context.setPainter( mypPainter );
+  }
+
+  job.renderer = ml->createMapRenderer( job.context );
+
+  if ( mRequestedGeomCacheForLayers.contains( ml->id() ) )
+  {
+    if ( QgsVectorLayerRenderer* vlr = dynamic_cast<QgsVectorLayerRenderer*>( job.renderer ) )
+    {
+      vlr->setGeometryCachePointer( &mGeometryCaches[ ml->id()] );
+    }
+  }
+
+  return true;
+}
+
+
+bool QgsMapRendererJob::preparePartialJobs( LayerRenderJobs& layerJobs, QgsMapLayer* ml, QPainter* painter, const QImage& cachedImage, const QList<QRect>& exposedRects )
+{
+  // the geometry cache would only get geometries of the exposed parts
+  if ( mRequestedGeomCacheForLayers.contains( ml->id() ) )
+    return false;
+
+  // the parts are rendered into images of their own size with a shifted map to pixel transform,
+  // like the tiles of the parallel renderer. Plugin layers may not respect the transform
+  if ( ml->type() != QgsMapLayer::VectorLayer && ml->type() != QgsMapLayer::RasterLayer )
+    return false;
+
+  LayerRenderJob& job = layerJobs.last();
+  const QgsCoordinateTransform* ct = job.context.coordinateTransform();
+  int margin = ml->type() == QgsMapLayer::VectorLayer ? RENDER_MARGIN_PIXELS : 0;
+  const QgsMapToPixel& mtp = mSettings.mapToPixel();
+  double mupp = mSettings.mapUnitsPerPixel();
+
+  // the cached part does not need rendering
+  job.cached = true;
+  job.finished = true;
+  job.img = new QImage( cachedImage );
+  job.renderer = 0;
+  job.context.setPainter( 0 );
+
+  foreach ( QRect rect, exposedRects )
+  {
+    LayerRenderJob partJob = job;
+    partJob.cached = false;
+    partJob.partial = true;
+    partJob.finished = false;
+    partJob.img = 0;
+    partJob.offset = rect.topLeft();
+    partJob.context.setPainter( painter );
+    QgsPoint topLeft = mtp.toMapCoordinatesF( rect.left(), rect.top() );
+    QgsPoint bottomRight = mtp.toMapCoordinatesF( rect.left() + rect.width(), rect.top() + rect.height() );
+    partJob.context.setMapToPixel( QgsMapToPixel( mupp, rect.height(), bottomRight.y(), topLeft.x() ) );
+    partJob.context.setExtent( outputRectToLayerExtent( ml, ct, rect, margin, job.context.extent() ) );
+    layerJobs.append( partJob );
+
+    // only the exposed part gets an image
+    LayerRenderJob& newJob = layerJobs.last();
+    if ( !prepareJobRenderer( newJob, ml, painter, rect.size() ) )
+    {
+      layerJobs.removeLast();
+      continue;
+    }
+  }
+
+  return true;
+}
+
+
+QgsRectangle QgsMapRendererJob::outputRectToLayerExtent( QgsMapLayer* ml, const QgsCoordinateTransform* ct, const QRect& rect, int marginPixels, const QgsRectangle& fallbackExtent ) const
+{
+  const QgsMapToPixel& mtp = mSettings.mapToPixel();
+  double margin = marginPixels * mSettings.mapUnitsPerPixel();
+
+  QgsPoint topLeft = mtp.toMapCoordinatesF( rect.left(), rect.top() );
+  QgsPoint bottomRight = mtp.toMapCoordinatesF( rect.left() + rect.width(), rect.top() + rect.height() );
+  QgsRectangle r1( topLeft.x() - margin, bottomRight.y() - margin, bottomRight.x() + margin, topLeft.y() + margin ), r2;
+  if ( ct )
+  {
+    reprojectToLayerExtent( ct, ml->crs().geographicFlag(), r1, r2 );
+    if ( !r1.isFinite() )
+      r1 = fallbackExtent;
+  }
+  return r1;
+}
+
+
+void QgsMapRendererJob::mergePartialJobs( LayerRenderJobs& jobs )
+{
+  LayerRenderJob* mainJob = 0;
+  bool complete = true;
+  for ( LayerRenderJobs::iterator it = jobs.begin(); it != jobs.end(); ++it )
+  {
+    LayerRenderJob& job = *it;
+    if ( !job.partial )
+    {
+      if ( mainJob && complete && mCache )
+        mCache->setCacheImage( mainJob->layerId, *mainJob->img );
+      mainJob = 0;
+      complete = true;
+
+      // parts of the layer follow the cached job
+      LayerRenderJobs::iterator next = it + 1;
+      if ( job.cached && next != jobs.end() && next->partial )
+        mainJob = &job;
+      continue;
+    }
+
+    if ( !mainJob || !job.img )
+      continue;
+
+    if ( job.context.renderingStopped() )
+      complete = false;
+
+    QPainter p( mainJob->img );
+    p.drawImage( job.offset, *job.img );
+    p.end();
+  }
+
+  if ( mainJob && complete && mCache )
+    mCache->setCacheImage( mainJob->layerId, *mainJob->img );
+}
+
+
 void QgsMapRendererJob::cleanupJobs( LayerRenderJobs& jobs )
 {
+  mLayerStatistics += statisticsForJobs( jobs );
+
+  for ( LayerRenderJobs::iterator it = jobs.begin(); it != jobs.end(); ++it )
+  {
+    if ( it->img )
+    {
+      delete it->context.painter();
+      it->context.setPainter( 0 );
+    }
+  }
+
+  mergePartialJobs( jobs );
+
   for ( LayerRenderJobs::iterator it = jobs.begin(); it != jobs.end(); ++it )
   {
     LayerRenderJob& job = *it;
     if ( job.img )
     {
-      delete job.context.painter();
-      job.context.setPainter( 0 );
-
-      if ( mCache && !job.cached && !job.context.renderingStopped() )
+      if ( mCache && !job.cached && !job.partial && !job.context.renderingStopped() )
       {
         QgsDebugMsg( "caching image for " + job.layerId );
         mCache->setCacheImage( job.layerId, *job.img );
@@ -699,14 +858,68 @@ void QgsMapRendererJob::cleanupJobs( LayerRenderJobs& jobs )
   updateLayerGeometryCaches();
 }
 
+QgsMapRendererJob::LayerStatisticsList QgsMapRendererJob::statisticsForJobs( const LayerRenderJobs& jobs )
+{
+  LayerStatisticsList list;
+  for ( LayerRenderJobs::const_iterator it = jobs.constBegin(); it != jobs.constEnd(); ++it )
+  {
+    const LayerRenderJob& job = *it;
+    if ( job.partial && !list.isEmpty() && list.last().layerID == job.layerId )
+    {
+      // exposed parts of a partially cached layer
+      LayerStatistics& stats = list.last();
+      stats.renderingTime += job.renderingTime;
+      if ( job.featureCount >= 0 )
+        stats.featureCount = qMax( stats.featureCount, 0 ) + job.featureCount;
+      stats.finished = stats.finished && job.finished;
+      continue;
+    }
+
+    LayerStatistics stats;
+    stats.layerID = job.layerId;
+    stats.renderingTime = job.renderingTime;
+    stats.featureCount = job.featureCount;
+    stats.cached = job.cached;
+    stats.finished = job.finished;
+    list.append( stats );
+  }
+  return list;
+}
+
+int QgsMapRendererJob::renderedFeatureCount( QgsMapLayerRenderer* renderer )
+{
+  if ( QgsVectorLayerRenderer* vlr = dynamic_cast<QgsVectorLayerRenderer*>( renderer ) )
+    return vlr->featureCount();
+  return -1;
+}
+
 /////////////
 
 
+/** Renders tasks of a parallel job in the job's own thread pool */
+class QgsMapRendererWorker : public QRunnable
+{
+  public:
+    QgsMapRendererWorker( QgsMapRendererParallelJob* job ) : mJob( job ) {}
+
+    void run() { QgsMapRendererParallelJob::renderWorkerStatic( mJob ); }
+
+  private:
+    QgsMapRendererParallelJob* mJob;
+};
+
+
 QgsMapRendererParallelJob::QgsMapRendererParallelJob( const QgsMapSettings& settings )
     : QgsMapRendererQImageJob( settings )
     , mStatus( Idle )
+    , mTiledRendering( false )
+    , mTileSize( 256, 256 )
+    , mMaxThreads( 0 )
+    , mPreviewEnabled( false )
     , mLabelingEngine( 0 )
+    , mLabelingEngineSettings( 0 )
 {
+  connect( &mPreviewTimer, SIGNAL( timeout() ), SLOT( previewTimeout() ) );
 }
 
 QgsMapRendererParallelJob::~QgsMapRendererParallelJob()
@@ -729,25 +942,65 @@ void QgsMapRendererParallelJob::start()
 
   mStatus = RenderingLayers;
 
+  mLayerStatistics.clear();
+  mReportedLayers.clear();
+
   delete mLabelingEngine;
   mLabelingEngine = 0;
 
   if ( mSettings.testFlag( QgsMapSettings::DrawLabeling ) )
   {
     mLabelingEngine = new QgsPalLabeling;
-    mLabelingEngine->loadEngineSettings();
+    if ( mLabelingEngineSettings )
+    {
+      int candPoint, candLine, candPolygon;
+      mLabelingEngineSettings->numCandidatePositions( candPoint, candLine, candPolygon );
+      mLabelingEngine->setNumCandidatePositions( candPoint, candLine, candPolygon );
+      mLabelingEngine->setSearchMethod( mLabelingEngineSettings->searchMethod() );
+      mLabelingEngine->setShowingCandidates( mLabelingEngineSettings->isShowingCandidates() );
+      mLabelingEngine->setShowingShadowRectangles( mLabelingEngineSettings->isShowingShadowRectangles() );
+      mLabelingEngine->setShowingAllLabels( mLabelingEngineSettings->isShowingAllLabels() );
+      mLabelingEngine->setShowingPartialsLabels( mLabelingEngineSettings->isShowingPartialsLabels() );
+    }
+    else
+    {
+      mLabelingEngine->loadEngineSettings();
+    }
     mLabelingEngine->init( mSettings );
   }
 
 
   mLayerJobs = prepareJobs( 0, mLabelingEngine );
 
+  prepareTasks();
+
   // start async job
 
   connect( &mFutureWatcher, SIGNAL( finished() ), SLOT( renderLayersFinished() ) );
 
-  mFuture = QtConcurrent::map( mLayerJobs, renderLayerStatic );
+  if ( mMaxThreads > 0 )
+  {
+    // each worker keeps picking tasks until there are none left. The workers run in the
+    // pool of the job, so that other users of the global pool do not count against the limit
+    int workers = qMin( mMaxThreads, mTasks.count() );
+    mNextTask = 0;
+    mRunningWorkers = workers;
+    mWorkersFuture = QFutureInterface<void>();
+    mWorkersFuture.reportStarted();
+    mFuture = mWorkersFuture.future();
+
+    mThreadPool.setMaxThreadCount( mMaxThreads );
+    for ( int i = 0; i < workers; ++i )
+      mThreadPool.start( new QgsMapRendererWorker( this ) );
+    if ( workers == 0 )
+      mWorkersFuture.reportFinished();
+  }
+  else
+    mFuture = QtConcurrent::map( mTasks, renderTaskStatic );
   mFutureWatcher.setFuture( mFuture );
+
+  if ( mPreviewEnabled )
+    mPreviewTimer.start();
 }
 
 void QgsMapRendererParallelJob::cancel()
@@ -762,6 +1015,10 @@ void QgsMapRendererParallelJob::cancel()
   {
     it->context.setRenderingStopped( true );
   }
+  for ( LayerRenderTiles::iterator it = mLayerTiles.begin(); it != mLayerTiles.end(); ++it )
+  {
+    it->context.setRenderingStopped( true );
+  }
 
   if ( mStatus == RenderingLayers )
   {
@@ -833,7 +1090,10 @@ QgsLabelingResults* QgsMapRendererParallelJob::takeLabelingResults()
 QImage QgsMapRendererParallelJob::renderedImage()
 {
   if ( mStatus == RenderingLayers )
+  {
+    QMutexLocker locker( &mTileMutex );
     return composeImage( mSettings, mLayerJobs );
+  }
   else
     return mFinalImage; // when rendering labels or idle
 }
@@ -842,9 +1102,13 @@ void QgsMapRendererParallelJob::renderLayersFinished()
 {
   Q_ASSERT( mStatus == RenderingLayers );
 
+  mPreviewTimer.stop();
+  reportLayers( true );
+
   // compose final image
   mFinalImage = composeImage( mSettings, mLayerJobs );
 
+  cleanupTiles();
   cleanupJobs( mLayerJobs );
 
   QgsDebugMsg( "PARALLEL layers finished" );
@@ -876,7 +1140,7 @@ void QgsMapRendererParallelJob::renderingFinished()
   emit finished();
 }
 
-void QgsMapRendererParallelJob::renderLayerStatic( LayerRenderJob& job )
+void QgsMapRendererParallelJob::renderLayerStatic( LayerRenderJob& job, QMutex& statisticsMutex )
 {
   if ( job.context.renderingStopped() )
     return;
@@ -890,6 +1154,257 @@ void QgsMapRendererParallelJob::renderLayerStatic( LayerRenderJob& job )
   job.renderer->render();
   int tt = t.elapsed();
   QgsDebugMsg( QString( "job %1 end [%2 ms]" ).arg(( ulong ) &job, 0, 16 ).arg( tt ) );
+
+  int count = renderedFeatureCount( job.renderer );
+
+  // the statistics are read by preview updates while other layers are rendered
+  QMutexLocker locker( &statisticsMutex );
+  job.renderingTime = tt;
+  job.featureCount = count;
+}
+
+
+void QgsMapRendererParallelJob::renderTaskStatic( LayerRenderTask& task )
+{
+  if ( task.job )
+  {
+    renderLayerStatic( *task.job, task.self->mTileMutex );
+
+    QMutexLocker locker( &task.self->mTileMutex );
+    if ( !task.job->context.renderingStopped() )
+      task.job->finished = true;
+    return;
+  }
+
+  LayerRenderTile& tile = *task.tile;
+  if ( tile.context.renderingStopped() )
+    return;
+
+  QTime t;
+  t.start();
+  QgsDebugMsg( QString( "tile %1 start" ).arg(( ulong ) &tile, 0, 16 ) );
+  tile.renderer->render();
+  int tt = t.elapsed();
+  QgsDebugMsg( QString( "tile %1 end [%2 ms]" ).arg(( ulong ) &tile, 0, 16 ).arg( tt ) );
+
+  task.self->composeTile( tile, tt );
+}
+
+
+void QgsMapRendererParallelJob::renderWorkerStatic( QgsMapRendererParallelJob* self )
+{
+  int count = self->mTasks.count();
+  int i;
+  while (( i = self->mNextTask.fetchAndAddOrdered( 1 ) ) < count )
+  {
+    renderTaskStatic( self->mTasks[i] );
+  }
+
+  if ( !self->mRunningWorkers.deref() )
+    self->mWorkersFuture.reportFinished();
+}
+
+
+bool QgsMapRendererParallelJob::canRenderInTiles( QgsMapLayer* ml, const LayerRenderJob& job ) const
+{
+  if ( job.cached || job.partial || !job.renderer || !job.img || !job.context.constPainter() )
+    return false;
+
+  // the geometry cache would only get geometries of the last tile
+  if ( mRequestedGeomCacheForLayers.contains( ml->id() ) )
+    return false;
+
+  if ( ml->type() == QgsMapLayer::VectorLayer )
+  {
+    // labels and diagrams would get registered once for each tile
+    QgsVectorLayer* vl = qobject_cast<QgsVectorLayer *>( ml );
+    if ( vl->diagramRenderer() )
+      return false;
+    if ( mLabelingEngine && mLabelingEngine->willUseLayer( vl ) )
+      return false;
+    return true;
+  }
+
+  return ml->type() == QgsMapLayer::RasterLayer;
+}
+
+
+void QgsMapRendererParallelJob::prepareTasks()
+{
+  mTasks.clear();
+  mLayerTiles.clear();
+
+  int width = mSettings.outputSize().width();
+  int height = mSettings.outputSize().height();
+  int tileWidth = qMax( mTileSize.width(), 1 );
+  int tileHeight = qMax( mTileSize.height(), 1 );
+  bool useTiles = mTiledRendering && ( tileWidth < width || tileHeight < height );
+
+  const QgsMapToPixel& mtp = mSettings.mapToPixel();
+  double mupp = mSettings.mapUnitsPerPixel();
+
+  for ( LayerRenderJobs::iterator it = mLayerJobs.begin(); it != mLayerJobs.end(); ++it )
+  {
+    LayerRenderJob& job = *it;
+
+    QgsMapLayer* ml = QgsMapLayerRegistry::instance()->mapLayer( job.layerId );
+    if ( !useTiles || !ml || !canRenderInTiles( ml, job ) )
+    {
+      LayerRenderTask task;
+      task.self = this;
+      task.job = &job;
+      task.tile = 0;
+      mTasks.append( task );
+      continue;
+    }
+
+    int margin = ml->type() == QgsMapLayer::VectorLayer ? RENDER_MARGIN_PIXELS : 0;
+    const QgsCoordinateTransform* ct = job.context.coordinateTransform();
+
+    for ( int y = 0; y < height; y += tileHeight )
+    {
+      for ( int x = 0; x < width; x += tileWidth )
+      {
+        int w = qMin( tileWidth, width - x );
+        int h = qMin( tileHeight, height - y );
+
+        QImage* img = new QImage( w, h, QImage::Format_ARGB32_Premultiplied );
+        if ( img->isNull() )
+        {
+          mErrors.append( Error( job.layerId, "Insufficient memory for tile " + QString::number( w ) + "x" + QString::number( h ) ) );
+          delete img;
+          continue;
+        }
+        img->fill( 0 );
+
+        QgsPoint topLeft = mtp.toMapCoordinatesF( x, y );
+        QgsPoint bottomRight = mtp.toMapCoordinatesF( x + w, y + h );
+
+        mLayerTiles.append( LayerRenderTile() );
+        LayerRenderTile& tile = mLayerTiles.last();
+        tile.img = img;
+        tile.offset = QPoint( x, y );
+        tile.job = &job;
+
+        tile.context = job.context;
+        tile.context.setLabelingEngine( 0 );
+        tile.context.setMapToPixel( QgsMapToPixel( mupp, h, bottomRight.y(), topLeft.x() ) );
+        tile.context.setExtent( outputRectToLayerExtent( ml, ct, QRect( x, y, w, h ), margin, job.context.extent() ) );
+
+        QPainter* painter = new QPainter( tile.img );
+        painter->setRenderHint( QPainter::Antialiasing, mSettings.testFlag( QgsMapSettings::Antialiasing ) );
+        tile.context.setPainter( painter );
+
+        tile.renderer = ml->createMapRenderer( tile.context );
+        job.pendingTiles++;
+      }
+    }
+
+    // the layer is going to be rendered by its tiles
+    delete job.renderer;
+    job.renderer = 0;
+  }
+
+  for ( LayerRenderTiles::iterator it = mLayerTiles.begin(); it != mLayerTiles.end(); ++it )
+  {
+    LayerRenderTask task;
+    task.self = this;
+    task.job = 0;
+    task.tile = &*it;
+    mTasks.append( task );
+  }
+}
+
+
+void QgsMapRendererParallelJob::composeTile( LayerRenderTile& tile, int renderingTime )
+{
+  QMutexLocker locker( &mTileMutex );
+
+  // the layer image is already open by the job's painter
+  QPainter* painter = tile.job->context.painter();
+  painter->save();
+  painter->setCompositionMode( QPainter::CompositionMode_Source );
+  painter->drawImage( tile.offset, *tile.img );
+  painter->restore();
+
+  LayerRenderJob* job = tile.job;
+  job->renderingTime += renderingTime;
+  // features in the margin of tiles get counted more than once
+  int count = renderedFeatureCount( tile.renderer );
+  if ( count >= 0 )
+    job->featureCount = qMax( job->featureCount, 0 ) + count;
+  if ( --job->pendingTiles == 0 && !tile.context.renderingStopped() )
+    job->finished = true;
+}
+
+
+void QgsMapRendererParallelJob::previewTimeout()
+{
+  if ( mStatus != RenderingLayers )
+    return;
+
+  reportLayers( false );
+
+  emit previewUpdated( renderedImage() );
+}
+
+
+void QgsMapRendererParallelJob::reportLayers( bool all )
+{
+  LayerStatisticsList stats;
+  {
+    QMutexLocker locker( &mTileMutex );
+    stats = statisticsForJobs( mLayerJobs );
+  }
+
+  foreach ( const LayerStatistics& layerStats, stats )
+  {
+    if ( mReportedLayers.contains( layerStats.layerID ) || !( all || layerStats.finished ) )
+      continue;
+
+    mReportedLayers.insert( layerStats.layerID );
+    emit layerRendered( layerStats );
+  }
+}
+
+
+void QgsMapRendererParallelJob::cleanupTiles()
+{
+  for ( LayerRenderTiles::iterator it = mLayerTiles.begin(); it != mLayerTiles.end(); ++it )
+  {
+    LayerRenderTile& tile = *it;
+
+    delete tile.context.painter();
+    tile.context.setPainter( 0 );
+
+    delete tile.img;
+    tile.img = 0;
+
+    if ( tile.renderer )
+    {
+      // tiles of one layer tend to report the same problems
+      foreach ( QString message, tile.renderer->errors() )
+      {
+        bool reported = false;
+        foreach ( const Error& error, mErrors )
+        {
+          if ( error.layerID == tile.renderer->layerID() && error.message == message )
+          {
+            reported = true;
+            break;
+          }
+        }
+        if ( !reported )
+          mErrors.append( Error( tile.renderer->layerID(), message ) );
+      }
+
+      delete tile.renderer;
+      tile.renderer = 0;
+    }
+  }
+
+  mTasks.clear();
+  mLayerTiles.clear();
 }
 
 
@@ -906,9 +1421,15 @@ void QgsMapRendererParallelJob::renderLabelsStatic( QgsMapRendererParallelJob* s
 QImage QgsMapRendererJob::composeImage( const QgsMapSettings& settings, const LayerRenderJobs& jobs )
 {
   QImage image( settings.outputSize(), QImage::Format_ARGB32_Premultiplied );
-  image.fill( settings.backgroundColor().rgb() );
+  // the background may be transparent, e.g. for server requests
+  int backgroundAlpha = settings.backgroundColor().alpha();
+  image.fill( backgroundAlpha < 255 ? 0 : settings.backgroundColor().rgb() );
 
   QPainter painter( &image );
+  if ( backgroundAlpha > 0 && backgroundAlpha < 255 )
+  {
+    painter.fillRect( image.rect(), settings.backgroundColor() );
+  }
 
   for ( LayerRenderJobs::const_iterator it = jobs.constBegin(); it != jobs.constEnd(); ++it )
   {
@@ -917,7 +1438,7 @@ QImage QgsMapRendererJob::composeImage( const QgsMapSettings& settings, const La
     painter.setCompositionMode( job.blendMode );
 
     Q_ASSERT( job.img != 0 );
-    painter.drawImage( 0, 0, *job.img );
+    painter.drawImage( job.offset, *job.img );
   }
 
   painter.end();
@@ -2,11 +2,17 @@
 #define QGSMAPRENDERERJOB_H
 
 #include <QtConcurrentRun>
+#include <QAtomicInt>
+#include <QFutureInterface>
 #include <QFutureWatcher>
 #include <QImage>
+#include <QMutex>
 #include <QPainter>
 #include <QObject>
+#include <QSet>
+#include <QThreadPool>
 #include <QTime>
+#include <QTimer>
 
 #include "qgsrendercontext.h"
 
@@ -26,12 +32,42 @@ struct LayerRenderJob
   QImage* img; // may be null if it is not necessary to draw to separate image (e.g. sequential rendering)
   QgsMapLayerRenderer* renderer; // must be deleted
   QPainter::CompositionMode blendMode;
-  bool cached; // if true, img already contains cached image from previous rendering
+  bool cached; // if true, img already contains cached image from previous rendering (possibly only partially - see below)
+  bool partial; // if true, only part of the layer exposed after panning is rendered and then merged into the preceding job of the layer
   QString layerId;
+  int renderingTime; // time spent in rendering (ms) - summed over all tiles for tiled layers
+  int featureCount; // number of features fetched for rendering, -1 if not a vector layer
+  bool finished; // whether the layer has been completely rendered
+  int pendingTiles; // number of tiles that still need to be rendered (tiled rendering only)
+  QPoint offset; // position of img within the map image (only parts of partially cached layers have smaller images)
 };
 
 typedef QList<LayerRenderJob> LayerRenderJobs;
 
+class QgsMapRendererParallelJob;
+
+/** Part of a layer rendered independently of the rest of the layer (used by tiled parallel rendering) */
+struct LayerRenderTile
+{
+  QgsRenderContext context;
+  QImage* img; // image of the size of the tile
+  QgsMapLayerRenderer* renderer; // must be deleted
+  QPoint offset; // position of the tile within the layer's image
+  LayerRenderJob* job; // parent job that receives the tile's image once rendered
+};
+
+typedef QList<LayerRenderTile> LayerRenderTiles;
+
+/** Unit of work for the parallel renderer: either a whole layer or a single tile of a layer */
+struct LayerRenderTask
+{
+  QgsMapRendererParallelJob* self;
+  LayerRenderJob* job; // set if the whole layer is rendered at once
+  LayerRenderTile* tile; // set if only a tile of the layer is rendered
+};
+
+typedef QList<LayerRenderTask> LayerRenderTasks;
+
 
 /** abstract base class renderer jobs that asynchronously start map rendering */
 class CORE_EXPORT QgsMapRendererJob : public QObject
@@ -73,6 +109,25 @@ class CORE_EXPORT QgsMapRendererJob : public QObject
     //! List of errors that happened during the rendering job - available when the rendering has been finished
     Errors errors() const;
 
+    //! Information about how rendering of one layer went
+    //! @note added in 2.4
+    struct LayerStatistics
+    {
+      LayerStatistics() : renderingTime( 0 ), featureCount( -1 ), cached( false ), finished( false ) {}
+
+      QString layerID;
+      int renderingTime; //!< time spent in rendering the layer (in miliseconds)
+      int featureCount;  //!< number of features fetched for rendering (-1 if not a vector layer)
+      bool cached;       //!< whether the layer's image has been taken from the cache
+      bool finished;     //!< false if the rendering of the layer has been stopped before completion
+    };
+
+    typedef QList<LayerStatistics> LayerStatisticsList;
+
+    //! Statistics about rendering of individual layers - available when the rendering has been finished
+    //! @note added in 2.4
+    LayerStatisticsList layerStatistics() const { return mLayerStatistics; }
+
 
     //! Assign a cache to be used for reading and storing rendered images of individual layers.
     //! Does not take ownership of the object.
@@ -90,6 +145,11 @@ class CORE_EXPORT QgsMapRendererJob : public QObject
     //! emitted when asynchronous rendering is finished (or canceled).
     void finished();
 
+    //! emitted when rendering of a layer has finished. Only some jobs are able to report
+    //! the layers while rendering, the statistics of all layers are available in layerStatistics()
+    //! @note added in 2.4
+    void layerRendered( const QgsMapRendererJob::LayerStatistics& stats );
+
   protected:
 
     /** Convenience function to project an extent into the layer source
@@ -104,6 +164,24 @@ class CORE_EXPORT QgsMapRendererJob : public QObject
 
     void cleanupJobs( LayerRenderJobs& jobs );
 
+    //! Return extent in layer's CRS that covers given part of the output (in pixels) extended by a margin
+    QgsRectangle outputRectToLayerExtent( QgsMapLayer* ml, const QgsCoordinateTransform* ct, const QRect& rect, int marginPixels, const QgsRectangle& fallbackExtent ) const;
+
+    //! Add jobs that render parts of the layer missing from a partially cached image.
+    //! @return false if it is not possible to use the partially cached image
+    bool preparePartialJobs( LayerRenderJobs& layerJobs, QgsMapLayer* ml, QPainter* painter, const QImage& cachedImage, const QList<QRect>& exposedRects );
+
+    //! Create the image for a job if necessary and the layer renderer.
+    //! @return false if there is not enough memory for the image
+    bool prepareJobRenderer( LayerRenderJob& job, QgsMapLayer* ml, QPainter* painter, const QSize& imageSize );
+
+    //! Merge images of partially rendered layers into the images of their cached parts
+    void mergePartialJobs( LayerRenderJobs& jobs );
+
+    //! Return statistics of layers rendered by the jobs (parts of partially cached layers are merged)
+    static LayerStatisticsList statisticsForJobs( const LayerRenderJobs& jobs );
+    static int renderedFeatureCount( QgsMapLayerRenderer* renderer );
+
     static QImage composeImage( const QgsMapSettings& settings, const LayerRenderJobs& jobs );
 
     bool needTemporaryImage( QgsMapLayer* ml );
@@ -117,6 +195,7 @@ class CORE_EXPORT QgsMapRendererJob : public QObject
 
     QgsMapSettings mSettings;
     Errors mErrors;
+    LayerStatisticsList mLayerStatistics;
 
     QgsMapRendererCache* mCache;
 
@@ -179,7 +258,13 @@ class CORE_EXPORT QgsMapRendererSequentialJob : public QgsMapRendererQImageJob
 
 
 
-/** job implementation that renders all layers in parallel */
+/** job implementation that renders all layers in parallel.
+ *
+ * By default each layer is rendered by one thread. With tiled rendering enabled,
+ * vector and raster layers are additionally split into tiles of the map extent
+ * which are rendered concurrently and composited back into the layer's image,
+ * so that a single heavy layer can make use of all available cores.
+ */
 class CORE_EXPORT QgsMapRendererParallelJob : public QgsMapRendererQImageJob
 {
     Q_OBJECT
@@ -187,6 +272,42 @@ class CORE_EXPORT QgsMapRendererParallelJob : public QgsMapRendererQImageJob
     QgsMapRendererParallelJob( const QgsMapSettings& settings );
     ~QgsMapRendererParallelJob();
 
+    //! Enable or disable rendering of individual layers in tiles. Must be set before start()
+    //! @note added in 2.4
+    void setTiledRenderingEnabled( bool enabled ) { mTiledRendering = enabled; }
+    //! Whether individual layers are rendered in tiles
+    //! @note added in 2.4
+    bool isTiledRenderingEnabled() const { return mTiledRendering; }
+
+    //! Set size of tiles (in pixels) used with tiled rendering
+    //! @note added in 2.4
+    void setTileSize( const QSize& size ) { mTileSize = size; }
+    //! Return size of tiles (in pixels) used with tiled rendering
+    //! @note added in 2.4
+    QSize tileSize() const { return mTileSize; }
+
+    //! Set maximum number of threads used for rendering. The layers are then rendered by a thread pool of the job
+    //! with that many threads. Zero means to use the global thread pool.
+    //! @note added in 2.4
+    void setMaxThreads( int threads ) { mMaxThreads = threads; }
+    //! Return maximum number of threads used for rendering (zero if the global thread pool is used)
+    //! @note added in 2.4
+    int maxThreads() const { return mMaxThreads; }
+
+    //! Set interval (in miliseconds) of preview updates while the layers are being rendered.
+    //! Zero (the default) disables preview updates.
+    //! @note added in 2.4
+    void setPreviewInterval( int msec ) { mPreviewTimer.setInterval( msec ); mPreviewEnabled = msec > 0; }
+    //! Return interval (in miliseconds) of preview updates, zero if they are disabled
+    //! @note added in 2.4
+    int previewInterval() const { return mPreviewEnabled ? mPreviewTimer.interval() : 0; }
+
+    //! Take the engine settings of labeling (search method, number of candidates, ...) from an existing
+    //! labeling engine instead of the current project. The engine is not owned by the job
+    //! and must be valid when start() is called. Pass 0 to use the project settings again.
+    //! @note added in 2.4
+    void setLabelingEngineSettings( QgsPalLabeling* engine ) { mLabelingEngineSettings = engine; }
+
     virtual void start();
     virtual void cancel();
     virtual void waitForFinished();
@@ -197,17 +318,41 @@ class CORE_EXPORT QgsMapRendererParallelJob : public QgsMapRendererQImageJob
     // from QgsMapRendererJobWithPreview
     virtual QImage renderedImage();
 
+  signals:
+    //! emitted periodically while layers are being rendered (see setPreviewInterval())
+    //! with composition of what has been rendered so far
+    //! @note added in 2.4
+    void previewUpdated( const QImage& image );
+
   protected slots:
     //! layers are rendered, labeling is still pending
     void renderLayersFinished();
+    //! report progress of rendering of layers
+    void previewTimeout();
     //! all rendering is finished, including labeling
     void renderingFinished();
 
   protected:
 
-    static void renderLayerStatic( LayerRenderJob& job );
+    friend class QgsMapRendererWorker;
+
+    static void renderLayerStatic( LayerRenderJob& job, QMutex& statisticsMutex );
+    static void renderTaskStatic( LayerRenderTask& task );
+    static void renderWorkerStatic( QgsMapRendererParallelJob* self );
     static void renderLabelsStatic( QgsMapRendererParallelJob* self );
 
+    //! whether the layer is worth and safe to be rendered in multiple tiles
+    bool canRenderInTiles( QgsMapLayer* ml, const LayerRenderJob& job ) const;
+    //! split layer jobs into tiles where appropriate and build the list of tasks
+    void prepareTasks();
+    //! copy rendered tile to its layer's image and update the layer's progress
+    void composeTile( LayerRenderTile& tile, int renderingTime );
+    //! free resources used by tiles
+    void cleanupTiles();
+    //! emit layerRendered() for layers that have finished since the last call
+    //! @param all report also layers that have not finished
+    void reportLayers( bool all );
+
   protected:
 
     QImage mFinalImage;
@@ -219,7 +364,30 @@ class CORE_EXPORT QgsMapRendererParallelJob : public QgsMapRendererQImageJob
 
     LayerRenderJobs mLayerJobs;
 
+    bool mTiledRendering;
+    QSize mTileSize;
+    int mMaxThreads;
+    LayerRenderTiles mLayerTiles;
+    LayerRenderTasks mTasks;
+    //! runs the workers when the number of threads is limited
+    QThreadPool mThreadPool;
+    //! reported finished by the last worker, so that mFuture can be used like for the global thread pool
+    QFutureInterface<void> mWorkersFuture;
+    //! number of workers that have not finished yet
+    QAtomicInt mRunningWorkers;
+    //! index of the next task to be picked by a worker
+    QAtomicInt mNextTask;
+    //! protects layer images and progress information of layer jobs while rendering
+    QMutex mTileMutex;
+
+    bool mPreviewEnabled;
+    QTimer mPreviewTimer;
+    //! IDs of layers for which layerRendered() has been emitted already
+    QSet<QString> mReportedLayers;
+
     QgsPalLabeling* mLabelingEngine;
+    //! engine whose settings are copied to the labeling engine, 0 to load them from the project
+    QgsPalLabeling* mLabelingEngineSettings;
     QgsRenderContext mLabelingRenderContext;
     QFuture<void> mLabelingFuture;
     QFutureWatcher<void> mLabelingFutureWatcher;
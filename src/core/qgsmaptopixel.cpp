@@ -17,10 +17,12 @@
 #include "qgsmaptopixel.h"
 
 #include <QPoint>
+#include <QPolygonF>
 #include <QTextStream>
 #include <QVector>
 
 #include "qgslogger.h"
+#include "qgsvertexkernels.h"
 
 QgsMapToPixel::QgsMapToPixel( double mapUnitsPerPixel,
                               double ymax,
@@ -150,8 +152,19 @@ void QgsMapToPixel::transformInPlace( QVector<double>& x,
                                       QVector<double>& y ) const
 {
   assert( x.size() == y.size() );
-  for ( int i = 0; i < x.size(); ++i )
-    transformInPlace( x[i], y[i] );
+  QgsVertexKernels::mapToPixel( x.data(), y.data(), x.size(), mMapUnitsPerPixel, xMin, yMin, yMax );
+}
+
+void QgsMapToPixel::transformInPlace( QPolygonF& poly ) const
+{
+#ifdef QT_ARCH_ARM
+  // qreal is float
+  QPointF* ptr = poly.data();
+  for ( int i = 0; i < poly.size(); ++i, ++ptr )
+    transformInPlace( ptr->rx(), ptr->ry() );
+#else
+  QgsVertexKernels::mapToPixel(( unsigned char* ) poly.data(), poly.size(), sizeof( QPointF ), mMapUnitsPerPixel, xMin, yMin, yMax );
+#endif
 }
 
 #ifdef ANDROID
@@ -24,6 +24,7 @@
 
 class QgsPoint;
 class QPoint;
+class QPolygonF;
 
 /** \ingroup core
   * Perform transforms between map coordinates and device coordinates.
@@ -77,6 +78,12 @@ class CORE_EXPORT QgsMapToPixel
      */
     void transformInPlace( QVector<double>& x, QVector<double>& y ) const;
 
+    /** Transforms the points of the polygon from map coordinates to device
+     * coordinates in place.
+     * @note added in 2.4
+     */
+    void transformInPlace( QPolygonF& poly ) const;
+
 #ifdef ANDROID
     void transformInPlace( float& x, float& y ) const;
     void transformInPlace( QVector<float>& x, QVector<float>& y ) const;
@@ -17,6 +17,7 @@
 #include <limits>
 #include "qgsmaptopixelgeometrysimplifier.h"
 #include "qgsapplication.h"
+#include "qgsvertexkernels.h"
 
 QgsMapToPixelSimplifier::QgsMapToPixelSimplifier( int simplifyFlags, double tolerance )
     : mSimplifyFlags( simplifyFlags )
@@ -42,24 +43,14 @@ float QgsMapToPixelSimplifier::calculateLengthSquared2D( double x1, double y1, d
 //! Returns the BBOX of the specified WKB-point stream
 inline static QgsRectangle calculateBoundingBox( QGis::WkbType wkbType, unsigned char* wkb, size_t numPoints )
 {
-  double xmin =  std::numeric_limits<double>::max(), x, y;
+  double xmin =  std::numeric_limits<double>::max();
   double ymin =  std::numeric_limits<double>::max();
   double xmax = -std::numeric_limits<double>::max();
   double ymax = -std::numeric_limits<double>::max();
 
-  int sizeOfDoubleX = sizeof( double );
-  int sizeOfDoubleY = QGis::wkbDimensions( wkbType ) == 3 /*hasZValue*/ ? 2 * sizeof( double ) : sizeof( double );
-
-  for ( size_t i = 0; i < numPoints; ++i )
-  {
-    memcpy( &x, wkb, sizeof( double ) ); wkb += sizeOfDoubleX;
-    memcpy( &y, wkb, sizeof( double ) ); wkb += sizeOfDoubleY;
+  int sizeOfPoint = QGis::wkbDimensions( wkbType ) == 3 /*hasZValue*/ ? 3 * sizeof( double ) : 2 * sizeof( double );
 
-    if ( xmin > x ) xmin = x;
-    if ( ymin > y ) ymin = y;
-    if ( xmax < x ) xmax = x;
-    if ( ymax < y ) ymax = y;
-  }
+  QgsVertexKernels::boundingBox( wkb, numPoints, sizeOfPoint, xmin, ymin, xmax, ymax );
 
   return QgsRectangle( xmin, ymin, xmax, ymax );
 }
@@ -225,22 +216,32 @@ bool QgsMapToPixelSimplifier::simplifyWkbGeometry( int simplifyFlags, QGis::WkbT
       isaLinearRing = ( x1 == x2 ) && ( y1 == y2 );
     }
 
-    // Process each vertex...
-    for ( int i = 0, numPoints_i = ( isaLinearRing ? numPoints - 1 : numPoints ); i < numPoints_i; ++i )
-    {
-      memcpy( &x, sourceWkb, sizeof( double ) ); sourceWkb += sizeOfDoubleX;
-      memcpy( &y, sourceWkb, sizeof( double ) ); sourceWkb += sizeOfDoubleY;
+    int sizeOfPoint = sizeOfDoubleX + sizeOfDoubleY;
+    int numPoints_i = ( isaLinearRing ? numPoints - 1 : numPoints );
 
-      if ( i == 0 || !canbeGeneralizable || QgsMapToPixelSimplifier::calculateLengthSquared2D( x, y, lastX, lastY ) > map2pixelTol || ( !isaLinearRing && ( i == 1 || i >= numPoints - 2 ) ) )
+    // The BBOX is calculated up front, the source and target WKB may be the same buffer
+    // but points are only ever written at or before the position they were read from.
+    QgsVertexKernels::boundingBox( sourceWkb, numPoints_i, sizeOfPoint, xmin, ymin, xmax, ymax );
+
+    // Process each vertex, skipping runs of vertices within the tolerance of the last kept one...
+    for ( int i = 0; i < numPoints_i; )
+    {
+      if ( i > 0 && canbeGeneralizable && ( isaLinearRing || ( i != 1 && i < numPoints - 2 ) ) )
       {
-        memcpy( ptr, &x, sizeof( double ) ); lastX = x; ptr++;
-        memcpy( ptr, &y, sizeof( double ) ); lastY = y; ptr++;
-        numTargetPoints++;
+        // ... the first and the last two vertices of a linestring are always kept
+        int numCandidates = ( isaLinearRing ? numPoints_i : numPoints - 2 ) - i;
+        int skipped = QgsVertexKernels::firstBeyondTolerance( sourceWkb + i * sizeOfPoint, numCandidates, sizeOfPoint, lastX, lastY, map2pixelTol );
+        i += skipped;
+        if ( skipped == numCandidates ) continue;
       }
-      if ( xmin > x ) xmin = x;
-      if ( ymin > y ) ymin = y;
-      if ( xmax < x ) xmax = x;
-      if ( ymax < y ) ymax = y;
+
+      memcpy( &x, sourceWkb + i * sizeOfPoint, sizeof( double ) );
+      memcpy( &y, sourceWkb + i * sizeOfPoint + sizeOfDoubleX, sizeof( double ) );
+
+      memcpy( ptr, &x, sizeof( double ) ); lastX = x; ptr++;
+      memcpy( ptr, &y, sizeof( double ) ); lastY = y; ptr++;
+      numTargetPoints++;
+      ++i;
     }
     targetWkb = wkb2 + 4;
 
@@ -17,11 +17,22 @@
 
 #include "qgsgeometry.h"
 #include "qgsfeature.h"
+#include "qgsfeatureiterator.h"
 #include "qgsrectangle.h"
 #include "qgslogger.h"
 
 #include "SpatialIndex.h"
 
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStack>
+#include <QVector>
+
 using namespace SpatialIndex;
 
 
@@ -73,6 +84,256 @@ class QgsSpatialIndexCopyVisitor : public SpatialIndex::IVisitor
 };
 
 
+// feeds features from an iterator to the bulk loader
+class QgsFeatureIteratorDataStream : public SpatialIndex::IDataStream
+{
+  public:
+    QgsFeatureIteratorDataStream( const QgsFeatureIterator& fi )
+        : mFi( fi )
+        , mNextData( 0 )
+    {
+      readNextEntry();
+    }
+
+    ~QgsFeatureIteratorDataStream()
+    {
+      delete mNextData;
+    }
+
+    IData* getNext()
+    {
+      RTree::Data* ret = mNextData;
+      mNextData = 0;
+      readNextEntry();
+      return ret;
+    }
+
+    bool hasNext() { return mNextData != 0; }
+
+    uint32_t size() { throw Tools::NotSupportedException( "Operation not supported." ); }
+
+    void rewind() { throw Tools::NotSupportedException( "Operation not supported." ); }
+
+  protected:
+    void readNextEntry()
+    {
+      QgsFeature f;
+      while ( mFi.nextFeature( f ) )
+      {
+        if ( !f.geometry() )
+          continue;
+
+        QgsRectangle rect = f.geometry()->boundingBox();
+        double pt1[2] = { rect.xMinimum(), rect.yMinimum() };
+        double pt2[2] = { rect.xMaximum(), rect.yMaximum() };
+        Region r( pt1, pt2, 2 );
+        mNextData = new RTree::Data( 0, 0, r, FID_TO_NUMBER( f.id() ) );
+        return;
+      }
+    }
+
+  private:
+    QgsFeatureIterator mFi;
+    RTree::Data* mNextData;
+};
+
+
+/** Storage of the R-tree pages. Pages are kept in memory or read directly
+ * from a memory mapped index file written by save(). Changes to pages of
+ * a mapped file only happen in memory. */
+class QgsSpatialIndexStorage : public SpatialIndex::IStorageManager
+{
+  public:
+    QgsSpatialIndexStorage()
+        : mMap( 0 )
+    {
+    }
+
+    ~QgsSpatialIndexStorage()
+    {
+      if ( mMap )
+        mFile.unmap( mMap );
+    }
+
+    void loadByteArray( const id_type page, uint32_t& len, byte** data )
+    {
+      if ( page < 0 || page >= mPages.size() || !mPages[page].used )
+        throw Tools::InvalidPageException( page );
+
+      const Page& p = mPages[page];
+      len = p.length;
+      *data = new byte[len];
+      memcpy( *data, p.mapped ? p.mapped : ( const uchar* ) p.data.constData(), len );
+    }
+
+    void storeByteArray( id_type& page, const uint32_t len, const byte* const data )
+    {
+      if ( page == StorageManager::NewPage )
+      {
+        if ( !mFreePages.isEmpty() )
+        {
+          page = mFreePages.pop();
+        }
+        else
+        {
+          page = mPages.size();
+          mPages.append( Page() );
+        }
+      }
+      else if ( page < 0 || page >= mPages.size() || !mPages[page].used )
+      {
+        throw Tools::InvalidPageException( page );
+      }
+
+      Page& p = mPages[page];
+      p.mapped = 0;
+      p.data = QByteArray(( const char* ) data, len );
+      p.length = len;
+      p.used = true;
+    }
+
+    void deleteByteArray( const id_type page )
+    {
+      if ( page < 0 || page >= mPages.size() || !mPages[page].used )
+        throw Tools::InvalidPageException( page );
+
+      mPages[page] = Page();
+      mFreePages.push( page );
+    }
+
+    // everything is written immediately
+    void flush() {}
+
+    bool save( const QString& fileName, id_type indexId, const QDateTime& sourceModified ) const;
+
+    bool load( const QString& fileName, id_type& indexId, const QDateTime& sourceModified );
+
+  private:
+    struct Page
+    {
+      Page() : mapped( 0 ), length( 0 ), used( false ) {}
+      const uchar* mapped;
+      QByteArray data;
+      uint32_t length;
+      bool used;
+    };
+
+    static const quint32 sMagic = 0x51534958; // "QSIX"
+    static const quint32 sVersion = 1;
+
+    QVector<Page> mPages;
+    QStack<id_type> mFreePages;
+
+    QFile mFile;
+    uchar* mMap;
+};
+
+// index file: header, page lengths (unused pages have zero length), page data
+bool QgsSpatialIndexStorage::save( const QString& fileName, id_type indexId, const QDateTime& sourceModified ) const
+{
+  // write a new file and replace the old one only when complete
+  QString tmpFileName = fileName + ".tmp";
+  QFile f( tmpFileName );
+  if ( !f.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+  {
+    QgsDebugMsg( QString( "cannot write spatial index %1: %2" ).arg( tmpFileName, f.errorString() ) );
+    return false;
+  }
+
+  QDataStream ds( &f );
+  ds.setVersion( QDataStream::Qt_4_7 );
+  ds << sMagic << sVersion << ( qint64 ) sourceModified.toMSecsSinceEpoch() << ( qint64 ) indexId << ( quint32 ) mPages.size();
+
+  foreach ( const Page& p, mPages )
+    ds << ( quint32 )( p.used ? p.length : 0 );
+
+  foreach ( const Page& p, mPages )
+  {
+    if ( p.used )
+      ds.writeRawData( p.mapped ? ( const char* ) p.mapped : p.data.constData(), p.length );
+  }
+
+  bool ok = ds.status() == QDataStream::Ok;
+  f.close();
+
+  if ( !ok || ( QFile::exists( fileName ) && !QFile::remove( fileName ) ) || !QFile::rename( tmpFileName, fileName ) )
+  {
+    QgsDebugMsg( QString( "cannot write spatial index %1" ).arg( fileName ) );
+    QFile::remove( tmpFileName );
+    return false;
+  }
+
+  return true;
+}
+
+bool QgsSpatialIndexStorage::load( const QString& fileName, id_type& indexId, const QDateTime& sourceModified )
+{
+  Q_ASSERT( !mMap && mPages.isEmpty() );
+
+  mFile.setFileName( fileName );
+  if ( !mFile.open( QIODevice::ReadOnly ) )
+    return false;
+
+  quint32 magic, version, pageCount;
+  qint64 modified, id;
+  QDataStream ds( &mFile );
+  ds.setVersion( QDataStream::Qt_4_7 );
+  ds >> magic >> version >> modified >> id >> pageCount;
+  if ( ds.status() != QDataStream::Ok || magic != sMagic || version != sVersion )
+  {
+    QgsDebugMsg( QString( "%1 is not a valid spatial index" ).arg( fileName ) );
+    return false;
+  }
+
+  if ( modified != sourceModified.toMSecsSinceEpoch() )
+  {
+    QgsDebugMsg( QString( "spatial index %1 is out of date" ).arg( fileName ) );
+    return false;
+  }
+
+  QVector<quint32> lengths( pageCount );
+  qint64 total = 0;
+  for ( quint32 i = 0; i < pageCount; ++i )
+  {
+    ds >> lengths[i];
+    total += lengths[i];
+  }
+
+  qint64 offset = mFile.pos();
+  if ( ds.status() != QDataStream::Ok || offset + total != mFile.size() )
+  {
+    QgsDebugMsg( QString( "spatial index %1 is damaged" ).arg( fileName ) );
+    return false;
+  }
+
+  mMap = mFile.map( 0, mFile.size() );
+  if ( !mMap )
+  {
+    QgsDebugMsg( QString( "cannot map spatial index %1: %2" ).arg( fileName, mFile.errorString() ) );
+    return false;
+  }
+
+  mPages.resize( pageCount );
+  for ( quint32 i = 0; i < pageCount; ++i )
+  {
+    if ( lengths[i] == 0 )
+    {
+      mFreePages.push( i );
+      continue;
+    }
+
+    Page& p = mPages[i];
+    p.mapped = mMap + offset;
+    p.length = lengths[i];
+    p.used = true;
+    offset += lengths[i];
+  }
+
+  indexId = id;
+  return true;
+}
+
+
 /** Data of spatial index that may be implicitly shared */
 class QgsSpatialIndexData : public QSharedData
 {
@@ -82,6 +343,12 @@ class QgsSpatialIndexData : public QSharedData
       initTree();
     }
 
+    QgsSpatialIndexData( const QgsFeatureIterator& fi )
+    {
+      QgsFeatureIteratorDataStream stream( fi );
+      initTree( &stream );
+    }
+
     QgsSpatialIndexData( const QgsSpatialIndexData& other )
         : QSharedData( other )
     {
@@ -101,10 +368,9 @@ class QgsSpatialIndexData : public QSharedData
       delete mStorage;
     }
 
-    void initTree()
+    void initTree( IDataStream* inputStream = 0 )
     {
-      // for now only memory manager
-      mStorage = StorageManager::createNewMemoryStorageManager();
+      mStorage = new QgsSpatialIndexStorage;
 
       // R-Tree parameters
       double fillFactor = 0.7;
@@ -113,14 +379,60 @@ class QgsSpatialIndexData : public QSharedData
       unsigned long dimension = 2;
       RTree::RTreeVariant variant = RTree::RV_RSTAR;
 
-      // create R-tree
+      // create R-tree (bulk loader refuses empty streams)
+      if ( inputStream && inputStream->hasNext() )
+        mRTree = RTree::createAndBulkLoadNewRTree( RTree::BLM_STR, *inputStream, *mStorage, fillFactor, indexCapacity,
+                 leafCapacity, dimension, variant, mIndexId );
+      else
+        mRTree = RTree::createNewRTree( *mStorage, fillFactor, indexCapacity,
+                                        leafCapacity, dimension, variant, mIndexId );
+    }
+
+    /** make sure the tree header in the storage is up to date */
+    void storeHeader()
+    {
+      // the header is written when the tree is destroyed
+      delete mRTree;
+      mRTree = 0;
+      mRTree = RTree::loadRTree( *mStorage, mIndexId );
+    }
+
+    /** replace the tree with one from an index file */
+    bool load( const QString& fileName, const QDateTime& sourceModified )
+    {
+      QgsSpatialIndexStorage* storage = new QgsSpatialIndexStorage;
       SpatialIndex::id_type indexId;
-      mRTree = RTree::createNewRTree( *mStorage, fillFactor, indexCapacity,
-                                      leafCapacity, dimension, variant, indexId );
+      SpatialIndex::ISpatialIndex* tree = 0;
+      try
+      {
+        if ( storage->load( fileName, indexId, sourceModified ) )
+          tree = RTree::loadRTree( *storage, indexId );
+      }
+      catch ( Tools::Exception &e )
+      {
+        Q_UNUSED( e );
+        QgsDebugMsg( QString( "Tools::Exception caught: %1" ).arg( e.what().c_str() ) );
+      }
+
+      if ( !tree )
+      {
+        delete storage;
+        return false;
+      }
+
+      delete mRTree;
+      delete mStorage;
+      mStorage = storage;
+      mRTree = tree;
+      mIndexId = indexId;
+      return true;
     }
 
     /** storage manager */
-    SpatialIndex::IStorageManager* mStorage;
+    QgsSpatialIndexStorage* mStorage;
+
+    /** identifier of the R-tree in the storage */
+    SpatialIndex::id_type mIndexId;
 
     /** R-tree containing spatial index */
     SpatialIndex::ISpatialIndex* mRTree;
@@ -134,6 +446,11 @@ QgsSpatialIndex::QgsSpatialIndex()
   d = new QgsSpatialIndexData;
 }
 
+QgsSpatialIndex::QgsSpatialIndex( const QgsFeatureIterator& fi )
+{
+  d = new QgsSpatialIndexData( fi );
+}
+
 QgsSpatialIndex::QgsSpatialIndex( const QgsSpatialIndex& other )
     : d( other.d )
 {
@@ -241,6 +558,75 @@ QList<QgsFeatureId> QgsSpatialIndex::nearestNeighbor( QgsPoint point, int neighb
   return list;
 }
 
+bool QgsSpatialIndex::save( const QString& fileName, const QDateTime& sourceModified )
+{
+  // refreshing the header recreates the tree object, so an index shared with copies is detached first
+  QgsSpatialIndexData* data = d.data();
+  try
+  {
+    data->storeHeader();
+  }
+  catch ( Tools::Exception &e )
+  {
+    Q_UNUSED( e );
+    QgsDebugMsg( QString( "Tools::Exception caught: %1" ).arg( e.what().c_str() ) );
+    return false;
+  }
+
+  return data->mStorage->save( fileName, data->mIndexId, sourceModified );
+}
+
+bool QgsSpatialIndex::load( const QString& fileName, const QDateTime& sourceModified )
+{
+  QgsSpatialIndexData* data = new QgsSpatialIndexData;
+  if ( !data->load( fileName, sourceModified ) )
+  {
+    delete data;
+    return false;
+  }
+
+  d = data;
+  return true;
+}
+
+QString QgsSpatialIndex::indexFileName( const QString& dataSource )
+{
+  // OGR sources may point to a layer in the file
+  QFileInfo fi( dataSource.section( '|', 0, 0 ) );
+  if ( !fi.isFile() )
+    return QString();
+
+  QString key = fi.absoluteFilePath();
+  if ( dataSource.contains( '|' ) )
+    key += "|" + dataSource.section( '|', 1 );
+
+  QSettings settings;
+  QString cacheDirectory = settings.value( "cache/directory", QgsApplication::qgisSettingsDirPath() + "cache" ).toString();
+  QString hash = QCryptographicHash::hash( key.toUtf8(), QCryptographicHash::Sha1 ).toHex();
+  return cacheDirectory + QDir::separator() + "spatialindex" + QDir::separator() + hash + ".qsi";
+}
+
+QgsSpatialIndex QgsSpatialIndex::fromDataSource( const QString& dataSource, const QgsFeatureIterator& fi )
+{
+  QString fileName = indexFileName( dataSource );
+  if ( fileName.isEmpty() )
+    return QgsSpatialIndex( fi );
+
+  QDateTime modified = QFileInfo( dataSource.section( '|', 0, 0 ) ).lastModified();
+
+  QgsSpatialIndex index;
+  if ( index.load( fileName, modified ) )
+  {
+    QgsDebugMsg( "using spatial index " + fileName );
+    return index;
+  }
+
+  index = QgsSpatialIndex( fi );
+  if ( QDir().mkpath( QFileInfo( fileName ).absolutePath() ) )
+    index.save( fileName, modified );
+  return index;
+}
+
 int QgsSpatialIndex::refs() const
 {
   return d->ref;
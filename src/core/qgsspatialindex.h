@@ -31,8 +31,10 @@ namespace SpatialIndex
 }
 
 class QgsFeature;
+class QgsFeatureIterator;
 class QgsRectangle;
 class QgsPoint;
+class QDateTime;
 
 #include <QList>
 #include <QSharedDataPointer>
@@ -51,6 +53,13 @@ class CORE_EXPORT QgsSpatialIndex
     /** constructor - creates R-tree */
     QgsSpatialIndex();
 
+    /** constructor - creates R-tree and bulk loads it with features from the iterator.
+     * Bulk loading packs the tree (STR algorithm) which is a lot faster than inserting
+     * features one by one and results in a tree with better query performance.
+     * @note added in 2.4
+     */
+    explicit QgsSpatialIndex( const QgsFeatureIterator& fi );
+
     /** copy constructor */
     QgsSpatialIndex( const QgsSpatialIndex& other );
 
@@ -78,6 +87,37 @@ class CORE_EXPORT QgsSpatialIndex
     /** returns nearest neighbors (their count is specified by second parameter) */
     QList<QgsFeatureId> nearestNeighbor( QgsPoint point, int neighbors ) const;
 
+    /* persistence */
+
+    /** write the index to a file so that it can be reused with load()
+     * @param fileName index file
+     * @param sourceModified modification time of the indexed data source
+     * @note an index shared with copies is detached first
+     * @note added in 2.4
+     */
+    bool save( const QString& fileName, const QDateTime& sourceModified );
+
+    /** replace the index with one written by save(). The file is memory mapped, pages
+     * are only read when queries need them. Fails if the file is missing, damaged or
+     * was written for a different modification time of the data source.
+     * @note added in 2.4
+     */
+    bool load( const QString& fileName, const QDateTime& sourceModified );
+
+    /** returns name of the index file of a file based data source in the spatialindex
+     * subdirectory of the QGIS cache directory or empty string if the data source is not a file
+     * @note added in 2.4
+     */
+    static QString indexFileName( const QString& dataSource );
+
+    /** returns index of a file based data source. The index is loaded from the file
+     * in the cache directory if it is still valid, otherwise it is bulk loaded from the
+     * iterator and written there for the next time. The iterator must return all features
+     * of the data source.
+     * @note added in 2.4
+     */
+    static QgsSpatialIndex fromDataSource( const QString& dataSource, const QgsFeatureIterator& fi );
+
     /* debugging */
 
     //! get reference count - just for debugging!
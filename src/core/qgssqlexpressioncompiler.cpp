@@ -0,0 +1,419 @@
+/***************************************************************************
+    qgssqlexpressioncompiler.cpp
+    ---------------------
+    begin                : May 2014
+    copyright            : (C) 2014 by the QGIS project
+    email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgssqlexpressioncompiler.h"
+#include "qgslogger.h"
+#include "qgis.h"
+
+// same rule as used by the expression engine to decide on numeric comparison
+static bool isDoubleSafe( const QVariant& v )
+{
+  if ( v.type() == QVariant::Double || v.type() == QVariant::Int )
+    return true;
+  if ( v.type() == QVariant::String )
+  {
+    bool ok;
+    v.toString().toDouble( &ok );
+    return ok;
+  }
+  return false;
+}
+
+// literal node value, invalid variant for other nodes
+static bool literalValue( const QgsExpression::Node* node, QVariant& value )
+{
+  if ( node->nodeType() != QgsExpression::ntLiteral )
+    return false;
+  value = static_cast<const QgsExpression::NodeLiteral*>( node )->value();
+  return true;
+}
+
+QgsSqlExpressionCompiler::QgsSqlExpressionCompiler( const QgsFields& fields, int flags )
+    : mFields( fields )
+    , mFlags( flags )
+{
+}
+
+QgsSqlExpressionCompiler::~QgsSqlExpressionCompiler()
+{
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compile( const QgsExpression* exp )
+{
+  mResult.clear();
+
+  if ( !exp || !exp->rootNode() )
+    return Fail;
+
+  QString sql;
+  ValueType type;
+  Result res = compileNode( exp->rootNode(), sql, type );
+  if ( res == Fail || type != Boolean )
+  {
+    QgsDebugMsgLevel( "expression not compiled: " + exp->dump(), 3 );
+    return Fail;
+  }
+
+  QgsDebugMsgLevel( QString( "expression %1 compiled to %2 (%3)" ).arg( exp->dump(), sql, QString( res == Complete ? "complete" : "partial" ) ), 3 );
+  mResult = sql;
+  return res;
+}
+
+QString QgsSqlExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  QString quoted = identifier;
+  quoted.replace( "\"", "\"\"" );
+  return quoted.prepend( "\"" ).append( "\"" );
+}
+
+QString QgsSqlExpressionCompiler::quotedValue( const QVariant& value )
+{
+  if ( value.isNull() )
+    return "NULL";
+
+  switch ( value.type() )
+  {
+    case QVariant::Int:
+    case QVariant::LongLong:
+      return value.toString();
+
+    case QVariant::Double:
+      return qgsDoubleToString( value.toDouble() );
+
+    default:
+    {
+      QString v = value.toString();
+      v.replace( "'", "''" );
+      return v.prepend( "'" ).append( "'" );
+    }
+  }
+}
+
+QgsSqlExpressionCompiler::ValueType QgsSqlExpressionCompiler::columnType( const QgsField& field )
+{
+  switch ( field.type() )
+  {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+      return Numeric;
+
+    case QVariant::String:
+      return String;
+
+    default:
+      return Other; // only usable with IS NULL
+  }
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compileLike( const QString& value, const QString& pattern, bool caseInsensitive, QString& result )
+{
+  if ( caseInsensitive )
+    result = QString( "UPPER(%1) LIKE UPPER(%2)" ).arg( value, quotedValue( pattern ) );
+  else
+    result = QString( "%1 LIKE %2" ).arg( value, quotedValue( pattern ) );
+  return Complete;
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compileNode( const QgsExpression::Node* node, QString& result, ValueType& type )
+{
+  switch ( node->nodeType() )
+  {
+    case QgsExpression::ntLiteral:
+    {
+      QVariant value = static_cast<const QgsExpression::NodeLiteral*>( node )->value();
+      if ( value.isNull() )
+        type = Null;
+      else if ( value.type() == QVariant::Int || value.type() == QVariant::Double )
+        type = Numeric;
+      else if ( value.type() == QVariant::String )
+        type = String;
+      else
+        return Fail;
+
+      result = quotedValue( value );
+      return Complete;
+    }
+
+    case QgsExpression::ntColumnRef:
+    {
+      int idx = mFields.fieldNameIndex( static_cast<const QgsExpression::NodeColumnRef*>( node )->name() );
+      if ( idx < 0 )
+        return Fail;
+
+      const QgsField& field = mFields[idx];
+      type = columnType( field );
+      result = quotedIdentifier( field.name() );
+      return Complete;
+    }
+
+    case QgsExpression::ntUnaryOperator:
+    {
+      const QgsExpression::NodeUnaryOperator* n = static_cast<const QgsExpression::NodeUnaryOperator*>( node );
+      QString operand;
+      ValueType operandType;
+      if ( compileNode( n->operand(), operand, operandType ) != Complete )
+        return Fail;
+
+      if ( n->op() == QgsExpression::uoNot && operandType == Boolean )
+      {
+        result = QString( "NOT (%1)" ).arg( operand );
+        type = Boolean;
+        return Complete;
+      }
+      else if ( n->op() == QgsExpression::uoMinus && operandType == Numeric )
+      {
+        result = QString( "-(%1)" ).arg( operand );
+        type = Numeric;
+        return Complete;
+      }
+      return Fail;
+    }
+
+    case QgsExpression::ntBinaryOperator:
+      return compileBinary( static_cast<const QgsExpression::NodeBinaryOperator*>( node ), result, type );
+
+    case QgsExpression::ntInOperator:
+      return compileIn( static_cast<const QgsExpression::NodeInOperator*>( node ), result, type );
+
+    case QgsExpression::ntFunction:
+    case QgsExpression::ntCondition:
+      break;
+  }
+
+  return Fail;
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compileBinary( const QgsExpression::NodeBinaryOperator* node, QString& result, ValueType& type )
+{
+  QgsExpression::BinaryOperator op = node->op();
+
+  switch ( op )
+  {
+    case QgsExpression::boEQ:
+    case QgsExpression::boNE:
+    case QgsExpression::boLE:
+    case QgsExpression::boGE:
+    case QgsExpression::boLT:
+    case QgsExpression::boGT:
+      return compileComparison( node, result, type );
+
+    default:
+      break;
+  }
+
+  QString left, right;
+  ValueType leftType, rightType;
+  Result leftRes = compileNode( node->opLeft(), left, leftType );
+  Result rightRes = compileNode( node->opRight(), right, rightType );
+  type = Boolean;
+
+  switch ( op )
+  {
+    case QgsExpression::boAnd:
+    {
+      if ( leftRes != Fail && leftType != Boolean )
+        leftRes = Fail;
+      if ( rightRes != Fail && rightType != Boolean )
+        rightRes = Fail;
+
+      // each operand alone selects a superset of the features
+      if ( leftRes == Fail && rightRes == Fail )
+        return Fail;
+      if ( leftRes == Fail )
+      {
+        result = right;
+        return Partial;
+      }
+      if ( rightRes == Fail )
+      {
+        result = left;
+        return Partial;
+      }
+
+      result = QString( "(%1) AND (%2)" ).arg( left, right );
+      return leftRes == Complete && rightRes == Complete ? Complete : Partial;
+    }
+
+    case QgsExpression::boOr:
+      if ( leftRes == Fail || rightRes == Fail || leftType != Boolean || rightType != Boolean )
+        return Fail;
+
+      result = QString( "(%1) OR (%2)" ).arg( left, right );
+      return leftRes == Complete && rightRes == Complete ? Complete : Partial;
+
+    case QgsExpression::boIs:
+    case QgsExpression::boIsNot:
+    {
+      // only IS [NOT] NULL - everything else has different NULL handling in SQL
+      QString operand;
+      if ( rightRes == Complete && rightType == Null && leftRes == Complete && leftType != Boolean )
+        operand = left;
+      else if ( leftRes == Complete && leftType == Null && rightRes == Complete && rightType != Boolean )
+        operand = right;
+      else
+        return Fail;
+
+      result = QString( "(%1) %2" ).arg( operand, QString( op == QgsExpression::boIs ? "IS NULL" : "IS NOT NULL" ) );
+      return Complete;
+    }
+
+    case QgsExpression::boLike:
+    case QgsExpression::boNotLike:
+    case QgsExpression::boILike:
+    case QgsExpression::boNotILike:
+    {
+      QVariant pattern;
+      if ( leftRes != Complete || leftType != String || !literalValue( node->opRight(), pattern ) || pattern.isNull() )
+        return Fail;
+
+      // backslash is an escape character for some databases
+      QString patternStr = pattern.toString();
+      if ( patternStr.contains( '\\' ) )
+        return Fail;
+
+      bool caseInsensitive = op == QgsExpression::boILike || op == QgsExpression::boNotILike;
+      QString match;
+      Result res = compileLike( left, patternStr, caseInsensitive, match );
+      if ( res == Fail )
+        return Fail;
+
+      if ( op == QgsExpression::boNotLike || op == QgsExpression::boNotILike )
+      {
+        // negation of a superset is not a superset
+        if ( res != Complete )
+          return Fail;
+        result = QString( "NOT (%1)" ).arg( match );
+      }
+      else
+      {
+        result = match;
+      }
+      return res;
+    }
+
+    case QgsExpression::boPlus:
+    case QgsExpression::boMinus:
+    case QgsExpression::boMul:
+      // division, modulo and power differ in integer and NULL handling
+      if ( leftRes != Complete || rightRes != Complete || leftType != Numeric || rightType != Numeric )
+        return Fail;
+
+      result = QString( "(%1) %2 (%3)" ).arg( left, QString( QgsExpression::BinaryOperatorText[op] ), right );
+      type = Numeric;
+      return Complete;
+
+    default:
+      break;
+  }
+
+  return Fail;
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compileComparison( const QgsExpression::NodeBinaryOperator* node, QString& result, ValueType& type )
+{
+  QString left, right;
+  ValueType leftType, rightType;
+  if ( compileNode( node->opLeft(), left, leftType ) != Complete ||
+       compileNode( node->opRight(), right, rightType ) != Complete )
+    return Fail;
+
+  QgsExpression::BinaryOperator op = node->op();
+  Result res = Complete;
+  QVariant literal;
+
+  if ( leftType == Numeric && rightType == Numeric )
+  {
+    // numeric comparison on both sides
+  }
+  else if ( leftType == Numeric && rightType == String && literalValue( node->opRight(), literal ) && isDoubleSafe( literal ) )
+  {
+    // the expression compares numerically
+    right = quotedValue( literal.toDouble() );
+  }
+  else if ( rightType == Numeric && leftType == String && literalValue( node->opLeft(), literal ) && isDoubleSafe( literal ) )
+  {
+    left = quotedValue( literal.toDouble() );
+  }
+  else if ( leftType == String && rightType == String )
+  {
+    // the expression compares strings only if one of them is not numeric,
+    // ordering also depends on the database collation
+    if ( !( literalValue( node->opLeft(), literal ) && !isDoubleSafe( literal ) ) &&
+         !( literalValue( node->opRight(), literal ) && !isDoubleSafe( literal ) ) )
+      return Fail;
+
+    if ( op != QgsExpression::boEQ && op != QgsExpression::boNE )
+      return Fail;
+
+    if ( mFlags & LooseStringEquality )
+    {
+      if ( op == QgsExpression::boNE )
+        return Fail;
+      res = Partial;
+    }
+  }
+  else
+  {
+    return Fail;
+  }
+
+  result = QString( "(%1) %2 (%3)" ).arg( left, QString( QgsExpression::BinaryOperatorText[op] ), right );
+  type = Boolean;
+  return res;
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compileIn( const QgsExpression::NodeInOperator* node, QString& result, ValueType& type )
+{
+  QString value;
+  ValueType valueType;
+  if ( compileNode( node->node(), value, valueType ) != Complete || ( valueType != Numeric && valueType != String ) )
+    return Fail;
+
+  QList<QgsExpression::Node*> items = node->list()->list();
+  if ( items.isEmpty() )
+    return Fail;
+
+  QStringList list;
+  foreach ( const QgsExpression::Node* item, items )
+  {
+    QVariant literal;
+    if ( !literalValue( item, literal ) )
+      return Fail;
+
+    if ( literal.isNull() )
+      list << quotedValue( literal );
+    else if ( valueType == Numeric && isDoubleSafe( literal ) )
+      list << quotedValue( literal.type() == QVariant::Int ? literal : QVariant( literal.toDouble() ) );
+    else if ( valueType == String && literal.type() == QVariant::String && !isDoubleSafe( literal ) )
+      list << quotedValue( literal );
+    else
+      return Fail;
+  }
+
+  Result res = Complete;
+  if ( valueType == String && ( mFlags & LooseStringEquality ) )
+  {
+    if ( node->isNotIn() )
+      return Fail;
+    res = Partial;
+  }
+
+  result = QString( "(%1) %2 (%3)" ).arg( value, QString( node->isNotIn() ? "NOT IN" : "IN" ), list.join( "," ) );
+  type = Boolean;
+  return res;
+}
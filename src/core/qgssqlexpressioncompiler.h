@@ -0,0 +1,91 @@
+/***************************************************************************
+    qgssqlexpressioncompiler.h
+    ---------------------
+    begin                : May 2014
+    copyright            : (C) 2014 by the QGIS project
+    email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSSQLEXPRESSIONCOMPILER_H
+#define QGSSQLEXPRESSIONCOMPILER_H
+
+#include "qgsexpression.h"
+#include "qgsfield.h"
+
+/**
+ * Translates a QgsExpression (as used by QgsFeatureRequest::setFilterExpression())
+ * into a SQL WHERE clause so that database providers can filter on the server.
+ *
+ * Only the subset of expressions with identical semantics in SQL is translated:
+ * comparisons, IN, LIKE / ILIKE, AND / OR / NOT, IS NULL and + - * arithmetic
+ * on columns and literals. If only some operands of an AND can be translated,
+ * the result is a partial filter which returns a superset of the matching
+ * features - the expression then still has to be evaluated on the client.
+ *
+ * Providers subclass it to adapt quoting and operators to their SQL dialect.
+ * @note added in 2.4
+ */
+class CORE_EXPORT QgsSqlExpressionCompiler
+{
+  public:
+    enum Result
+    {
+      None,     //!< nothing has been compiled yet
+      Complete, //!< the whole expression was translated, no client side filtering is needed
+      Partial,  //!< the SQL returns a superset of matching features, the expression has to be evaluated too
+      Fail      //!< the expression could not be translated
+    };
+
+    enum Flag
+    {
+      LooseStringEquality = 1 //!< string equality depends on collation (may ignore case or trailing spaces)
+    };
+
+    QgsSqlExpressionCompiler( const QgsFields& fields, int flags = 0 );
+    virtual ~QgsSqlExpressionCompiler();
+
+    //! Translate the expression, the SQL is then available in result()
+    Result compile( const QgsExpression* exp );
+
+    //! Returns the SQL WHERE clause of the last successful compile() call
+    QString result() const { return mResult; }
+
+  protected:
+    //! type of the value of a translated node
+    enum ValueType
+    {
+      Null,
+      Numeric,
+      String,
+      Boolean,
+      Other
+    };
+
+    //! Type of values of a column - columns of type Other can only be tested for NULL
+    virtual ValueType columnType( const QgsField& field );
+    //! Quote a column name
+    virtual QString quotedIdentifier( const QString& identifier );
+    //! Quote a literal (null, numeric or string)
+    virtual QString quotedValue( const QVariant& value );
+    //! Translate a LIKE / ILIKE match of already translated string value with a pattern
+    //! (in LIKE syntax, not quoted yet)
+    virtual Result compileLike( const QString& value, const QString& pattern, bool caseInsensitive, QString& result );
+
+    Result compileNode( const QgsExpression::Node* node, QString& result, ValueType& type );
+    Result compileBinary( const QgsExpression::NodeBinaryOperator* node, QString& result, ValueType& type );
+    Result compileComparison( const QgsExpression::NodeBinaryOperator* node, QString& result, ValueType& type );
+    Result compileIn( const QgsExpression::NodeInOperator* node, QString& result, ValueType& type );
+
+    QgsFields mFields;
+    int mFlags;
+    QString mResult;
+};
+
+#endif // QGSSQLEXPRESSIONCOMPILER_H
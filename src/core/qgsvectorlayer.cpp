@@ -177,6 +177,12 @@ QgsVectorLayer::QgsVectorLayer( QString vectorLayerPath,
 
   connect( QgsProject::instance()->relationManager(), SIGNAL( relationsLoaded() ), this, SLOT( onRelationsLoaded() ) );
 
+  // simplified geometries of the committed features are cached for rendering
+  connect( this, SIGNAL( featureAdded( QgsFeatureId ) ), this, SLOT( invalidateSimplifiedGeometryCache() ) );
+  connect( this, SIGNAL( featureDeleted( QgsFeatureId ) ), this, SLOT( invalidateSimplifiedGeometryCache() ) );
+  connect( this, SIGNAL( geometryChanged( QgsFeatureId, QgsGeometry& ) ), this, SLOT( invalidateSimplifiedGeometryCache() ) );
+  connect( this, SIGNAL( attributeValueChanged( QgsFeatureId, int, QVariant ) ), this, SLOT( invalidateSimplifiedGeometryCache() ) );
+
   // Default simplify drawing settings
   QSettings settings;
   mSimplifyMethod.setSimplifyHints(( QgsVectorSimplifyMethod::SimplifyHints ) settings.value( "/qgis/simplifyDrawingHints", ( int ) mSimplifyMethod.simplifyHints() ).toInt() );
@@ -196,6 +202,8 @@ QgsVectorLayer::~QgsVectorLayer()
 
   mValid = false;
 
+  QgsMultiResolutionGeometryCache::instance()->invalidate( id() );
+
   delete mDataProvider;
   delete mEditBuffer;
   delete mJoinBuffer;
@@ -396,6 +404,8 @@ void QgsVectorLayer::reload()
   {
     mDataProvider->reloadData();
   }
+
+  invalidateSimplifiedGeometryCache();
 }
 
 QgsMapLayerRenderer* QgsVectorLayer::createMapRenderer( QgsRenderContext& rendererContext )
@@ -567,6 +577,8 @@ void QgsVectorLayer::removeSelection()
 
 void QgsVectorLayer::triggerRepaint()
 {
+  // the data may have been changed from outside (e.g. in the database)
+  invalidateSimplifiedGeometryCache();
   emit repaintRequested();
 }
 
@@ -917,6 +929,8 @@ bool QgsVectorLayer::setSubsetString( QString subset )
 
   bool res = mDataProvider->setSubsetString( subset );
 
+  QgsMultiResolutionGeometryCache::instance()->invalidate( id() );
+
   // get the updated data source string from the provider
   mDataSource = mDataProvider->dataSourceUri();
   updateExtents();
@@ -1354,6 +1368,7 @@ bool QgsVectorLayer::setDataProvider( QString const & provider )
     {
       // TODO: Check if the provider has the capability to send fullExtentCalculated
       connect( mDataProvider, SIGNAL( fullExtentCalculated() ), this, SLOT( updateExtents() ) );
+      connect( mDataProvider, SIGNAL( dataChanged() ), this, SLOT( invalidateSimplifiedGeometryCache() ) );
 
       // get and store the feature type
       mWkbType = mDataProvider->geometryType();
@@ -2961,6 +2976,9 @@ void QgsVectorLayer::updateFields()
 
   mUpdatedFields = mDataProvider->fields();
 
+  // committed changes and joins change the data rendered from the cache
+  QgsMultiResolutionGeometryCache::instance()->invalidate( id() );
+
   // added / removed fields
   if ( mEditBuffer )
     mEditBuffer->updateFields( mUpdatedFields );
@@ -3690,6 +3708,11 @@ void QgsVectorLayer::invalidateSymbolCountedFlag()
   mSymbolFeatureCounted = false;
 }
 
+void QgsVectorLayer::invalidateSimplifiedGeometryCache()
+{
+  QgsMultiResolutionGeometryCache::instance()->invalidate( id() );
+}
+
 void QgsVectorLayer::onRelationsLoaded()
 {
   Q_FOREACH( QgsAttributeEditorElement* elem, mAttributeEditorElements )
@@ -1553,6 +1553,8 @@ class CORE_EXPORT QgsVectorLayer : public QgsMapLayer
 
   private slots:
     void onRelationsLoaded();
+    //! drops the simplified geometries of the layer from the multi-resolution geometry cache
+    void invalidateSimplifiedGeometryCache();
 
   protected:
     /** Set the extent */
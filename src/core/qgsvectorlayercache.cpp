@@ -18,6 +18,7 @@
 #include "qgsvectorlayercache.h"
 #include "qgscacheindex.h"
 #include "qgscachedfeatureiterator.h"
+#include "qgscolumnarfeaturestore.h"
 
 QgsVectorLayerCache::QgsVectorLayerCache( QgsVectorLayer* layer, int cacheSize, QObject* parent )
     : QObject( parent )
@@ -25,6 +26,7 @@ QgsVectorLayerCache::QgsVectorLayerCache( QgsVectorLayer* layer, int cacheSize,
     , mFullCache( false )
 {
   mCache.setMaxCost( cacheSize );
+  mFeatureStore = new QgsColumnarFeatureStore;
 
   connect( mLayer, SIGNAL( featureDeleted( QgsFeatureId ) ), SLOT( featureDeleted( QgsFeatureId ) ) );
   connect( mLayer, SIGNAL( featureAdded( QgsFeatureId ) ), SLOT( onFeatureAdded( QgsFeatureId ) ) );
@@ -39,6 +41,11 @@ QgsVectorLayerCache::QgsVectorLayerCache( QgsVectorLayer* layer, int cacheSize,
   connect( mLayer, SIGNAL( attributeValueChanged( QgsFeatureId, int, const QVariant& ) ), SLOT( onAttributeValueChanged( QgsFeatureId, int, const QVariant& ) ) );
 }
 
+QgsVectorLayerCache::~QgsVectorLayerCache()
+{
+  delete mFeatureStore;
+}
+
 void QgsVectorLayerCache::setCacheSize( int cacheSize )
 {
   mCache.setMaxCost( cacheSize );
@@ -69,6 +76,19 @@ void QgsVectorLayerCache::setCacheSubsetOfAttributes( const QgsAttributeList& at
 
 void QgsVectorLayerCache::setFullCache( bool fullCache )
 {
+  if ( !fullCache && mFullCache )
+  {
+    // Keep what fits into the regular cache
+    mFullCache = false;
+    QgsFeature f;
+    for ( int row = 0; row < mFeatureStore->count(); ++row )
+    {
+      mFeatureStore->featureAt( row, f );
+      cacheFeature( f );
+    }
+    mFeatureStore->clear();
+  }
+
   mFullCache = fullCache;
 
   if ( mFullCache )
@@ -76,6 +96,11 @@ void QgsVectorLayerCache::setFullCache( bool fullCache )
     // Add a little more than necessary...
     setCacheSize( mLayer->featureCount() + 100 );
 
+    // All features go to the columnar storage
+    mCache.clear();
+    resetFeatureStore();
+    mFeatureStore->reserve( mLayer->featureCount() );
+
     // Initialize the cache...
     QgsFeatureIterator it( new QgsCachedFeatureWriterIterator( this, QgsFeatureRequest()
                            .setSubsetOfAttributes( mCachedAttributes )
@@ -133,6 +158,11 @@ bool QgsVectorLayerCache::featureAtId( QgsFeatureId featureId, QgsFeature& featu
 
   if ( !skipCache )
   {
+    if ( mFullCache && mFeatureStore->feature( featureId, feature ) )
+    {
+      return true;
+    }
+
     cachedFeature = mCache[ featureId ];
   }
 
@@ -156,6 +186,12 @@ bool QgsVectorLayerCache::featureAtId( QgsFeatureId featureId, QgsFeature& featu
 
 bool QgsVectorLayerCache::removeCachedFeature( QgsFeatureId fid )
 {
+  if ( mFeatureStore->remove( fid ) )
+  {
+    featureRemoved( fid );
+    return true;
+  }
+
   return mCache.remove( fid );
 }
 
@@ -167,7 +203,7 @@ QgsVectorLayer* QgsVectorLayerCache::layer()
 void QgsVectorLayerCache::requestCompleted( QgsFeatureRequest featureRequest, QgsFeatureIds fids )
 {
   // If a request is too large for the cache don't notify to prevent from indexing incomplete requests
-  if ( fids.count() < mCache.size() )
+  if ( fids.count() < cachedFeatureCount() )
   {
     foreach ( QgsAbstractCacheIndex* idx, mCacheIndices )
     {
@@ -192,13 +228,17 @@ void QgsVectorLayerCache::onAttributeValueChanged( QgsFeatureId fid, int field,
   {
     cachedFeat->mFeature->setAttribute( field, value );
   }
+  else
+  {
+    mFeatureStore->setAttribute( fid, field, value );
+  }
 
   emit attributeValueChanged( fid, field, value );
 }
 
 void QgsVectorLayerCache::featureDeleted( QgsFeatureId fid )
 {
-  mCache.remove( fid );
+  removeCachedFeature( fid );
 }
 
 void QgsVectorLayerCache::onFeatureAdded( QgsFeatureId fid )
@@ -221,6 +261,7 @@ void QgsVectorLayerCache::attributeAdded( int field )
   Q_UNUSED( field )
   mCachedAttributes.append( field );
   mCache.clear();
+  resetFeatureStore();
 }
 
 void QgsVectorLayerCache::attributeDeleted( int field )
@@ -229,6 +270,7 @@ void QgsVectorLayerCache::attributeDeleted( int field )
   {
     mCache[ fid ]->mFeature->deleteAttribute( field );
   }
+  mFeatureStore->deleteAttribute( field );
 }
 
 void QgsVectorLayerCache::geometryChanged( QgsFeatureId fid, QgsGeometry& geom )
@@ -239,6 +281,10 @@ void QgsVectorLayerCache::geometryChanged( QgsFeatureId fid, QgsGeometry& geom )
   {
     cachedFeat->mFeature->setGeometry( geom );
   }
+  else
+  {
+    mFeatureStore->setGeometry( fid, geom );
+  }
 }
 
 void QgsVectorLayerCache::layerDeleted()
@@ -250,6 +296,7 @@ void QgsVectorLayerCache::layerDeleted()
 void QgsVectorLayerCache::updatedFields()
 {
   mCache.clear();
+  resetFeatureStore();
 }
 
 QgsFeatureIterator QgsVectorLayerCache::getFeatures( const QgsFeatureRequest &featureRequest )
@@ -307,7 +354,37 @@ QgsFeatureIterator QgsVectorLayerCache::getFeatures( const QgsFeatureRequest &fe
 
 bool QgsVectorLayerCache::isFidCached( const QgsFeatureId fid )
 {
-  return mCache.contains( fid );
+  return mCache.contains( fid ) || mFeatureStore->contains( fid );
+}
+
+void QgsVectorLayerCache::cacheFeature( QgsFeature& feat )
+{
+  if ( mFullCache )
+  {
+    mFeatureStore->insert( feat );
+    return;
+  }
+
+  QgsCachedFeature* cachedFeature = new QgsCachedFeature( feat, this );
+  mCache.insert( feat.id(), cachedFeature );
+}
+
+int QgsVectorLayerCache::cachedFeatureCount() const
+{
+  return mFullCache ? mFeatureStore->count() : mCache.size();
+}
+
+void QgsVectorLayerCache::resetFeatureStore()
+{
+  if ( mFeatureStore->count() > 0 )
+  {
+    foreach ( QgsAbstractCacheIndex* idx, mCacheIndices )
+    {
+      idx->flush();
+    }
+  }
+
+  mFeatureStore->reset( mLayer ? mLayer->pendingFields() : QgsFields(), mCachedAttributes );
 }
 
 bool QgsVectorLayerCache::checkInformationCovered( const QgsFeatureRequest& featureRequest )
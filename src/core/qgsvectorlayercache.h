@@ -25,6 +25,7 @@
 
 class QgsCachedFeatureIterator;
 class QgsAbstractCacheIndex;
+class QgsColumnarFeatureStore;
 
 /**
  * This class caches features of a given QgsVectorLayer.
@@ -79,6 +80,7 @@ class CORE_EXPORT QgsVectorLayerCache : public QObject
 
   public:
     QgsVectorLayerCache( QgsVectorLayer* layer, int cacheSize, QObject* parent = NULL );
+    ~QgsVectorLayerCache();
 
     /**
      * Sets the maximum number of features to keep in the cache. Some features will be removed from
@@ -127,6 +129,8 @@ class CORE_EXPORT QgsVectorLayerCache : public QObject
      * be increased to offer space for all features.
      * When enabled, all features will be read into cache. As this feature will most likely
      * be used for slow data sources, be aware, that the call to this method might take a long time.
+     * The features of a full cache are kept in compact columnar storage instead of
+     * separate feature objects.
      *
      * @param fullCache   True: enable full caching, False: disable full caching
      */
@@ -265,15 +269,20 @@ class CORE_EXPORT QgsVectorLayerCache : public QObject
 
   private:
 
-    inline void cacheFeature( QgsFeature& feat )
-    {
-      QgsCachedFeature* cachedFeature = new QgsCachedFeature( feat, this );
-      mCache.insert( feat.id(), cachedFeature );
-    }
+    void cacheFeature( QgsFeature& feat );
+
+    //! number of features in the cache
+    int cachedFeatureCount() const;
+
+    //! reset the columnar storage to the current fields
+    void resetFeatureStore();
 
     QgsVectorLayer* mLayer;
     QCache< QgsFeatureId, QgsCachedFeature > mCache;
 
+    //! storage of all features in full cache mode, mCache is empty then
+    QgsColumnarFeatureStore* mFeatureStore;
+
     bool mCacheGeometry;
     bool mFullCache;
     QList<QgsAbstractCacheIndex*> mCacheIndices;
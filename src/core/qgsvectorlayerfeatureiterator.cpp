@@ -138,6 +138,7 @@ QgsVectorLayerFeatureIterator::QgsVectorLayerFeatureIterator( QgsVectorLayerFeat
   if ( mRequest.filterType() == QgsFeatureRequest::FilterExpression )
   {
     mRequest.filterExpression()->prepare( mSource->mFields );
+    mRequest.filterExpression()->compile();
   }
 }
 
@@ -30,6 +30,7 @@ QgsVectorLayerRenderer::QgsVectorLayerRenderer( QgsVectorLayer* layer, QgsRender
     , mLabeling( false )
     , mDiagrams( false )
     , mLayerTransparency( 0 )
+    , mFeatureCount( 0 )
 {
   mSource = new QgsVectorLayerFeatureSource( layer );
 
@@ -45,6 +46,9 @@ QgsVectorLayerRenderer::QgsVectorLayerRenderer( QgsVectorLayer* layer, QgsRender
 
   mSimplifyMethod = layer->simplifyMethod();
   mSimplifyGeometry = layer->simplifyDrawingCanbeApplied( mContext, QgsVectorSimplifyMethod::GeometrySimplification );
+  mSimplifiedCacheGeneration = QgsMultiResolutionGeometryCache::instance()->generation( layer->id() );
+  // the cache holds committed features only
+  mUseSimplifiedCache = !layer->isEditable();
 
   QSettings settings;
   mVertexMarkerOnlyForSelection = settings.value( "/qgis/digitizing/marker_only_for_selected", false ).toBool();
@@ -117,6 +121,8 @@ bool QgsVectorLayerRenderer::render()
                                      .setFilterRect( mContext.extent() )
                                      .setSubsetOfAttributes( mAttrNames, mFields );
 
+  double simplifyTolerance = 0;
+
   // enable the simplification of the geometries (Using the current map2pixel context) before send it to renderer engine.
   if ( mSimplifyGeometry )
   {
@@ -171,9 +177,14 @@ bool QgsVectorLayerRenderer::render()
     simplifyMethod.setForceLocalOptimization( mSimplifyMethod.forceLocalOptimization() );
 
     featureRequest.setSimplifyMethod( simplifyMethod );
+    simplifyTolerance = map2pixelTol;
   }
 
-  QgsFeatureIterator fit = mSource->getFeatures( featureRequest );
+  // reuse geometries simplified by previous renders, the geometry cache
+  // for editing needs the geometries as they are
+  QgsFeatureIterator fit;
+  if ( simplifyTolerance <= 0 || mCache || !mUseSimplifiedCache || !cachedSimplifiedFeatures( featureRequest, simplifyTolerance, fit ) )
+    fit = mSource->getFeatures( featureRequest );
 
   if (( mRendererV2->capabilities() & QgsFeatureRendererV2::SymbolLevels ) && mRendererV2->usingSymbolLevels() )
     drawRendererV2Levels( fit );
@@ -195,6 +206,52 @@ bool QgsVectorLayerRenderer::render()
   return true;
 }
 
+bool QgsVectorLayerRenderer::cachedSimplifiedFeatures( const QgsFeatureRequest& request, double tolerance, QgsFeatureIterator& fit )
+{
+  QgsMultiResolutionGeometryCache* cache = QgsMultiResolutionGeometryCache::instance();
+  int band = QgsMultiResolutionGeometryCache::band( tolerance );
+
+  QgsMultiResolutionGeometryCache::EntryPtr entry = cache->entry( mLayerID, band, mAttrNames, mContext.extent() );
+  if ( entry )
+  {
+    QgsFeatureRequest cachedRequest( request );
+    cachedRequest.setSimplifyMethod( QgsSimplifyMethod() );
+    fit = QgsMultiResolutionGeometryCache::getFeatures( entry, cachedRequest );
+    return true;
+  }
+
+  // another renderer (e.g. a tile of the same map) is building the entry
+  if ( !cache->reserveEntry( mLayerID, band, mAttrNames ) )
+    return false;
+
+  // fetch a larger area so that the entry can be reused when panning
+  QgsRectangle extent = mContext.extent();
+  extent.scale( 2.0 );
+
+  QgsSimplifyMethod simplifyMethod = request.simplifyMethod();
+  simplifyMethod.setTolerance( QgsMultiResolutionGeometryCache::bandTolerance( band ) );
+
+  QgsFeatureRequest entryRequest( request );
+  entryRequest.setFilterRect( extent );
+  entryRequest.setSimplifyMethod( simplifyMethod );
+
+  QgsAttributeList attributes;
+  foreach ( const QString& name, mAttrNames )
+  {
+    int idx = mFields.indexFromName( name );
+    if ( idx >= 0 )
+      attributes << idx;
+  }
+
+  QgsMultiResolutionGeometryCache::Entry* newEntry = new QgsMultiResolutionGeometryCache::Entry;
+  newEntry->extent = extent;
+  newEntry->features.reset( mFields, attributes );
+
+  // features are drawn while the entry is filled, it is only stored if all features were fetched
+  fit = cache->fillEntry( mLayerID, mSimplifiedCacheGeneration, band, mAttrNames, newEntry, mSource->getFeatures( entryRequest ), mContext.extent() );
+  return true;
+}
+
 void QgsVectorLayerRenderer::setGeometryCachePointer( QgsGeometryCache* cache )
 {
   mCache = cache;
@@ -224,6 +281,8 @@ void QgsVectorLayerRenderer::drawRendererV2( QgsFeatureIterator& fit )
         break;
       }
 
+      ++mFeatureCount;
+
       bool sel = mSelectedFeatureIds.contains( fet.id() );
       bool drawMarker = ( mDrawVertexMarkers && mContext.drawEditingInformation() && ( !mVertexMarkerOnlyForSelection || sel ) );
 
@@ -288,6 +347,8 @@ void QgsVectorLayerRenderer::drawRendererV2Levels( QgsFeatureIterator& fit )
       return;
     }
 
+    ++mFeatureCount;
+
     QgsSymbolV2* sym = mRendererV2->symbolForFeature( fet );
     if ( !sym )
     {
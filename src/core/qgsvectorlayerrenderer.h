@@ -39,6 +39,10 @@ class QgsVectorLayerRenderer : public QgsMapLayerRenderer
     //! @note The way how geometries are cached is really suboptimal - this method may be removed in future releases
     void setGeometryCachePointer( QgsGeometryCache* cache );
 
+    //! number of features fetched for rendering so far
+    //! @note added in 2.4
+    int featureCount() const { return mFeatureCount; }
+
   private:
 
     /**Registers label and diagram layer
@@ -59,6 +63,12 @@ class QgsVectorLayerRenderer : public QgsMapLayerRenderer
     /** Stop version 2 renderer and selected renderer (if required) */
     void stopRendererV2( QgsSingleSymbolRendererV2* selRenderer );
 
+    /** Get iterator over features with geometries simplified for the tolerance from the
+     * multi-resolution geometry cache. On a miss the returned iterator fills the cache while
+     * the features are drawn. Returns false if another renderer is filling the same entry.
+     */
+    bool cachedSimplifiedFeatures( const QgsFeatureRequest& request, double tolerance, QgsFeatureIterator& fit );
+
 
   protected:
 
@@ -91,6 +101,13 @@ class QgsVectorLayerRenderer : public QgsMapLayerRenderer
 
     QgsVectorSimplifyMethod mSimplifyMethod;
     bool mSimplifyGeometry;
+
+    //! generation of the layer data in the multi-resolution geometry cache
+    int mSimplifiedCacheGeneration;
+    //! false for editable layers, their edit buffer changes the rendered features
+    bool mUseSimplifiedCache;
+
+    int mFeatureCount;
 };
 
 
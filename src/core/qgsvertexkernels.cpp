@@ -0,0 +1,464 @@
+/***************************************************************************
+    qgsvertexkernels.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsvertexkernels.h"
+
+#include <string.h>
+
+// SSE2 is part of every x86-64 CPU, AVX kernels are compiled for the target
+// with function attributes and only called after checking the CPU at runtime
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define QGS_VERTEXKERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(QGS_VERTEXKERNELS_SSE2)
+#if defined(__clang__)
+#if __clang_major__ > 3 || ( __clang_major__ == 3 && __clang_minor__ >= 8 )
+#define QGS_VERTEXKERNELS_AVX
+#define QGS_TARGET_AVX __attribute__(( target( "avx" ) ))
+#endif
+#elif defined(__GNUC__)
+#if __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 )
+#define QGS_VERTEXKERNELS_AVX
+#define QGS_TARGET_AVX __attribute__(( target( "avx" ) ))
+#endif
+#elif defined(_MSC_VER) && _MSC_VER >= 1700
+#define QGS_VERTEXKERNELS_AVX
+#define QGS_TARGET_AVX
+#endif
+#endif
+
+#ifdef QGS_VERTEXKERNELS_AVX
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// CPU detection
+
+#ifdef QGS_VERTEXKERNELS_AVX
+static bool cpuSupportsAvx()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid( info, 0 );
+  if ( info[0] < 1 )
+    return false;
+
+  __cpuid( info, 1 );
+  // OSXSAVE and AVX
+  if (( info[2] & ( 1 << 27 ) ) == 0 || ( info[2] & ( 1 << 28 ) ) == 0 )
+    return false;
+
+  // the OS must save the YMM registers on context switches
+  return ( _xgetbv( 0 ) & 6 ) == 6;
+#else
+  unsigned int eax, ebx, ecx, edx;
+  if ( __get_cpuid_max( 0, 0 ) < 1 )
+    return false;
+
+  __cpuid( 1, eax, ebx, ecx, edx );
+  // OSXSAVE and AVX
+  if (( ecx & ( 1 << 27 ) ) == 0 || ( ecx & ( 1 << 28 ) ) == 0 )
+    return false;
+
+  // the OS must save the YMM registers on context switches, xgetbv is emitted
+  // as bytes for assemblers that do not know it
+  unsigned int xcr0, xcr0High;
+  __asm__ __volatile__( ".byte 0x0f, 0x01, 0xd0" : "=a"( xcr0 ), "=d"( xcr0High ) : "c"( 0 ) );
+  return ( xcr0 & 6 ) == 6;
+#endif
+}
+#endif
+
+static QgsVertexKernels::InstructionSet detectInstructionSet()
+{
+#ifdef QGS_VERTEXKERNELS_AVX
+  if ( cpuSupportsAvx() )
+    return QgsVertexKernels::AVX;
+#endif
+#ifdef QGS_VERTEXKERNELS_SSE2
+  return QgsVertexKernels::SSE2;
+#else
+  return QgsVertexKernels::Scalar;
+#endif
+}
+
+static const QgsVertexKernels::InstructionSet sSupportedInstructionSet = detectInstructionSet();
+static QgsVertexKernels::InstructionSet sInstructionSet = sSupportedInstructionSet;
+
+QgsVertexKernels::InstructionSet QgsVertexKernels::instructionSet()
+{
+  return sInstructionSet;
+}
+
+QgsVertexKernels::InstructionSet QgsVertexKernels::supportedInstructionSet()
+{
+  return sSupportedInstructionSet;
+}
+
+void QgsVertexKernels::setInstructionSet( InstructionSet set )
+{
+  sInstructionSet = set > sSupportedInstructionSet ? sSupportedInstructionSet : set;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Scalar kernels
+
+static void mapToPixelScalar( double* x, double* y, int count, double mupp, double xMin, double yMin, double yMax )
+{
+  for ( int i = 0; i < count; ++i )
+  {
+    x[i] = ( x[i] - xMin ) / mupp;
+    y[i] = yMax - ( y[i] - yMin ) / mupp;
+  }
+}
+
+static void mapToPixelScalar( unsigned char* xy, int count, int stride, double mupp, double xMin, double yMin, double yMax )
+{
+  double x, y;
+  for ( int i = 0; i < count; ++i, xy += stride )
+  {
+    memcpy( &x, xy, sizeof( double ) );
+    memcpy( &y, xy + sizeof( double ), sizeof( double ) );
+    x = ( x - xMin ) / mupp;
+    y = yMax - ( y - yMin ) / mupp;
+    memcpy( xy, &x, sizeof( double ) );
+    memcpy( xy + sizeof( double ), &y, sizeof( double ) );
+  }
+}
+
+static void boundingBoxScalar( const unsigned char* xy, int count, int stride, double& xMin, double& yMin, double& xMax, double& yMax )
+{
+  double x, y;
+  for ( int i = 0; i < count; ++i, xy += stride )
+  {
+    memcpy( &x, xy, sizeof( double ) );
+    memcpy( &y, xy + sizeof( double ), sizeof( double ) );
+
+    if ( xMin > x ) xMin = x;
+    if ( yMin > y ) yMin = y;
+    if ( xMax < x ) xMax = x;
+    if ( yMax < y ) yMax = y;
+  }
+}
+
+static int firstBeyondToleranceScalar( const unsigned char* xy, int count, int stride, double x, double y, double toleranceSquared )
+{
+  double px, py;
+  for ( int i = 0; i < count; ++i, xy += stride )
+  {
+    memcpy( &px, xy, sizeof( double ) );
+    memcpy( &py, xy + sizeof( double ), sizeof( double ) );
+
+    float vx = ( float )( x - px );
+    float vy = ( float )( y - py );
+    float lengthSquared = vx * vx + vy * vy;
+    if ( lengthSquared > toleranceSquared )
+      return i;
+  }
+  return count;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// SSE2 kernels
+
+#ifdef QGS_VERTEXKERNELS_SSE2
+
+// The transform keeps the scalar order of operations, including the division,
+// so that the vectorized results are identical to the scalar ones.
+
+static void mapToPixelSSE2( double* x, double* y, int count, double mupp, double xMin, double yMin, double yMax )
+{
+  const __m128d vMupp = _mm_set1_pd( mupp );
+  const __m128d vXMin = _mm_set1_pd( xMin );
+  const __m128d vYMin = _mm_set1_pd( yMin );
+  const __m128d vYMax = _mm_set1_pd( yMax );
+
+  int i = 0;
+  for ( ; i + 2 <= count; i += 2 )
+  {
+    __m128d vx = _mm_loadu_pd( x + i );
+    __m128d vy = _mm_loadu_pd( y + i );
+    _mm_storeu_pd( x + i, _mm_div_pd( _mm_sub_pd( vx, vXMin ), vMupp ) );
+    _mm_storeu_pd( y + i, _mm_sub_pd( vYMax, _mm_div_pd( _mm_sub_pd( vy, vYMin ), vMupp ) ) );
+  }
+  mapToPixelScalar( x + i, y + i, count - i, mupp, xMin, yMin, yMax );
+}
+
+static void mapToPixelSSE2( unsigned char* xy, int count, int stride, double mupp, double xMin, double yMin, double yMax )
+{
+  // (x, y) -> ((x - xMin) / mupp, -((y - yMin) / mupp)) + (-0, yMax)
+  // adding -0 leaves x unchanged, including the sign of zero
+  const __m128d vMupp = _mm_set1_pd( mupp );
+  const __m128d vOrigin = _mm_setr_pd( xMin, yMin );
+  const __m128d vSign = _mm_setr_pd( 0.0, -0.0 );
+  const __m128d vOffset = _mm_setr_pd( -0.0, yMax );
+
+  for ( int i = 0; i < count; ++i, xy += stride )
+  {
+    __m128d p = _mm_loadu_pd(( const double* ) xy );
+    p = _mm_div_pd( _mm_sub_pd( p, vOrigin ), vMupp );
+    p = _mm_add_pd( _mm_xor_pd( p, vSign ), vOffset );
+    _mm_storeu_pd(( double* ) xy, p );
+  }
+}
+
+static void boundingBoxSSE2( const unsigned char* xy, int count, int stride, double& xMin, double& yMin, double& xMax, double& yMax )
+{
+  if ( count <= 0 )
+    return;
+
+  // minpd/maxpd return the second operand if either is NaN, so NaN vertices are skipped
+  __m128d vMin = _mm_setr_pd( xMin, yMin );
+  __m128d vMax = _mm_setr_pd( xMax, yMax );
+  for ( int i = 0; i < count; ++i, xy += stride )
+  {
+    __m128d p = _mm_loadu_pd(( const double* ) xy );
+    vMin = _mm_min_pd( p, vMin );
+    vMax = _mm_max_pd( p, vMax );
+  }
+
+  double min[2], max[2];
+  _mm_storeu_pd( min, vMin );
+  _mm_storeu_pd( max, vMax );
+  xMin = min[0]; yMin = min[1];
+  xMax = max[0]; yMax = max[1];
+}
+
+static int firstBeyondToleranceSSE2( const unsigned char* xy, int count, int stride, double x, double y, double toleranceSquared )
+{
+  const __m128d vX = _mm_set1_pd( x );
+  const __m128d vY = _mm_set1_pd( y );
+  const __m128d vTolerance = _mm_set1_pd( toleranceSquared );
+
+  int i = 0;
+  for ( ; i + 2 <= count; i += 2, xy += 2 * stride )
+  {
+    __m128d p0 = _mm_loadu_pd(( const double* ) xy );
+    __m128d p1 = _mm_loadu_pd(( const double* )( xy + stride ) );
+
+    // differences in double, squares and sum in float like the scalar code
+    __m128 vx = _mm_cvtpd_ps( _mm_sub_pd( _mm_unpacklo_pd( p0, p1 ), vX ) );
+    __m128 vy = _mm_cvtpd_ps( _mm_sub_pd( _mm_unpackhi_pd( p0, p1 ), vY ) );
+    __m128 lengthSquared = _mm_add_ps( _mm_mul_ps( vx, vx ), _mm_mul_ps( vy, vy ) );
+
+    int mask = _mm_movemask_pd( _mm_cmpgt_pd( _mm_cvtps_pd( lengthSquared ), vTolerance ) );
+    if ( mask )
+      return i + (( mask & 1 ) ? 0 : 1 );
+  }
+  return i + firstBeyondToleranceScalar( xy, count - i, stride, x, y, toleranceSquared );
+}
+
+#endif // QGS_VERTEXKERNELS_SSE2
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// AVX kernels
+
+#ifdef QGS_VERTEXKERNELS_AVX
+
+//! loads the XY of two vertices into one register
+QGS_TARGET_AVX static inline __m256d loadTwoVertices( const unsigned char* xy, int stride )
+{
+  __m128d p0 = _mm_loadu_pd(( const double* ) xy );
+  __m128d p1 = _mm_loadu_pd(( const double* )( xy + stride ) );
+  return _mm256_insertf128_pd( _mm256_castpd128_pd256( p0 ), p1, 1 );
+}
+
+QGS_TARGET_AVX static void mapToPixelAVX( double* x, double* y, int count, double mupp, double xMin, double yMin, double yMax )
+{
+  const __m256d vMupp = _mm256_set1_pd( mupp );
+  const __m256d vXMin = _mm256_set1_pd( xMin );
+  const __m256d vYMin = _mm256_set1_pd( yMin );
+  const __m256d vYMax = _mm256_set1_pd( yMax );
+
+  int i = 0;
+  for ( ; i + 4 <= count; i += 4 )
+  {
+    __m256d vx = _mm256_loadu_pd( x + i );
+    __m256d vy = _mm256_loadu_pd( y + i );
+    _mm256_storeu_pd( x + i, _mm256_div_pd( _mm256_sub_pd( vx, vXMin ), vMupp ) );
+    _mm256_storeu_pd( y + i, _mm256_sub_pd( vYMax, _mm256_div_pd( _mm256_sub_pd( vy, vYMin ), vMupp ) ) );
+  }
+  mapToPixelScalar( x + i, y + i, count - i, mupp, xMin, yMin, yMax );
+}
+
+QGS_TARGET_AVX static void mapToPixelAVX( unsigned char* xy, int count, int stride, double mupp, double xMin, double yMin, double yMax )
+{
+  const __m256d vMupp = _mm256_set1_pd( mupp );
+  const __m256d vOrigin = _mm256_setr_pd( xMin, yMin, xMin, yMin );
+  const __m256d vSign = _mm256_setr_pd( 0.0, -0.0, 0.0, -0.0 );
+  const __m256d vOffset = _mm256_setr_pd( -0.0, yMax, -0.0, yMax );
+
+  int i = 0;
+  for ( ; i + 2 <= count; i += 2, xy += 2 * stride )
+  {
+    __m256d p = loadTwoVertices( xy, stride );
+    p = _mm256_div_pd( _mm256_sub_pd( p, vOrigin ), vMupp );
+    p = _mm256_add_pd( _mm256_xor_pd( p, vSign ), vOffset );
+    _mm_storeu_pd(( double* ) xy, _mm256_castpd256_pd128( p ) );
+    _mm_storeu_pd(( double* )( xy + stride ), _mm256_extractf128_pd( p, 1 ) );
+  }
+  mapToPixelSSE2( xy, count - i, stride, mupp, xMin, yMin, yMax );
+}
+
+QGS_TARGET_AVX static void boundingBoxAVX( const unsigned char* xy, int count, int stride, double& xMin, double& yMin, double& xMax, double& yMax )
+{
+  if ( count <= 0 )
+    return;
+
+  __m256d vMin = _mm256_setr_pd( xMin, yMin, xMin, yMin );
+  __m256d vMax = _mm256_setr_pd( xMax, yMax, xMax, yMax );
+
+  int i = 0;
+  for ( ; i + 2 <= count; i += 2, xy += 2 * stride )
+  {
+    __m256d p = loadTwoVertices( xy, stride );
+    vMin = _mm256_min_pd( p, vMin );
+    vMax = _mm256_max_pd( p, vMax );
+  }
+
+  __m128d min = _mm_min_pd( _mm256_extractf128_pd( vMin, 1 ), _mm256_castpd256_pd128( vMin ) );
+  __m128d max = _mm_max_pd( _mm256_extractf128_pd( vMax, 1 ), _mm256_castpd256_pd128( vMax ) );
+  double minValues[2], maxValues[2];
+  _mm_storeu_pd( minValues, min );
+  _mm_storeu_pd( maxValues, max );
+  xMin = minValues[0]; yMin = minValues[1];
+  xMax = maxValues[0]; yMax = maxValues[1];
+
+  boundingBoxSSE2( xy, count - i, stride, xMin, yMin, xMax, yMax );
+}
+
+QGS_TARGET_AVX static int firstBeyondToleranceAVX( const unsigned char* xy, int count, int stride, double x, double y, double toleranceSquared )
+{
+  const __m256d vX = _mm256_set1_pd( x );
+  const __m256d vY = _mm256_set1_pd( y );
+  const __m256d vTolerance = _mm256_set1_pd( toleranceSquared );
+
+  int i = 0;
+  for ( ; i + 4 <= count; i += 4, xy += 4 * stride )
+  {
+    // (x0 y0 x2 y2) and (x1 y1 x3 y3) unpack to (x0 x1 x2 x3) and (y0 y1 y2 y3)
+    __m128d p0 = _mm_loadu_pd(( const double* ) xy );
+    __m128d p1 = _mm_loadu_pd(( const double* )( xy + stride ) );
+    __m128d p2 = _mm_loadu_pd(( const double* )( xy + 2 * stride ) );
+    __m128d p3 = _mm_loadu_pd(( const double* )( xy + 3 * stride ) );
+    __m256d even = _mm256_insertf128_pd( _mm256_castpd128_pd256( p0 ), p2, 1 );
+    __m256d odd = _mm256_insertf128_pd( _mm256_castpd128_pd256( p1 ), p3, 1 );
+
+    __m128 vx = _mm256_cvtpd_ps( _mm256_sub_pd( _mm256_unpacklo_pd( even, odd ), vX ) );
+    __m128 vy = _mm256_cvtpd_ps( _mm256_sub_pd( _mm256_unpackhi_pd( even, odd ), vY ) );
+    __m128 lengthSquared = _mm_add_ps( _mm_mul_ps( vx, vx ), _mm_mul_ps( vy, vy ) );
+
+    int mask = _mm256_movemask_pd( _mm256_cmp_pd( _mm256_cvtps_pd( lengthSquared ), vTolerance, _CMP_GT_OQ ) );
+    if ( mask )
+    {
+      int j = 0;
+      while (( mask & ( 1 << j ) ) == 0 )
+        ++j;
+      return i + j;
+    }
+  }
+  return i + firstBeyondToleranceSSE2( xy, count - i, stride, x, y, toleranceSquared );
+}
+
+#endif // QGS_VERTEXKERNELS_AVX
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Dispatch
+
+void QgsVertexKernels::mapToPixel( double* x, double* y, int count, double mapUnitsPerPixel, double xMin, double yMin, double yMax )
+{
+  switch ( sInstructionSet )
+  {
+#ifdef QGS_VERTEXKERNELS_AVX
+    case AVX:
+      mapToPixelAVX( x, y, count, mapUnitsPerPixel, xMin, yMin, yMax );
+      return;
+#endif
+#ifdef QGS_VERTEXKERNELS_SSE2
+    case SSE2:
+      mapToPixelSSE2( x, y, count, mapUnitsPerPixel, xMin, yMin, yMax );
+      return;
+#endif
+    default:
+      mapToPixelScalar( x, y, count, mapUnitsPerPixel, xMin, yMin, yMax );
+  }
+}
+
+void QgsVertexKernels::mapToPixel( unsigned char* xy, int count, int stride, double mapUnitsPerPixel, double xMin, double yMin, double yMax )
+{
+  switch ( sInstructionSet )
+  {
+#ifdef QGS_VERTEXKERNELS_AVX
+    case AVX:
+      mapToPixelAVX( xy, count, stride, mapUnitsPerPixel, xMin, yMin, yMax );
+      return;
+#endif
+#ifdef QGS_VERTEXKERNELS_SSE2
+    case SSE2:
+      mapToPixelSSE2( xy, count, stride, mapUnitsPerPixel, xMin, yMin, yMax );
+      return;
+#endif
+    default:
+      mapToPixelScalar( xy, count, stride, mapUnitsPerPixel, xMin, yMin, yMax );
+  }
+}
+
+void QgsVertexKernels::boundingBox( const unsigned char* xy, int count, int stride, double& xMin, double& yMin, double& xMax, double& yMax )
+{
+  switch ( sInstructionSet )
+  {
+#ifdef QGS_VERTEXKERNELS_AVX
+    case AVX:
+      boundingBoxAVX( xy, count, stride, xMin, yMin, xMax, yMax );
+      return;
+#endif
+#ifdef QGS_VERTEXKERNELS_SSE2
+    case SSE2:
+      boundingBoxSSE2( xy, count, stride, xMin, yMin, xMax, yMax );
+      return;
+#endif
+    default:
+      boundingBoxScalar( xy, count, stride, xMin, yMin, xMax, yMax );
+  }
+}
+
+int QgsVertexKernels::firstBeyondTolerance( const unsigned char* xy, int count, int stride, double x, double y, double toleranceSquared )
+{
+  switch ( sInstructionSet )
+  {
+#ifdef QGS_VERTEXKERNELS_AVX
+    case AVX:
+      return firstBeyondToleranceAVX( xy, count, stride, x, y, toleranceSquared );
+#endif
+#ifdef QGS_VERTEXKERNELS_SSE2
+    case SSE2:
+      return firstBeyondToleranceSSE2( xy, count, stride, x, y, toleranceSquared );
+#endif
+    default:
+      return firstBeyondToleranceScalar( xy, count, stride, x, y, toleranceSquared );
+  }
+}
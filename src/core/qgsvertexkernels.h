@@ -0,0 +1,78 @@
+/***************************************************************************
+    qgsvertexkernels.h
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSVERTEXKERNELS_H
+#define QGSVERTEXKERNELS_H
+
+/** \ingroup core
+ * Per-vertex kernels for runs of coordinates, as used when drawing dense linework.
+ *
+ * Every kernel has a scalar implementation and, on x86, SSE2 and AVX ones. The
+ * implementation is picked at runtime from the instruction sets supported by the
+ * CPU. All implementations return bit-identical results.
+ *
+ * Interleaved coordinates are addressed by a stride in bytes between consecutive
+ * vertices (16 for XY, 24 for XYZ) and need not be aligned, so WKB can be passed as is.
+ *
+ * @note added in 2.4
+ * @note not available in python bindings
+ */
+class CORE_EXPORT QgsVertexKernels
+{
+  public:
+    //! instruction sets the kernels are implemented for
+    enum InstructionSet
+    {
+      Scalar,
+      SSE2,
+      AVX
+    };
+
+    /** Returns the instruction set used by the kernels */
+    static InstructionSet instructionSet();
+
+    /** Returns the best instruction set supported by both the build and the CPU */
+    static InstructionSet supportedInstructionSet();
+
+    /**
+     * Selects the instruction set used by the kernels, e.g. to compare implementations.
+     * Sets that are not supported fall back to the best supported one.
+     */
+    static void setInstructionSet( InstructionSet set );
+
+    /**
+     * Transforms map coordinates held in two arrays to device coordinates in place,
+     * as QgsMapToPixel::transformInPlace() does for a single point.
+     */
+    static void mapToPixel( double* x, double* y, int count, double mapUnitsPerPixel, double xMin, double yMin, double yMax );
+
+    /** Transforms interleaved map coordinates to device coordinates in place */
+    static void mapToPixel( unsigned char* xy, int count, int stride, double mapUnitsPerPixel, double xMin, double yMin, double yMax );
+
+    /**
+     * Extends the given bounding box by interleaved coordinates. NaN coordinates
+     * are ignored.
+     */
+    static void boundingBox( const unsigned char* xy, int count, int stride, double& xMin, double& yMin, double& xMax, double& yMax );
+
+    /**
+     * Returns the index of the first vertex of interleaved coordinates whose squared
+     * distance to x,y exceeds the tolerance, or count if there is none. The distance
+     * is calculated like QgsMapToPixelSimplifier::calculateLengthSquared2D() does.
+     */
+    static int firstBeyondTolerance( const unsigned char* xy, int count, int stride, double x, double y, double toleranceSquared );
+};
+
+#endif // QGSVERTEXKERNELS_H
@@ -0,0 +1,183 @@
+/***************************************************************************
+    qgswkbview.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgswkbview.h"
+#include "qgsgeometry.h"
+
+static QGis::GeometryType geometryType( QGis::WkbType wkbType )
+{
+  switch ( QGis::flatType( QGis::singleType( wkbType ) ) )
+  {
+    case QGis::WKBPoint:
+      return QGis::Point;
+    case QGis::WKBLineString:
+      return QGis::Line;
+    case QGis::WKBPolygon:
+      return QGis::Polygon;
+    default:
+      return QGis::UnknownGeometry;
+  }
+}
+
+QgsWkbPart::QgsWkbPart( const unsigned char* wkb )
+    : mWkb( wkb )
+    , mRings( 0 )
+    , mWkbType( QGis::WKBUnknown )
+    , mType( QGis::UnknownGeometry )
+    , mRingCount( 0 )
+    , mHasZValue( false )
+{
+  if ( !wkb )
+  {
+    return;
+  }
+
+  QgsConstWkbPtr wkbPtr( wkb + 1 );
+  wkbPtr >> mWkbType;
+  mHasZValue = QGis::wkbDimensions( mWkbType ) == 3;
+
+  if ( QGis::isMultiType( mWkbType ) )
+  {
+    return;
+  }
+
+  mType = geometryType( mWkbType );
+  switch ( mType )
+  {
+    case QGis::Point:
+    case QGis::Line:
+      mRingCount = 1;
+      break;
+    case QGis::Polygon:
+      wkbPtr >> mRingCount;
+      break;
+    default:
+      return;
+  }
+  mRings = wkbPtr;
+}
+
+QgsWkbRing QgsWkbPart::ring( int i ) const
+{
+  if ( i < 0 || i >= mRingCount )
+  {
+    return QgsWkbRing();
+  }
+
+  const_iterator it = begin();
+  while ( it.index() < i )
+  {
+    ++it;
+  }
+  return *it;
+}
+
+const unsigned char* QgsWkbPart::wkbEnd() const
+{
+  if ( !mRings )
+  {
+    return mWkb;
+  }
+
+  const unsigned char* p = mRings;
+  for ( const_iterator it = begin(); it != end(); ++it )
+  {
+    p = ( *it ).coordinatesEnd();
+  }
+  return p;
+}
+
+QgsWkbView::QgsWkbView( const QgsGeometry* geometry )
+    : mParts( 0 )
+    , mWkbType( QGis::WKBUnknown )
+    , mType( QGis::UnknownGeometry )
+    , mPartCount( 0 )
+{
+  if ( geometry )
+  {
+    const unsigned char* wkb = geometry->asWkb();
+    init( wkb, geometry->wkbSize() );
+  }
+}
+
+QgsWkbView::QgsWkbView( const unsigned char* wkb, size_t size )
+    : mParts( 0 )
+    , mWkbType( QGis::WKBUnknown )
+    , mType( QGis::UnknownGeometry )
+    , mPartCount( 0 )
+{
+  init( wkb, size );
+}
+
+void QgsWkbView::init( const unsigned char* wkb, size_t size )
+{
+  if ( !wkb || size < 1 + sizeof( int ) )
+  {
+    return;
+  }
+
+  QgsConstWkbPtr wkbPtr( wkb + 1 );
+  wkbPtr >> mWkbType;
+  mType = geometryType( mWkbType );
+  if ( mType == QGis::UnknownGeometry )
+  {
+    return;
+  }
+
+  if ( QGis::isMultiType( mWkbType ) )
+  {
+    if ( size < 1 + 2 * sizeof( int ) )
+    {
+      mType = QGis::UnknownGeometry;
+      return;
+    }
+    wkbPtr >> mPartCount;
+    mParts = wkbPtr;
+  }
+  else
+  {
+    mPartCount = 1;
+    mParts = wkb;
+  }
+}
+
+QgsWkbPart QgsWkbView::part( int i ) const
+{
+  if ( i < 0 || i >= mPartCount )
+  {
+    return QgsWkbPart();
+  }
+
+  const_iterator it = begin();
+  while ( it.index() < i )
+  {
+    ++it;
+  }
+  return *it;
+}
+
+int QgsWkbView::vertexCount() const
+{
+  int count = 0;
+  for ( const_iterator partIt = begin(); partIt != end(); ++partIt )
+  {
+    QgsWkbPart part = *partIt;
+    for ( QgsWkbPart::const_iterator ringIt = part.begin(); ringIt != part.end(); ++ringIt )
+    {
+      count += ( *ringIt ).vertexCount();
+    }
+  }
+  return count;
+}
@@ -0,0 +1,270 @@
+/***************************************************************************
+    qgswkbview.h
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSWKBVIEW_H
+#define QGSWKBVIEW_H
+
+#include "qgis.h"
+#include "qgspoint.h"
+
+#include <string.h>
+
+class QgsGeometry;
+
+/** \ingroup core
+ * Read-only view of a run of vertices in WKB: a linestring, a polygon ring or a single point.
+ *
+ * The view points into the WKB buffer, no coordinates are copied. It is only valid as long
+ * as the buffer is (i.e. until the geometry is modified or deleted).
+ *
+ * @note added in 2.4
+ * @note not available in python bindings
+ */
+class CORE_EXPORT QgsWkbRing
+{
+  public:
+    //! iterator over the vertices of a ring
+    class const_iterator
+    {
+      public:
+        const_iterator() : mP( 0 ), mStride( 0 ) {}
+        const_iterator( const unsigned char* p, int stride ) : mP( p ), mStride( stride ) {}
+
+        inline double x() const { double v; memcpy( &v, mP, sizeof( v ) ); return v; }
+        inline double y() const { double v; memcpy( &v, mP + sizeof( double ), sizeof( v ) ); return v; }
+        //! z value, only valid if the ring has z values
+        inline double z() const { double v; memcpy( &v, mP + 2 * sizeof( double ), sizeof( v ) ); return v; }
+
+        inline QgsPoint operator*() const { return QgsPoint( x(), y() ); }
+
+        inline const_iterator& operator++() { mP += mStride; return *this; }
+        inline const_iterator operator++( int ) { const_iterator it( *this ); mP += mStride; return it; }
+        inline const_iterator& operator--() { mP -= mStride; return *this; }
+        inline const_iterator& operator+=( int n ) { mP += n * mStride; return *this; }
+        inline const_iterator operator+( int n ) const { return const_iterator( mP + n * mStride, mStride ); }
+        inline int operator-( const const_iterator& other ) const { return ( int )(( mP - other.mP ) / mStride ); }
+
+        inline bool operator==( const const_iterator& other ) const { return mP == other.mP; }
+        inline bool operator!=( const const_iterator& other ) const { return mP != other.mP; }
+
+      private:
+        const unsigned char* mP;
+        int mStride;
+    };
+
+    QgsWkbRing() : mCoordinates( 0 ), mCount( 0 ), mHasZValue( false ) {}
+
+    /**Constructor
+      @param coordinates first coordinate of the vertices (x y [z] doubles, no alignment required)
+      @param count number of vertices
+      @param hasZValue true if the vertices have z values*/
+    QgsWkbRing( const unsigned char* coordinates, int count, bool hasZValue )
+        : mCoordinates( coordinates ), mCount( count ), mHasZValue( hasZValue ) {}
+
+    inline int vertexCount() const { return mCount; }
+    inline bool isEmpty() const { return mCount == 0; }
+    inline bool hasZValue() const { return mHasZValue; }
+
+    //! bytes between two vertices (16 for 2D, 24 for 2.5D vertices)
+    inline int stride() const { return mHasZValue ? 3 * sizeof( double ) : 2 * sizeof( double ); }
+    //! pointer to the coordinates of the first vertex
+    inline const unsigned char* coordinates() const { return mCoordinates; }
+    //! pointer behind the coordinates of the last vertex
+    inline const unsigned char* coordinatesEnd() const { return mCoordinates + mCount * stride(); }
+
+    inline double x( int i ) const { return ( begin() + i ).x(); }
+    inline double y( int i ) const { return ( begin() + i ).y(); }
+    inline QgsPoint vertex( int i ) const { return *( begin() + i ); }
+
+    inline const_iterator begin() const { return const_iterator( mCoordinates, stride() ); }
+    inline const_iterator end() const { return const_iterator( coordinatesEnd(), stride() ); }
+
+  private:
+    const unsigned char* mCoordinates;
+    int mCount;
+    bool mHasZValue;
+};
+
+/** \ingroup core
+ * Read-only view of a single point, linestring or polygon in WKB, either a whole geometry or a
+ * part of a multi geometry. Points and linestrings consist of one ring, polygons of the exterior
+ * ring followed by the interior rings.
+ *
+ * @note added in 2.4
+ * @note not available in python bindings
+ */
+class CORE_EXPORT QgsWkbPart
+{
+  public:
+    //! iterator over the rings of a part
+    class const_iterator
+    {
+      public:
+        const_iterator() : mP( 0 ), mIndex( 0 ), mIsPoint( false ), mHasZValue( false ) {}
+        const_iterator( const unsigned char* p, int index, bool isPoint, bool hasZValue )
+            : mP( p ), mIndex( index ), mIsPoint( isPoint ), mHasZValue( hasZValue ) {}
+
+        inline QgsWkbRing operator*() const
+        {
+          if ( mIsPoint )
+            return QgsWkbRing( mP, 1, mHasZValue );
+
+          int count;
+          memcpy( &count, mP, sizeof( count ) );
+          return QgsWkbRing( mP + sizeof( int ), count, mHasZValue );
+        }
+
+        inline const_iterator& operator++() { mP = ( **this ).coordinatesEnd(); ++mIndex; return *this; }
+        inline const_iterator operator++( int ) { const_iterator it( *this ); ++( *this ); return it; }
+
+        //! index of the ring in the part (0 is the exterior ring of polygons)
+        inline int index() const { return mIndex; }
+
+        inline bool operator==( const const_iterator& other ) const { return mIndex == other.mIndex; }
+        inline bool operator!=( const const_iterator& other ) const { return mIndex != other.mIndex; }
+
+      private:
+        const unsigned char* mP;
+        int mIndex;
+        bool mIsPoint;
+        bool mHasZValue;
+    };
+
+    QgsWkbPart() : mWkb( 0 ), mRings( 0 ), mWkbType( QGis::WKBUnknown ), mType( QGis::UnknownGeometry ), mRingCount( 0 ), mHasZValue( false ) {}
+
+    /**Constructor
+      @param wkb WKB of a point, linestring or polygon (starting with the byte order).
+      Other geometry types result in a part without rings*/
+    explicit QgsWkbPart( const unsigned char* wkb );
+
+    inline QGis::WkbType wkbType() const { return mWkbType; }
+    //! point, line or polygon (UnknownGeometry if the WKB type is not supported)
+    inline QGis::GeometryType type() const { return mType; }
+    inline bool hasZValue() const { return mHasZValue; }
+
+    //! number of rings (1 for points and linestrings)
+    inline int ringCount() const { return mRingCount; }
+    /**Returns the ring with the given index. The rings before have to be skipped,
+      use the iterator to access all rings*/
+    QgsWkbRing ring( int i = 0 ) const;
+
+    inline const_iterator begin() const { return const_iterator( mRings, 0, mType == QGis::Point, mHasZValue ); }
+    inline const_iterator end() const { return const_iterator( 0, mRingCount, mType == QGis::Point, mHasZValue ); }
+
+    //! pointer to the start of the WKB of the part
+    inline const unsigned char* wkb() const { return mWkb; }
+    //! pointer behind the WKB of the part (skips all rings)
+    const unsigned char* wkbEnd() const;
+
+  private:
+    const unsigned char* mWkb;
+    //! first ring (vertex count or coordinates of a point)
+    const unsigned char* mRings;
+    QGis::WkbType mWkbType;
+    QGis::GeometryType mType;
+    int mRingCount;
+    bool mHasZValue;
+};
+
+/** \ingroup core
+ * Read-only, allocation free view of the WKB of a geometry. The parts, rings and vertices are
+ * accessed with iterators walking the WKB buffer in place:
+ *
+ * \code
+ * QgsWkbView view( geometry );
+ * for ( QgsWkbView::const_iterator partIt = view.begin(); partIt != view.end(); ++partIt )
+ * {
+ *   QgsWkbPart part = *partIt;
+ *   for ( QgsWkbPart::const_iterator ringIt = part.begin(); ringIt != part.end(); ++ringIt )
+ *   {
+ *     QgsWkbRing ring = *ringIt;
+ *     for ( QgsWkbRing::const_iterator vIt = ring.begin(); vIt != ring.end(); ++vIt )
+ *       ... vIt.x(), vIt.y()
+ *   }
+ * }
+ * \endcode
+ *
+ * Single geometries have one part. The view is only valid as long as the WKB buffer is,
+ * i.e. until the geometry is modified or deleted.
+ *
+ * @note added in 2.4
+ * @note not available in python bindings
+ */
+class CORE_EXPORT QgsWkbView
+{
+  public:
+    //! iterator over the parts of a geometry
+    class const_iterator
+    {
+      public:
+        const_iterator() : mP( 0 ), mIndex( 0 ) {}
+        const_iterator( const unsigned char* p, int index ) : mP( p ), mIndex( index ) {}
+
+        inline QgsWkbPart operator*() const { return QgsWkbPart( mP ); }
+
+        inline const_iterator& operator++() { mP = QgsWkbPart( mP ).wkbEnd(); ++mIndex; return *this; }
+        inline const_iterator operator++( int ) { const_iterator it( *this ); ++( *this ); return it; }
+
+        //! index of the part in the geometry
+        inline int index() const { return mIndex; }
+
+        inline bool operator==( const const_iterator& other ) const { return mIndex == other.mIndex; }
+        inline bool operator!=( const const_iterator& other ) const { return mIndex != other.mIndex; }
+
+      private:
+        const unsigned char* mP;
+        int mIndex;
+    };
+
+    //! View of the WKB of a geometry (0 results in an empty view)
+    explicit QgsWkbView( const QgsGeometry* geometry );
+
+    /**View of a WKB buffer
+      @param wkb WKB (starting with the byte order)
+      @param size size of the buffer*/
+    QgsWkbView( const unsigned char* wkb, size_t size );
+
+    //! false if there is no WKB or its type is not supported
+    inline bool isValid() const { return mType != QGis::UnknownGeometry; }
+
+    inline QGis::WkbType wkbType() const { return mWkbType; }
+    //! point, line or polygon (UnknownGeometry if there is no WKB or its type is not supported)
+    inline QGis::GeometryType type() const { return mType; }
+    inline bool isMultipart() const { return QGis::isMultiType( mWkbType ); }
+    inline bool hasZValue() const { return QGis::wkbDimensions( mWkbType ) == 3; }
+
+    //! number of parts (1 for single geometries)
+    inline int partCount() const { return mPartCount; }
+    /**Returns the part with the given index. The parts before have to be skipped,
+      use the iterator to access all parts*/
+    QgsWkbPart part( int i = 0 ) const;
+
+    inline const_iterator begin() const { return const_iterator( mParts, 0 ); }
+    inline const_iterator end() const { return const_iterator( 0, mPartCount ); }
+
+    //! total number of vertices of all parts
+    int vertexCount() const;
+
+  private:
+    void init( const unsigned char* wkb, size_t size );
+
+    //! first part
+    const unsigned char* mParts;
+    QGis::WkbType mWkbType;
+    QGis::GeometryType mType;
+    int mPartCount;
+};
+
+#endif // QGSWKBVIEW_H
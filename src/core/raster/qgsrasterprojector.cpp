@@ -504,6 +504,11 @@ bool QgsRasterProjector::preciseSrcRowCol( int theDestRow, int theDestCol, int *
   QgsDebugMsgLevel( QString( "x = %1 y = %2" ).arg( x ).arg( y ), 5 );
 #endif
 
+  return srcPointRowCol( x, y, theSrcRow, theSrcCol );
+}
+
+bool QgsRasterProjector::srcPointRowCol( double x, double y, int *theSrcRow, int *theSrcCol )
+{
   if ( !mExtent.contains( QgsPoint( x, y ) ) )
   {
     return false;
@@ -844,12 +849,55 @@ QgsRasterBlock * QgsRasterProjector::block( int bandNo, QgsRectangle  const & ex
 
   outputBlock->setIsNoData();
 
+  // In precise mode the centers of the destination cells are transformed in batches
+  // of rows, which are split across threads by the coordinate transform
+  int batchRows = ct ? qMax( 1, 262144 / width ) : 0;
+  int batchTopRow = -1;
+  QVector<double> batchX, batchY, batchZ;
+
   int srcRow, srcCol;
   for ( int i = 0; i < height; ++i )
   {
+    if ( ct && i >= batchTopRow + batchRows )
+    {
+      batchTopRow = i;
+      int rows = qMin( batchRows, height - i );
+      batchX.resize( rows * width );
+      batchY.resize( rows * width );
+      batchZ.fill( 0.0, rows * width );
+      for ( int r = 0; r < rows; ++r )
+      {
+        double y = mDestExtent.yMaximum() - ( i + r + 0.5 ) * mDestYRes;
+        for ( int c = 0; c < width; ++c )
+        {
+          batchX[ r * width + c ] = mDestExtent.xMinimum() + ( c + 0.5 ) * mDestXRes;
+          batchY[ r * width + c ] = y;
+        }
+      }
+      try
+      {
+        ct->transformCoordsBatch( rows * width, batchX.data(), batchY.data(), batchZ.data() );
+      }
+      catch ( QgsCsException &e )
+      {
+        Q_UNUSED( e );
+        // transform the cells one by one
+        batchX.clear();
+      }
+    }
+
     for ( int j = 0; j < width; ++j )
     {
-      bool inside = srcRowCol( i, j, &srcRow, &srcCol, ct );
+      bool inside;
+      if ( !batchX.isEmpty() )
+      {
+        int batchIndex = ( i - batchTopRow ) * width + j;
+        inside = srcPointRowCol( batchX[batchIndex], batchY[batchIndex], &srcRow, &srcCol );
+      }
+      else
+      {
+        inside = srcRowCol( i, j, &srcRow, &srcCol, ct );
+      }
       if ( !inside ) continue; // we have everything set to no data
 
       qgssize srcIndex = ( qgssize )srcRow * mSrcCols + srcCol;
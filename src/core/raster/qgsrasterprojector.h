@@ -135,6 +135,9 @@ class CORE_EXPORT QgsRasterProjector : public QgsRasterInterface
     /** \brief Get precise source row and column indexes for current source extent and resolution */
     inline bool preciseSrcRowCol( int theDestRow, int theDestCol, int *theSrcRow, int *theSrcCol, const QgsCoordinateTransform* ct );
 
+    /** \brief Get source row and column indexes for a point in source coordinates */
+    inline bool srcPointRowCol( double theX, double theY, int *theSrcRow, int *theSrcCol );
+
     /** \brief Get approximate source row and column indexes for current source extent and resolution */
     inline bool approximateSrcRowCol( int theDestRow, int theDestCol, int *theSrcRow, int *theSrcCol );
 
@@ -350,6 +350,7 @@ void QgsCategorizedSymbolRendererV2::startRender( QgsRenderContext& context, con
   {
     mExpression.reset( new QgsExpression( mAttrName ) );
     mExpression->prepare( fields );
+    mExpression->compile();
   }
 
   QgsCategoryList::iterator it = mCategories.begin();
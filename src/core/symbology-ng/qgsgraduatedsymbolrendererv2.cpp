@@ -227,6 +227,7 @@ void QgsGraduatedSymbolRendererV2::startRender( QgsRenderContext& context, const
   {
     mExpression.reset( new QgsExpression( mAttrName ) );
     mExpression->prepare( fields );
+    mExpression->compile();
   }
 
   QgsRangeList::iterator it = mRanges.begin();
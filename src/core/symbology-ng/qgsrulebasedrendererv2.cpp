@@ -355,7 +355,10 @@ bool QgsRuleBasedRendererV2::Rule::startRender( QgsRenderContext& context, const
 
   // init this rule
   if ( mFilter )
+  {
     mFilter->prepare( fields );
+    mFilter->compile();
+  }
   if ( mSymbol )
     mSymbol->startRender( context, &fields );
 
@@ -460,6 +460,7 @@ void QgsMapCanvas::setCrsTransformEnabled( bool enabled )
 
   mSettings.setCrsTransformEnabled( enabled );
 
+  clearCache();
   refresh();
 
   emit hasCrsTransformEnabledChanged( enabled );
@@ -470,6 +471,9 @@ void QgsMapCanvas::setDestinationCrs( const QgsCoordinateReferenceSystem &crs )
   if ( mSettings.destinationCrs() == crs )
     return;
 
+  // cached images of other extents would be reused for panning, but they are in the old CRS
+  clearCache();
+
   if ( mSettings.hasCrsTransformEnabled() )
   {
     // try to reproject current extent to the new one
@@ -661,6 +665,15 @@ void QgsMapCanvas::rendererJobFinished()
     {
       QString logMsg = tr( "Canvas refresh: %1 ms" ).arg( mJob->renderingTime() );
       QgsMessageLog::logMessage( logMsg, tr( "Rendering" ) );
+
+      foreach ( const QgsMapRendererJob::LayerStatistics& stats, mJob->layerStatistics() )
+      {
+        QgsMapLayer* layer = QgsMapLayerRegistry::instance()->mapLayer( stats.layerID );
+        QString layerMsg = tr( "Layer %1: %2 ms, %3 features%4" )
+                           .arg( layer ? layer->name() : stats.layerID ).arg( stats.renderingTime ).arg( stats.featureCount )
+                           .arg( stats.cached ? tr( " (cached)" ) : QString() );
+        QgsMessageLog::logMessage( layerMsg, tr( "Rendering" ) );
+      }
     }
 
     if ( mDrawRenderingStats )
@@ -29,11 +29,13 @@ map service syntax for SOAP/HTTP POST
 #include "qgswmsserver.h"
 #include "qgswfsserver.h"
 #include "qgswcsserver.h"
+#include "qgswmstilecache.h"
 #include "qgsmaprenderer.h"
 #include "qgsmapserviceexception.h"
 #include "qgspallabeling.h"
 #include "qgsprojectparser.h"
 #include "qgssldparser.h"
+#include "qgsserverprefork.h"
 #include "qgsnetworkaccessmanager.h"
 
 #include <QDomDocument>
@@ -163,10 +165,103 @@ int fcgi_accept()
   else
     return FCGX_Accept( &FCGI_stdin->fcgx_stream, &FCGI_stdout->fcgx_stream, &FCGI_stderr->fcgx_stream, &environ );
 #else
-  return FCGI_Accept();
+  //finish the previous request first, a retired prefork worker may exit while waiting for the next one
+  FCGI_Finish();
+  QgsServerPrefork::setAcceptingRequests( true );
+  if ( QgsServerPrefork::quitRequested() )
+  {
+    return -1;
+  }
+  int result = FCGI_Accept();
+  QgsServerPrefork::setAcceptingRequests( false );
+  return result;
 #endif
 }
 
+/**Renders the tiles of a seeding request into the tile cache (qgis_mapserv.fcgi --seed "MAP=...&SCALES=...&BBOX=...")*/
+int seedTileCache( const QString& queryString, const QString& defaultConfigFilePath, QgsMapRenderer* theMapRenderer, QgsWMSTileCache& tileCache )
+{
+  if ( tileCache.directory().isEmpty() )
+  {
+    fprintf( stderr, "Seeding needs a cache directory (QGIS_SERVER_TILE_CACHE_DIR)\n" );
+    return 1;
+  }
+
+  QMap<QString, QString> parameterMap;
+  try
+  {
+    qputenv( "QUERY_STRING", queryString.toLocal8Bit() );
+    QgsGetRequestHandler requestHandler;
+    parameterMap = requestHandler.parseInput();
+  }
+  catch ( QgsMapServiceException& e )
+  {
+    fprintf( stderr, "%s\n", e.message().toLocal8Bit().constData() );
+    return 1;
+  }
+
+  QString configFilePath = getenv( "QGIS_PROJECT_FILE" );
+  if ( configFilePath.isEmpty() )
+  {
+    configFilePath = parameterMap.value( "MAP", defaultConfigFilePath );
+  }
+  QgsConfigParser* adminConfigParser = QgsConfigCache::instance()->searchConfiguration( configFilePath );
+  if ( !adminConfigParser )
+  {
+    fprintf( stderr, "Could not read configuration file %s\n", configFilePath.toLocal8Bit().constData() );
+    return 1;
+  }
+
+  QString errorMessage;
+  QList< QMap<QString, QString> > requests = QgsWMSTileCache::seedingRequests( parameterMap, errorMessage );
+  if ( requests.isEmpty() )
+  {
+    fprintf( stderr, "%s\n", errorMessage.toLocal8Bit().constData() );
+    return 1;
+  }
+
+  int nRendered = 0;
+  for ( int i = 0; i < requests.size(); ++i )
+  {
+    const QMap<QString, QString>& tileParameters = requests.at( i );
+    QString key = QgsWMSTileCache::cacheKey( configFilePath, tileParameters );
+    if ( key.isEmpty() )
+    {
+      fprintf( stderr, "The request cannot be cached\n" );
+      return 1;
+    }
+    if ( tileCache.containsImage( key ) )
+    {
+      continue;
+    }
+
+    QImage* result = 0;
+    try
+    {
+      adminConfigParser->setParameterMap( tileParameters );
+      QgsWMSServer server( tileParameters, theMapRenderer );
+      adminConfigParser->loadLabelSettings( theMapRenderer->labelingEngine() );
+      server.setAdminConfigParser( adminConfigParser );
+      result = server.getMap();
+    }
+    catch ( QgsMapServiceException& e )
+    {
+      fprintf( stderr, "%s\n", e.message().toLocal8Bit().constData() );
+      return 1;
+    }
+
+    if ( result )
+    {
+      tileCache.insertImage( key, *result );
+      delete result;
+      ++nRendered;
+    }
+    fprintf( stderr, "\r%d / %d tiles", i + 1, requests.size() );
+  }
+  fprintf( stderr, "\n%d tiles rendered\n", nRendered );
+  return 0;
+}
+
 int main( int argc, char * argv[] )
 {
 #ifndef _MSC_VER
@@ -245,6 +340,41 @@ int main( int argc, char * argv[] )
   QgsFontUtils::loadStandardTestFonts( QStringList() << "Roman" << "Bold" );
 #endif
 
+  //cache for rendered GetMap images. QGIS_SERVER_TILE_CACHE_SIZE is the memory cache size per process (in MB),
+  //QGIS_SERVER_TILE_CACHE_DIR a directory shared by all server processes, QGIS_SERVER_TILE_CACHE_TTL the maximum
+  //age of the cached images (in seconds) and QGIS_SERVER_TILE_CACHE_DIR_SIZE the maximum size of the directory (in MB)
+  QgsWMSTileCache tileCache( QString( getenv( "QGIS_SERVER_TILE_CACHE_SIZE" ) ).toInt() * 1024, getenv( "QGIS_SERVER_TILE_CACHE_DIR" ),
+                             QString( getenv( "QGIS_SERVER_TILE_CACHE_TTL" ) ).toInt(), QString( getenv( "QGIS_SERVER_TILE_CACHE_DIR_SIZE" ) ).toInt() );
+
+  QStringList arguments = qgsapp.arguments();
+  int seedIndex = arguments.indexOf( "--seed" );
+  if ( seedIndex != -1 )
+  {
+    if ( seedIndex + 1 >= arguments.size() )
+    {
+      fprintf( stderr, "Usage: %s --seed \"MAP=...&LAYERS=...&CRS=...&BBOX=...&SCALES=...\"\n", argv[0] );
+      return 1;
+    }
+    return seedTileCache( arguments.at( seedIndex + 1 ), defaultConfigFilePath, theMapRenderer, tileCache );
+  }
+
+#ifndef Q_OS_WIN
+  //QGIS_SERVER_PREFORK=n: load the projects once and serve the requests with n worker processes sharing them.
+  //Projects are the default project, QGIS_PROJECT_FILE and the ':' separated list QGIS_SERVER_PREFORK_PROJECTS
+  int nPreforkWorkers = QString( getenv( "QGIS_SERVER_PREFORK" ) ).toInt();
+  if ( nPreforkWorkers > 0 && !FCGX_IsCGI() )
+  {
+    QStringList preforkProjects = QString( getenv( "QGIS_SERVER_PREFORK_PROJECTS" ) ).split( ":", QString::SkipEmptyParts );
+    preforkProjects << defaultConfigFilePath << getenv( "QGIS_PROJECT_FILE" );
+    QgsServerPrefork prefork( nPreforkWorkers, preforkProjects );
+    if ( !prefork.run() )
+    {
+      //master process terminated
+      delete theMapRenderer;
+      return 0;
+    }
+  }
+#endif
 
   //for( int i = 0; i < 2; ++i )
   while ( fcgi_accept() >= 0 )
@@ -613,9 +743,26 @@ int main( int argc, char * argv[] )
     else if ( request.compare( "GetMap", Qt::CaseInsensitive ) == 0 )
     {
       QImage* result = 0;
+      QString cacheKey;
+      if ( tileCache.isEnabled() )
+      {
+        cacheKey = QgsWMSTileCache::cacheKey( configFilePath, parameterMap );
+      }
+      if ( !cacheKey.isEmpty() )
+      {
+        result = tileCache.searchImage( cacheKey );
+      }
+
       try
       {
-        result = theServer->getMap();
+        if ( !result )
+        {
+          result = theServer->getMap();
+          if ( result && !cacheKey.isEmpty() )
+          {
+            tileCache.insertImage( cacheKey, *result );
+          }
+        }
       }
       catch ( QgsMapServiceException& ex )
       {
@@ -51,7 +51,7 @@ class QgsConfigCache: public QObject
     /**Check for configuration file updates (remove entry from cache if file changes)*/
     QFileSystemWatcher mFileSystemWatcher;
 
-  private slots:
+  public slots:
     /**Removes changed entry from this cache*/
     void removeChangedEntry( const QString& path );
 };
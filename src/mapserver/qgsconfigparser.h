@@ -180,6 +180,10 @@ class QgsConfigParser
     /**Applies configuration specific label settings*/
     virtual void loadLabelSettings( QgsLabelingEngineInterface* lbl ) { Q_UNUSED( lbl ); }
 
+    /**Creates the layers of the configuration using one of the given providers and inserts them into the layer cache
+      (e.g. before the worker processes of a preforking server are created)*/
+    virtual void preloadLayers( const QStringList& providerKeys ) { Q_UNUSED( providerKeys ); }
+
     virtual QList< QPair< QString, QgsLayerCoordinateTransform > > layerCoordinateTransforms() const;
 
   protected:
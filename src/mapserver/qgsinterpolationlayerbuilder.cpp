@@ -141,6 +141,11 @@ QgsMapLayer* QgsInterpolationLayerBuilder::createMapLayer( const QDomElement &el
 
   QgsRectangle extent = mVectorLayer->extent();
   QgsGridFileWriter gridWriter( theInterpolator, tmpFile->fileName(), extent, nCols, nRows, extent.width() / nCols, extent.height() / nRows );
+  //binary output is much faster to write and read than ascii text. The file lives for a single request only,
+  //so it is neither compressed nor given overviews
+  gridWriter.setOutputFormat( QgsGridFileWriter::GeoTiff );
+  gridWriter.setCompression( "NONE" );
+  gridWriter.setBuildOverviews( false );
   if ( gridWriter.writeFile( false ) != 0 )
   {
     QgsDebugMsg( "Interpolation of raster failed" );
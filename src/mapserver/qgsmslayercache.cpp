@@ -110,6 +110,18 @@ QgsMapLayer* QgsMSLayerCache::searchLayer( const QString& url, const QString& la
   }
 }
 
+void QgsMSLayerCache::reloadLayers()
+{
+  QHash<QPair<QString, QString>, QgsMSLayerCacheEntry>::iterator entryIt = mEntries.begin();
+  for ( ; entryIt != mEntries.end(); ++entryIt )
+  {
+    if ( entryIt.value().layerPointer )
+    {
+      entryIt.value().layerPointer->reload();
+    }
+  }
+}
+
 void QgsMSLayerCache::removeProjectFileLayers( const QString& project )
 {
   QList< QPair< QString, QString > > removeEntries;
@@ -60,6 +60,10 @@ class QgsMSLayerCache: public QObject
 
     void setProjectMaxLayers( int n ) { mProjectMaxLayers = n; }
 
+    /**Reopens the data sources of all cached layers. A forked server process calls this
+      to get its own file handles instead of the ones inherited from the parent process*/
+    void reloadLayers();
+
   protected:
     /**Protected singleton constructor*/
     QgsMSLayerCache();
@@ -90,7 +94,7 @@ class QgsMSLayerCache: public QObject
     /**Maximum number of layers in the cache, overrides DEFAULT_MAX_N_LAYERS if larger*/
     int mProjectMaxLayers;
 
-  private slots:
+  public slots:
 
     /**Removes entries from a project (e.g. if a project file has changed)*/
     void removeProjectFileLayers( const QString& project );
@@ -100,6 +100,20 @@ int QgsProjectParser::numberOfLayers() const
   return mProjectLayerElements.size();
 }
 
+void QgsProjectParser::preloadLayers( const QStringList& providerKeys )
+{
+  foreach ( const QDomElement &elem, mProjectLayerElements )
+  {
+    //join and value relation layers are created on demand like for any other request
+    if ( elem.attribute( "type" ) != "vector" || elem.attribute( "embedded" ) == "1"
+         || !providerKeys.contains( elem.firstChildElement( "provider" ).text() ) )
+    {
+      continue;
+    }
+    createLayerFromElement( elem );
+  }
+}
+
 void QgsProjectParser::layersAndStylesCapabilities( QDomElement& parentElement, QDomDocument& doc, const QString& version, bool fullProjectSettings ) const
 {
   QStringList nonIdentifiableLayers = identifyDisabledLayers();
@@ -158,6 +158,8 @@ class QgsProjectParser: public QgsConfigParser
 
     void loadLabelSettings( QgsLabelingEngineInterface* lbl );
 
+    void preloadLayers( const QStringList& providerKeys );
+
     QList< QPair< QString, QgsLayerCoordinateTransform > > layerCoordinateTransforms() const;
 
     /**Makes sure the join layers needed for a layer are in the layer cache / maplayer registry*/
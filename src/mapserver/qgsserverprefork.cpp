@@ -0,0 +1,232 @@
+/***************************************************************************
+                              qgsserverprefork.cpp
+                              --------------------
+  begin                : May 2014
+  copyright            : (C) 2014 by the QGIS project
+  email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsserverprefork.h"
+#include "qgsconfigcache.h"
+#include "qgsconfigparser.h"
+#include "qgslogger.h"
+#include "qgsmslayercache.h"
+#include <QFileInfo>
+#include <signal.h>
+
+#ifndef Q_OS_WIN
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+//providers whose layers may be shared by forked processes once their data sources are reopened
+//(feature iterators open their own handles). Database connections cannot be shared
+static const char* sPreloadProviders[] = { "ogr", 0 };
+
+static volatile sig_atomic_t sQuitRequested = 0;
+static volatile sig_atomic_t sReloadRequested = 0;
+static volatile sig_atomic_t sAcceptingRequests = 0;
+
+#ifndef Q_OS_WIN
+static void quitSignalHandler( int )
+{
+  if ( sAcceptingRequests )
+  {
+    //idle worker, nothing to finish
+    _exit( 0 );
+  }
+  sQuitRequested = 1;
+}
+
+static void reloadSignalHandler( int )
+{
+  sReloadRequested = 1;
+}
+
+static void setSignalHandler( int signalNumber, void ( *handler )( int ) )
+{
+  struct sigaction action;
+  memset( &action, 0, sizeof( action ) );
+  action.sa_handler = handler;
+  sigemptyset( &action.sa_mask );
+  action.sa_flags = SA_RESTART;
+  sigaction( signalNumber, &action, 0 );
+}
+#endif
+
+QgsServerPrefork::QgsServerPrefork( int nWorkers, const QStringList& projectFiles )
+    : mNumWorkers( nWorkers )
+    , mProjectFiles( projectFiles )
+{
+  mProjectFiles.removeAll( QString() );
+  mProjectFiles.removeDuplicates();
+}
+
+void QgsServerPrefork::setAcceptingRequests( bool accepting )
+{
+  sAcceptingRequests = accepting;
+}
+
+bool QgsServerPrefork::quitRequested()
+{
+  return sQuitRequested;
+}
+
+#ifdef Q_OS_WIN
+bool QgsServerPrefork::run()
+{
+  QgsDebugMsg( "Preforking is not available on Windows" );
+  return true;
+}
+
+void QgsServerPrefork::loadProjects() {}
+bool QgsServerPrefork::projectsModified() const { return false; }
+void QgsServerPrefork::unloadProject( const QString& ) {}
+bool QgsServerPrefork::startWorker() { return true; }
+void QgsServerPrefork::retireWorkers() {}
+void QgsServerPrefork::collectWorkers() {}
+#else
+
+bool QgsServerPrefork::run()
+{
+  setSignalHandler( SIGTERM, quitSignalHandler );
+  setSignalHandler( SIGINT, quitSignalHandler );
+  setSignalHandler( SIGHUP, reloadSignalHandler );
+
+  loadProjects();
+
+  while ( !sQuitRequested )
+  {
+    while ( mWorkers.size() < mNumWorkers )
+    {
+      if ( startWorker() )
+      {
+        return true;
+      }
+    }
+
+    //terminated workers are replaced after at most a second. SIGHUP and SIGTERM interrupt the sleep
+    sleep( 1 );
+    collectWorkers();
+
+    if ( sReloadRequested || projectsModified() )
+    {
+      sReloadRequested = 0;
+      QgsDebugMsg( "Reloading projects and replacing the worker processes" );
+      foreach ( const QString& projectFile, mProjectFiles )
+      {
+        unloadProject( projectFile );
+      }
+      loadProjects();
+      retireWorkers();
+    }
+  }
+
+  retireWorkers();
+  while ( waitpid( -1, 0, 0 ) > 0 || errno == EINTR )
+  {
+  }
+  return false;
+}
+
+void QgsServerPrefork::loadProjects()
+{
+  QStringList providerKeys;
+  for ( int i = 0; sPreloadProviders[i]; ++i )
+  {
+    providerKeys << sPreloadProviders[i];
+  }
+
+  mModificationTimes.clear();
+  foreach ( const QString& projectFile, mProjectFiles )
+  {
+    mModificationTimes.insert( projectFile, QFileInfo( projectFile ).lastModified() );
+    QgsConfigParser* configParser = QgsConfigCache::instance()->searchConfiguration( projectFile );
+    if ( !configParser )
+    {
+      QgsDebugMsg( "Could not load project " + projectFile );
+      continue;
+    }
+    configParser->preloadLayers( providerKeys );
+  }
+}
+
+bool QgsServerPrefork::projectsModified() const
+{
+  QHash<QString, QDateTime>::const_iterator it = mModificationTimes.constBegin();
+  for ( ; it != mModificationTimes.constEnd(); ++it )
+  {
+    if ( QFileInfo( it.key() ).lastModified() != it.value() )
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void QgsServerPrefork::unloadProject( const QString& projectFile )
+{
+  QgsConfigCache::instance()->removeChangedEntry( projectFile );
+  QgsMSLayerCache::instance()->removeProjectFileLayers( projectFile );
+}
+
+bool QgsServerPrefork::startWorker()
+{
+  pid_t pid = fork();
+  if ( pid < 0 )
+  {
+    QgsDebugMsg( QString( "fork failed: %1" ).arg( strerror( errno ) ) );
+    sleep( 1 );
+    return false;
+  }
+
+  if ( pid == 0 )
+  {
+    //worker: reloading is done by the master
+    signal( SIGHUP, SIG_IGN );
+    QgsMSLayerCache::instance()->reloadLayers();
+    return true;
+  }
+
+  QgsDebugMsg( QString( "Started worker %1" ).arg( pid ) );
+  mWorkers.insert( pid );
+  return false;
+}
+
+void QgsServerPrefork::retireWorkers()
+{
+  foreach ( int pid, mWorkers )
+  {
+    kill( pid, SIGTERM );
+    mRetiredWorkers.insert( pid );
+  }
+  mWorkers.clear();
+}
+
+void QgsServerPrefork::collectWorkers()
+{
+  pid_t pid;
+  int status;
+  while (( pid = waitpid( -1, &status, WNOHANG ) ) > 0 )
+  {
+    if ( mWorkers.remove( pid ) )
+    {
+      QgsDebugMsg( QString( "Worker %1 terminated with status %2" ).arg( pid ).arg( status ) );
+    }
+    mRetiredWorkers.remove( pid );
+  }
+}
+
+#endif
@@ -0,0 +1,75 @@
+/***************************************************************************
+                              qgsserverprefork.h
+                              ------------------
+  begin                : May 2014
+  copyright            : (C) 2014 by the QGIS project
+  email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSSERVERPREFORK_H
+#define QGSSERVERPREFORK_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+/**Preforking mode of the server. The master process loads the projects (and the layers of file based
+  providers) once and then forks the worker processes accepting the FastCGI requests. The workers share
+  the loaded projects copy-on-write with the master. If a project file changes, the master reloads it,
+  starts new workers and retires the old ones once they have finished their current request.
+  Not available on Windows*/
+class QgsServerPrefork
+{
+  public:
+    /**Constructor
+      @param nWorkers number of worker processes
+      @param projectFiles projects loaded by the master before forking*/
+    QgsServerPrefork( int nWorkers, const QStringList& projectFiles );
+
+    /**Loads the projects, forks the workers and supervises them until the master is terminated (SIGTERM / SIGINT).
+      SIGHUP reloads all projects.
+      @return true in a worker process, which continues with the request loop. False in the master process after termination*/
+    bool run();
+
+    /**To be called around accepting a request in a worker. A worker which is retired while waiting for a request
+      exits immediately, otherwise after the current request (see quitRequested())*/
+    static void setAcceptingRequests( bool accepting );
+    /**True if a worker has been retired and should exit instead of accepting the next request*/
+    static bool quitRequested();
+
+  private:
+    /**Loads the projects into the config and layer cache*/
+    void loadProjects();
+    /**True if a project file has been modified since loadProjects()*/
+    bool projectsModified() const;
+    /**Removes a modified project from the caches*/
+    void unloadProject( const QString& projectFile );
+    /**Forks a new worker
+      @return true in the new worker process*/
+    bool startWorker();
+    /**Sends SIGTERM to the workers. They exit after their current request*/
+    void retireWorkers();
+    /**Removes the terminated workers from the worker lists*/
+    void collectWorkers();
+
+    int mNumWorkers;
+    QStringList mProjectFiles;
+    /**Modification times of the loaded project files*/
+    QHash<QString, QDateTime> mModificationTimes;
+    /**Process ids of the workers serving the current projects*/
+    QSet<int> mWorkers;
+    /**Process ids of the workers which finish their last request*/
+    QSet<int> mRetiredWorkers;
+};
+
+#endif // QGSSERVERPREFORK_H
@@ -0,0 +1,715 @@
+/***************************************************************************
+                              qgswfsfeaturewriter.cpp
+                              -----------------------
+  begin                : May 2014
+  copyright            : (C) 2014 by the QGIS project
+  email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgswfsfeaturewriter.h"
+#include "qgscoordinatereferencesystem.h"
+#include "qgsgeometry.h"
+#include "qgsrectangle.h"
+#include <stdio.h>
+
+QgsWFSFeatureWriter::QgsWFSFeatureWriter( Format format, const QString& typeName, const QgsCoordinateReferenceSystem& crs, bool withGeometry,
+    const QgsFields& fields, const QgsAttributeList& attrIndexes, const QSet<QString>& excludedAttributes )
+    : mFormat( format )
+    , mTypeName( typeName )
+    , mWithGeometry( withGeometry )
+    , mAttrIndexes( attrIndexes )
+{
+  appendXmlEscaped( mIdPrefix, typeName + ".", true );
+
+  if ( crs.isValid() )
+  {
+    mSrsNameAttribute = " srsName=\"";
+    appendXmlEscaped( mSrsNameAttribute, crs.authid(), true );
+    mSrsNameAttribute += "\"";
+  }
+
+  foreach ( int idx, attrIndexes )
+  {
+    if ( idx < 0 || idx >= fields.count() )
+    {
+      continue;
+    }
+    QString attributeName = fields[idx].name();
+    //skip attribute if it is excluded from WFS publication
+    if ( excludedAttributes.contains( attributeName ) )
+    {
+      continue;
+    }
+    mWrittenIndexes << idx;
+    if ( format == GeoJSON )
+    {
+      QByteArray name;
+      appendJSONEscaped( name, attributeName );
+      mAttributeNames << name;
+    }
+    else
+    {
+      mAttributeNames << ( "qgs:" + attributeName.replace( QString( " " ), QString( "_" ) ) ).toUtf8();
+    }
+  }
+}
+
+void QgsWFSFeatureWriter::writeFeature( const QgsFeature& feature, bool firstFeature, QByteArray& out )
+{
+  QgsGeometry* geom = mWithGeometry ? feature.geometry() : 0;
+  const QgsAttributes& attributes = feature.attributes();
+
+  if ( mFormat == GeoJSON )
+  {
+    out += firstFeature ? "  " : " ,";
+    out += "{\"type\": \"Feature\",\n";
+    out += "   \"id\": \"";
+    appendJSONEscaped( out, mTypeName );
+    out += ".";
+    out += QByteArray::number( feature.id() );
+    out += "\",\n";
+
+    if ( geom )
+    {
+      QgsRectangle box = geom->boundingBox();
+      out += " \"bbox\": [ ";
+      appendBBoxNumber( out, box.xMinimum() );
+      out += ", ";
+      appendBBoxNumber( out, box.yMinimum() );
+      out += ", ";
+      appendBBoxNumber( out, box.xMaximum() );
+      out += ", ";
+      appendBBoxNumber( out, box.yMaximum() );
+      out += "],\n";
+
+      out += "  \"geometry\": ";
+      if ( !geom->asWkb() || !appendGeoJSONGeometry( out, geom->asWkb() ) )
+      {
+        out += "null";
+      }
+      out += ",\n";
+    }
+
+    out += "   \"properties\": {\n";
+    for ( int i = 0; i < mWrittenIndexes.size(); ++i )
+    {
+      out += i == 0 ? "    \"" : "   ,\"";
+      out += mAttributeNames[i];
+      out += "\": ";
+      int idx = mWrittenIndexes[i];
+      const QVariant& val = idx < attributes.size() ? attributes[idx] : QVariant();
+      if ( val.isNull() )
+      {
+        out += "null";
+      }
+      else if ( val.type() == QVariant::Double || val.type() == QVariant::Int )
+      {
+        out += val.toString().toUtf8();
+      }
+      else
+      {
+        out += "\"";
+        appendJSONEscaped( out, val.toString() );
+        out += "\"";
+      }
+      out += "\n";
+    }
+    out += "   }\n";
+    out += "  }\n";
+    return;
+  }
+
+  //GML, laid out like QDomDocument::toByteArray() with an indentation of one space
+  out += "<gml:featureMember>\n <qgs:";
+  out += mTypeName.toUtf8();
+  out += mFormat == GML3 ? " gml:id=\"" : " fid=\"";
+  out += mIdPrefix;
+  out += QByteArray::number( feature.id() );
+  out += "\"";
+
+  mGeometryBuffer.clear();
+  bool hasGeometry = geom && geom->asWkb() && appendGMLGeometry( mGeometryBuffer, geom->asWkb(), 3 );
+  if ( !hasGeometry && mWrittenIndexes.isEmpty() )
+  {
+    out += "/>\n</gml:featureMember>\n";
+    return;
+  }
+  out += ">\n";
+
+  if ( hasGeometry )
+  {
+    out += "  <gml:boundedBy>\n";
+    appendGMLBoundingBox( out, geom->boundingBox(), 3 );
+    out += "  </gml:boundedBy>\n  <qgs:geometry>\n";
+    out += mGeometryBuffer;
+    out += "  </qgs:geometry>\n";
+  }
+
+  for ( int i = 0; i < mWrittenIndexes.size(); ++i )
+  {
+    int idx = mWrittenIndexes[i];
+    out += "  <";
+    out += mAttributeNames[i];
+    out += ">";
+    if ( idx < attributes.size() )
+    {
+      appendXmlEscaped( out, attributes[idx].toString() );
+    }
+    out += "</";
+    out += mAttributeNames[i];
+    out += ">\n";
+  }
+
+  out += " </qgs:";
+  out += mTypeName.toUtf8();
+  out += ">\n</gml:featureMember>\n";
+}
+
+bool QgsWFSFeatureWriter::appendGMLGeometry( QByteArray& out, const unsigned char* wkb, int depth ) const
+{
+  QgsConstWkbPtr wkbPtr( wkb + 1 );
+  QGis::WkbType wkbType;
+  wkbPtr >> wkbType;
+  bool hasZValue = false;
+
+  //opening tag of the collection, closed with '>' before the first member. Collections without members are written as empty elements
+  const char* collectionName = 0;
+  bool hasMembers = false;
+
+  switch ( wkbType )
+  {
+    case QGis::WKBPoint25D:
+    case QGis::WKBPoint:
+      appendIndent( out, depth );
+      out += "<gml:Point" + mSrsNameAttribute + ">\n";
+      appendGMLCoordinates( out, wkbPtr, 1, false, true, depth + 1 );
+      appendIndent( out, depth );
+      out += "</gml:Point>\n";
+      return true;
+
+    case QGis::WKBLineString25D:
+      hasZValue = true;
+    case QGis::WKBLineString:
+    {
+      int nPoints;
+      wkbPtr >> nPoints;
+      appendIndent( out, depth );
+      out += "<gml:LineString" + mSrsNameAttribute + ">\n";
+      appendGMLCoordinates( out, wkbPtr, nPoints, hasZValue, false, depth + 1 );
+      appendIndent( out, depth );
+      out += "</gml:LineString>\n";
+      return true;
+    }
+
+    case QGis::WKBPolygon25D:
+      hasZValue = true;
+    case QGis::WKBPolygon:
+    {
+      int nRings;
+      wkbPtr >> nRings;
+      if ( nRings == 0 ) // sanity check for zero rings in polygon
+      {
+        return false;
+      }
+      appendIndent( out, depth );
+      out += "<gml:Polygon" + mSrsNameAttribute + ">\n";
+      for ( int idx = 0; idx < nRings; ++idx )
+      {
+        appendGMLRing( out, wkbPtr, idx == 0, hasZValue, depth + 1 );
+      }
+      appendIndent( out, depth );
+      out += "</gml:Polygon>\n";
+      return true;
+    }
+
+    case QGis::WKBMultiPoint25D:
+      hasZValue = true;
+    case QGis::WKBMultiPoint:
+    {
+      collectionName = "gml:MultiPoint";
+      appendIndent( out, depth );
+      out += "<gml:MultiPoint" + mSrsNameAttribute;
+      int nPoints;
+      wkbPtr >> nPoints;
+      for ( int idx = 0; idx < nPoints; ++idx )
+      {
+        if ( !hasMembers )
+        {
+          out += ">\n";
+          hasMembers = true;
+        }
+        wkbPtr += 1 + sizeof( int );
+        appendIndent( out, depth + 1 );
+        out += "<gml:pointMember>\n";
+        appendIndent( out, depth + 2 );
+        out += "<gml:Point>\n";
+        appendGMLCoordinates( out, wkbPtr, 1, hasZValue, true, depth + 3 );
+        appendIndent( out, depth + 2 );
+        out += "</gml:Point>\n";
+        appendIndent( out, depth + 1 );
+        out += "</gml:pointMember>\n";
+      }
+      break;
+    }
+
+    case QGis::WKBMultiLineString25D:
+      hasZValue = true;
+    case QGis::WKBMultiLineString:
+    {
+      collectionName = "gml:MultiLineString";
+      appendIndent( out, depth );
+      out += "<gml:MultiLineString" + mSrsNameAttribute;
+      int nLines;
+      wkbPtr >> nLines;
+      for ( int jdx = 0; jdx < nLines; ++jdx )
+      {
+        if ( !hasMembers )
+        {
+          out += ">\n";
+          hasMembers = true;
+        }
+        wkbPtr += 1 + sizeof( int ); // skip type since we know its 2
+        int nPoints;
+        wkbPtr >> nPoints;
+        appendIndent( out, depth + 1 );
+        out += "<gml:lineStringMember>\n";
+        appendIndent( out, depth + 2 );
+        out += "<gml:LineString>\n";
+        appendGMLCoordinates( out, wkbPtr, nPoints, hasZValue, false, depth + 3 );
+        appendIndent( out, depth + 2 );
+        out += "</gml:LineString>\n";
+        appendIndent( out, depth + 1 );
+        out += "</gml:lineStringMember>\n";
+      }
+      break;
+    }
+
+    case QGis::WKBMultiPolygon25D:
+      hasZValue = true;
+    case QGis::WKBMultiPolygon:
+    {
+      collectionName = "gml:MultiPolygon";
+      appendIndent( out, depth );
+      out += "<gml:MultiPolygon" + mSrsNameAttribute;
+      int nPolygons;
+      wkbPtr >> nPolygons;
+      for ( int kdx = 0; kdx < nPolygons; ++kdx )
+      {
+        wkbPtr += 1 + sizeof( int );
+        int nRings;
+        wkbPtr >> nRings;
+        if ( nRings == 0 )
+        {
+          //polygons without rings are left out
+          continue;
+        }
+        if ( !hasMembers )
+        {
+          out += ">\n";
+          hasMembers = true;
+        }
+        appendIndent( out, depth + 1 );
+        out += "<gml:polygonMember>\n";
+        appendIndent( out, depth + 2 );
+        out += "<gml:Polygon>\n";
+        for ( int idx = 0; idx < nRings; ++idx )
+        {
+          appendGMLRing( out, wkbPtr, idx == 0, hasZValue, depth + 3 );
+        }
+        appendIndent( out, depth + 2 );
+        out += "</gml:Polygon>\n";
+        appendIndent( out, depth + 1 );
+        out += "</gml:polygonMember>\n";
+      }
+      break;
+    }
+
+    default:
+      return false;
+  }
+
+  if ( !hasMembers )
+  {
+    out += "/>\n";
+  }
+  else
+  {
+    appendIndent( out, depth );
+    out += "</";
+    out += collectionName;
+    out += ">\n";
+  }
+  return true;
+}
+
+void QgsWFSFeatureWriter::appendGMLRing( QByteArray& out, QgsConstWkbPtr& wkbPtr, bool outer, bool hasZValue, int depth ) const
+{
+  const char* boundaryElement = outer ? "gml:outerBoundaryIs>\n" : "gml:innerBoundaryIs>\n";
+  int nPoints;
+  wkbPtr >> nPoints;
+
+  appendIndent( out, depth );
+  out += "<";
+  out += boundaryElement;
+  appendIndent( out, depth + 1 );
+  out += "<gml:LinearRing>\n";
+  appendGMLCoordinates( out, wkbPtr, nPoints, hasZValue, false, depth + 2 );
+  appendIndent( out, depth + 1 );
+  out += "</gml:LinearRing>\n";
+  appendIndent( out, depth );
+  out += "</";
+  out += boundaryElement;
+}
+
+void QgsWFSFeatureWriter::appendGMLCoordinates( QByteArray& out, QgsConstWkbPtr& wkbPtr, int nPoints, bool hasZValue, bool point, int depth ) const
+{
+  const char* elementName;
+  char cs;
+  if ( mFormat == GML3 )
+  {
+    elementName = point ? "gml:pos" : "gml:posList";
+    cs = ' ';
+    appendIndent( out, depth );
+    out += "<";
+    out += elementName;
+    out += " srsDimension=\"2\">";
+  }
+  else
+  {
+    elementName = "gml:coordinates";
+    cs = ',';
+    appendIndent( out, depth );
+    out += "<gml:coordinates cs=\",\" ts=\" \">";
+  }
+
+  double x, y;
+  for ( int idx = 0; idx < nPoints; ++idx )
+  {
+    if ( idx != 0 )
+    {
+      out += ' ';
+    }
+    wkbPtr >> x >> y;
+    appendDouble( out, x );
+    out += cs;
+    appendDouble( out, y );
+    if ( hasZValue )
+    {
+      wkbPtr += sizeof( double );
+    }
+  }
+
+  out += "</";
+  out += elementName;
+  out += ">\n";
+}
+
+void QgsWFSFeatureWriter::appendGMLBoundingBox( QByteArray& out, const QgsRectangle& box, int depth ) const
+{
+  if ( mFormat == GML3 )
+  {
+    appendIndent( out, depth );
+    out += "<gml:Envelope" + mSrsNameAttribute + ">\n";
+    appendIndent( out, depth + 1 );
+    out += "<gml:lowerCorner>";
+    appendDouble( out, box.xMinimum() );
+    out += ' ';
+    appendDouble( out, box.yMinimum() );
+    out += "</gml:lowerCorner>\n";
+    appendIndent( out, depth + 1 );
+    out += "<gml:upperCorner>";
+    appendDouble( out, box.xMaximum() );
+    out += ' ';
+    appendDouble( out, box.yMaximum() );
+    out += "</gml:upperCorner>\n";
+    appendIndent( out, depth );
+    out += "</gml:Envelope>\n";
+  }
+  else
+  {
+    appendIndent( out, depth );
+    out += "<gml:Box" + mSrsNameAttribute + ">\n";
+    appendIndent( out, depth + 1 );
+    out += "<gml:coordinates cs=\",\" ts=\" \">";
+    appendDouble( out, box.xMinimum() );
+    out += ',';
+    appendDouble( out, box.yMinimum() );
+    out += ' ';
+    appendDouble( out, box.xMaximum() );
+    out += ',';
+    appendDouble( out, box.yMaximum() );
+    out += "</gml:coordinates>\n";
+    appendIndent( out, depth );
+    out += "</gml:Box>\n";
+  }
+}
+
+bool QgsWFSFeatureWriter::appendGeoJSONGeometry( QByteArray& out, const unsigned char* wkb ) const
+{
+  QgsConstWkbPtr wkbPtr( wkb + 1 );
+  QGis::WkbType wkbType;
+  wkbPtr >> wkbType;
+  bool hasZValue = false;
+
+  switch ( wkbType )
+  {
+    case QGis::WKBPoint25D:
+    case QGis::WKBPoint:
+    {
+      double x, y;
+      wkbPtr >> x >> y;
+      out += "{ \"type\": \"Point\", \"coordinates\": [";
+      appendDouble( out, x );
+      out += ", ";
+      appendDouble( out, y );
+      out += "] }";
+      return true;
+    }
+
+    case QGis::WKBLineString25D:
+      hasZValue = true;
+    case QGis::WKBLineString:
+    {
+      int nPoints;
+      wkbPtr >> nPoints;
+      out += "{ \"type\": \"LineString\", \"coordinates\": [ ";
+      appendGeoJSONCoordinates( out, wkbPtr, nPoints, hasZValue );
+      out += " ] }";
+      return true;
+    }
+
+    case QGis::WKBPolygon25D:
+      hasZValue = true;
+    case QGis::WKBPolygon:
+    {
+      int nRings;
+      wkbPtr >> nRings;
+      if ( nRings == 0 ) // sanity check for zero rings in polygon
+      {
+        return false;
+      }
+      out += "{ \"type\": \"Polygon\", \"coordinates\": [ ";
+      for ( int idx = 0; idx < nRings; ++idx )
+      {
+        if ( idx != 0 )
+          out += ", ";
+        int nPoints;
+        wkbPtr >> nPoints;
+        out += "[ ";
+        appendGeoJSONCoordinates( out, wkbPtr, nPoints, hasZValue );
+        out += " ]";
+      }
+      out += " ] }";
+      return true;
+    }
+
+    case QGis::WKBMultiPoint25D:
+      hasZValue = true;
+    case QGis::WKBMultiPoint:
+    {
+      int nPoints;
+      wkbPtr >> nPoints;
+      out += "{ \"type\": \"MultiPoint\", \"coordinates\": [ ";
+      for ( int idx = 0; idx < nPoints; ++idx )
+      {
+        if ( idx != 0 )
+          out += ", ";
+        wkbPtr += 1 + sizeof( int );
+        appendGeoJSONCoordinates( out, wkbPtr, 1, hasZValue );
+      }
+      out += " ] }";
+      return true;
+    }
+
+    case QGis::WKBMultiLineString25D:
+      hasZValue = true;
+    case QGis::WKBMultiLineString:
+    {
+      int nLines;
+      wkbPtr >> nLines;
+      out += "{ \"type\": \"MultiLineString\", \"coordinates\": [ ";
+      for ( int jdx = 0; jdx < nLines; ++jdx )
+      {
+        if ( jdx != 0 )
+          out += ", ";
+        wkbPtr += 1 + sizeof( int ); // skip type since we know its 2
+        int nPoints;
+        wkbPtr >> nPoints;
+        out += "[ ";
+        appendGeoJSONCoordinates( out, wkbPtr, nPoints, hasZValue );
+        out += " ]";
+      }
+      out += " ] }";
+      return true;
+    }
+
+    case QGis::WKBMultiPolygon25D:
+      hasZValue = true;
+    case QGis::WKBMultiPolygon:
+    {
+      int nPolygons;
+      wkbPtr >> nPolygons;
+      out += "{ \"type\": \"MultiPolygon\", \"coordinates\": [ ";
+      for ( int kdx = 0; kdx < nPolygons; ++kdx )
+      {
+        if ( kdx != 0 )
+          out += ", ";
+        wkbPtr += 1 + sizeof( int );
+        int nRings;
+        wkbPtr >> nRings;
+        out += "[ ";
+        for ( int idx = 0; idx < nRings; ++idx )
+        {
+          if ( idx != 0 )
+            out += ", ";
+          int nPoints;
+          wkbPtr >> nPoints;
+          out += "[ ";
+          appendGeoJSONCoordinates( out, wkbPtr, nPoints, hasZValue );
+          out += " ]";
+        }
+        out += " ]";
+      }
+      out += " ] }";
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+void QgsWFSFeatureWriter::appendGeoJSONCoordinates( QByteArray& out, QgsConstWkbPtr& wkbPtr, int nPoints, bool hasZValue ) const
+{
+  double x, y;
+  for ( int idx = 0; idx < nPoints; ++idx )
+  {
+    if ( idx != 0 )
+      out += ", ";
+    wkbPtr >> x >> y;
+    if ( hasZValue )
+      wkbPtr += sizeof( double );
+    out += '[';
+    appendDouble( out, x );
+    out += ", ";
+    appendDouble( out, y );
+    out += ']';
+  }
+}
+
+void QgsWFSFeatureWriter::appendIndent( QByteArray& out, int depth )
+{
+  out.append( QByteArray( depth, ' ' ) );
+}
+
+void QgsWFSFeatureWriter::appendDouble( QByteArray& out, double value )
+{
+  //same result as qgsDoubleToString, without the QString and QRegExp overhead.
+  //QByteArray::number always uses a dot, snprintf follows LC_NUMERIC
+  QByteArray number = QByteArray::number( value, 'f', 17 );
+  int length = number.size();
+  if ( number.contains( '.' ) )
+  {
+    while ( length > 0 && number[length - 1] == '0' )
+    {
+      --length;
+    }
+    if ( length > 0 && number[length - 1] == '.' )
+    {
+      --length;
+    }
+  }
+  out.append( number.constData(), length );
+}
+
+void QgsWFSFeatureWriter::appendBBoxNumber( QByteArray& out, double value )
+{
+  QByteArray number = QByteArray::number( value, 'f', 8 );
+  int length = number.size();
+  for ( int i = 0; i < 7 && length > 0 && number[length - 1] == '0'; ++i )
+  {
+    --length;
+  }
+  out.append( number.constData(), length );
+}
+
+void QgsWFSFeatureWriter::appendXmlEscaped( QByteArray& out, const QString& text, bool attribute )
+{
+  QByteArray utf8 = text.toUtf8();
+  const char* data = utf8.constData();
+  int start = 0;
+  for ( int i = 0; i < utf8.size(); ++i )
+  {
+    const char* replacement;
+    switch ( data[i] )
+    {
+      case '&':
+        replacement = "&amp;";
+        break;
+      case '<':
+        replacement = "&lt;";
+        break;
+      case '>':
+        replacement = "&gt;";
+        break;
+      case '"':
+        if ( !attribute )
+          continue;
+        replacement = "&quot;";
+        break;
+      default:
+        continue;
+    }
+    out.append( data + start, i - start );
+    out += replacement;
+    start = i + 1;
+  }
+  out.append( data + start, utf8.size() - start );
+}
+
+void QgsWFSFeatureWriter::appendJSONEscaped( QByteArray& out, const QString& text )
+{
+  QByteArray utf8 = text.toUtf8();
+  for ( int i = 0; i < utf8.size(); ++i )
+  {
+    char c = utf8[i];
+    switch ( c )
+    {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (( unsigned char ) c < 0x20 )
+        {
+          char escaped[8];
+          snprintf( escaped, sizeof( escaped ), "\\u%04x", ( unsigned char ) c );
+          out += escaped;
+        }
+        else
+        {
+          out += c;
+        }
+    }
+  }
+}
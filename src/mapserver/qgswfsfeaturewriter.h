@@ -0,0 +1,109 @@
+/***************************************************************************
+                              qgswfsfeaturewriter.h
+                              ---------------------
+  begin                : May 2014
+  copyright            : (C) 2014 by the QGIS project
+  email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSWFSFEATUREWRITER_H
+#define QGSWFSFEATUREWRITER_H
+
+#include "qgsfeature.h"
+#include <QByteArray>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+class QgsConstWkbPtr;
+class QgsCoordinateReferenceSystem;
+class QgsRectangle;
+
+/**Serialises the features of a GetFeature response as GML2, GML3 or GeoJSON directly into a byte buffer.
+  Coordinates are formatted straight from the WKB of the geometries, no DOM elements or intermediate strings
+  are created. The output has the same structure as the one of QgsOgcUtils::geometryToGML and
+  QgsGeometry::exportToGeoJSON*/
+class QgsWFSFeatureWriter
+{
+  public:
+    enum Format
+    {
+      GML2,
+      GML3,
+      GeoJSON
+    };
+
+    /**Constructor
+      @param format output format
+      @param typeName feature type name (used for element names and feature ids)
+      @param crs layer crs (srsName of the geometries)
+      @param withGeometry write the feature geometries
+      @param fields fields of the features
+      @param attrIndexes indexes of the written attributes
+      @param excludedAttributes names of attributes not published by WFS*/
+    QgsWFSFeatureWriter( Format format, const QString& typeName, const QgsCoordinateReferenceSystem& crs, bool withGeometry,
+                         const QgsFields& fields, const QgsAttributeList& attrIndexes, const QSet<QString>& excludedAttributes );
+
+    Format format() const { return mFormat; }
+    QString typeName() const { return mTypeName; }
+    bool withGeometry() const { return mWithGeometry; }
+    const QgsAttributeList& attributeIndexes() const { return mAttrIndexes; }
+
+    /**Appends a feature to the buffer
+      @param feature the feature
+      @param firstFeature true for the first feature of the response (GeoJSON separator)
+      @param out the output buffer*/
+    void writeFeature( const QgsFeature& feature, bool firstFeature, QByteArray& out );
+
+    /**Appends a number like qgsDoubleToString (17 decimals without trailing zeros)*/
+    static void appendDouble( QByteArray& out, double value );
+    /**Appends text with the XML special characters escaped
+      @param attribute true for attribute values (escapes double quotes too)*/
+    static void appendXmlEscaped( QByteArray& out, const QString& text, bool attribute = false );
+
+  private:
+    /**Appends the GML geometry element of a WKB geometry
+      @return false if the geometry type is not supported (no output in that case)*/
+    bool appendGMLGeometry( QByteArray& out, const unsigned char* wkb, int depth ) const;
+    /**Appends the coordinates of nPoints points as gml:coordinates / gml:pos / gml:posList element*/
+    void appendGMLCoordinates( QByteArray& out, QgsConstWkbPtr& wkbPtr, int nPoints, bool hasZValue, bool point, int depth ) const;
+    /**Appends a gml:LinearRing inside a gml:outerBoundaryIs / gml:innerBoundaryIs element*/
+    void appendGMLRing( QByteArray& out, QgsConstWkbPtr& wkbPtr, bool outer, bool hasZValue, int depth ) const;
+    void appendGMLBoundingBox( QByteArray& out, const QgsRectangle& box, int depth ) const;
+    /**Appends a geometry like QgsGeometry::exportToGeoJSON
+      @return false if the geometry type is not supported*/
+    bool appendGeoJSONGeometry( QByteArray& out, const unsigned char* wkb ) const;
+    void appendGeoJSONCoordinates( QByteArray& out, QgsConstWkbPtr& wkbPtr, int nPoints, bool hasZValue ) const;
+
+    static void appendIndent( QByteArray& out, int depth );
+    /**Appends a number like QString::number( value, 'f', 8 ) with at most 7 trailing zeros removed (GeoJSON bbox)*/
+    static void appendBBoxNumber( QByteArray& out, double value );
+    static void appendJSONEscaped( QByteArray& out, const QString& text );
+
+    Format mFormat;
+    QString mTypeName;
+    bool mWithGeometry;
+    QgsAttributeList mAttrIndexes;
+
+    /**Prefix of the feature ids (type name and '.')*/
+    QByteArray mIdPrefix;
+    /**srsName attribute (with leading space) or empty*/
+    QByteArray mSrsNameAttribute;
+    /**Indexes of the written attributes (without the excluded ones)*/
+    QList<int> mWrittenIndexes;
+    /**GML element names / GeoJSON property names of the written attributes*/
+    QList<QByteArray> mAttributeNames;
+    /**Buffer for the geometry (the bounding box is written before the geometry)*/
+    QByteArray mGeometryBuffer;
+};
+
+#endif // QGSWFSFEATUREWRITER_H
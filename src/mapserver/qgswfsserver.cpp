@@ -26,6 +26,7 @@
 #include "qgsmaptopixel.h"
 #include "qgspallabeling.h"
 #include "qgsproject.h"
+#include "qgsproviderregistry.h"
 #include "qgsrasterlayer.h"
 #include "qgsscalecalculator.h"
 #include "qgscoordinatereferencesystem.h"
@@ -40,6 +41,7 @@
 #include "qgscomposerlegenditem.h"
 #include "qgsrequesthandler.h"
 #include "qgsogcutils.h"
+#include "qgswfsfeaturewriter.h"
 
 #include <QImage>
 #include <QPainter>
@@ -66,17 +68,204 @@ static const QString GML_NAMESPACE = "http://www.opengis.net/gml";
 static const QString OGC_NAMESPACE = "http://www.opengis.net/ogc";
 static const QString QGS_NAMESPACE = "http://www.qgis.org/gml";
 
+//features are sent to the client in blocks of this size
+static const int FEATURE_BUFFER_SIZE = 1024 * 1024;
+
+//providers whose subset string is a SQL WHERE clause which can take the translated filter conditions
+static const char* sFilterProviders[] = { "postgres", "spatialite", "ogr", 0 };
+
+static bool isNumericField( const QgsField& field )
+{
+  switch ( field.type() )
+  {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static QString sqlIdentifier( const QString& name )
+{
+  QString quoted = name;
+  return "\"" + quoted.replace( "\"", "\"\"" ) + "\"";
+}
+
+//translates a literal compared with a field. Only values which QgsExpression compares the same way as SQL are translated:
+//numbers with numeric fields and strings which are no numbers (QgsExpression compares those numerically) with string fields
+static QString sqlLiteral( const QgsExpression::Node* node, const QgsField& field )
+{
+  if ( node->nodeType() != QgsExpression::ntLiteral )
+  {
+    return QString();
+  }
+
+  QVariant value = static_cast<const QgsExpression::NodeLiteral*>( node )->value();
+  if ( isNumericField( field ) )
+  {
+    switch ( value.type() )
+    {
+      case QVariant::Int:
+      case QVariant::LongLong:
+        return QString::number( value.toLongLong() );
+      case QVariant::Double:
+      {
+        //shortest representation, so that numeric columns compare with the value the user has written
+        double d = value.toDouble();
+        QString number = QString::number( d, 'g', 15 );
+        return number.toDouble() == d ? number : QString::number( d, 'g', 17 );
+      }
+      default:
+        return QString();
+    }
+  }
+
+  if ( field.type() != QVariant::String || value.type() != QVariant::String )
+  {
+    return QString();
+  }
+  QString string = value.toString();
+  bool isNumber;
+  string.toDouble( &isNumber );
+  if ( isNumber || string.contains( "\\" ) )
+  {
+    return QString();
+  }
+  return "'" + string.replace( "'", "''" ) + "'";
+}
+
+//translates an expression to a SQL condition which is true for (at least) all features matching the expression.
+//Parts which cannot be translated are left out of AND conditions. An empty string means that all features may match
+static QString sqlCondition( const QgsExpression::Node* node, const QgsFields& fields )
+{
+  switch ( node->nodeType() )
+  {
+    case QgsExpression::ntBinaryOperator:
+    {
+      const QgsExpression::NodeBinaryOperator* binOp = static_cast<const QgsExpression::NodeBinaryOperator*>( node );
+      if ( binOp->op() == QgsExpression::boAnd || binOp->op() == QgsExpression::boOr )
+      {
+        QString left = sqlCondition( binOp->opLeft(), fields );
+        QString right = sqlCondition( binOp->opRight(), fields );
+        if ( binOp->op() == QgsExpression::boOr && ( left.isEmpty() || right.isEmpty() ) )
+        {
+          return QString();
+        }
+        if ( left.isEmpty() || right.isEmpty() )
+        {
+          return left.isEmpty() ? right : left;
+        }
+        return QString( "(%1) %2 (%3)" ).arg( left ).arg( binOp->op() == QgsExpression::boAnd ? "AND" : "OR" ).arg( right );
+      }
+
+      if ( binOp->opLeft()->nodeType() != QgsExpression::ntColumnRef )
+      {
+        return QString();
+      }
+      int fieldIndex = fields.indexFromName( static_cast<const QgsExpression::NodeColumnRef*>( binOp->opLeft() )->name() );
+      if ( fieldIndex < 0 )
+      {
+        return QString();
+      }
+      const QgsField& field = fields[fieldIndex];
+      QString column = sqlIdentifier( field.name() );
+
+      if ( binOp->op() == QgsExpression::boIs || binOp->op() == QgsExpression::boIsNot )
+      {
+        if ( binOp->opRight()->nodeType() != QgsExpression::ntLiteral
+             || !static_cast<const QgsExpression::NodeLiteral*>( binOp->opRight() )->value().isNull() )
+        {
+          return QString();
+        }
+        return column + ( binOp->op() == QgsExpression::boIs ? " IS NULL" : " IS NOT NULL" );
+      }
+
+      QString value = sqlLiteral( binOp->opRight(), field );
+      if ( value.isEmpty() )
+      {
+        return QString();
+      }
+
+      switch ( binOp->op() )
+      {
+        case QgsExpression::boEQ:
+          return column + " = " + value;
+        case QgsExpression::boNE:
+          return column + " <> " + value;
+        case QgsExpression::boLE:
+        case QgsExpression::boGE:
+        case QgsExpression::boLT:
+        case QgsExpression::boGT:
+        {
+          if ( !isNumericField( field ) )
+          {
+            //string order depends on the collation of the database
+            return QString();
+          }
+          const char* op = binOp->op() == QgsExpression::boLE ? " <= " : binOp->op() == QgsExpression::boGE ? " >= " : binOp->op() == QgsExpression::boLT ? " < " : " > ";
+          return column + op + value;
+        }
+        case QgsExpression::boLike:
+          return isNumericField( field ) ? QString() : column + " LIKE " + value;
+        default:
+          return QString();
+      }
+    }
+
+    case QgsExpression::ntInOperator:
+    {
+      const QgsExpression::NodeInOperator* inOp = static_cast<const QgsExpression::NodeInOperator*>( node );
+      if ( inOp->isNotIn() || inOp->node()->nodeType() != QgsExpression::ntColumnRef )
+      {
+        return QString();
+      }
+      int fieldIndex = fields.indexFromName( static_cast<const QgsExpression::NodeColumnRef*>( inOp->node() )->name() );
+      if ( fieldIndex < 0 )
+      {
+        return QString();
+      }
+      QStringList values;
+      foreach ( const QgsExpression::Node* valueNode, inOp->list()->list() )
+      {
+        QString value = sqlLiteral( valueNode, fields[fieldIndex] );
+        if ( value.isEmpty() )
+        {
+          return QString();
+        }
+        values << value;
+      }
+      if ( values.isEmpty() )
+      {
+        return QString();
+      }
+      return QString( "%1 IN (%2)" ).arg( sqlIdentifier( fields[fieldIndex].name() ) ).arg( values.join( "," ) );
+    }
+
+    default:
+      return QString();
+  }
+}
+
 QgsWFSServer::QgsWFSServer( QMap<QString, QString> parameters )
     : mParameterMap( parameters )
     , mConfigParser( 0 )
+    , mStartIndex( 0 )
+    , mFeatureWriter( 0 )
 {
 }
 
 QgsWFSServer::~QgsWFSServer()
 {
+  delete mFeatureWriter;
 }
 
 QgsWFSServer::QgsWFSServer()
+    : mStartIndex( 0 )
+    , mFeatureWriter( 0 )
 {
 }
 
@@ -307,6 +496,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
     if ( docElem.hasAttribute( "maxFeatures" ) )
       maxFeatures = docElem.attribute( "maxFeatures" ).toLong();
 
+    if ( docElem.hasAttribute( "startIndex" ) )
+      mStartIndex = docElem.attribute( "startIndex" ).toLong();
+
     QDomNodeList queryNodes = docElem.elementsByTagName( "Query" );
     QDomElement queryElem;
     for ( int i = 0; i < queryNodes.size(); i++ )
@@ -413,10 +605,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
         if ( maxFeatures == -1 )
           maxFeat += layer->featureCount();
 
-        QgsFeatureIterator fit = layer->getFeatures(
-                                   QgsFeatureRequest()
-                                   .setFlags( QgsFeatureRequest::ExactIntersect | ( mWithGeom ? QgsFeatureRequest::NoFlags : QgsFeatureRequest::NoGeometry ) )
-                                   .setSubsetOfAttributes( attrIndexes ) );
+        QgsFeatureRequest layerRequest = QgsFeatureRequest()
+                                         .setFlags( QgsFeatureRequest::ExactIntersect | ( mWithGeom ? QgsFeatureRequest::NoFlags : QgsFeatureRequest::NoGeometry ) )
+                                         .setSubsetOfAttributes( attrIndexes );
 
         long featCounter = 0;
         QDomNodeList filterNodes = queryElem.elementsByTagName( "Filter" );
@@ -446,6 +637,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
                                   .setSubsetOfAttributes( attrIndexes )
                                 ).nextFeature( feature );
 
+              if ( skipFeature() )
+                continue;
+
               if ( featureCounter == 0 )
                 startGetFeature( request, format, layerCrs, &searchRect );
 
@@ -483,6 +677,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
             QgsFeatureIterator fit = layer->getFeatures( req );
             while ( fit.nextFeature( feature ) && featureCounter < maxFeat )
             {
+              if ( skipFeature() )
+                continue;
+
               if ( featureCounter == 0 )
                 startGetFeature( request, format, layerCrs, &searchRect );
 
@@ -500,6 +697,7 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
               {
                 throw QgsMapServiceException( "RequestNotWellFormed", mFilter->parserErrorString() );
               }
+              QgsFeatureIterator fit = getFilteredFeatures( layer, layerRequest, mFilter );
               while ( fit.nextFeature( feature ) && featureCounter < maxFeat )
               {
                 QVariant res = mFilter->evaluate( &feature, fields );
@@ -509,6 +707,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
                 }
                 if ( res.toInt() != 0 )
                 {
+                  if ( skipFeature() )
+                    continue;
+
                   if ( featureCounter == 0 )
                     startGetFeature( request, format, layerCrs, &searchRect );
 
@@ -517,13 +718,18 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
                   ++featCounter;
                 }
               }
+              delete mFilter;
             }
           }
         }
         else
         {
+          QgsFeatureIterator fit = layer->getFeatures( layerRequest );
           while ( fit.nextFeature( feature ) && featureCounter < maxFeat )
           {
+            if ( skipFeature() )
+              continue;
+
             if ( featureCounter == 0 )
               startGetFeature( request, format, layerCrs, &searchRect );
 
@@ -656,6 +862,13 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
     maxFeat = mfString.toLong( &mfOk, 10 );
   }
 
+  //read STARTINDEX
+  QMap<QString, QString>::const_iterator siIt = mParameterMap.find( "STARTINDEX" );
+  if ( siIt != mParameterMap.end() )
+  {
+    mStartIndex = siIt.value().toLong();
+  }
+
   //read PROPERTYNAME
   mWithGeom = true;
   mPropertyName = "*";
@@ -765,6 +978,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
                               .setSubsetOfAttributes( attrIndexes )
                             ).nextFeature( feature );
 
+          if ( skipFeature() )
+            continue;
+
           if ( featureCounter == 0 )
             startGetFeature( request, format, layerCrs, &searchRect );
 
@@ -794,7 +1010,6 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
           mWithGeom = false;
         }
         req.setSubsetOfAttributes( attrIndexes );
-        QgsFeatureIterator fit = layer->getFeatures( req );
         QgsExpression *mFilter = new QgsExpression( expFilter );
         if ( mFilter )
         {
@@ -802,6 +1017,7 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
           {
             throw QgsMapServiceException( "RequestNotWellFormed", QString( "Expression filter error message: %1." ).arg( mFilter->parserErrorString() ) );
           }
+          QgsFeatureIterator fit = getFilteredFeatures( layer, req, mFilter );
           while ( fit.nextFeature( feature ) && featureCounter < maxFeat )
           {
             QVariant res = mFilter->evaluate( &feature, fields );
@@ -811,6 +1027,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
             }
             if ( res.toInt() != 0 )
             {
+              if ( skipFeature() )
+                continue;
+
               if ( featureCounter == 0 )
                 startGetFeature( request, format, layerCrs, &searchRect );
 
@@ -848,6 +1067,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
                                 .setSubsetOfAttributes( attrIndexes )
                               ).nextFeature( feature );
 
+            if ( skipFeature() )
+              continue;
+
             if ( featureCounter == 0 )
               startGetFeature( request, format, layerCrs, &searchRect );
 
@@ -885,6 +1107,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
           QgsFeatureIterator fit = layer->getFeatures( req );
           while ( fit.nextFeature( feature ) && featureCounter < maxFeat )
           {
+            if ( skipFeature() )
+              continue;
+
             if ( featureCounter == 0 )
               startGetFeature( request, format, layerCrs, &searchRect );
 
@@ -920,7 +1145,7 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
               mWithGeom = false;
             }
             req.setSubsetOfAttributes( attrIndexes );
-            QgsFeatureIterator fit = layer->getFeatures( req );
+            QgsFeatureIterator fit = getFilteredFeatures( layer, req, mFilter );
             while ( fit.nextFeature( feature ) && featureCounter < maxFeat )
             {
               QVariant res = mFilter->evaluate( &feature, fields );
@@ -930,6 +1155,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
               }
               if ( res.toInt() != 0 )
               {
+                if ( skipFeature() )
+                  continue;
+
                 if ( featureCounter == 0 )
                   startGetFeature( request, format, layerCrs, &searchRect );
 
@@ -966,6 +1194,9 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
         QgsFeatureIterator fit = layer->getFeatures( req );
         while ( fit.nextFeature( feature ) && featureCounter < maxFeat )
         {
+          if ( skipFeature() )
+            continue;
+
           mErrors << QString( "The feature %2 of layer for the TypeName '%1'" ).arg( tnStr ).arg( featureCounter );
           if ( featureCounter == 0 )
             startGetFeature( request, format, layerCrs, &searchRect );
@@ -1128,44 +1359,111 @@ void QgsWFSServer::sendGetFeature( QgsRequestHandler& request, const QString& fo
   if ( !feat->isValid() )
     return;
 
-  QByteArray result;
+  QgsWFSFeatureWriter::Format writerFormat = QgsWFSFeatureWriter::GML2;
   if ( format == "GeoJSON" )
+    writerFormat = QgsWFSFeatureWriter::GeoJSON;
+  else if ( format == "GML3" )
+    writerFormat = QgsWFSFeatureWriter::GML3;
+
+  //the writer prepares element names and attributes once per feature type
+  if ( !mFeatureWriter || mFeatureWriter->format() != writerFormat || mFeatureWriter->typeName() != mTypeName
+       || mFeatureWriter->withGeometry() != mWithGeom || mFeatureWriter->attributeIndexes() != attrIndexes )
   {
-    QString fcString;
-    if ( featIdx == 0 )
-      fcString += "  ";
-    else
-      fcString += " ,";
-    fcString += createFeatureGeoJSON( feat, crs, attrIndexes, excludedAttributes );
-    fcString += "\n";
+    delete mFeatureWriter;
+    mFeatureWriter = new QgsWFSFeatureWriter( writerFormat, mTypeName, crs, mWithGeom, feat->fields() ? *feat->fields() : QgsFields(),
+        attrIndexes, excludedAttributes );
+  }
 
-    result = fcString.toUtf8();
-    request.sendGetFeatureResponse( &result );
-    fcString = "";
+  mFeatureWriter->writeFeature( *feat, featIdx == 0, mFeatureBuffer );
+  if ( mFeatureBuffer.size() >= FEATURE_BUFFER_SIZE )
+  {
+    flushFeatures( request );
   }
-  else
+}
+
+void QgsWFSServer::flushFeatures( QgsRequestHandler& request )
+{
+  if ( mFeatureBuffer.isEmpty() )
+    return;
+
+  request.sendGetFeatureResponse( &mFeatureBuffer );
+  mFeatureBuffer.clear();
+}
+
+bool QgsWFSServer::skipFeature()
+{
+  if ( mStartIndex > 0 )
   {
-    QDomDocument gmlDoc;
-    QDomElement featureElement;
-    if ( format == "GML3" )
+    --mStartIndex;
+    return true;
+  }
+  return false;
+}
+
+QgsFeatureIterator QgsWFSServer::getFilteredFeatures( QgsVectorLayer* layer, QgsFeatureRequest& request, QgsExpression* filter )
+{
+  QgsVectorDataProvider* provider = layer->dataProvider();
+  const QgsFields& fields = provider->fields();
+
+  //the expression is evaluated with the fetched attributes
+  if ( request.flags() & QgsFeatureRequest::SubsetOfAttributes )
+  {
+    QgsAttributeList attributes = request.subsetOfAttributes();
+    foreach ( const QString& column, filter->referencedColumns() )
     {
-      featureElement = createFeatureGML3( feat, gmlDoc, crs, attrIndexes, excludedAttributes );
-      gmlDoc.appendChild( featureElement );
+      int idx = fields.indexFromName( column );
+      if ( idx >= 0 && !attributes.contains( idx ) )
+      {
+        attributes << idx;
+      }
     }
-    else
+    request.setSubsetOfAttributes( attributes );
+  }
+
+  bool sqlProvider = false;
+  for ( int i = 0; sFilterProviders[i]; ++i )
+  {
+    if ( provider->name() == sFilterProviders[i] )
     {
-      featureElement = createFeatureGML2( feat, gmlDoc, crs, attrIndexes, excludedAttributes );
-      gmlDoc.appendChild( featureElement );
+      sqlProvider = true;
+      break;
     }
+  }
+  //the provider alone does not add joined attributes
+  QString condition = sqlProvider && filter->rootNode() ? sqlCondition( filter->rootNode(), fields ) : QString();
+  if ( condition.isEmpty() || layer->pendingFields().count() != fields.count() )
+  {
+    return layer->getFeatures( request );
+  }
 
-    result = gmlDoc.toByteArray();
-    request.sendGetFeatureResponse( &result );
-    gmlDoc.removeChild( featureElement );
+  //the condition is applied by a second provider of the same data source, so that the provider of the
+  //cached layer is never modified. The feature source of the iterator does not depend on the provider
+  QgsVectorDataProvider* filterProvider = qobject_cast<QgsVectorDataProvider*>( QgsProviderRegistry::instance()->provider( provider->name(), provider->dataSourceUri() ) );
+  if ( !filterProvider || !filterProvider->isValid() || filterProvider->fields().count() != fields.count() )
+  {
+    QgsDebugMsg( "Could not open a second provider for " + provider->dataSourceUri() );
+    delete filterProvider;
+    return layer->getFeatures( request );
   }
+
+  QString subsetString = provider->subsetString();
+  QString filteredSubsetString = subsetString.isEmpty() ? condition : QString( "(%1) AND (%2)" ).arg( subsetString ).arg( condition );
+  if ( !filterProvider->setSubsetString( filteredSubsetString, false ) )
+  {
+    QgsDebugMsg( "Provider could not apply the filter " + condition );
+    delete filterProvider;
+    return layer->getFeatures( request );
+  }
+
+  QgsFeatureIterator fit = filterProvider->getFeatures( request );
+  delete filterProvider;
+  return fit;
 }
 
 void QgsWFSServer::endGetFeature( QgsRequestHandler& request, const QString& format )
 {
+  flushFeatures( request );
+
   QByteArray result;
   QString fcString;
   if ( format == "GeoJSON" )
@@ -1603,187 +1901,6 @@ QgsFeatureIds QgsWFSServer::getFeatureIdsFromFilter( QDomElement filterElem, Qgs
   return fids;
 }
 
-QString QgsWFSServer::createFeatureGeoJSON( QgsFeature* feat, QgsCoordinateReferenceSystem &, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/
-{
-  QString fStr = "{\"type\": \"Feature\",\n";
-
-  fStr += "   \"id\": ";
-  fStr += "\"" + mTypeName + "." + QString::number( feat->id() ) + "\"";
-  fStr += ",\n";
-
-  QgsGeometry* geom = feat->geometry();
-  if ( geom && mWithGeom )
-  {
-    QgsRectangle box = geom->boundingBox();
-
-    fStr += " \"bbox\": [ " + QString::number( box.xMinimum(), 'f', 8 ).remove( QRegExp( "[0]{1,7}$" ) ) + ", " + QString::number( box.yMinimum(), 'f', 8 ).remove( QRegExp( "[0]{1,7}$" ) ) + ", " + QString::number( box.xMaximum(), 'f', 8 ).remove( QRegExp( "[0]{1,7}$" ) ) + ", " + QString::number( box.yMaximum(), 'f', 8 ).remove( QRegExp( "[0]{1,7}$" ) ) + "],\n";
-
-    fStr += "  \"geometry\": ";
-    fStr += geom->exportToGeoJSON();
-    fStr += ",\n";
-  }
-
-  //read all attribute values from the feature
-  fStr += "   \"properties\": {\n";
-  QgsAttributes featureAttributes = feat->attributes();
-  const QgsFields* fields = feat->fields();
-  int attributeCounter = 0;
-  for ( int i = 0; i < attrIndexes.count(); ++i )
-  {
-    int idx = attrIndexes[i];
-    QString attributeName = fields->at( idx ).name();
-    //skip attribute if it is excluded from WFS publication
-    if ( excludedAttributes.contains( attributeName ) )
-    {
-      continue;
-    }
-    QVariant val = featureAttributes[idx];
-
-    if ( attributeCounter == 0 )
-      fStr += "    \"";
-    else
-      fStr += "   ,\"";
-    fStr += attributeName;
-    fStr += "\": ";
-    if ( val.type() == 6 || val.type() == 2 )
-    {
-      fStr +=  val.toString();
-    }
-    else
-    {
-      fStr += "\"";
-      fStr +=  val.toString().replace( QString( "\"" ), QString( "\\\"" ) );
-      fStr += "\"";
-    }
-    fStr += "\n";
-    ++attributeCounter;
-  }
-
-  fStr += "   }\n";
-
-  fStr += "  }";
-
-  return fStr;
-}
-
-QDomElement QgsWFSServer::createFeatureGML2( QgsFeature* feat, QDomDocument& doc, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/
-{
-  //gml:FeatureMember
-  QDomElement featureElement = doc.createElement( "gml:featureMember"/*wfs:FeatureMember*/ );
-
-  //qgs:%TYPENAME%
-  QDomElement typeNameElement = doc.createElement( "qgs:" + mTypeName /*qgs:%TYPENAME%*/ );
-  typeNameElement.setAttribute( "fid", mTypeName + "." + QString::number( feat->id() ) );
-  featureElement.appendChild( typeNameElement );
-
-  if ( mWithGeom )
-  {
-    //add geometry column (as gml)
-    QgsGeometry* geom = feat->geometry();
-
-    QDomElement geomElem = doc.createElement( "qgs:geometry" );
-    QDomElement gmlElem = QgsOgcUtils::geometryToGML( geom, doc );
-    if ( !gmlElem.isNull() )
-    {
-      QgsRectangle box = geom->boundingBox();
-      QDomElement bbElem = doc.createElement( "gml:boundedBy" );
-      QDomElement boxElem = QgsOgcUtils::rectangleToGMLBox( &box, doc );
-
-      if ( crs.isValid() )
-      {
-        boxElem.setAttribute( "srsName", crs.authid() );
-        gmlElem.setAttribute( "srsName", crs.authid() );
-      }
-
-      bbElem.appendChild( boxElem );
-      typeNameElement.appendChild( bbElem );
-
-      geomElem.appendChild( gmlElem );
-      typeNameElement.appendChild( geomElem );
-    }
-  }
-
-  //read all attribute values from the feature
-  QgsAttributes featureAttributes = feat->attributes();
-  const QgsFields* fields = feat->fields();
-  for ( int i = 0; i < attrIndexes.count(); ++i )
-  {
-    int idx = attrIndexes[i];
-    QString attributeName = fields->at( idx ).name();
-    //skip attribute if it is excluded from WFS publication
-    if ( excludedAttributes.contains( attributeName ) )
-    {
-      continue;
-    }
-
-    QDomElement fieldElem = doc.createElement( "qgs:" + attributeName.replace( QString( " " ), QString( "_" ) ) );
-    QDomText fieldText = doc.createTextNode( featureAttributes[idx].toString() );
-    fieldElem.appendChild( fieldText );
-    typeNameElement.appendChild( fieldElem );
-  }
-
-  return featureElement;
-}
-
-QDomElement QgsWFSServer::createFeatureGML3( QgsFeature* feat, QDomDocument& doc, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/
-{
-  //gml:FeatureMember
-  QDomElement featureElement = doc.createElement( "gml:featureMember"/*wfs:FeatureMember*/ );
-
-  //qgs:%TYPENAME%
-  QDomElement typeNameElement = doc.createElement( "qgs:" + mTypeName /*qgs:%TYPENAME%*/ );
-  typeNameElement.setAttribute( "gml:id", mTypeName + "." + QString::number( feat->id() ) );
-  featureElement.appendChild( typeNameElement );
-
-  if ( mWithGeom )
-  {
-    //add geometry column (as gml)
-    QgsGeometry* geom = feat->geometry();
-
-    QDomElement geomElem = doc.createElement( "qgs:geometry" );
-    QDomElement gmlElem = QgsOgcUtils::geometryToGML( geom, doc, "GML3" );
-    if ( !gmlElem.isNull() )
-    {
-      QgsRectangle box = geom->boundingBox();
-      QDomElement bbElem = doc.createElement( "gml:boundedBy" );
-      QDomElement boxElem = QgsOgcUtils::rectangleToGMLEnvelope( &box, doc );
-
-      if ( crs.isValid() )
-      {
-        boxElem.setAttribute( "srsName", crs.authid() );
-        gmlElem.setAttribute( "srsName", crs.authid() );
-      }
-
-      bbElem.appendChild( boxElem );
-      typeNameElement.appendChild( bbElem );
-
-      geomElem.appendChild( gmlElem );
-      typeNameElement.appendChild( geomElem );
-    }
-  }
-
-  //read all attribute values from the feature
-  QgsAttributes featureAttributes = feat->attributes();
-  const QgsFields* fields = feat->fields();
-  for ( int i = 0; i < attrIndexes.count(); ++i )
-  {
-    int idx = attrIndexes[i];
-    QString attributeName = fields->at( idx ).name();
-    //skip attribute if it is excluded from WFS publication
-    if ( excludedAttributes.contains( attributeName ) )
-    {
-      continue;
-    }
-
-    QDomElement fieldElem = doc.createElement( "qgs:" + attributeName.replace( QString( " " ), QString( "_" ) ) );
-    QDomText fieldText = doc.createTextNode( featureAttributes[idx].toString() );
-    fieldElem.appendChild( fieldText );
-    typeNameElement.appendChild( fieldElem );
-  }
-
-  return featureElement;
-}
-
 QString QgsWFSServer::serviceUrl() const
 {
   QUrl mapUrl( getenv( "REQUEST_URI" ) );
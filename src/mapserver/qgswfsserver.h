@@ -29,6 +29,7 @@ class QgsCoordinateReferenceSystem;
 class QgsComposerLayerItem;
 class QgsComposerLegendItem;
 class QgsComposition;
+class QgsExpression;
 class QgsFields;
 class QgsMapLayer;
 class QgsMapRenderer;
@@ -43,6 +44,7 @@ class QgsRectangle;
 class QgsGeometry;
 class QgsSymbol;
 class QgsRequestHandler;
+class QgsWFSFeatureWriter;
 class QFile;
 class QFont;
 class QImage;
@@ -95,24 +97,31 @@ class QgsWFSServer
     bool mWithGeom;
     /* Error messages */
     QStringList mErrors;
+    /* Number of matching features to skip before the first returned feature (STARTINDEX) */
+    long mStartIndex;
+    /* Serialises the features of the current feature type */
+    QgsWFSFeatureWriter* mFeatureWriter;
+    /* Features not yet sent to the client */
+    QByteArray mFeatureBuffer;
 
   protected:
 
     void startGetFeature( QgsRequestHandler& request, const QString& format, QgsCoordinateReferenceSystem& crs, QgsRectangle* rect );
     void sendGetFeature( QgsRequestHandler& request, const QString& format, QgsFeature* feat, int featIdx, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes );
     void endGetFeature( QgsRequestHandler& request, const QString& format );
+    /**Sends the buffered features to the client*/
+    void flushFeatures( QgsRequestHandler& request );
+    /**Returns true (and counts the feature) while the matching features before STARTINDEX are skipped*/
+    bool skipFeature();
+
+    /**Creates the feature iterator for a filter expression. The conditions of the expression which the provider
+      can evaluate in SQL are added to the subset string of a second provider of the layer's data source, so that
+      they reduce the number of fetched features. The expression still has to be evaluated for each returned feature.
+      The attributes referenced by the expression are added to the attributes of the request*/
+    QgsFeatureIterator getFilteredFeatures( QgsVectorLayer* layer, QgsFeatureRequest& request, QgsExpression* filter );
 
     //method for transaction
     QgsFeatureIds getFeatureIdsFromFilter( QDomElement filter, QgsVectorLayer* layer );
-
-    //methods to write GeoJSON
-    QString createFeatureGeoJSON( QgsFeature* feat, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/;
-
-    //methods to write GML2
-    QDomElement createFeatureGML2( QgsFeature* feat, QDomDocument& doc, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/;
-
-    //methods to write GML3
-    QDomElement createFeatureGML3( QgsFeature* feat, QDomDocument& doc, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/;
 };
 
 #endif
@@ -23,6 +23,8 @@
 #include "qgsmaplayer.h"
 #include "qgsmaplayerregistry.h"
 #include "qgsmaprenderer.h"
+#include "qgsmaprendererjob.h"
+#include "qgsmapsettings.h"
 #include "qgsmaptopixel.h"
 #include "qgsproject.h"
 #include "qgsrasteridentifyresult.h"
@@ -40,6 +42,7 @@
 #include "qgscomposerlegenditem.h"
 #include "qgspaintenginehack.h"
 #include "qgsogcutils.h"
+#include "qgspallabeling.h"
 #include "qgsfeature.h"
 
 #include <QImage>
@@ -761,7 +764,10 @@ QImage* QgsWMSServer::getMap()
 
   applyOpacities( layersList, bkVectorRenderers, bkRasterRenderers, labelTransparencies, labelBufferTransparencies );
 
-  mMapRenderer->render( &thePainter );
+  if ( !renderParallel( &thePainter ) )
+  {
+    mMapRenderer->render( &thePainter );
+  }
   if ( mConfigParser )
   {
     //draw configuration format specific overlay items
@@ -781,6 +787,48 @@ QImage* QgsWMSServer::getMap()
   return theImage;
 }
 
+bool QgsWMSServer::renderParallel( QPainter* painter )
+{
+  if ( !mMapRenderer || !painter )
+  {
+    return false;
+  }
+
+  //the parallel renderer has no per layer datum transformations and uses millimeters as output units
+  if ( mMapRenderer->outputUnits() != QgsMapRenderer::Millimeters )
+  {
+    return false;
+  }
+  if ( mConfigParser && mMapRenderer->hasCrsTransformEnabled() )
+  {
+    QList< QPair< QString, QgsLayerCoordinateTransform > > lt = mConfigParser->layerCoordinateTransforms();
+    QList< QPair< QString, QgsLayerCoordinateTransform > >::const_iterator ltIt = lt.constBegin();
+    for ( ; ltIt != lt.constEnd(); ++ltIt )
+    {
+      if ( ltIt->second.srcDatumTransform != -1 || ltIt->second.destDatumTransform != -1 )
+      {
+        return false;
+      }
+    }
+  }
+
+  QgsMapSettings settings = mMapRenderer->mapSettings();
+  settings.setBackgroundColor( Qt::transparent );
+  settings.setFlags( QgsMapSettings::Antialiasing | QgsMapSettings::DrawLabeling | QgsMapSettings::UseAdvancedEffects );
+
+  QgsMapRendererParallelJob job( settings );
+  job.setTiledRenderingEnabled( true );
+  //QGIS_SERVER_MAX_THREADS limits the number of rendering threads per server process (default: number of cores)
+  job.setMaxThreads( QString( getenv( "QGIS_SERVER_MAX_THREADS" ) ).toInt() );
+  //use the label settings of the admin configuration instead of the (empty) current project
+  job.setLabelingEngineSettings( dynamic_cast<QgsPalLabeling*>( mMapRenderer->labelingEngine() ) );
+  job.start();
+  job.waitForFinished();
+
+  painter->drawImage( 0, 0, job.renderedImage() );
+  return true;
+}
+
 int QgsWMSServer::getFeatureInfo( QDomDocument& result, QString version )
 {
   if ( !mMapRenderer || !mConfigParser )
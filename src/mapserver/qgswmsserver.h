@@ -206,6 +206,10 @@ class QgsWMSServer
 
     void appendFormats( QDomDocument &doc, QDomElement &elem, const QStringList &formats );
 
+    /**Renders the map with QgsMapRendererParallelJob (layers and tiles of layers in several threads).
+      @return false if the map needs features of the legacy renderer (datum transformations, pixel units) and has not been rendered*/
+    bool renderParallel( QPainter* painter );
+
     /**Checks WIDTH/HEIGHT values agains MaxWidth and MaxHeight
       @return true if width/height values are okay*/
     bool checkMaximumWidthHeight() const;
@@ -0,0 +1,512 @@
+/***************************************************************************
+                              qgswmstilecache.cpp
+                              -------------------
+  begin                : May 2014
+  copyright            : (C) 2014 by the QGIS project
+  email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgswmstilecache.h"
+#include "qgscoordinatereferencesystem.h"
+#include "qgscrscache.h"
+#include "qgsdatasourceuri.h"
+#include "qgslogger.h"
+#include "qgsrectangle.h"
+#include "qgsscalecalculator.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QDomDocument>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QStringList>
+#include <QUrl>
+#include <math.h>
+
+//parameters which may be part of a cached request. Requests with other parameters (e.g. SLD, FILTER, SELECTION)
+//are rendered each time
+static const char* sCacheableParameters[] = { "SERVICE", "REQUEST", "VERSION", "MAP", "LAYERS", "STYLES", "CRS", "SRS",
+    "BBOX", "WIDTH", "HEIGHT", "FORMAT", "TRANSPARENT", "DPI", "OPACITIES", "EXCEPTIONS", 0
+                                            };
+
+//parses a comma separated list of numbers
+static bool parseNumbers( const QString& string, int count, double* numbers )
+{
+  QStringList parts = string.split( "," );
+  if ( parts.size() != count )
+  {
+    return false;
+  }
+  for ( int i = 0; i < count; ++i )
+  {
+    bool ok;
+    numbers[i] = parts.at( i ).toDouble( &ok );
+    if ( !ok )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//number of images written by a process between two purges of the cache directory
+static const int sPurgeInterval = 100;
+
+QgsWMSTileCache::QgsWMSTileCache( int maxMemoryKB, const QString& directory, int maxAgeSeconds, int maxDirectoryMB )
+    : mDirectory( directory )
+    , mMaxAge( qMax( 0, maxAgeSeconds ) )
+    , mMaxDirectorySize( qMax( 0, maxDirectoryMB ) * ( qint64 ) 1024 * 1024 )
+    , mWrittenImages( 0 )
+{
+  mMemoryCache.setMaxCost( qMax( 0, maxMemoryKB ) );
+  if ( !mDirectory.isEmpty() && !QDir().mkpath( mDirectory ) )
+  {
+    QgsDebugMsg( "Could not create tile cache directory " + mDirectory );
+    mDirectory.clear();
+  }
+  if ( !mDirectory.isEmpty() && ( mMaxAge > 0 || mMaxDirectorySize > 0 ) )
+  {
+    purgeDirectory();
+  }
+}
+
+QgsWMSTileCache::~QgsWMSTileCache()
+{
+}
+
+QString QgsWMSTileCache::cacheKey( const QString& configFilePath, const QMap<QString, QString>& parameters )
+{
+  QMap<QString, QString>::const_iterator paramIt = parameters.constBegin();
+  for ( ; paramIt != parameters.constEnd(); ++paramIt )
+  {
+    bool cacheable = false;
+    for ( int i = 0; sCacheableParameters[i]; ++i )
+    {
+      if ( paramIt.key() == sCacheableParameters[i] )
+      {
+        cacheable = true;
+        break;
+      }
+    }
+    if ( !cacheable && !paramIt.value().isEmpty() )
+    {
+      return QString();
+    }
+  }
+
+  QFileInfo configFileInfo( configFilePath );
+  bool widthOk, heightOk;
+  int width = parameters.value( "WIDTH" ).toInt( &widthOk );
+  int height = parameters.value( "HEIGHT" ).toInt( &heightOk );
+  double bbox[4];
+  if ( !configFileInfo.exists() || !widthOk || !heightOk || width <= 0 || height <= 0
+       || !parseNumbers( parameters.value( "BBOX" ), 4, bbox ) )
+  {
+    return QString();
+  }
+
+  //bounding boxes are compared with a precision of about 1/1000 pixel, so that tiles requested by clients
+  //are found even if the coordinates are written with a different number of decimals. The precision is
+  //snapped to a power of two, otherwise the last bits of the coordinates would change it. Its exponent
+  //is part of the key, as the same multiples of different precisions describe different boxes
+  double pixelPrecision = qMin( fabs( bbox[2] - bbox[0] ), fabs( bbox[3] - bbox[1] ) ) / qMax( width, height ) / 1000.0;
+  double precision = 0;
+  int exponent = 0;
+  if ( pixelPrecision > 0 )
+  {
+    frexp( pixelPrecision, &exponent );
+    precision = ldexp( 1.0, exponent - 1 );
+  }
+  QStringList bboxParts;
+  for ( int i = 0; i < 4; ++i )
+  {
+    bboxParts << ( precision > 0 ? QString::number( qRound64( bbox[i] / precision ) ) : QString::number( bbox[i], 'g', 17 ) );
+  }
+
+  //modification times of the project and its data files
+  QStringList modificationTimes;
+  modificationTimes << QString::number( configFileInfo.lastModified().toTime_t() );
+  foreach ( QString dataFile, dataSourceFiles( configFileInfo.absoluteFilePath() ) )
+  {
+    QFileInfo dataFileInfo( dataFile );
+    modificationTimes << ( dataFileInfo.exists() ? QString::number( dataFileInfo.lastModified().toTime_t() ) : "-" );
+  }
+
+  QStringList keyParts;
+  keyParts << configFileInfo.absoluteFilePath()
+  << modificationTimes.join( "," )
+  << parameters.value( "VERSION", "1.3.0" )
+  << parameters.value( "LAYERS" )
+  << parameters.value( "STYLES" )
+  << parameters.value( "CRS", parameters.value( "SRS" ) ).toUpper()
+  << bboxParts.join( "," )
+  << QString::number( exponent )
+  << QString::number( width ) << QString::number( height )
+  << parameters.value( "FORMAT" ).toLower()
+  << parameters.value( "TRANSPARENT" ).toLower()
+  << parameters.value( "DPI" )
+  << parameters.value( "OPACITIES" );
+  return keyParts.join( "|" );
+}
+
+QStringList QgsWMSTileCache::dataSourceFiles( const QString& configFilePath )
+{
+  //the list of a project is kept until the project file is modified
+  static QMap< QString, QPair<uint, QStringList> > sDataSourceFiles;
+
+  uint projectModified = QFileInfo( configFilePath ).lastModified().toTime_t();
+  QMap< QString, QPair<uint, QStringList> >::const_iterator cachedIt = sDataSourceFiles.find( configFilePath );
+  if ( cachedIt != sDataSourceFiles.constEnd() && cachedIt.value().first == projectModified )
+  {
+    return cachedIt.value().second;
+  }
+
+  QStringList files;
+  QFile projectFile( configFilePath );
+  QDomDocument projectDocument;
+  if ( !projectFile.open( QIODevice::ReadOnly ) || !projectDocument.setContent( &projectFile ) )
+  {
+    QgsDebugMsg( "Could not read the data sources of " + configFilePath );
+    return files;
+  }
+
+  //paths are resolved like QgsProjectParser::createLayerFromElement does
+  QDir projectDir = QFileInfo( configFilePath ).absoluteDir();
+  QDomNodeList dataSourceNodes = projectDocument.elementsByTagName( "datasource" );
+  for ( int i = 0; i < dataSourceNodes.size(); ++i )
+  {
+    QString uri = dataSourceNodes.at( i ).toElement().text();
+    QString path;
+    if ( uri.startsWith( "dbname" ) )
+    {
+      QgsDataSourceURI dsUri( uri );
+      if ( dsUri.host().isEmpty() )
+      {
+        path = dsUri.database();
+      }
+    }
+    else if ( uri.startsWith( "file:" ) )
+    {
+      path = QUrl::fromEncoded( uri.toAscii() ).toLocalFile();
+    }
+    else
+    {
+      //OGR sources may be followed by |layerid=... or |layername=...
+      path = uri.section( "|", 0, 0 );
+    }
+    if ( path.isEmpty() )
+    {
+      continue;
+    }
+
+    QFileInfo fileInfo( projectDir, path );
+    if ( !fileInfo.isFile() )
+    {
+      continue;
+    }
+    files << fileInfo.absoluteFilePath();
+    //the attributes of shapefiles are in a separate file
+    if ( fileInfo.suffix().compare( "shp", Qt::CaseInsensitive ) == 0 )
+    {
+      files << fileInfo.absolutePath() + QDir::separator() + fileInfo.completeBaseName() + ".dbf";
+    }
+  }
+  files.removeDuplicates();
+  files.sort();
+
+  sDataSourceFiles.insert( configFilePath, qMakePair( projectModified, files ) );
+  return files;
+}
+
+bool QgsWMSTileCache::isExpired( uint created ) const
+{
+  return mMaxAge > 0 && created + mMaxAge < QDateTime::currentDateTime().toTime_t();
+}
+
+QString QgsWMSTileCache::filePath( const QString& key ) const
+{
+  QString hash = QCryptographicHash::hash( key.toUtf8(), QCryptographicHash::Sha1 ).toHex();
+  return mDirectory + QDir::separator() + hash.left( 2 ) + QDir::separator() + hash + ".png";
+}
+
+QImage* QgsWMSTileCache::searchImage( const QString& key )
+{
+  CachedImage* cachedImage = mMemoryCache.object( key );
+  if ( cachedImage )
+  {
+    if ( !isExpired( cachedImage->created ) )
+    {
+      return new QImage( cachedImage->image );
+    }
+    mMemoryCache.remove( key );
+  }
+
+  if ( mDirectory.isEmpty() )
+  {
+    return 0;
+  }
+
+  QString path = filePath( key );
+  QFileInfo fileInfo( path );
+  if ( !fileInfo.exists() )
+  {
+    return 0;
+  }
+  uint created = fileInfo.lastModified().toTime_t();
+  if ( isExpired( created ) )
+  {
+    QFile::remove( path );
+    return 0;
+  }
+
+  QImage* image = new QImage();
+  if ( !image->load( path, "PNG" ) )
+  {
+    QgsDebugMsg( "Could not read cached image " + path );
+    delete image;
+    return 0;
+  }
+
+  if ( mMemoryCache.maxCost() > 0 )
+  {
+    cachedImage = new CachedImage;
+    cachedImage->image = *image;
+    cachedImage->created = created;
+    mMemoryCache.insert( key, cachedImage, image->byteCount() / 1024 );
+  }
+  return image;
+}
+
+bool QgsWMSTileCache::containsImage( const QString& key ) const
+{
+  CachedImage* cachedImage = mMemoryCache.object( key );
+  if ( cachedImage && !isExpired( cachedImage->created ) )
+  {
+    return true;
+  }
+  if ( mDirectory.isEmpty() )
+  {
+    return false;
+  }
+  QFileInfo fileInfo( filePath( key ) );
+  return fileInfo.exists() && !isExpired( fileInfo.lastModified().toTime_t() );
+}
+
+void QgsWMSTileCache::insertImage( const QString& key, const QImage& image )
+{
+  if ( mMemoryCache.maxCost() > 0 )
+  {
+    CachedImage* cachedImage = new CachedImage;
+    cachedImage->image = image;
+    cachedImage->created = QDateTime::currentDateTime().toTime_t();
+    mMemoryCache.insert( key, cachedImage, image.byteCount() / 1024 );
+  }
+
+  if ( mDirectory.isEmpty() )
+  {
+    return;
+  }
+
+  //other server processes may read the directory at the same time, so the image
+  //is written to a temporary file first and then renamed
+  QString path = filePath( key );
+  QDir().mkpath( QFileInfo( path ).absolutePath() );
+  QString tmpPath = path + QString( ".%1.tmp" ).arg( QCoreApplication::applicationPid() );
+  if ( !image.save( tmpPath, "PNG" ) )
+  {
+    QgsDebugMsg( "Could not write cached image " + tmpPath );
+    QFile::remove( tmpPath );
+    return;
+  }
+  //an expired file with the same name is replaced
+  QFile::remove( path );
+  if ( !QFile::rename( tmpPath, path ) )
+  {
+    //another process was faster
+    QFile::remove( tmpPath );
+  }
+
+  if (( mMaxAge > 0 || mMaxDirectorySize > 0 ) && ++mWrittenImages >= sPurgeInterval )
+  {
+    purgeDirectory();
+  }
+}
+
+void QgsWMSTileCache::purgeDirectory()
+{
+  mWrittenImages = 0;
+  if ( mDirectory.isEmpty() )
+  {
+    return;
+  }
+
+  //files of the other processes are purged as well. Files which have already been removed by another
+  //process are skipped. Temporary files are only removed when they are expired
+  QMultiMap<uint, QPair<QString, qint64> > filesByAge;
+  qint64 directorySize = 0;
+  QDirIterator it( mDirectory, QDir::Files, QDirIterator::Subdirectories );
+  while ( it.hasNext() )
+  {
+    QString path = it.next();
+    QFileInfo fileInfo = it.fileInfo();
+    uint modified = fileInfo.lastModified().toTime_t();
+    if ( isExpired( modified ) )
+    {
+      QFile::remove( path );
+      continue;
+    }
+    if ( fileInfo.suffix() == "png" )
+    {
+      filesByAge.insert( modified, qMakePair( path, fileInfo.size() ) );
+      directorySize += fileInfo.size();
+    }
+  }
+
+  if ( mMaxDirectorySize <= 0 || directorySize <= mMaxDirectorySize )
+  {
+    return;
+  }
+
+  //remove down to 90% of the maximum size, so that the directory is not purged again after a few images
+  qint64 targetSize = mMaxDirectorySize / 10 * 9;
+  QMultiMap<uint, QPair<QString, qint64> >::const_iterator fileIt = filesByAge.constBegin();
+  for ( ; fileIt != filesByAge.constEnd() && directorySize > targetSize; ++fileIt )
+  {
+    QFile::remove( fileIt.value().first );
+    directorySize -= fileIt.value().second;
+  }
+  QgsDebugMsg( QString( "Tile cache directory purged to %1 bytes" ).arg( directorySize ) );
+}
+
+QList< QMap<QString, QString> > QgsWMSTileCache::seedingRequests( const QMap<QString, QString>& parameters, QString& errorMessage )
+{
+  QList< QMap<QString, QString> > requests;
+
+  QStringList scaleList = parameters.value( "SCALES" ).split( ",", QString::SkipEmptyParts );
+  if ( scaleList.isEmpty() )
+  {
+    errorMessage = "The SCALES parameter is missing";
+    return requests;
+  }
+
+  QString crsString = parameters.value( "CRS", parameters.value( "SRS" ) );
+  QgsCoordinateReferenceSystem crs = QgsCRSCache::instance()->crsByAuthId( crsString );
+  if ( !crs.isValid() )
+  {
+    errorMessage = "Invalid CRS: " + crsString;
+    return requests;
+  }
+
+  double bbox[4];
+  if ( !parseNumbers( parameters.value( "BBOX" ), 4, bbox ) || bbox[2] <= bbox[0] || bbox[3] <= bbox[1] )
+  {
+    errorMessage = "Invalid BBOX parameter";
+    return requests;
+  }
+
+  double origin[2] = { bbox[0], bbox[1] };
+  if ( parameters.contains( "TILEORIGIN" ) && !parseNumbers( parameters.value( "TILEORIGIN" ), 2, origin ) )
+  {
+    errorMessage = "Invalid TILEORIGIN parameter";
+    return requests;
+  }
+
+  //work in x/y order, like QgsWMSServer does for WMS 1.3.0 with inverted axes
+  bool axisInverted = parameters.value( "VERSION", "1.3.0" ) != "1.1.1" && crs.axisInverted();
+  if ( axisInverted )
+  {
+    qSwap( bbox[0], bbox[1] );
+    qSwap( bbox[2], bbox[3] );
+    qSwap( origin[0], origin[1] );
+  }
+
+  int tileWidth = parameters.value( "WIDTH", "256" ).toInt();
+  int tileHeight = parameters.value( "HEIGHT", "256" ).toInt();
+  if ( tileWidth <= 0 || tileHeight <= 0 )
+  {
+    errorMessage = "Invalid tile size";
+    return requests;
+  }
+
+  //same dots per meter as the images created by QgsWMSServer
+  double dpi = 0.0254 / 0.00028;
+  if ( parameters.contains( "DPI" ) )
+  {
+    dpi = parameters.value( "DPI" ).toDouble();
+  }
+  QgsScaleCalculator scaleCalculator( dpi, crs.mapUnits() );
+
+  //scale of a tile covering one map unit in the middle of the area. The scale is proportional to the tile extent
+  double centerX = ( bbox[0] + bbox[2] ) / 2.0;
+  double centerY = ( bbox[1] + bbox[3] ) / 2.0;
+  double unitScale = scaleCalculator.calculate( QgsRectangle( centerX - 0.5, centerY - 0.5, centerX + 0.5, centerY + 0.5 ), tileWidth );
+  if ( unitScale <= 0 )
+  {
+    errorMessage = "Could not calculate the tile extents";
+    return requests;
+  }
+
+  QMap<QString, QString> tileParameters( parameters );
+  tileParameters.remove( "SCALES" );
+  tileParameters.remove( "TILEORIGIN" );
+  tileParameters.insert( "SERVICE", "WMS" );
+  tileParameters.insert( "REQUEST", "GetMap" );
+  tileParameters.insert( "WIDTH", QString::number( tileWidth ) );
+  tileParameters.insert( "HEIGHT", QString::number( tileHeight ) );
+
+  foreach ( QString scaleString, scaleList )
+  {
+    bool ok;
+    double scale = scaleString.toDouble( &ok );
+    if ( !ok || scale <= 0 )
+    {
+      errorMessage = "Invalid scale: " + scaleString;
+      requests.clear();
+      return requests;
+    }
+
+    double tileExtentX = scale / unitScale;
+    double tileExtentY = tileExtentX * tileHeight / tileWidth;
+    int firstColumn = floor(( bbox[0] - origin[0] ) / tileExtentX );
+    int lastColumn = ceil(( bbox[2] - origin[0] ) / tileExtentX ) - 1;
+    int firstRow = floor(( bbox[1] - origin[1] ) / tileExtentY );
+    int lastRow = ceil(( bbox[3] - origin[1] ) / tileExtentY ) - 1;
+
+    for ( int row = firstRow; row <= lastRow; ++row )
+    {
+      for ( int column = firstColumn; column <= lastColumn; ++column )
+      {
+        double xMin = origin[0] + column * tileExtentX;
+        double yMin = origin[1] + row * tileExtentY;
+        double tile[4] = { xMin, yMin, xMin + tileExtentX, yMin + tileExtentY };
+        if ( axisInverted )
+        {
+          qSwap( tile[0], tile[1] );
+          qSwap( tile[2], tile[3] );
+        }
+
+        QStringList tileBBox;
+        for ( int i = 0; i < 4; ++i )
+        {
+          tileBBox << QString::number( tile[i], 'g', 17 );
+        }
+        tileParameters.insert( "BBOX", tileBBox.join( "," ) );
+        requests.append( tileParameters );
+      }
+    }
+  }
+
+  return requests;
+}
@@ -0,0 +1,93 @@
+/***************************************************************************
+                              qgswmstilecache.h
+                              -----------------
+  begin                : May 2014
+  copyright            : (C) 2014 by the QGIS project
+  email                :
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSWMSTILECACHE_H
+#define QGSWMSTILECACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+/**A cache for rendered GetMap images. Images are kept in memory and optionally written to a directory
+  which is shared by all server processes. Only requests whose result depends on nothing else than the project,
+  layers, styles, CRS, bounding box, image size, format and opacities are cached. Entries of a project
+  are not used any more once the project file or one of its file based data sources is modified.
+  Changes of other data sources (e.g. databases) are only noticed after the maximum age of the entries*/
+class QgsWMSTileCache
+{
+  public:
+    /**Constructor
+      @param maxMemoryKB maximum size of the images kept in memory (in kilobytes), 0 disables the memory cache
+      @param directory directory for the cached images, an empty string disables the disk cache
+      @param maxAgeSeconds entries older than this are rendered again, 0 keeps them until the project changes
+      @param maxDirectoryMB the oldest files are removed from the directory when it becomes larger, 0 for no limit*/
+    QgsWMSTileCache( int maxMemoryKB, const QString& directory, int maxAgeSeconds = 0, int maxDirectoryMB = 0 );
+    ~QgsWMSTileCache();
+
+    /**False if neither memory nor disk cache are enabled*/
+    bool isEnabled() const { return mMemoryCache.maxCost() > 0 || !mDirectory.isEmpty(); }
+    QString directory() const { return mDirectory; }
+
+    /**Returns the cache key of a GetMap request or an empty string if the request cannot be cached*/
+    static QString cacheKey( const QString& configFilePath, const QMap<QString, QString>& parameters );
+
+    /**Returns a copy of the cached image (or 0 if the image is not in the cache). The caller takes ownership*/
+    QImage* searchImage( const QString& key );
+    /**True if an image is in the cache, without loading it from disk*/
+    bool containsImage( const QString& key ) const;
+    /**Inserts an image into the cache (creates a copy of the image)*/
+    void insertImage( const QString& key, const QImage& image );
+
+    /**Creates the GetMap requests rendering a tile matrix for pre-seeding the cache.
+      Besides the usual GetMap parameters the seeding request contains SCALES (comma separated list of scale
+      denominators) and optionally TILEORIGIN (x,y in the axis order of BBOX, default is the lower left corner
+      of BBOX). BBOX is the area to seed and WIDTH / HEIGHT the size of the tiles (default 256 pixels)
+      @param parameters parameters of the seeding request
+      @param errorMessage receives the reason if no requests could be created
+      @return parameters of the GetMap request of each tile*/
+    static QList< QMap<QString, QString> > seedingRequests( const QMap<QString, QString>& parameters, QString& errorMessage );
+
+    /**Removes expired files and, if the directory is larger than the maximum size, the oldest files from the
+      cache directory. Called regularly by insertImage()*/
+    void purgeDirectory();
+
+  private:
+    struct CachedImage
+    {
+      QImage image;
+      uint created;
+    };
+
+    /**Path of the cache file of an entry*/
+    QString filePath( const QString& key ) const;
+    /**True if an entry created at that time (seconds since the epoch) is too old to be used*/
+    bool isExpired( uint created ) const;
+    /**Files read by the data sources of the layers of a project*/
+    static QStringList dataSourceFiles( const QString& configFilePath );
+
+    QCache< QString, CachedImage > mMemoryCache;
+    QString mDirectory;
+    int mMaxAge;
+    qint64 mMaxDirectorySize;
+    /**Number of images written since the last purge*/
+    int mWrittenImages;
+};
+
+#endif // QGSWMSTILECACHE_H
@@ -122,11 +122,11 @@ void QgsInterpolationDialog::on_buttonBox_accepted()
     return;
   }
 
-  //add .asc suffix if the user did not provider it already
+  //add .tif suffix if the user did not provider it already. Files ending with .asc are written as ascii grid
   QString suffix = theFileInfo.suffix();
   if ( suffix.isEmpty() )
   {
-    fileName.append( ".asc" );
+    fileName.append( ".tif" );
   }
 
   int nLayers = mLayersTreeWidget->topLevelItemCount();
@@ -308,7 +308,8 @@ void QgsInterpolationDialog::on_mOutputFileButton_clicked()
   QSettings s;
   QString lastOutputDir = s.value( "/Interpolation/lastOutputDir", "" ).toString();
 
-  QString rasterFileName = QFileDialog::getSaveFileName( 0, tr( "Save interpolated raster as..." ), lastOutputDir );
+  QString rasterFileName = QFileDialog::getSaveFileName( 0, tr( "Save interpolated raster as..." ), lastOutputDir,
+                           tr( "GeoTIFF" ) + " (*.tif *.tiff);;" + tr( "ESRI ASCII grid" ) + " (*.asc)" );
   if ( !rasterFileName.isEmpty() )
   {
     mOutputFileLineEdit->setText( rasterFileName );
@@ -324,7 +325,8 @@ void QgsInterpolationDialog::on_mOutputFileButton_clicked()
 
 void QgsInterpolationDialog::on_mOutputFileLineEdit_textChanged()
 {
-  if ( mOutputFileLineEdit->text().endsWith( ".asc" ) )
+  QString fileName = mOutputFileLineEdit->text();
+  if ( fileName.endsWith( ".asc", Qt::CaseInsensitive ) || fileName.endsWith( ".tif", Qt::CaseInsensitive ) || fileName.endsWith( ".tiff", Qt::CaseInsensitive ) )
   {
     enableOrDisableOkButton();
   }
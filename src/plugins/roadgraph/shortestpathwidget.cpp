@@ -15,6 +15,9 @@
  * \brief implemetation UI for find shotest path
  */
 
+// C++ standard includes
+#include <limits>
+
 //qt includes
 #include <qcombobox.h>
 #include <qlayout.h>
@@ -42,7 +45,7 @@
 #include <qgsgraphdirector.h>
 #include <qgsgraphbuilder.h>
 #include <qgsgraph.h>
-#include <qgsgraphanalyzer.h>
+#include <qgsgraphrouter.h>
 
 // roadgraph plugin includes
 #include "roadgraphplugin.h"
@@ -299,15 +302,31 @@ QgsGraph* RgShortestPathWidget::getPath( QgsPoint& p1, QgsPoint& p2 )
   }
 
 
-  QgsGraph* shortestpathTree = QgsGraphAnalyzer::shortestTree( graph, startVertexIdx, criterionNum );
-  delete graph;
+  int stopVertexIdx = graph->findVertex( p2 );
 
-  if ( shortestpathTree->findVertex( p2 ) == -1 )
+  // A* only visits the part of the graph between the two points
+  QgsGraphRouter router( graph, criterionNum );
+  QVector<int> pathArcs;
+  if ( stopVertexIdx == -1 || router.shortestPath( startVertexIdx, stopVertexIdx, &pathArcs ) == std::numeric_limits<double>::infinity() )
   {
+    delete graph;
     QMessageBox::critical( this, tr( "Path not found" ), tr( "Path not found" ) );
     return NULL;
   }
-  return shortestpathTree;
+
+  // the path as a graph, like the shortest path tree it replaces
+  QgsGraph* shortestpath = new QgsGraph();
+  int prevVertexIdx = shortestpath->addVertex( graph->vertex( startVertexIdx ).point() );
+  foreach ( int arcIdx, pathArcs )
+  {
+    const QgsGraphArc& arc = graph->arc( arcIdx );
+    int vertexIdx = shortestpath->addVertex( graph->vertex( arc.inVertex() ).point() );
+    shortestpath->addArc( prevVertexIdx, vertexIdx, arc.properties() );
+    prevVertexIdx = vertexIdx;
+  }
+  delete graph;
+
+  return shortestpath;
 }
 
 void RgShortestPathWidget::findingPath()
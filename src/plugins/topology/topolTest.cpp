@@ -18,6 +18,7 @@
 #include "topolTest.h"
 
 #include <qgsvectorlayer.h>
+#include <qgsvectordataprovider.h>
 #include <qgsmaplayer.h>
 #include <qgsmapcanvas.h>
 #include <qgsgeometry.h>
@@ -26,6 +27,7 @@
 #include <qgisinterface.h>
 #include <qgslogger.h>
 #include <qgsmessagelog.h>
+#include <QFile>
 #include <cmath>
 #include <set>
 #include <map>
@@ -1626,44 +1628,123 @@ void topolTest::fillFeatureList( QgsVectorLayer* layer, QgsRectangle extent )
 
 }
 
-QgsSpatialIndex* topolTest::createIndex( QgsVectorLayer* layer, QgsRectangle extent )
+/**
+ * Reads the features of the second layer into the feature map while the spatial index
+ * is bulk loaded from them, so that the layer is only read once
+ */
+class TopolIndexFeatureIterator : public QgsAbstractFeatureIterator
 {
-  QgsSpatialIndex* index = new QgsSpatialIndex();
+  public:
+    TopolIndexFeatureIterator( topolTest* test, QgsVectorLayer* layer, const QgsFeatureRequest& request )
+        : QgsAbstractFeatureIterator( QgsFeatureRequest() )
+        , mTest( test )
+        , mLayer( layer )
+        , mSource( layer->getFeatures( request ) )
+        , mCount( 0 )
+        , mCancelled( false )
+    {
+    }
 
-  QgsFeatureIterator fit;
+    ~TopolIndexFeatureIterator()
+    {
+      close();
+    }
+
+    bool rewind()
+    {
+      return false;
+    }
+
+    bool close()
+    {
+      mClosed = true;
+      return mSource.close();
+    }
+
+    bool isCancelled() const
+    {
+      return mCancelled;
+    }
+
+  protected:
+    bool fetchFeature( QgsFeature& f )
+    {
+      if ( mClosed || mCancelled )
+        return false;
+
+      while ( mSource.nextFeature( f ) )
+      {
+        if ( !( ++mCount % 100 ) )
+          emit mTest->progress( mCount );
+
+        if ( mTest->testCancelled() )
+        {
+          mCancelled = true;
+          return false;
+        }
+
+        if ( f.geometry() )
+        {
+          mTest->mFeatureMap2[f.id()] = FeatureLayer( mLayer, f );
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    topolTest* mTest;
+    QgsVectorLayer* mLayer;
+    QgsFeatureIterator mSource;
+    int mCount;
+    bool mCancelled;
+};
+
+QgsSpatialIndex* topolTest::createIndex( QgsVectorLayer* layer, QgsRectangle extent )
+{
+  QgsFeatureRequest request;
   if ( extent.isEmpty() )
   {
-    fit = layer->getFeatures( QgsFeatureRequest().setSubsetOfAttributes( QgsAttributeList() ) );
+    request.setSubsetOfAttributes( QgsAttributeList() );
   }
   else
   {
-    fit = layer->getFeatures( QgsFeatureRequest()
-                              .setFilterRect( extent )
-                              .setFlags( QgsFeatureRequest::ExactIntersect )
-                              .setSubsetOfAttributes( QgsAttributeList() ) );
+    request.setFilterRect( extent )
+    .setFlags( QgsFeatureRequest::ExactIntersect )
+    .setSubsetOfAttributes( QgsAttributeList() );
   }
 
+  TopolIndexFeatureIterator* collector = new TopolIndexFeatureIterator( this, layer, request );
+  QgsFeatureIterator fit( collector );
 
-  int i = 0;
-  QgsFeature f;
-  while ( fit.nextFeature( f ) )
+  // bulk loading is much faster than inserting the features one by one,
+  // the index of a whole unedited file is reused from the previous run
+  QgsSpatialIndex* index;
+  bool reusable = extent.isEmpty() && !layer->isEditable() && layer->subsetString().isEmpty();
+  if ( reusable )
   {
-    if ( !( ++i % 100 ) )
-      emit progress( i );
+    index = new QgsSpatialIndex( QgsSpatialIndex::fromDataSource( layer->dataProvider()->dataSourceUri(), fit ) );
+  }
+  else
+  {
+    index = new QgsSpatialIndex( fit );
+  }
 
-    if ( testCancelled() )
-    {
-      delete index;
-      return 0;
-    }
+  // a reused index does not read the features, the map still needs them
+  QgsFeature f;
+  while ( fit.nextFeature( f ) )
+    ;
 
-    if ( f.geometry() )
+  if ( collector->isCancelled() )
+  {
+    // the saved index may be incomplete
+    if ( reusable )
     {
-      index->insertFeature( f );
-      mFeatureMap2[f.id()] = FeatureLayer( layer, f );
+      QFile::remove( QgsSpatialIndex::indexFileName( layer->dataProvider()->dataSourceUri() ) );
     }
+    delete index;
+    return 0;
   }
-
   return index;
 }
 
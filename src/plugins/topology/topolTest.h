@@ -246,6 +246,8 @@ class topolTest: public QObject
     void setTestCancelled();
 
   private:
+    friend class TopolIndexFeatureIterator;
+
     QMap<QString, QgsSpatialIndex*> mLayerIndexes;
     QMap<QString, TopologyRule> mTopologyRuleMap;
 
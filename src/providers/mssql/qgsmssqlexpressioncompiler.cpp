@@ -0,0 +1,56 @@
+/***************************************************************************
+    qgsmssqlexpressioncompiler.cpp
+    ---------------------
+    begin                : May 2014
+    copyright            : (C) 2014 by the QGIS project
+    email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsmssqlexpressioncompiler.h"
+
+QgsMssqlExpressionCompiler::QgsMssqlExpressionCompiler( const QgsFields& fields )
+    // string comparisons follow the collation of the column
+    : QgsSqlExpressionCompiler( fields, LooseStringEquality )
+{
+}
+
+QString QgsMssqlExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  QString quoted = identifier;
+  quoted.replace( "]", "]]" );
+  return quoted.prepend( "[" ).append( "]" );
+}
+
+QString QgsMssqlExpressionCompiler::quotedValue( const QVariant& value )
+{
+  if ( value.type() == QVariant::String )
+  {
+    QString v = value.toString();
+    v.replace( "'", "''" );
+    return v.prepend( "N'" ).append( "'" );
+  }
+
+  return QgsSqlExpressionCompiler::quotedValue( value );
+}
+
+QgsSqlExpressionCompiler::Result QgsMssqlExpressionCompiler::compileLike( const QString& value, const QString& pattern, bool caseInsensitive, QString& result )
+{
+  // [] is a character class in T-SQL patterns
+  if ( pattern.contains( '[' ) )
+    return Fail;
+
+  if ( caseInsensitive )
+    result = QString( "LOWER(%1) LIKE LOWER(%2)" ).arg( value, quotedValue( pattern ) );
+  else
+    result = QString( "%1 LIKE %2" ).arg( value, quotedValue( pattern ) );
+
+  // the collation may ignore case or accents - the result is a superset
+  return Partial;
+}
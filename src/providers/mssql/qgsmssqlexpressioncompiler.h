@@ -0,0 +1,33 @@
+/***************************************************************************
+    qgsmssqlexpressioncompiler.h
+    ---------------------
+    begin                : May 2014
+    copyright            : (C) 2014 by the QGIS project
+    email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSMSSQLEXPRESSIONCOMPILER_H
+#define QGSMSSQLEXPRESSIONCOMPILER_H
+
+#include "qgssqlexpressioncompiler.h"
+
+/** Translates filter expressions to Transact-SQL */
+class QgsMssqlExpressionCompiler : public QgsSqlExpressionCompiler
+{
+  public:
+    explicit QgsMssqlExpressionCompiler( const QgsFields& fields );
+
+  protected:
+    virtual QString quotedIdentifier( const QString& identifier );
+    virtual QString quotedValue( const QVariant& value );
+    virtual Result compileLike( const QString& value, const QString& pattern, bool caseInsensitive, QString& result );
+};
+
+#endif // QGSMSSQLEXPRESSIONCOMPILER_H
@@ -17,6 +17,7 @@
 
 #include "qgsmssqlfeatureiterator.h"
 #include "qgsmssqlprovider.h"
+#include "qgsmssqlexpressioncompiler.h"
 #include "qgslogger.h"
 
 #include <QObject>
@@ -28,6 +29,7 @@ QgsMssqlFeatureIterator::QgsMssqlFeatureIterator( QgsMssqlFeatureSource* source,
 {
   mClosed = false;
   mQuery = NULL;
+  mExpressionCompiled = false;
 
   mParser.IsGeography = mSource->mIsGeography;
 
@@ -154,6 +156,22 @@ void QgsMssqlFeatureIterator::BuildStatement( const QgsFeatureRequest& request )
     filterAdded = true;
   }
 
+  // set attribute filter
+  if ( request.filterType() == QgsFeatureRequest::FilterExpression )
+  {
+    QgsMssqlExpressionCompiler compiler( mSource->mFields );
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+    {
+      if ( !filterAdded )
+        mStatement += " where (" + compiler.result() + ")";
+      else
+        mStatement += " and (" + compiler.result() + ")";
+      filterAdded = true;
+      mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+    }
+  }
+
   if ( !mSource->mSqlWhereClause.isEmpty() )
   {
     if ( !filterAdded )
@@ -170,6 +188,16 @@ void QgsMssqlFeatureIterator::BuildStatement( const QgsFeatureRequest& request )
 }
 
 
+bool QgsMssqlFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  // the database already did the filtering
+  if ( mExpressionCompiled )
+    return fetchFeature( f );
+
+  return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+}
+
+
 bool QgsMssqlFeatureIterator::fetchFeature( QgsFeature& feature )
 {
   feature.setValid( false );
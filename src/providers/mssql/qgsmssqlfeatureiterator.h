@@ -88,6 +88,9 @@ class QgsMssqlFeatureIterator : public QgsAbstractFeatureIteratorFromSource<QgsM
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! fetch next feature matching the filter expression - uses SQL filter if possible
+    virtual bool nextFeatureFilterExpression( QgsFeature& f );
+
     // The current database
     QSqlDatabase mDatabase;
 
@@ -109,6 +112,9 @@ class QgsMssqlFeatureIterator : public QgsAbstractFeatureIteratorFromSource<QgsM
     // List of attribute indices to fetch with nextFeature calls
     QgsAttributeList mAttributesToFetch;
 
+    // Set to true, if the filter expression was translated to SQL completely
+    bool mExpressionCompiled;
+
     // for parsing sql geometries
     QgsMssqlGeometryParser mParser;
 };
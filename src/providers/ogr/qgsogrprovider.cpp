@@ -526,6 +526,56 @@ bool QgsOgrProvider::setSubsetString( QString theSQL, bool updateFeatureCount )
   return true;
 }
 
+void QgsOgrProvider::reloadData()
+{
+  if ( !ogrDataSource )
+  {
+    return;
+  }
+
+  if ( ogrLayer != ogrOrigLayer )
+  {
+    OGR_DS_ReleaseResultSet( ogrDataSource, ogrLayer );
+  }
+  OGR_DS_Destroy( ogrDataSource );
+  ogrLayer = ogrOrigLayer = 0;
+
+  // zipped data sources are read-only (see constructor)
+  bool openReadOnly = !QgsZipItem::vsiPrefix( mFilePath ).isEmpty();
+  ogrDataSource = openReadOnly ? 0 : OGROpen( TO8F( mFilePath ), true, NULL );
+  if ( !ogrDataSource )
+  {
+    ogrDataSource = OGROpen( TO8F( mFilePath ), false, NULL );
+  }
+  if ( !ogrDataSource )
+  {
+    QgsMessageLog::logMessage( tr( "Data source could not be reopened (%1)" ).arg( QString::fromUtf8( CPLGetLastErrorMsg() ) ), tr( "OGR" ) );
+    valid = false;
+    return;
+  }
+
+  if ( mLayerName.isNull() )
+  {
+    ogrOrigLayer = OGR_DS_GetLayer( ogrDataSource, mLayerIndex );
+  }
+  else
+  {
+    ogrOrigLayer = OGR_DS_GetLayerByName( ogrDataSource, TO8( mLayerName ) );
+  }
+  ogrLayer = ogrOrigLayer;
+
+  if ( ogrLayer && !mSubsetString.isEmpty() )
+  {
+    ogrLayer = setSubsetString( ogrOrigLayer, ogrDataSource );
+  }
+  if ( !ogrLayer )
+  {
+    QgsMessageLog::logMessage( tr( "Layer could not be reopened (%1)" ).arg( QString::fromUtf8( CPLGetLastErrorMsg() ) ), tr( "OGR" ) );
+    ogrLayer = ogrOrigLayer;
+    valid = false;
+  }
+}
+
 QString QgsOgrProvider::subsetString()
 {
   return mSubsetString;
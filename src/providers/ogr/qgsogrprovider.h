@@ -99,6 +99,10 @@ class QgsOgrProvider : public QgsVectorDataProvider
     /** mutator for sql where clause used to limit dataset size */
     virtual bool setSubsetString( QString theSQL, bool updateFeatureCount = true );
 
+    /** Reopens the data source. Used by forked server processes, which must not share
+     *  file handles (and file offsets) with their parent process */
+    virtual void reloadData();
+
     /**
      * Get feature type.
      * @return int representing the feature type
@@ -0,0 +1,36 @@
+/***************************************************************************
+    qgsoracleexpressioncompiler.cpp
+    ---------------------
+    begin                : May 2014
+    copyright            : (C) 2014 by the QGIS project
+    email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsoracleexpressioncompiler.h"
+#include "qgsoracleconn.h"
+
+QgsOracleExpressionCompiler::QgsOracleExpressionCompiler( const QgsFields& fields )
+    : QgsSqlExpressionCompiler( fields )
+{
+}
+
+QString QgsOracleExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  return QgsOracleConn::quotedIdentifier( identifier );
+}
+
+QString QgsOracleExpressionCompiler::quotedValue( const QVariant& value )
+{
+  // keep full precision of doubles
+  if ( value.type() == QVariant::Double )
+    return QgsSqlExpressionCompiler::quotedValue( value );
+
+  return QgsOracleConn::quotedValue( value );
+}
@@ -0,0 +1,32 @@
+/***************************************************************************
+    qgsoracleexpressioncompiler.h
+    ---------------------
+    begin                : May 2014
+    copyright            : (C) 2014 by the QGIS project
+    email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSORACLEEXPRESSIONCOMPILER_H
+#define QGSORACLEEXPRESSIONCOMPILER_H
+
+#include "qgssqlexpressioncompiler.h"
+
+/** Translates filter expressions to Oracle SQL */
+class QgsOracleExpressionCompiler : public QgsSqlExpressionCompiler
+{
+  public:
+    explicit QgsOracleExpressionCompiler( const QgsFields& fields );
+
+  protected:
+    virtual QString quotedIdentifier( const QString& identifier );
+    virtual QString quotedValue( const QVariant& value );
+};
+
+#endif // QGSORACLEEXPRESSIONCOMPILER_H
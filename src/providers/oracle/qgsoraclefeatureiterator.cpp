@@ -15,6 +15,7 @@
 
 #include "qgsoraclefeatureiterator.h"
 #include "qgsoracleprovider.h"
+#include "qgsoracleexpressioncompiler.h"
 
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
@@ -25,6 +26,7 @@
 QgsOracleFeatureIterator::QgsOracleFeatureIterator( QgsOracleFeatureSource* source, bool ownSource, const QgsFeatureRequest &request )
     : QgsAbstractFeatureIteratorFromSource( source, ownSource, request )
     , mRewind( false )
+    , mExpressionCompiled( false )
 {
   mConnection = QgsOracleConn::connectDb( mSource->mUri.connectionInfo() );
   if ( !mConnection )
@@ -49,7 +51,16 @@ QgsOracleFeatureIterator::QgsOracleFeatureIterator( QgsOracleFeatureSource* sour
   switch ( request.filterType() )
   {
     case QgsFeatureRequest::FilterExpression:
-      break;
+    {
+      QgsOracleExpressionCompiler compiler( mSource->mFields );
+      QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+      if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+      {
+        whereClause = compiler.result();
+        mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+      }
+    }
+    break;
 
     case QgsFeatureRequest::FilterRect:
       if ( !mSource->mGeometryColumn.isNull() )
@@ -240,6 +251,15 @@ bool QgsOracleFeatureIterator::fetchFeature( QgsFeature& feature )
   }
 }
 
+bool QgsOracleFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  // the database already did the filtering
+  if ( mExpressionCompiled )
+    return fetchFeature( f );
+
+  return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+}
+
 bool QgsOracleFeatureIterator::rewind()
 {
   if ( !mQry.isActive() )
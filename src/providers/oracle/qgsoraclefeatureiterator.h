@@ -72,11 +72,16 @@ class QgsOracleFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Qgs
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! fetch next feature matching the filter expression - uses SQL filter if possible
+    virtual bool nextFeatureFilterExpression( QgsFeature& f );
+
     bool openQuery( QString whereClause );
 
     QgsOracleConn *mConnection;
     QSqlQuery mQry;
     bool mRewind;
+    //! Set to true, if the filter expression was translated to SQL completely
+    bool mExpressionCompiled;
     QgsAttributeList mAttributeList;
 };
 
@@ -24,9 +24,12 @@
 #include "qgspgtablemodel.h"
 
 #include <QApplication>
+#include <QDate>
 #include <QSettings>
 #include <QThread>
 
+#include <algorithm>
+#include <cfloat>
 #include <climits>
 
 // for htonl
@@ -856,6 +859,13 @@ bool QgsPostgresConn::closeCursor( QString cursorName )
   return true;
 }
 
+bool QgsPostgresConn::rollbackCursors()
+{
+  QgsDebugMsg( "Rolling back read-only transaction" );
+  mOpenCursors = 0;
+  return PQexecNR( "ROLLBACK" );
+}
+
 QString QgsPostgresConn::uniqueCursorName()
 {
   return QString( "qgis_%1" ).arg( ++mNextCursorId );
@@ -1082,6 +1092,199 @@ QString QgsPostgresConn::fieldExpression( const QgsField &fld )
   }
 }
 
+QgsPostgresBinaryType QgsPostgresConn::binaryType( const QgsField &fld )
+{
+  const QString &type = fld.typeName();
+  if ( type == "int2" )
+    return pbtInt2;
+  else if ( type == "int4" )
+    return pbtInt4;
+  else if ( type == "int8" )
+    return pbtInt8;
+  else if ( type == "float4" )
+    return pbtFloat4;
+  else if ( type == "float8" )
+    return pbtFloat8;
+  else if ( type == "numeric" )
+    return pbtNumeric;
+  else if ( type == "bool" )
+    return pbtBool;
+  else if ( type == "date" )
+    return pbtDate;
+  else if ( type == "timestamp" )
+  {
+    // timestamps are returned as text in the ISO format of the server,
+    // which is only reproduced for servers storing them as integers
+    Q_ASSERT( mConn );
+    const char *integerDatetimes = ::PQparameterStatus( mConn, "integer_datetimes" );
+    const char *dateStyle = ::PQparameterStatus( mConn, "DateStyle" );
+    if ( integerDatetimes && qstrcmp( integerDatetimes, "on" ) == 0 &&
+         dateStyle && qstrncmp( dateStyle, "ISO", 3 ) == 0 )
+      return pbtTimestamp;
+  }
+
+  return pbtText;
+}
+
+// read a number in the byte order of the server
+template<class T> static T binaryValue( const char *p, bool swapEndian )
+{
+  T v;
+  memcpy( &v, p, sizeof( T ) );
+  if ( swapEndian )
+  {
+    char *b = reinterpret_cast<char *>( &v );
+    std::reverse( b, b + sizeof( T ) );
+  }
+  return v;
+}
+
+// proleptic gregorian date of a day relative to 2000-01-01 (the epoch of PostgreSQL)
+static void dateFromPostgresDay( qint64 day, int &year, int &month, int &dayOfMonth )
+{
+  qint64 z = day + 10957 + 719468; // days since 0000-03-01
+  qint64 era = ( z >= 0 ? z : z - 146096 ) / 146097;
+  qint64 dayOfEra = z - era * 146097;
+  qint64 yearOfEra = ( dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096 ) / 365;
+  qint64 dayOfYear = dayOfEra - ( 365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100 );
+  qint64 mp = ( 5 * dayOfYear + 2 ) / 153;
+  dayOfMonth = dayOfYear - ( 153 * mp + 2 ) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = yearOfEra + era * 400 + ( month <= 2 ? 1 : 0 );
+}
+
+QVariant QgsPostgresConn::getBinaryValue( QgsPostgresResult &queryResult, int row, int col, QgsPostgresBinaryType type, QVariant::Type fieldType )
+{
+  if ( queryResult.PQgetisnull( row, col ) )
+    return QVariant( fieldType );
+
+  const char *p = ::PQgetvalue( queryResult.result(), row, col );
+  int length = ::PQgetlength( queryResult.result(), row, col );
+
+  switch ( type )
+  {
+    case pbtInt2:
+      return QVariant(( int ) binaryValue<qint16>( p, mSwapEndian ) );
+
+    case pbtInt4:
+      return QVariant( binaryValue<qint32>( p, mSwapEndian ) );
+
+    case pbtInt8:
+      return QVariant(( qlonglong ) binaryValue<qint64>( p, mSwapEndian ) );
+
+    case pbtFloat4:
+    {
+      // the text representation has FLT_DIG significant digits, e.g. 0.1 instead of 0.100000001490116
+      float f = binaryValue<float>( p, mSwapEndian );
+      if ( !qIsFinite( f ) )
+        return QVariant(( double ) f );
+      // QString::number does not depend on LC_NUMERIC, unlike qsnprintf
+      return QVariant( QString::number( f, 'g', FLT_DIG ).toDouble() );
+    }
+
+    case pbtFloat8:
+      return QVariant( binaryValue<double>( p, mSwapEndian ) );
+
+    case pbtNumeric:
+    {
+      // ndigits, weight, sign, dscale and the digits in base 10000
+      int nDigits = binaryValue<qint16>( p, mSwapEndian );
+      int weight = binaryValue<qint16>( p + 2, mSwapEndian );
+      quint16 sign = binaryValue<quint16>( p + 4, mSwapEndian );
+      if (( sign != 0x0000 && sign != 0x4000 ) || length < 8 + 2 * nDigits )
+      {
+        // NaN and infinities are converted from their text representation like the text values.
+        // Values with other signs cannot be decoded
+        QString text;
+        if ( sign == 0xC000 )
+          text = "NaN";
+        else if ( sign == 0xD000 )
+          text = "Infinity";
+        else if ( sign == 0xF000 )
+          text = "-Infinity";
+        else
+          QgsDebugMsg( QString( "unknown numeric sign 0x%1" ).arg( sign, 4, 16, QChar( '0' ) ) );
+
+        QVariant v( text );
+        if ( text.isEmpty() || !v.convert( fieldType ) )
+          v = QVariant( fieldType );
+        return v;
+      }
+
+      // parsed from decimal digits, so that the result is rounded like the text representation
+      QByteArray number = sign == 0x4000 ? "-0." : "0.";
+      char group[8];
+      for ( int i = 0; i < nDigits; ++i )
+      {
+        qsnprintf( group, sizeof( group ), "%04d", ( int ) binaryValue<qint16>( p + 8 + 2 * i, mSwapEndian ) );
+        number += group;
+      }
+      number += "e" + QByteArray::number( 4 * ( weight + 1 ) );
+      return QVariant( nDigits == 0 ? 0.0 : number.toDouble() );
+    }
+
+    case pbtBool:
+      return QVariant( QString( *p ? "t" : "f" ) );
+
+    case pbtDate:
+    {
+      qint32 day = binaryValue<qint32>( p, mSwapEndian );
+      int year, month, dayOfMonth;
+      dateFromPostgresDay( day, year, month, dayOfMonth );
+      // infinite dates, dates BC and years beyond 9999 are not valid ISO dates
+      if ( day == INT_MAX || day == INT_MIN || year < 1 || year > 9999 )
+        return QVariant( fieldType );
+      return QVariant( QDate( year, month, dayOfMonth ) );
+    }
+
+    case pbtTimestamp:
+    {
+      qint64 usecs = binaryValue<qint64>( p, mSwapEndian );
+      if ( usecs == Q_INT64_C( 0x7FFFFFFFFFFFFFFF ) )
+        return QVariant( QString( "infinity" ) );
+      if ( usecs == -Q_INT64_C( 0x7FFFFFFFFFFFFFFF ) - 1 )
+        return QVariant( QString( "-infinity" ) );
+
+      const qint64 usecsPerDay = Q_INT64_C( 86400000000 );
+      qint64 day = usecs / usecsPerDay;
+      qint64 time = usecs % usecsPerDay;
+      if ( time < 0 )
+      {
+        time += usecsPerDay;
+        day--;
+      }
+
+      int year, month, dayOfMonth;
+      dateFromPostgresDay( day, year, month, dayOfMonth );
+      int seconds = time / 1000000;
+
+      char text[64];
+      qsnprintf( text, sizeof( text ), "%04d-%02d-%02d %02d:%02d:%02d",
+                 year > 0 ? year : 1 - year, month, dayOfMonth, seconds / 3600, seconds / 60 % 60, seconds % 60 );
+      QString timestamp = text;
+      if ( time % 1000000 != 0 )
+      {
+        // fractional seconds without trailing zeros
+        int len = qsnprintf( text, sizeof( text ), ".%06d", ( int )( time % 1000000 ) );
+        while ( text[len - 1] == '0' )
+          len--;
+        timestamp += QString::fromLatin1( text, len );
+      }
+      if ( year <= 0 )
+        timestamp += " BC";
+      return QVariant( timestamp );
+    }
+
+    case pbtText:
+      break;
+  }
+
+  QVariant v( queryResult.PQgetvalue( row, col ) );
+  if ( !v.convert( fieldType ) )
+    v = QVariant( fieldType );
+  return v;
+}
+
 void QgsPostgresConn::deduceEndian()
 {
   // need to store the PostgreSQL endian format used in binary cursors
@@ -50,6 +50,21 @@ enum QgsPostgresPrimaryKeyType
   pktFidMap
 };
 
+/** Format of the values of a field in binary cursors (see QgsPostgresConn::binaryType()) */
+enum QgsPostgresBinaryType
+{
+  pbtText,      //! fetched as text using QgsPostgresConn::fieldExpression()
+  pbtInt2,
+  pbtInt4,
+  pbtInt8,
+  pbtFloat4,
+  pbtFloat8,
+  pbtNumeric,
+  pbtBool,
+  pbtDate,
+  pbtTimestamp
+};
+
 /** Layer Property structure */
 // TODO: Fill to Postgres/PostGIS specifications
 struct QgsPostgresLayerProperty
@@ -196,6 +211,8 @@ class QgsPostgresConn : public QObject
     //! cursor handling
     bool openCursor( QString cursorName, QString declare );
     bool closeCursor( QString cursorName );
+    //! roll back the transaction of the cursors after an error aborted it
+    bool rollbackCursors();
 
     QString uniqueCursorName();
 
@@ -243,6 +260,14 @@ class QgsPostgresConn : public QObject
 
     QString fieldExpression( const QgsField &fld );
 
+    /** Returns the binary format in which a plain column of the field is returned by binary cursors.
+     * pbtText if the values have to be fetched as text (with fieldExpression()) */
+    QgsPostgresBinaryType binaryType( const QgsField &fld );
+
+    /** Decodes a value returned in binary format by a binary cursor.
+     * The result is the value convertValue() returns for the text representation */
+    QVariant getBinaryValue( QgsPostgresResult &queryResult, int row, int col, QgsPostgresBinaryType type, QVariant::Type fieldType );
+
     QString connInfo() const { return mConnInfo; }
 
     static const int sGeomTypeSelectLimit;
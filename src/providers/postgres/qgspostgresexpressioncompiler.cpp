@@ -0,0 +1,54 @@
+/***************************************************************************
+    qgspostgresexpressioncompiler.cpp
+    ---------------------
+    begin                : May 2014
+    copyright            : (C) 2014 by the QGIS project
+    email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgspostgresexpressioncompiler.h"
+#include "qgspostgresconn.h"
+
+QgsPostgresExpressionCompiler::QgsPostgresExpressionCompiler( const QgsFields& fields )
+    : QgsSqlExpressionCompiler( fields )
+{
+}
+
+QgsSqlExpressionCompiler::ValueType QgsPostgresExpressionCompiler::columnType( const QgsField& field )
+{
+  ValueType type = QgsSqlExpressionCompiler::columnType( field );
+
+  // dates, uuids, enums, arrays etc. are reported as strings too,
+  // but comparing them with arbitrary string literals fails in SQL
+  if ( type == String && field.typeName() != "text" && field.typeName() != "varchar" )
+    return Other;
+
+  return type;
+}
+
+QString QgsPostgresExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  return QgsPostgresConn::quotedIdentifier( identifier );
+}
+
+QString QgsPostgresExpressionCompiler::quotedValue( const QVariant& value )
+{
+  // keep full precision of doubles
+  if ( value.type() == QVariant::Double )
+    return QgsSqlExpressionCompiler::quotedValue( value );
+
+  return QgsPostgresConn::quotedValue( value );
+}
+
+QgsSqlExpressionCompiler::Result QgsPostgresExpressionCompiler::compileLike( const QString& value, const QString& pattern, bool caseInsensitive, QString& result )
+{
+  result = QString( "%1 %2 %3" ).arg( value, QString( caseInsensitive ? "ILIKE" : "LIKE" ), quotedValue( pattern ) );
+  return Complete;
+}
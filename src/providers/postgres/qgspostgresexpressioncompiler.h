@@ -0,0 +1,34 @@
+/***************************************************************************
+    qgspostgresexpressioncompiler.h
+    ---------------------
+    begin                : May 2014
+    copyright            : (C) 2014 by the QGIS project
+    email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSPOSTGRESEXPRESSIONCOMPILER_H
+#define QGSPOSTGRESEXPRESSIONCOMPILER_H
+
+#include "qgssqlexpressioncompiler.h"
+
+/** Translates filter expressions to PostgreSQL */
+class QgsPostgresExpressionCompiler : public QgsSqlExpressionCompiler
+{
+  public:
+    explicit QgsPostgresExpressionCompiler( const QgsFields& fields );
+
+  protected:
+    virtual ValueType columnType( const QgsField& field );
+    virtual QString quotedIdentifier( const QString& identifier );
+    virtual QString quotedValue( const QVariant& value );
+    virtual Result compileLike( const QString& value, const QString& pattern, bool caseInsensitive, QString& result );
+};
+
+#endif // QGSPOSTGRESEXPRESSIONCOMPILER_H
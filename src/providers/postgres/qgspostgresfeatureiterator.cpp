@@ -15,20 +15,33 @@
 #include "qgspostgresfeatureiterator.h"
 #include "qgspostgresprovider.h"
 #include "qgspostgresconnpool.h"
+#include "qgspostgresexpressioncompiler.h"
 #include "qgsgeometry.h"
 
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
 
 #include <QObject>
+#include <QTime>
+#include <QtConcurrentRun>
 
 
 const int QgsPostgresFeatureIterator::sFeatureQueueSize = 2000;
+const int QgsPostgresFeatureIterator::sMinFeatureQueueSize = 100;
+const int QgsPostgresFeatureIterator::sMaxFeatureQueueSize = 100000;
+const int QgsPostgresFeatureIterator::sMaxBatchBytes = 16 * 1024 * 1024;
+const int QgsPostgresFeatureIterator::sTargetBatchTime = 200;
 
 
 QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource* source, bool ownSource, const QgsFeatureRequest& request )
     : QgsAbstractFeatureIteratorFromSource( source, ownSource, request )
     , mFeatureQueueSize( sFeatureQueueSize )
+    , mPipelined( request.filterType() != QgsFeatureRequest::FilterFid )
+    , mFetchStarted( false )
+    , mFetchCancelled( 0 )
+    , mFetchAborted( false )
+    , mCursorExhausted( false )
+    , mExpressionCompiled( false )
 {
   mConn = QgsPostgresConnPool::instance()->acquireConnection( mSource->mConnInfo );
 
@@ -54,6 +67,16 @@ QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource
   {
     whereClause = QgsPostgresUtils::whereClause( mRequest.filterFids(), mSource->mFields, mConn, mSource->mPrimaryKeyType, mSource->mPrimaryKeyAttrs, mSource->mShared );
   }
+  else if ( request.filterType() == QgsFeatureRequest::FilterExpression )
+  {
+    QgsPostgresExpressionCompiler compiler( mSource->mFields );
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+    {
+      whereClause = compiler.result();
+      mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+    }
+  }
 
   if ( !mSource->mSqlWhereClause.isEmpty() )
   {
@@ -63,6 +86,7 @@ QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource
     whereClause += "(" + mSource->mSqlWhereClause + ")";
   }
 
+  mWhereClause = whereClause;
   if ( !declareCursor( whereClause ) )
   {
     mClosed = true;
@@ -71,6 +95,10 @@ QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource
   }
 
   mFetched = 0;
+
+  // the first batch is already on its way when the first feature is requested
+  if ( mPipelined )
+    startFetch();
 }
 
 
@@ -89,35 +117,19 @@ bool QgsPostgresFeatureIterator::fetchFeature( QgsFeature& feature )
 
   if ( mFeatureQueue.empty() )
   {
-    QString fetch = QString( "FETCH FORWARD %1 FROM %2" ).arg( mFeatureQueueSize ).arg( mCursorName );
-    QgsDebugMsgLevel( QString( "fetching %1 features." ).arg( mFeatureQueueSize ), 4 );
-    if ( mConn->PQsendQuery( fetch ) == 0 ) // fetch features asynchronously
-    {
-      QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName ).arg( mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
-    }
+    if ( !mFetchStarted && !mCursorExhausted )
+      startFetch();
 
-    QgsPostgresResult queryResult;
-    for ( ;; )
+    if ( mFetchStarted )
     {
-      queryResult = mConn->PQgetResult();
-      if ( !queryResult.result() )
-        break;
-
-      if ( queryResult.PQresultStatus() != PGRES_TUPLES_OK )
-      {
-        QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName ).arg( mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
-        break;
-      }
-
-      int rows = queryResult.PQntuples();
-      if ( rows == 0 )
-        continue;
-
-      for ( int row = 0; row < rows; row++ )
-      {
-        mFeatureQueue.enqueue( QgsFeature() );
-        getFeature( queryResult, row, mFeatureQueue.back() );
-      } // for each row in queue
+      mFetchFuture.waitForFinished();
+      // the queue is empty, hand it back for the next batch
+      qSwap( mFeatureQueue, mFetchedFeatures );
+      mFetchStarted = false;
+
+      // fetch the next batch while this one is consumed
+      if ( mPipelined && !mCursorExhausted )
+        startFetch();
     }
   }
 
@@ -153,6 +165,108 @@ bool QgsPostgresFeatureIterator::fetchFeature( QgsFeature& feature )
   return true;
 }
 
+void QgsPostgresFeatureIterator::startFetch()
+{
+  mFetchStarted = true;
+  if ( mPipelined )
+    mFetchFuture = QtConcurrent::run( this, &QgsPostgresFeatureIterator::fetchBatch );
+  else
+    fetchBatch();
+}
+
+void QgsPostgresFeatureIterator::stopFetch()
+{
+  // the connection is busy until the running fetch is complete,
+  // cancel it instead of waiting for the rest of the batch
+  if ( mFetchStarted && mFetchFuture.isRunning() )
+  {
+    mFetchCancelled = 1;
+    mConn->cancel();
+  }
+
+  mFetchFuture.waitForFinished();
+  mFetchCancelled = 0;
+  mFetchedFeatures.clear();
+  mFetchStarted = false;
+}
+
+void QgsPostgresFeatureIterator::fetchBatch()
+{
+  // the connection is only used by this thread until the batch is complete
+  QTime fetchTime;
+  fetchTime.start();
+
+  int batchSize = mFeatureQueueSize;
+  QString fetch = QString( "FETCH FORWARD %1 FROM %2" ).arg( batchSize ).arg( mCursorName );
+  QgsDebugMsgLevel( QString( "fetching %1 features." ).arg( batchSize ), 4 );
+  if ( mConn->PQsendQuery( fetch ) == 0 ) // fetch features asynchronously
+  {
+    QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName ).arg( mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
+  }
+
+  int fetchedRows = 0;
+  qint64 fetchedBytes = 0;
+  QgsPostgresResult queryResult;
+  for ( ;; )
+  {
+    queryResult = mConn->PQgetResult();
+    if ( !queryResult.result() )
+      break;
+
+    if ( queryResult.PQresultStatus() != PGRES_TUPLES_OK )
+    {
+      // the error aborted the transaction of the cursor
+      mFetchAborted = true;
+      if ( !mFetchCancelled )
+        QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName ).arg( mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
+      break;
+    }
+
+    int rows = queryResult.PQntuples();
+    if ( rows == 0 )
+      continue;
+
+    int nFields = queryResult.PQnfields();
+    for ( int row = 0; row < rows; row++ )
+    {
+      mFetchedFeatures.enqueue( QgsFeature() );
+      getFeature( queryResult, row, mFetchedFeatures.back() );
+
+      for ( int col = 0; col < nFields; ++col )
+        fetchedBytes += ::PQgetlength( queryResult.result(), row, col );
+    } // for each row in queue
+
+    fetchedRows += rows;
+  }
+
+  mCursorExhausted = fetchedRows < batchSize;
+  if ( mCursorExhausted || fetchedRows == 0 )
+    return;
+
+  // adapt the size of the next batch: batches whose round trip is dominated by
+  // latency grow, slow ones shrink, and wide rows limit the memory of a batch
+  int elapsed = fetchTime.elapsed();
+  qint64 size = batchSize;
+  if ( elapsed < sTargetBatchTime )
+    size *= 2;
+  else if ( elapsed > 2 * sTargetBatchTime )
+    size /= 2;
+
+  if ( fetchedBytes > 0 )
+    size = qMin( size, ( qint64 ) sMaxBatchBytes * fetchedRows / fetchedBytes );
+
+  mFeatureQueueSize = qBound( ( qint64 ) sMinFeatureQueueSize, size, ( qint64 ) sMaxFeatureQueueSize );
+}
+
+bool QgsPostgresFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  // the database already did the filtering
+  if ( mExpressionCompiled )
+    return fetchFeature( f );
+
+  return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+}
+
 bool QgsPostgresFeatureIterator::prepareSimplification( const QgsSimplifyMethod& simplifyMethod )
 {
   // setup simplification of geometries to fetch
@@ -182,8 +296,25 @@ bool QgsPostgresFeatureIterator::rewind()
   if ( mClosed )
     return false;
 
-  // move cursor to first record
-  mConn->PQexecNR( QString( "move absolute 0 in %1" ).arg( mCursorName ) );
+  stopFetch();
+  mCursorExhausted = false;
+
+  if ( mFetchAborted )
+  {
+    // the cursor is gone with its transaction
+    mFetchAborted = false;
+    mConn->rollbackCursors();
+    if ( !declareCursor( mWhereClause ) )
+    {
+      close();
+      return false;
+    }
+  }
+  else
+  {
+    // move cursor to first record
+    mConn->PQexecNR( QString( "move absolute 0 in %1" ).arg( mCursorName ) );
+  }
   mFeatureQueue.clear();
   mFetched = 0;
 
@@ -195,7 +326,12 @@ bool QgsPostgresFeatureIterator::close()
   if ( mClosed )
     return false;
 
-  mConn->closeCursor( mCursorName );
+  stopFetch();
+
+  if ( mFetchAborted )
+    mConn->rollbackCursors();
+  else
+    mConn->closeCursor( mCursorName );
 
   QgsPostgresConnPool::instance()->releaseConnection( mConn );
   mConn = 0;
@@ -287,6 +423,11 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
   //}
 
 
+  // numbers, booleans and dates are fetched in their binary format, other types as text
+  mBinaryTypes.resize( mSource->mFields.count() );
+  for ( int idx = 0; idx < mSource->mFields.count(); ++idx )
+    mBinaryTypes[idx] = mConn->binaryType( mSource->mFields[idx] );
+
   const QgsSimplifyMethod& simplifyMethod = mRequest.simplifyMethod();
 
   QString query = "SELECT ", delim = "";
@@ -339,7 +480,7 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
     case pktFidMap:
       foreach ( int idx, mSource->mPrimaryKeyAttrs )
       {
-        query += delim + mConn->fieldExpression( mSource->mFields[idx] );
+        query += delim + fieldExpression( idx );
         delim = ",";
       }
       break;
@@ -356,7 +497,7 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
     if ( mSource->mPrimaryKeyAttrs.contains( idx ) )
       continue;
 
-    query += delim + mConn->fieldExpression( mSource->mFields[idx] );
+    query += delim + fieldExpression( idx );
   }
 
   query += " FROM " + mSource->mQuery;
@@ -478,9 +619,7 @@ bool QgsPostgresFeatureIterator::getFeature( QgsPostgresResult &queryResult, int
 
       foreach ( int idx, mSource->mPrimaryKeyAttrs )
       {
-        const QgsField &fld = mSource->mFields[idx];
-
-        QVariant v = QgsPostgresProvider::convertValue( fld.type(), queryResult.PQgetvalue( row, col ) );
+        QVariant v = fieldValue( idx, queryResult, row, col );
         primaryKeyVals << v;
 
         if ( !subsetOfAttributes || fetchAttributes.contains( idx ) )
@@ -522,12 +661,28 @@ void QgsPostgresFeatureIterator::getFeatureAttribute( int idx, QgsPostgresResult
   if ( mSource->mPrimaryKeyAttrs.contains( idx ) )
     return;
 
-  QVariant v = QgsPostgresProvider::convertValue( mSource->mFields[idx].type(), queryResult.PQgetvalue( row, col ) );
+  QVariant v = fieldValue( idx, queryResult, row, col );
   feature.setAttribute( idx, v );
 
   col++;
 }
 
+QString QgsPostgresFeatureIterator::fieldExpression( int idx )
+{
+  if ( mBinaryTypes[idx] != pbtText )
+    return QgsPostgresConn::quotedIdentifier( mSource->mFields[idx].name() );
+
+  return mConn->fieldExpression( mSource->mFields[idx] );
+}
+
+QVariant QgsPostgresFeatureIterator::fieldValue( int idx, QgsPostgresResult& queryResult, int row, int col )
+{
+  if ( mBinaryTypes[idx] != pbtText )
+    return mConn->getBinaryValue( queryResult, row, col, mBinaryTypes[idx], mSource->mFields[idx].type() );
+
+  return QgsPostgresProvider::convertValue( mSource->mFields[idx].type(), queryResult.PQgetvalue( row, col ) );
+}
+
 
 //  ------------------
 
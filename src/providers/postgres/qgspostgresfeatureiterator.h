@@ -17,6 +17,8 @@
 
 #include "qgsfeatureiterator.h"
 
+#include <QAtomicInt>
+#include <QFuture>
 #include <QQueue>
 
 #include "qgspostgresprovider.h"
@@ -74,6 +76,9 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Q
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! fetch next feature matching the filter expression - uses SQL filter if possible
+    virtual bool nextFeatureFilterExpression( QgsFeature& f );
+
     //! Setup the simplification of geometries to fetch using the specified simplify method
     virtual bool prepareSimplification( const QgsSimplifyMethod& simplifyMethod );
 
@@ -83,10 +88,24 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Q
     QString whereClauseRect();
     bool getFeature( QgsPostgresResult &queryResult, int row, QgsFeature &feature );
     void getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeature& feature );
+    //! expression selecting a field in the cursor
+    QString fieldExpression( int idx );
+    //! decode the value of a field selected with fieldExpression()
+    QVariant fieldValue( int idx, QgsPostgresResult& queryResult, int row, int col );
     bool declareCursor( const QString& whereClause );
 
+    //! fetch the next batch of features from the cursor into mFetchedFeatures
+    void fetchBatch();
+    //! start fetching the next batch, in a worker thread if the iterator is pipelined
+    void startFetch();
+    //! cancel a running fetch and drop the fetched batch
+    void stopFetch();
+
     QString mCursorName;
 
+    //! Filter of the cursor, to declare it again after an aborted fetch
+    QString mWhereClause;
+
     /**
      * Feature queue that GetNextFeature will retrieve from
      * before the next fetch from PostgreSQL
@@ -96,13 +115,51 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Q
     //! Maximal size of the feature queue
     int mFeatureQueueSize;
 
+    /**
+     * Features of the next batch. While pipelined, the batch is fetched
+     * and decoded by a worker thread while mFeatureQueue is consumed
+     */
+    QQueue<QgsFeature> mFetchedFeatures;
+
+    //! Running fetch of the next batch
+    QFuture<void> mFetchFuture;
+
+    //! Fetch the next batch in the background while the current one is consumed
+    bool mPipelined;
+
+    //! Set to true, if a batch is being fetched or waits in mFetchedFeatures
+    bool mFetchStarted;
+
+    //! Set by stopFetch() while a running fetch is cancelled
+    QAtomicInt mFetchCancelled;
+
+    //! Set to true, if the last fetch failed and aborted the transaction of the cursor
+    bool mFetchAborted;
+
+    //! Set to true, if the cursor returned less features than requested
+    bool mCursorExhausted;
+
     //! Number of retrieved features
     int mFetched;
 
     //! Set to true, if geometry is in the requested columns
     bool mFetchGeometry;
 
+    //! Binary format of the fields (pbtText for fields fetched as text)
+    QVector<QgsPostgresBinaryType> mBinaryTypes;
+
+    //! Set to true, if the filter expression was translated to SQL completely
+    bool mExpressionCompiled;
+
     static const int sFeatureQueueSize;
+    static const int sMinFeatureQueueSize;
+    static const int sMaxFeatureQueueSize;
+
+    //! Approximate upper limit for the size of the fetched rows of a batch (in bytes)
+    static const int sMaxBatchBytes;
+
+    //! Batches fetched faster than this (in ms) are dominated by latency and grow
+    static const int sTargetBatchTime;
 
   private:
     //! returns whether the iterator supports simplify geometries on provider side
@@ -0,0 +1,53 @@
+/***************************************************************************
+    qgsspatialiteexpressioncompiler.cpp
+    ---------------------
+    begin                : May 2014
+    copyright            : (C) 2014 by the QGIS project
+    email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsspatialiteexpressioncompiler.h"
+#include "qgsspatialiteprovider.h"
+
+QgsSpatiaLiteExpressionCompiler::QgsSpatiaLiteExpressionCompiler( const QgsFields& fields )
+    : QgsSqlExpressionCompiler( fields )
+{
+}
+
+QString QgsSpatiaLiteExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  return QgsSpatiaLiteProvider::quotedIdentifier( identifier );
+}
+
+QString QgsSpatiaLiteExpressionCompiler::quotedValue( const QVariant& value )
+{
+  if ( value.type() == QVariant::String )
+    return QgsSpatiaLiteProvider::quotedValue( value.toString() );
+
+  return QgsSqlExpressionCompiler::quotedValue( value );
+}
+
+QgsSqlExpressionCompiler::Result QgsSpatiaLiteExpressionCompiler::compileLike( const QString& value, const QString& pattern, bool caseInsensitive, QString& result )
+{
+  // SQLite's LIKE ignores case of ASCII characters only
+  if ( caseInsensitive )
+  {
+    for ( int i = 0; i < pattern.length(); ++i )
+    {
+      if ( pattern[i].unicode() > 127 )
+        return Fail;
+    }
+  }
+
+  result = QString( "%1 LIKE %2" ).arg( value, quotedValue( pattern ) );
+
+  // case sensitive LIKE matches a superset
+  return caseInsensitive ? Complete : Partial;
+}
@@ -17,6 +17,7 @@
 #include "qgsspatialiteconnection.h"
 #include "qgsspatialiteconnpool.h"
 #include "qgsspatialiteprovider.h"
+#include "qgsspatialiteexpressioncompiler.h"
 
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
@@ -26,6 +27,7 @@
 QgsSpatiaLiteFeatureIterator::QgsSpatiaLiteFeatureIterator( QgsSpatiaLiteFeatureSource* source, bool ownSource, const QgsFeatureRequest& request )
     : QgsAbstractFeatureIteratorFromSource( source, ownSource, request )
     , sqliteStatement( NULL )
+    , mExpressionCompiled( false )
 {
 
   mHandle = QgsSpatiaLiteConnPool::instance()->acquireConnection( mSource->mSqlitePath );
@@ -44,6 +46,17 @@ QgsSpatiaLiteFeatureIterator::QgsSpatiaLiteFeatureIterator( QgsSpatiaLiteFeature
     whereClause += whereClauseFid();
   }
 
+  if ( request.filterType() == QgsFeatureRequest::FilterExpression )
+  {
+    QgsSpatiaLiteExpressionCompiler compiler( mSource->mFields );
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+    {
+      whereClause += "( " + compiler.result() + ")";
+      mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+    }
+  }
+
   if ( !mSource->mSubsetString.isEmpty() )
   {
     if ( !whereClause.isEmpty() )
@@ -96,6 +109,16 @@ bool QgsSpatiaLiteFeatureIterator::fetchFeature( QgsFeature& feature )
 }
 
 
+bool QgsSpatiaLiteFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  // the database already did the filtering
+  if ( mExpressionCompiled )
+    return fetchFeature( f );
+
+  return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+}
+
+
 bool QgsSpatiaLiteFeatureIterator::rewind()
 {
   if ( mClosed )
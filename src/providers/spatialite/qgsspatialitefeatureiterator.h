@@ -69,6 +69,9 @@ class QgsSpatiaLiteFeatureIterator : public QgsAbstractFeatureIteratorFromSource
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! fetch next feature matching the filter expression - uses SQL filter if possible
+    virtual bool nextFeatureFilterExpression( QgsFeature& f );
+
     QString whereClauseRect();
     QString whereClauseFid();
     QString mbr( const QgsRectangle& rect );
@@ -92,6 +95,9 @@ class QgsSpatiaLiteFeatureIterator : public QgsAbstractFeatureIteratorFromSource
 
     //! Set to true, if geometry is in the requested columns
     bool mFetchGeometry;
+
+    //! Set to true, if the filter expression was translated to SQL completely
+    bool mExpressionCompiled;
 };
 
 #endif // QGSSPATIALITEFEATUREITERATOR_H
@@ -0,0 +1,153 @@
+/***************************************************************************
+    qgsbenchvertexkernels.cpp  - Benchmark of the per-vertex kernels
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Compares the scalar, SSE2 and AVX implementations of the kernels used when
+ * drawing dense linework, e.g.
+ *
+ *   qgis_bench_vertexkernels -tickcounter
+ *
+ * Each benchmark processes one million vertices per iteration, rows for
+ * instruction sets not supported by the CPU are skipped.
+ */
+
+#include <QObject>
+#include <QPolygonF>
+#include <QTest>
+#include <QVector>
+
+#include "qgsgeometry.h"
+#include "qgsmaptopixel.h"
+#include "qgsmaptopixelgeometrysimplifier.h"
+#include "qgsvertexkernels.h"
+
+#include <limits>
+
+static const int sVertexCount = 1000000;
+
+class QgsBenchVertexKernels : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void cleanup();
+
+    void mapToPixel_data() { instructionSetData(); }
+    void mapToPixel();
+    void boundingBox_data() { instructionSetData(); }
+    void boundingBox();
+    void simplify_data() { instructionSetData(); }
+    void simplify();
+
+  private:
+    void instructionSetData();
+    //! skips the benchmark if the instruction set is not supported
+    bool selectInstructionSet();
+
+    QPolygonF mLine;
+    QgsGeometry* mGeometry;
+};
+
+void QgsBenchVertexKernels::initTestCase()
+{
+  // a dense random walk, like digitized contour lines
+  qsrand( 1 );
+  QgsPolyline line;
+  line.reserve( sVertexCount );
+  mLine.reserve( sVertexCount );
+  double x = 0, y = 0;
+  for ( int i = 0; i < sVertexCount; ++i )
+  {
+    x += ( double ) qrand() / RAND_MAX - 0.5;
+    y += ( double ) qrand() / RAND_MAX - 0.5;
+    line << QgsPoint( x, y );
+    mLine << QPointF( x, y );
+  }
+  mGeometry = QgsGeometry::fromPolyline( line );
+}
+
+void QgsBenchVertexKernels::cleanupTestCase()
+{
+  delete mGeometry;
+}
+
+void QgsBenchVertexKernels::cleanup()
+{
+  QgsVertexKernels::setInstructionSet( QgsVertexKernels::supportedInstructionSet() );
+}
+
+void QgsBenchVertexKernels::instructionSetData()
+{
+  QTest::addColumn<int>( "instructionSet" );
+  QTest::newRow( "scalar" ) << ( int ) QgsVertexKernels::Scalar;
+  QTest::newRow( "sse2" ) << ( int ) QgsVertexKernels::SSE2;
+  QTest::newRow( "avx" ) << ( int ) QgsVertexKernels::AVX;
+}
+
+bool QgsBenchVertexKernels::selectInstructionSet()
+{
+  QFETCH( int, instructionSet );
+  if ( instructionSet > QgsVertexKernels::supportedInstructionSet() )
+    return false;
+
+  QgsVertexKernels::setInstructionSet(( QgsVertexKernels::InstructionSet ) instructionSet );
+  return true;
+}
+
+void QgsBenchVertexKernels::mapToPixel()
+{
+  if ( !selectInstructionSet() )
+    QSKIP( "instruction set not supported", SkipSingle );
+
+  // an identity scale keeps the values stable over the iterations
+  QgsMapToPixel mtp( 1.0, 0.0, 0.0, 0.0 );
+  QPolygonF line = mLine;
+  QBENCHMARK
+  {
+    mtp.transformInPlace( line );
+  }
+}
+
+void QgsBenchVertexKernels::boundingBox()
+{
+  if ( !selectInstructionSet() )
+    QSKIP( "instruction set not supported", SkipSingle );
+
+  const unsigned char* xy = ( const unsigned char* ) mLine.constData();
+  QBENCHMARK
+  {
+    double xMin = std::numeric_limits<double>::max(), yMin = std::numeric_limits<double>::max();
+    double xMax = -std::numeric_limits<double>::max(), yMax = -std::numeric_limits<double>::max();
+    QgsVertexKernels::boundingBox( xy, mLine.size(), sizeof( QPointF ), xMin, yMin, xMax, yMax );
+  }
+}
+
+void QgsBenchVertexKernels::simplify()
+{
+  if ( !selectInstructionSet() )
+    QSKIP( "instruction set not supported", SkipSingle );
+
+  // a tolerance in the order of the vertex spacing, as when zoomed out
+  QgsMapToPixelSimplifier simplifier( QgsMapToPixelSimplifier::SimplifyGeometry, 0.5 );
+  QBENCHMARK
+  {
+    delete simplifier.simplify( mGeometry );
+  }
+}
+
+QTEST_MAIN( QgsBenchVertexKernels )
+#include "moc_qgsbenchvertexkernels.cxx"
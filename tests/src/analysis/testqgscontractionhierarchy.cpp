@@ -0,0 +1,230 @@
+/***************************************************************************
+     testqgscontractionhierarchy.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QtTest>
+#include <QVector>
+
+#include "qgscontractionhierarchy.h"
+#include "qgsgraph.h"
+#include "qgsgraphanalyzer.h"
+
+#include <limits>
+#include <math.h>
+
+/** \ingroup UnitTests
+ * This is a unit test for the contraction hierarchy shortest path queries
+ */
+class TestQgsContractionHierarchy: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void shortestPath();
+    void file();
+    void invalidFile();
+    void closestVertex();
+
+  private:
+    //! compares the shortest paths of the hierarchy with dijkstra
+    void checkPaths( const QgsContractionHierarchy* ch );
+
+    QgsGraph* mGraph;
+    int mIsolatedVertex;
+    QString mFileName;
+};
+
+void TestQgsContractionHierarchy::initTestCase()
+{
+  // a 30 x 20 grid with some arcs missing, fast roads on every fifth row and column,
+  // parallel arcs and a loop
+  qsrand( 11 );
+  mGraph = new QgsGraph();
+  int columns = 30, rows = 20;
+  for ( int j = 0; j < rows; ++j )
+  {
+    for ( int i = 0; i < columns; ++i )
+    {
+      mGraph->addVertex( QgsPoint( i, j ) );
+    }
+  }
+
+  for ( int v = 0; v < columns * rows; ++v )
+  {
+    QList<int> neighbours;
+    if ( v % columns + 1 < columns )
+      neighbours << v + 1;
+    if ( v + columns < columns * rows )
+      neighbours << v + columns;
+
+    foreach ( int w, neighbours )
+    {
+      bool fast = ( w == v + 1 && ( v / columns ) % 5 == 0 ) || ( w == v + columns && ( v % columns ) % 5 == 0 );
+      double cost = ( fast ? 1.0 : 3.0 ) * ( 1.0 + 0.2 * qrand() / RAND_MAX );
+      if ( qrand() % 10 != 0 )
+        mGraph->addArc( v, w, QVector<QVariant>() << cost );
+      if ( qrand() % 10 != 0 )
+        mGraph->addArc( w, v, QVector<QVariant>() << cost );
+      if ( qrand() % 20 == 0 )
+        mGraph->addArc( v, w, QVector<QVariant>() << cost * 0.5 );
+    }
+  }
+  mGraph->addArc( 3, 3, QVector<QVariant>() << 1.0 );
+
+  mIsolatedVertex = mGraph->addVertex( QgsPoint( 100, 100 ) );
+  mFileName = QDir::tempPath() + QDir::separator() + "testqgscontractionhierarchy.ch";
+}
+
+void TestQgsContractionHierarchy::cleanupTestCase()
+{
+  delete mGraph;
+  QFile::remove( mFileName );
+}
+
+void TestQgsContractionHierarchy::checkPaths( const QgsContractionHierarchy* ch )
+{
+  QCOMPARE( ch->vertexCount(), mGraph->vertexCount() );
+  QCOMPARE( ch->arcCount(), mGraph->arcCount() );
+
+  for ( int start = 0; start < mGraph->vertexCount(); start += 47 )
+  {
+    QVector<double> expectedCost;
+    QgsGraphAnalyzer::dijkstra( mGraph, start, 0, NULL, &expectedCost );
+
+    for ( int stop = 5; stop < mGraph->vertexCount(); stop += 29 )
+    {
+      QVector<int> arcs;
+      double cost = ch->shortestPath( start, stop, &arcs );
+      if ( expectedCost[stop] == std::numeric_limits<double>::infinity() )
+      {
+        QCOMPARE( cost, std::numeric_limits<double>::infinity() );
+        QVERIFY( arcs.isEmpty() );
+        continue;
+      }
+
+      double tolerance = 1e-9 * ( 1.0 + expectedCost[stop] );
+      QVERIFY( qAbs( cost - expectedCost[stop] ) < tolerance );
+
+      // shortcuts are unpacked into arcs of the source graph
+      double pathCost = 0;
+      int vertex = start;
+      foreach ( int arcIdx, arcs )
+      {
+        const QgsGraphArc& arc = mGraph->arc( arcIdx );
+        QCOMPARE( arc.outVertex(), vertex );
+        pathCost += arc.property( 0 ).toDouble();
+        vertex = arc.inVertex();
+      }
+      QCOMPARE( vertex, stop );
+      QVERIFY( qAbs( pathCost - cost ) < tolerance );
+    }
+  }
+
+  QCOMPARE( ch->shortestPath( 7, 7 ), 0.0 );
+  QCOMPARE( ch->shortestPath( 0, mIsolatedVertex ), std::numeric_limits<double>::infinity() );
+  QCOMPARE( ch->shortestPath( 0, -1 ), std::numeric_limits<double>::infinity() );
+}
+
+void TestQgsContractionHierarchy::shortestPath()
+{
+  QgsContractionHierarchy ch( mGraph, 0 );
+  QVERIFY( ch.isValid() );
+  QVERIFY( ch.shortcutCount() > 0 );
+  checkPaths( &ch );
+}
+
+void TestQgsContractionHierarchy::file()
+{
+  QgsContractionHierarchy ch( mGraph, 0 );
+  QVERIFY( ch.writeToFile( mFileName ) );
+
+  QgsContractionHierarchy* loaded = QgsContractionHierarchy::fromFile( mFileName );
+  QVERIFY( loaded );
+  QVERIFY( loaded->isValid() );
+  QCOMPARE( loaded->shortcutCount(), ch.shortcutCount() );
+  QCOMPARE( loaded->vertexPoint( 31 ).x(), 1.0 );
+  QCOMPARE( loaded->vertexPoint( 31 ).y(), 1.0 );
+  checkPaths( loaded );
+
+  // a loaded hierarchy can be written again
+  QString copyName = mFileName + ".copy";
+  QVERIFY( loaded->writeToFile( copyName ) );
+  delete loaded;
+
+  QFile original( mFileName ), copy( copyName );
+  QVERIFY( original.open( QIODevice::ReadOnly ) );
+  QVERIFY( copy.open( QIODevice::ReadOnly ) );
+  QCOMPARE( copy.readAll(), original.readAll() );
+  copy.remove();
+}
+
+void TestQgsContractionHierarchy::invalidFile()
+{
+  QVERIFY( !QgsContractionHierarchy::fromFile( QDir::tempPath() + QDir::separator() + "does_not_exist.ch" ) );
+
+  // truncated file
+  QgsContractionHierarchy ch( mGraph, 0 );
+  QVERIFY( ch.writeToFile( mFileName ) );
+  QFile file( mFileName );
+  QVERIFY( file.resize( file.size() - 8 ) );
+  QVERIFY( !QgsContractionHierarchy::fromFile( mFileName ) );
+
+  // arc pointing to a vertex which does not exist. The file ends with the last upward arc
+  QVERIFY( ch.writeToFile( mFileName ) );
+  QVERIFY( file.open( QIODevice::ReadWrite ) );
+  QVERIFY( file.seek( file.size() - 16 ) );
+  qint32 badVertex = 1 << 30;
+  file.write(( const char* ) &badVertex, sizeof( badVertex ) );
+  file.close();
+  QVERIFY( !QgsContractionHierarchy::fromFile( mFileName ) );
+
+  // not a hierarchy at all
+  QVERIFY( file.open( QIODevice::WriteOnly | QIODevice::Truncate ) );
+  file.write( QByteArray( 256, 'x' ) );
+  file.close();
+  QVERIFY( !QgsContractionHierarchy::fromFile( mFileName ) );
+}
+
+void TestQgsContractionHierarchy::closestVertex()
+{
+  QgsContractionHierarchy ch( mGraph, 0 );
+  QCOMPARE( ch.closestVertex( QgsPoint( 2.2, 1.9 ) ), 2 * 30 + 2 );
+  QCOMPARE( ch.closestVertex( QgsPoint( 90, 95 ) ), mIsolatedVertex );
+  QCOMPARE( ch.closestVertex( QgsPoint( -50, 30 ) ), 19 * 30 );
+
+  // the grid gives the same results as a linear scan
+  for ( int i = 0; i < 200; ++i )
+  {
+    QgsPoint pt( -10.0 + 130.0 * qrand() / RAND_MAX, -10.0 + 130.0 * qrand() / RAND_MAX );
+    int closest = -1;
+    double minDist = std::numeric_limits<double>::max();
+    for ( int v = 0; v < ch.vertexCount(); ++v )
+    {
+      double dist = ch.vertexPoint( v ).sqrDist( pt );
+      if ( dist < minDist )
+      {
+        minDist = dist;
+        closest = v;
+      }
+    }
+    QCOMPARE( ch.closestVertex( pt ), closest );
+  }
+}
+
+QTEST_MAIN( TestQgsContractionHierarchy )
+#include "moc_testqgscontractionhierarchy.cxx"
@@ -0,0 +1,200 @@
+/***************************************************************************
+     testqgsgraphrouter.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QtTest>
+#include <QVector>
+
+#include "qgsgraph.h"
+#include "qgsgraphanalyzer.h"
+#include "qgsgraphrouter.h"
+
+#include <limits>
+#include <math.h>
+
+/** \ingroup UnitTests
+ * This is a unit test for the shortest path queries of QgsGraphRouter
+ */
+class TestQgsGraphRouter: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void dijkstra();
+    void shortestPath();
+    void unreachable();
+    void costMatrix();
+
+  private:
+    //! checks that the arcs form a path from start to stop and returns its cost
+    double pathCost( const QVector<int>& arcs, int start, int stop ) const;
+
+    QgsGraph* mGraph;
+    int mIsolatedVertex;
+};
+
+void TestQgsGraphRouter::initTestCase()
+{
+  // a 30 x 20 grid with some arcs missing and costs of 1 to 3 times the arc length
+  qsrand( 7 );
+  mGraph = new QgsGraph();
+  int columns = 30, rows = 20;
+  for ( int j = 0; j < rows; ++j )
+  {
+    for ( int i = 0; i < columns; ++i )
+    {
+      mGraph->addVertex( QgsPoint( i + 0.3 * qrand() / RAND_MAX, j + 0.3 * qrand() / RAND_MAX ) );
+    }
+  }
+
+  for ( int v = 0; v < columns * rows; ++v )
+  {
+    QList<int> neighbours;
+    if ( v % columns + 1 < columns )
+      neighbours << v + 1;
+    if ( v + columns < columns * rows )
+      neighbours << v + columns;
+
+    foreach ( int w, neighbours )
+    {
+      double length = sqrt( mGraph->vertex( v ).point().sqrDist( mGraph->vertex( w ).point() ) );
+      if ( qrand() % 10 != 0 )
+        mGraph->addArc( v, w, QVector<QVariant>() << length * ( 1.0 + 2.0 * qrand() / RAND_MAX ) );
+      if ( qrand() % 10 != 0 )
+        mGraph->addArc( w, v, QVector<QVariant>() << length * ( 1.0 + 2.0 * qrand() / RAND_MAX ) );
+    }
+  }
+
+  mIsolatedVertex = mGraph->addVertex( QgsPoint( 100, 100 ) );
+}
+
+void TestQgsGraphRouter::cleanupTestCase()
+{
+  delete mGraph;
+}
+
+double TestQgsGraphRouter::pathCost( const QVector<int>& arcs, int start, int stop ) const
+{
+  double cost = 0;
+  int vertex = start;
+  foreach ( int arcIdx, arcs )
+  {
+    const QgsGraphArc& arc = mGraph->arc( arcIdx );
+    if ( arc.outVertex() != vertex )
+      return -1;
+    cost += arc.property( 0 ).toDouble();
+    vertex = arc.inVertex();
+  }
+  return vertex == stop ? cost : -1;
+}
+
+void TestQgsGraphRouter::dijkstra()
+{
+  QgsGraphRouter router( mGraph, 0 );
+  QCOMPARE( router.vertexCount(), mGraph->vertexCount() );
+  QCOMPARE( router.arcCount(), mGraph->arcCount() );
+  QVERIFY( router.heuristicFactor() >= 1.0 );
+
+  for ( int start = 0; start < mGraph->vertexCount(); start += 97 )
+  {
+    QVector<int> expectedTree, tree;
+    QVector<double> expectedCost, cost;
+    QgsGraphAnalyzer::dijkstra( mGraph, start, 0, &expectedTree, &expectedCost );
+    router.dijkstra( start, &tree, &cost );
+
+    QCOMPARE( cost.size(), expectedCost.size() );
+    for ( int i = 0; i < cost.size(); ++i )
+    {
+      QVERIFY( cost[i] == expectedCost[i] || qAbs( cost[i] - expectedCost[i] ) < 1e-9 );
+      QCOMPARE( tree[i] == -1, expectedTree[i] == -1 );
+    }
+  }
+}
+
+void TestQgsGraphRouter::shortestPath()
+{
+  QgsGraphRouter router( mGraph, 0 );
+
+  for ( int start = 0; start < mIsolatedVertex; start += 53 )
+  {
+    QVector<double> expectedCost;
+    QgsGraphAnalyzer::dijkstra( mGraph, start, 0, NULL, &expectedCost );
+
+    for ( int stop = 11; stop < mIsolatedVertex; stop += 41 )
+    {
+      if ( expectedCost[stop] == std::numeric_limits<double>::infinity() )
+        continue;
+
+      double tolerance = 1e-9 * ( 1.0 + expectedCost[stop] );
+      QVector<int> arcs;
+      double cost = router.shortestPath( start, stop, &arcs );
+      QVERIFY( qAbs( cost - expectedCost[stop] ) < tolerance );
+      QVERIFY( qAbs( pathCost( arcs, start, stop ) - cost ) < tolerance );
+
+      cost = router.shortestPathBidirectional( start, stop, &arcs );
+      QVERIFY( qAbs( cost - expectedCost[stop] ) < tolerance );
+      QVERIFY( qAbs( pathCost( arcs, start, stop ) - cost ) < tolerance );
+    }
+  }
+
+  // path to itself
+  QVector<int> arcs;
+  QCOMPARE( router.shortestPath( 5, 5, &arcs ), 0.0 );
+  QVERIFY( arcs.isEmpty() );
+  QCOMPARE( router.shortestPathBidirectional( 5, 5, &arcs ), 0.0 );
+  QVERIFY( arcs.isEmpty() );
+}
+
+void TestQgsGraphRouter::unreachable()
+{
+  QgsGraphRouter router( mGraph, 0 );
+  QVector<int> arcs;
+
+  QCOMPARE( router.shortestPath( 0, mIsolatedVertex, &arcs ), std::numeric_limits<double>::infinity() );
+  QVERIFY( arcs.isEmpty() );
+  QCOMPARE( router.shortestPathBidirectional( 0, mIsolatedVertex, &arcs ), std::numeric_limits<double>::infinity() );
+  QVERIFY( arcs.isEmpty() );
+  QCOMPARE( router.shortestPath( 0, -1 ), std::numeric_limits<double>::infinity() );
+}
+
+void TestQgsGraphRouter::costMatrix()
+{
+  QgsGraphRouter router( mGraph, 0 );
+
+  // duplicates and unreachable targets
+  QVector<int> targets;
+  targets << 3 << 250 << mIsolatedVertex << 599 << 3 << 0;
+  QVector<int> sources;
+  for ( int source = 0; source < mIsolatedVertex; source += 37 )
+    sources << source;
+
+  QVector< QVector<double> > matrix = router.costMatrix( sources, targets );
+  QCOMPARE( matrix.size(), sources.size() );
+
+  for ( int i = 0; i < sources.size(); ++i )
+  {
+    QVector<double> expectedCost;
+    QgsGraphAnalyzer::dijkstra( mGraph, sources[i], 0, NULL, &expectedCost );
+    QCOMPARE( matrix[i].size(), targets.size() );
+    for ( int j = 0; j < targets.size(); ++j )
+    {
+      QVERIFY( matrix[i][j] == expectedCost[ targets[j] ] || qAbs( matrix[i][j] - expectedCost[ targets[j] ] ) < 1e-9 );
+    }
+  }
+}
+
+QTEST_MAIN( TestQgsGraphRouter )
+#include "moc_testqgsgraphrouter.cxx"
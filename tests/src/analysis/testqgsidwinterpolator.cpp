@@ -0,0 +1,240 @@
+/***************************************************************************
+     testqgsidwinterpolator.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QtTest>
+
+#include <gdal.h>
+
+#include "qgsapplication.h"
+#include "qgsgeometry.h"
+#include "qgsgridfilewriter.h"
+#include "qgsidwinterpolator.h"
+#include "qgsvectordataprovider.h"
+#include "qgsvectorlayer.h"
+
+/** \ingroup UnitTests
+ * This is a unit test for the IDW interpolation
+ */
+class TestQgsIDWInterpolator: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void nearestNeighbours();
+    void searchRadius();
+    void exactHit();
+    void preparedWithoutData();
+    void gridFile();
+    void geoTiff();
+
+  private:
+    QList<QgsInterpolator::LayerData> layerData() const;
+
+    QgsVectorLayer* mLayer;
+};
+
+void TestQgsIDWInterpolator::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  // a 20 x 20 grid of sample points with value x + y
+  mLayer = new QgsVectorLayer( "Point?field=value:double", "samples", "memory" );
+  QgsFeatureList features;
+  for ( int i = 0; i < 20; ++i )
+  {
+    for ( int j = 0; j < 20; ++j )
+    {
+      QgsFeature f( mLayer->pendingFields() );
+      f.setAttribute( 0, i + j );
+      f.setGeometry( QgsGeometry::fromPoint( QgsPoint( i * 10, j * 10 ) ) );
+      features << f;
+    }
+  }
+  QVERIFY( mLayer->dataProvider()->addFeatures( features ) );
+}
+
+void TestQgsIDWInterpolator::cleanupTestCase()
+{
+  delete mLayer;
+}
+
+QList<QgsInterpolator::LayerData> TestQgsIDWInterpolator::layerData() const
+{
+  QgsInterpolator::LayerData ld;
+  ld.vectorLayer = mLayer;
+  ld.zCoordInterpolation = false;
+  ld.interpolationAttribute = 0;
+  ld.mInputType = QgsInterpolator::POINTS;
+  return QList<QgsInterpolator::LayerData>() << ld;
+}
+
+void TestQgsIDWInterpolator::nearestNeighbours()
+{
+  QgsIDWInterpolator all( layerData() );
+  QgsIDWInterpolator nearest( layerData() );
+  nearest.setSearchMode( QgsIDWInterpolator::NearestNeighbours );
+
+  // with all points as neighbours the result is the same as without index
+  nearest.setNumberOfNeighbours( 400 );
+  double expected, result;
+  QCOMPARE( all.interpolatePoint( 33.3, 71.7, expected ), 0 );
+  QCOMPARE( nearest.interpolatePoint( 33.3, 71.7, result ), 0 );
+  QVERIFY( qAbs( result - expected ) < 1e-9 );
+
+  // the four neighbours around the center of a cell are equally weighted
+  nearest.setNumberOfNeighbours( 4 );
+  QCOMPARE( nearest.interpolatePoint( 45.0, 85.0, result ), 0 );
+  QVERIFY( qAbs( result - 13.0 ) < 1e-9 );
+
+  // locations outside the samples use the closest ones
+  QCOMPARE( nearest.interpolatePoint( -1000.0, -1000.0, result ), 0 );
+  QVERIFY( result < 2.0 );
+}
+
+void TestQgsIDWInterpolator::searchRadius()
+{
+  QgsIDWInterpolator idw( layerData() );
+  idw.setSearchMode( QgsIDWInterpolator::SearchRadius );
+  idw.setSearchRadius( 7.5 );
+
+  double result;
+  QCOMPARE( idw.interpolatePoint( 45.0, 85.0, result ), 0 );
+  QVERIFY( qAbs( result - 13.0 ) < 1e-9 );
+
+  // no samples within the radius
+  QCOMPARE( idw.interpolatePoint( 500.0, 500.0, result ), 1 );
+}
+
+void TestQgsIDWInterpolator::exactHit()
+{
+  QgsIDWInterpolator idw( layerData() );
+  idw.setSearchMode( QgsIDWInterpolator::NearestNeighbours );
+
+  double result;
+  QCOMPARE( idw.interpolatePoint( 50.0, 30.0, result ), 0 );
+  QCOMPARE( result, 8.0 );
+}
+
+void TestQgsIDWInterpolator::preparedWithoutData()
+{
+  QgsVectorLayer empty( "Point?field=value:double", "empty", "memory" );
+  QgsInterpolator::LayerData ld = layerData().at( 0 );
+  ld.vectorLayer = &empty;
+
+  QgsIDWInterpolator idw( QList<QgsInterpolator::LayerData>() << ld );
+  idw.setSearchMode( QgsIDWInterpolator::NearestNeighbours );
+  QVERIFY( idw.prepareConcurrentInterpolation() );
+
+  // nothing is cached while interpolating, there is nothing to interpolate from
+  double result;
+  QCOMPARE( idw.interpolatePoint( 45.0, 85.0, result ), 1 );
+}
+
+void TestQgsIDWInterpolator::gridFile()
+{
+  QgsIDWInterpolator idw( layerData() );
+  idw.setSearchMode( QgsIDWInterpolator::NearestNeighbours );
+  idw.setNumberOfNeighbours( 8 );
+
+  QString fileName = QDir::tempPath() + QDir::separator() + "idw_grid.asc";
+  QgsRectangle extent( 0, 0, 190, 190 );
+  QgsGridFileWriter writer( &idw, fileName, extent, 38, 38, 5.0, 5.0 );
+  QCOMPARE( writer.writeFile( false ), 0 );
+
+  // rows are written in order regardless of how many threads interpolate them
+  QFile file( fileName );
+  QVERIFY( file.open( QIODevice::ReadOnly ) );
+  QTextStream stream( &file );
+  QStringList lines;
+  while ( !stream.atEnd() )
+  {
+    lines << stream.readLine();
+  }
+  QCOMPARE( lines.size(), 6 + 38 );
+
+  for ( int row = 0; row < 38; row += 7 )
+  {
+    QStringList values = lines.at( 6 + row ).split( " ", QString::SkipEmptyParts );
+    QCOMPARE( values.size(), 38 );
+    for ( int column = 0; column < 38; column += 5 )
+    {
+      double expected;
+      QCOMPARE( idw.interpolatePoint( 2.5 + column * 5.0, 187.5 - row * 5.0, expected ), 0 );
+      QVERIFY( qAbs( values.at( column ).toDouble() - expected ) < 1e-5 * qMax( 1.0, qAbs( expected ) ) );
+    }
+  }
+
+  file.close();
+  QFile::remove( fileName );
+  QFile::remove( QDir::tempPath() + QDir::separator() + "idw_grid.prj" );
+}
+
+void TestQgsIDWInterpolator::geoTiff()
+{
+  QgsIDWInterpolator idw( layerData() );
+  idw.setSearchMode( QgsIDWInterpolator::NearestNeighbours );
+  idw.setNumberOfNeighbours( 8 );
+
+  // more rows and columns than one block, so there are partial blocks and overviews
+  QString fileName = QDir::tempPath() + QDir::separator() + "idw_grid.tif";
+  QgsRectangle extent( 0, 0, 190, 190 );
+  QgsGridFileWriter writer( &idw, fileName, extent, 300, 400, 190.0 / 300, 190.0 / 400 );
+  QCOMPARE( writer.outputFormat(), QgsGridFileWriter::GeoTiff );
+  QCOMPARE( writer.writeFile( false ), 0 );
+
+  GDALAllRegister();
+  GDALDatasetH dataset = GDALOpen( fileName.toUtf8().constData(), GA_ReadOnly );
+  QVERIFY( dataset );
+  QCOMPARE( GDALGetRasterXSize( dataset ), 300 );
+  QCOMPARE( GDALGetRasterYSize( dataset ), 400 );
+
+  double geoTransform[6];
+  QCOMPARE( GDALGetGeoTransform( dataset, geoTransform ), CE_None );
+  QCOMPARE( geoTransform[0], 0.0 );
+  QCOMPARE( geoTransform[3], 190.0 );
+  QCOMPARE( geoTransform[5], -190.0 / 400 );
+
+  GDALRasterBandH band = GDALGetRasterBand( dataset, 1 );
+  int blockXSize, blockYSize;
+  GDALGetBlockSize( band, &blockXSize, &blockYSize );
+  QCOMPARE( blockXSize, 256 );
+  QCOMPARE( blockYSize, 256 );
+  QCOMPARE( GDALGetOverviewCount( band ), 1 );
+  QCOMPARE( GDALGetRasterNoDataValue( band, NULL ), -9999.0 );
+
+  QVector<float> line( 300 );
+  for ( int row = 0; row < 400; row += 37 )
+  {
+    QCOMPARE( GDALRasterIO( band, GF_Read, 0, row, 300, 1, line.data(), 300, 1, GDT_Float32, 0, 0 ), CE_None );
+    for ( int column = 0; column < 300; column += 23 )
+    {
+      double expected;
+      QCOMPARE( idw.interpolatePoint(( column + 0.5 ) * 190.0 / 300, 190.0 - ( row + 0.5 ) * 190.0 / 400, expected ), 0 );
+      QCOMPARE( line[column], ( float ) expected );
+    }
+  }
+
+  GDALClose( dataset );
+  QFile::remove( fileName );
+}
+
+QTEST_MAIN( TestQgsIDWInterpolator )
+#include "moc_testqgsidwinterpolator.cxx"
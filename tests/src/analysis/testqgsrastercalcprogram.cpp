@@ -0,0 +1,174 @@
+/***************************************************************************
+     testqgsrastercalcprogram.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QMap>
+#include <QStringList>
+#include <QtTest>
+#include <QVector>
+
+#include "qgsrastercalcnode.h"
+#include "qgsrastercalcprogram.h"
+#include "qgsrastermatrix.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+/** \ingroup UnitTests
+ * This is a unit test for the compiled evaluation of raster calculator expressions
+ */
+class TestQgsRasterCalcProgram: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+
+    void sameAsTree_data();
+    void sameAsTree();
+    void numberExpression();
+    void unknownRaster();
+
+  private:
+    QStringList mRefs;
+    QVector<double> mNodataValues;
+    QVector< QVector<float> > mData;
+};
+
+void TestQgsRasterCalcProgram::initTestCase()
+{
+  // three rasters with nodata cells, zeros and negative values. 3000 cells are more than one evaluation chunk
+  mRefs << "a@1" << "b@1" << "c@1";
+  mNodataValues << -9999 << 0 << -FLT_MAX;
+  qsrand( 5 );
+  for ( int k = 0; k < mRefs.size(); ++k )
+  {
+    QVector<float> values( 3000 );
+    for ( int i = 0; i < values.size(); ++i )
+    {
+      int r = qrand() % 10;
+      if ( r == 0 )
+        values[i] = mNodataValues[k];
+      else if ( r == 1 )
+        values[i] = 0;
+      else if ( r == 2 )
+        values[i] = qrand() % 4;
+      else
+        values[i] = ( qrand() % 20000 - 10000 ) / 313.0;
+    }
+    mData << values;
+  }
+}
+
+void TestQgsRasterCalcProgram::sameAsTree_data()
+{
+  QTest::addColumn<QString>( "formula" );
+  QTest::addColumn<bool>( "exact" );
+
+  QTest::newRow( "arithmetic" ) << "a@1 + b@1 * 2 - c@1" << true;
+  QTest::newRow( "division" ) << "a@1 / b@1 + c@1 / 0" << true;
+  QTest::newRow( "power" ) << "c@1 ^ b@1" << true;
+  // the expression tree calculates powers with a number operand in float precision
+  QTest::newRow( "power of numbers" ) << "a@1 ^ 0.5 + 2 ^ b@1" << false;
+  QTest::newRow( "functions" ) << "sqrt( a@1 ) * sin( b@1 ) - cos( c@1 ) + tan( a@1 )" << true;
+  QTest::newRow( "inverse functions" ) << "asin( a@1 / 100 ) + acos( b@1 / 100 ) - atan( c@1 )" << true;
+  QTest::newRow( "comparisons" ) << "( a@1 > 3 ) + ( b@1 < c@1 ) + ( a@1 = 0 ) + ( c@1 != 1 ) + ( b@1 >= 2 ) + ( 2 <= a@1 )" << true;
+  QTest::newRow( "logic" ) << "( a@1 > 0 AND b@1 > 0 ) OR c@1 = 0" << true;
+  QTest::newRow( "sign" ) << "-a@1 - -( b@1 * c@1 )" << true;
+  QTest::newRow( "folded numbers" ) << "a@1 * ( 2 + 3 * 4 ) - sqrt( 16 )" << true;
+  QTest::newRow( "raster only" ) << "b@1" << true;
+}
+
+void TestQgsRasterCalcProgram::sameAsTree()
+{
+  QFETCH( QString, formula );
+  QFETCH( bool, exact );
+
+  QString errorString;
+  QgsRasterCalcNode* node = QgsRasterCalcNode::parseRasterCalcString( formula, errorString );
+  QVERIFY( node );
+
+  int nCells = mData[0].size();
+  QMap<QString, QgsRasterMatrix*> matrices;
+  for ( int k = 0; k < mRefs.size(); ++k )
+  {
+    float* values = new float[nCells];
+    memcpy( values, mData[k].constData(), nCells * sizeof( float ) );
+    matrices.insert( mRefs[k], new QgsRasterMatrix( nCells, 1, values, mNodataValues[k] ) );
+  }
+  QgsRasterMatrix expected;
+  QVERIFY( node->calculate( matrices, expected ) );
+  QVERIFY( !expected.isNumber() );
+
+  QgsRasterCalcProgram program( node, mRefs, mNodataValues );
+  QVERIFY( program.isValid() );
+  const float* inputs[3] = { mData[0].constData(), mData[1].constData(), mData[2].constData() };
+  QVector<float> result( nCells );
+  program.evaluate( inputs, nCells, result.data(), -1.5 );
+
+  for ( int i = 0; i < nCells; ++i )
+  {
+    float value = expected.data()[i];
+    if ( value == expected.nodataValue() )
+    {
+      QCOMPARE( result[i], -1.5f );
+    }
+    else if ( value != value )
+    {
+      QVERIFY( result[i] != result[i] );
+    }
+    else if ( exact )
+    {
+      // the results are exactly the same as the ones of the expression tree
+      QVERIFY( memcmp( &value, &result[i], sizeof( float ) ) == 0 );
+    }
+    else
+    {
+      QVERIFY( qAbs( value - result[i] ) <= 4 * FLT_EPSILON * qMax( 1.0f, qAbs( value ) ) );
+    }
+  }
+
+  qDeleteAll( matrices );
+  delete node;
+}
+
+void TestQgsRasterCalcProgram::numberExpression()
+{
+  QString errorString;
+  QgsRasterCalcNode* node = QgsRasterCalcNode::parseRasterCalcString( "2 * 3 + atan( 0 )", errorString );
+  QVERIFY( node );
+  QgsRasterCalcProgram program( node, mRefs, mNodataValues );
+  delete node;
+  QVERIFY( program.isValid() );
+
+  QVector<float> result( 10 );
+  program.evaluate( 0, result.size(), result.data(), -1.5 );
+  for ( int i = 0; i < result.size(); ++i )
+  {
+    QCOMPARE( result[i], 6.0f );
+  }
+}
+
+void TestQgsRasterCalcProgram::unknownRaster()
+{
+  QString errorString;
+  QgsRasterCalcNode* node = QgsRasterCalcNode::parseRasterCalcString( "a@1 + d@1", errorString );
+  QVERIFY( node );
+  QgsRasterCalcProgram program( node, mRefs, mNodataValues );
+  delete node;
+  QVERIFY( !program.isValid() );
+}
+
+QTEST_MAIN( TestQgsRasterCalcProgram )
+#include "moc_testqgsrastercalcprogram.cxx"
@@ -16,8 +16,11 @@ Email                : sherman at mrcc dot com
 
 //header for class being tested
 #include <qgsgeometryanalyzer.h>
+#include <qgsoverlayanalyzer.h>
 #include <qgsapplication.h>
 #include <qgsproviderregistry.h>
+#include <qgsvectordataprovider.h>
+#include <qgsvectorlayer.h>
 
 class TestQgsVectorAnalyzer: public QObject
 {
@@ -36,6 +39,10 @@ class TestQgsVectorAnalyzer: public QObject
     void simplifyGeometry( );
     void polygonCentroids( );
     void layerExtent( );
+    void bufferLayer( );
+    void dissolveLayer( );
+    void intersectLayers( );
+    void invalidGeometries( );
   private:
     QgsGeometryAnalyzer mAnalyzer;
     QgsVectorLayer * mpLineLayer;
@@ -129,5 +136,94 @@ void TestQgsVectorAnalyzer::layerExtent( )
   QVERIFY( mAnalyzer.extent( mpPointLayer, myFileName ) );
 }
 
+void TestQgsVectorAnalyzer::bufferLayer( )
+{
+  QString myTmpDir = QDir::tempPath() + QDir::separator() ;
+  QString myFileName = myTmpDir +  "buffer_layer.shp";
+  QVERIFY( mAnalyzer.buffer( mpPointLayer, myFileName, 1.0 ) );
+  QgsVectorLayer bufferLayer( myFileName, "buffer_layer", "ogr" );
+  QVERIFY( bufferLayer.isValid() );
+  QCOMPARE( bufferLayer.featureCount(), mpPointLayer->featureCount() );
+
+  myFileName = myTmpDir +  "buffer_dissolve_layer.shp";
+  QVERIFY( mAnalyzer.buffer( mpPointLayer, myFileName, 1.0, false, true ) );
+  QgsVectorLayer dissolveLayer( myFileName, "buffer_dissolve_layer", "ogr" );
+  QVERIFY( dissolveLayer.isValid() );
+  QCOMPARE( dissolveLayer.featureCount(), 1L );
+}
+
+void TestQgsVectorAnalyzer::dissolveLayer( )
+{
+  QString myTmpDir = QDir::tempPath() + QDir::separator() ;
+  QString myFileName = myTmpDir +  "dissolve_layer.shp";
+  QVERIFY( mAnalyzer.dissolve( mpPolyLayer, myFileName ) );
+  QgsVectorLayer dissolveLayer( myFileName, "dissolve_layer", "ogr" );
+  QVERIFY( dissolveLayer.isValid() );
+  QCOMPARE( dissolveLayer.featureCount(), 1L );
+
+  //one feature per distinct value of the first field
+  QSet<QString> values;
+  QgsFeatureIterator fit = mpPolyLayer->getFeatures();
+  QgsFeature f;
+  while ( fit.nextFeature( f ) )
+  {
+    values.insert( f.attribute( 0 ).toString() );
+  }
+  myFileName = myTmpDir +  "dissolve_field_layer.shp";
+  QVERIFY( mAnalyzer.dissolve( mpPolyLayer, myFileName, false, 0 ) );
+  QgsVectorLayer dissolveFieldLayer( myFileName, "dissolve_field_layer", "ogr" );
+  QVERIFY( dissolveFieldLayer.isValid() );
+  QCOMPARE( dissolveFieldLayer.featureCount(), ( long ) values.size() );
+}
+
+void TestQgsVectorAnalyzer::intersectLayers( )
+{
+  QString myTmpDir = QDir::tempPath() + QDir::separator() ;
+  QString myFileName = myTmpDir +  "intersection_layer.shp";
+  QgsOverlayAnalyzer overlayAnalyzer;
+  QVERIFY( overlayAnalyzer.intersection( mpPolyLayer, mpPolyLayer, myFileName ) );
+  QgsVectorLayer intersectionLayer( myFileName, "intersection_layer", "ogr" );
+  QVERIFY( intersectionLayer.isValid() );
+  //every polygon intersects at least itself
+  QVERIFY( intersectionLayer.featureCount() >= mpPolyLayer->featureCount() );
+  QCOMPARE( intersectionLayer.pendingFields().count(), 2 * mpPolyLayer->pendingFields().count() );
+}
+
+void TestQgsVectorAnalyzer::invalidGeometries( )
+{
+  //self-intersecting polygons make GEOS throw topology exceptions in the worker threads
+  QgsVectorLayer invalidLayer( "Polygon?field=id:integer", "invalid", "memory" );
+  QVERIFY( invalidLayer.isValid() );
+  QgsFeatureList features;
+  for ( int i = 0; i < 500; ++i )
+  {
+    double x = ( i % 25 ) * 5;
+    double y = ( i / 25 ) * 5;
+    QgsFeature f( invalidLayer.pendingFields() );
+    f.setAttribute( 0, i % 3 );
+    QString wkt = i % 2 == 0 ? "POLYGON((%1 %2, %3 %4, %3 %2, %1 %4, %1 %2))" : "POLYGON((%1 %2, %3 %2, %3 %4, %1 %4, %1 %2))";
+    f.setGeometry( QgsGeometry::fromWkt( wkt.arg( x ).arg( y ).arg( x + 8 ).arg( y + 8 ) ) );
+    features << f;
+  }
+  QVERIFY( invalidLayer.dataProvider()->addFeatures( features ) );
+
+  //a failing union must not drop the group of the invalid geometry
+  QString myTmpDir = QDir::tempPath() + QDir::separator() ;
+  QVERIFY( mAnalyzer.buffer( &invalidLayer, myTmpDir + "invalid_buffer_layer.shp", 1.0, false, true ) );
+  QgsVectorLayer bufferLayer( myTmpDir + "invalid_buffer_layer.shp", "buffer", "ogr" );
+  QCOMPARE( bufferLayer.featureCount(), 1L );
+
+  QVERIFY( mAnalyzer.dissolve( &invalidLayer, myTmpDir + "invalid_dissolve_layer.shp", false, 0 ) );
+  QgsVectorLayer dissolveLayer( myTmpDir + "invalid_dissolve_layer.shp", "dissolve", "ogr" );
+  QCOMPARE( dissolveLayer.featureCount(), 3L );
+
+  QVERIFY( mAnalyzer.dissolve( &invalidLayer, myTmpDir + "invalid_dissolve_all_layer.shp", false, -1 ) );
+  QgsVectorLayer dissolveAllLayer( myTmpDir + "invalid_dissolve_all_layer.shp", "dissolve", "ogr" );
+  QCOMPARE( dissolveAllLayer.featureCount(), 1L );
+
+  QgsOverlayAnalyzer overlayAnalyzer;
+  QVERIFY( overlayAnalyzer.intersection( &invalidLayer, &invalidLayer, myTmpDir + "invalid_intersection_layer.shp" ) );
+}
+
 QTEST_MAIN( TestQgsVectorAnalyzer )
 #include "moc_testqgsvectoranalyzer.cxx"
@@ -20,6 +20,8 @@
 #include "qgsvectorlayer.h"
 #include "qgszonalstatistics.h"
 
+#include <math.h>
+
 /** \ingroup UnitTests
  * This is a unit test for the zonal statistics class
  */
@@ -33,6 +35,7 @@ class TestQgsZonalStatistics: public QObject
     void cleanup() {};
 
     void testStatistics();
+    void testAdditionalStatistics();
 
   private:
     QgsVectorLayer* mVectorLayer;
@@ -116,5 +119,44 @@ void TestQgsZonalStatistics::testStatistics()
   QCOMPARE( f.attribute( "myqgis2_me" ).toDouble(), 0.833333333333333 );
 }
 
+void TestQgsZonalStatistics::testAdditionalStatistics()
+{
+  QgsZonalStatistics zs( mVectorLayer, mRasterPath, "x_", 1 );
+  zs.setStatistics( QgsZonalStatistics::Min | QgsZonalStatistics::Max | QgsZonalStatistics::StDev
+                    | QgsZonalStatistics::Median | QgsZonalStatistics::Histogram );
+  zs.setHistogramBins( 2, 0, 1 );
+  QCOMPARE( zs.calculateStatistics( NULL ), 0 );
+  QCOMPARE( mVectorLayer->fieldNameIndex( "x_count" ), -1 );
+
+  QgsFeature f;
+  QgsFeatureRequest request;
+  request.setFilterFid( 0 );
+  bool fetched = mVectorLayer->getFeatures( request ).nextFeature( f );
+  QVERIFY( fetched );
+  QCOMPARE( f.attribute( "x_min" ).toDouble(), 0.0 );
+  QCOMPARE( f.attribute( "x_max" ).toDouble(), 1.0 );
+  QVERIFY( qAbs( f.attribute( "x_stdev" ).toDouble() - sqrt( 2.0 / 9.0 ) ) < 1e-9 );
+  QCOMPARE( f.attribute( "x_median" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "x_hist" ).toString(), QString( "4,8" ) );
+
+  request.setFilterFid( 1 );
+  fetched = mVectorLayer->getFeatures( request ).nextFeature( f );
+  QVERIFY( fetched );
+  QCOMPARE( f.attribute( "x_min" ).toDouble(), 0.0 );
+  QCOMPARE( f.attribute( "x_max" ).toDouble(), 1.0 );
+  QVERIFY( qAbs( f.attribute( "x_stdev" ).toDouble() - sqrt( 20.0 / 81.0 ) ) < 1e-9 );
+  QCOMPARE( f.attribute( "x_median" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "x_hist" ).toString(), QString( "4,5" ) );
+
+  request.setFilterFid( 2 );
+  fetched = mVectorLayer->getFeatures( request ).nextFeature( f );
+  QVERIFY( fetched );
+  QCOMPARE( f.attribute( "x_min" ).toDouble(), 0.0 );
+  QCOMPARE( f.attribute( "x_max" ).toDouble(), 1.0 );
+  QVERIFY( qAbs( f.attribute( "x_stdev" ).toDouble() - sqrt( 5.0 / 36.0 ) ) < 1e-9 );
+  QCOMPARE( f.attribute( "x_median" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "x_hist" ).toString(), QString( "1,5" ) );
+}
+
 QTEST_MAIN( TestQgsZonalStatistics )
 #include "moc_testqgszonalstatistics.cxx"
@@ -29,6 +29,12 @@ class TestQgsMapRendererJob : public QObject
 
     void testCache();
 
+    void testTiled();
+
+    void testLayerStatistics();
+
+    void testPartialCache();
+
   private:
     QStringList mLayerIds;
 };
@@ -274,6 +280,83 @@ void TestQgsMapRendererJob::testCache()
   QgsMapLayerRegistry::instance()->removeMapLayer( l->id() );
 }
 
+void TestQgsMapRendererJob::testTiled()
+{
+  QgsMapSettings settings( _mapSettings( mLayerIds ) );
+
+  QgsMapRendererParallelJob job( settings );
+  job.start();
+  job.waitForFinished();
+  QImage img = job.renderedImage();
+
+  QgsMapRendererParallelJob jobT( settings );
+  jobT.setTiledRenderingEnabled( true );
+  jobT.setTileSize( QSize( 100, 100 ) );
+  jobT.setMaxThreads( 3 );
+  QCOMPARE( jobT.isTiledRenderingEnabled(), true );
+  jobT.start();
+  jobT.waitForFinished();
+  QImage imgT = jobT.renderedImage();
+
+  QCOMPARE( jobT.errors().count(), 0 );
+  QCOMPARE( img, imgT );
+}
+
+
+void TestQgsMapRendererJob::testLayerStatistics()
+{
+  QgsMapSettings settings( _mapSettings( mLayerIds ) );
+
+  QgsMapRendererParallelJob job( settings );
+  job.start();
+  job.waitForFinished();
+
+  QCOMPARE( job.layerStatistics().count(), mLayerIds.count() );
+  foreach ( const QgsMapRendererJob::LayerStatistics& stats, job.layerStatistics() )
+  {
+    QVERIFY( mLayerIds.contains( stats.layerID ) );
+    QVERIFY( stats.finished );
+    QVERIFY( !stats.cached );
+    QVERIFY( stats.featureCount >= 0 );
+  }
+}
+
+
+void TestQgsMapRendererJob::testPartialCache()
+{
+  QgsMapRendererCache cache;
+
+  QImage img( 100, 100, QImage::Format_ARGB32_Premultiplied );
+  img.fill( qRgb( 255, 0, 0 ) );
+
+  cache.init( QgsRectangle( 0, 0, 100, 100 ), 1000 );
+  cache.setCacheImage( "layer", img );
+  QCOMPARE( cache.cacheImage( "layer" ), img );
+
+  // pan by 10 pixels to the right
+  QgsRectangle extent( 10, 0, 110, 100 );
+  QCOMPARE( cache.init( extent, 1000 ), false );
+  QVERIFY( cache.cacheImage( "layer" ).isNull() );
+
+  QList<QRect> exposed;
+  QImage partial = cache.partialCacheImage( "layer", extent, QSize( 100, 100 ), exposed );
+  QVERIFY( !partial.isNull() );
+  QCOMPARE( exposed.count(), 1 );
+  QCOMPARE( exposed[0], QRect( 90, 0, 10, 100 ) );
+  QCOMPARE( partial.pixel( 0, 0 ), img.pixel( 0, 0 ) );
+  QCOMPARE( qAlpha( partial.pixel( 95, 50 ) ), 0 );
+
+  // different scale cannot be reused
+  cache.init( extent, 2000 );
+  QVERIFY( cache.partialCacheImage( "layer", extent, QSize( 100, 100 ), exposed ).isNull() );
+
+  // least recently used images get evicted
+  cache.setCacheImage( "layer2", img );
+  cache.setMaxMemory( img.byteCount() );
+  QCOMPARE( cache.memoryUsage(), ( qint64 ) img.byteCount() );
+  QCOMPARE( cache.cacheImage( "layer2" ), img );
+}
+
 
 QTEST_MAIN( TestQgsMapRendererJob )
 #include "moc_testmaprendererjob.cxx"
@@ -0,0 +1,162 @@
+/***************************************************************************
+     testqgscoordinatetransform.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QtConcurrentMap>
+
+#include <qgsapplication.h>
+#include <qgscoordinatereferencesystem.h>
+#include <qgscoordinatetransform.h>
+
+class TestQgsCoordinateTransform: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void batch();
+    void batchReverse();
+    void batchConcurrent();
+    void batchShortCircuit();
+
+  private:
+    //! grid of lat/long coordinates
+    static void coordinates( int count, QVector<double>& x, QVector<double>& y, QVector<double>& z );
+};
+
+void TestQgsCoordinateTransform::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+}
+
+void TestQgsCoordinateTransform::cleanupTestCase()
+{
+  QgsApplication::exitQgis();
+}
+
+void TestQgsCoordinateTransform::coordinates( int count, QVector<double>& x, QVector<double>& y, QVector<double>& z )
+{
+  x.resize( count );
+  y.resize( count );
+  z.fill( 0.0, count );
+  for ( int i = 0; i < count; ++i )
+  {
+    x[i] = -170.0 + ( i % 340 );
+    y[i] = -80.0 + ( i / 340 % 160 );
+  }
+}
+
+void TestQgsCoordinateTransform::batch()
+{
+  QgsCoordinateReferenceSystem wgs84( "EPSG:4326" );
+  QgsCoordinateReferenceSystem mercator( "EPSG:3857" );
+  QgsCoordinateTransform ct( wgs84, mercator );
+
+  // large enough to be split across threads, odd to get an uneven last chunk
+  int count = 100001;
+  QVector<double> x, y, z;
+  coordinates( count, x, y, z );
+  QVector<double> expectedX = x, expectedY = y, expectedZ = z;
+
+  ct.transformCoords( count, expectedX.data(), expectedY.data(), expectedZ.data() );
+  ct.transformCoordsBatch( count, x.data(), y.data(), z.data() );
+
+  QCOMPARE( x, expectedX );
+  QCOMPARE( y, expectedY );
+}
+
+void TestQgsCoordinateTransform::batchReverse()
+{
+  QgsCoordinateReferenceSystem wgs84( "EPSG:4326" );
+  QgsCoordinateReferenceSystem mercator( "EPSG:3857" );
+  QgsCoordinateTransform ct( wgs84, mercator );
+
+  int count = 20000;
+  QVector<double> x, y, z;
+  coordinates( count, x, y, z );
+  QVector<double> originalX = x, originalY = y;
+
+  ct.transformCoordsBatch( count, x.data(), y.data(), z.data() );
+  ct.transformCoordsBatch( count, x.data(), y.data(), z.data(), QgsCoordinateTransform::ReverseTransform );
+
+  for ( int i = 0; i < count; ++i )
+  {
+    QVERIFY( qAbs( x[i] - originalX[i] ) < 1e-8 );
+    QVERIFY( qAbs( y[i] - originalY[i] ) < 1e-8 );
+  }
+}
+
+struct BatchTask
+{
+  const QgsCoordinateTransform* ct;
+  QVector<double> x, y, z;
+};
+
+static void transformBatchTask( BatchTask& task )
+{
+  task.ct->transformCoordsBatch( task.x.size(), task.x.data(), task.y.data(), task.z.data() );
+}
+
+void TestQgsCoordinateTransform::batchConcurrent()
+{
+  QgsCoordinateReferenceSystem wgs84( "EPSG:4326" );
+  QgsCoordinateReferenceSystem utm( "EPSG:32633" );
+  QgsCoordinateTransform ct( wgs84, utm );
+
+  QVector<double> expectedX, expectedY, expectedZ;
+  coordinates( 10000, expectedX, expectedY, expectedZ );
+  for ( int i = 0; i < expectedX.size(); ++i )
+    expectedX[i] = 10.0 + expectedX[i] / 100.0;
+
+  // the same transform used from several threads at the same time
+  QVector<BatchTask> tasks( 8 );
+  for ( int i = 0; i < tasks.size(); ++i )
+  {
+    tasks[i].ct = &ct;
+    tasks[i].x = expectedX;
+    tasks[i].y = expectedY;
+    tasks[i].z = expectedZ;
+  }
+
+  ct.transformCoords( expectedX.size(), expectedX.data(), expectedY.data(), expectedZ.data() );
+  QtConcurrent::blockingMap( tasks, transformBatchTask );
+
+  foreach ( const BatchTask& task, tasks )
+  {
+    QCOMPARE( task.x, expectedX );
+    QCOMPARE( task.y, expectedY );
+  }
+}
+
+void TestQgsCoordinateTransform::batchShortCircuit()
+{
+  QgsCoordinateReferenceSystem wgs84( "EPSG:4326" );
+  QgsCoordinateTransform ct( wgs84, wgs84 );
+
+  QVector<double> x, y, z;
+  coordinates( 5000, x, y, z );
+  QVector<double> originalX = x, originalY = y;
+
+  ct.transformCoordsBatch( x.size(), x.data(), y.data(), z.data() );
+  QCOMPARE( x, originalX );
+  QCOMPARE( y, originalY );
+}
+
+QTEST_MAIN( TestQgsCoordinateTransform )
+#include "moc_testqgscoordinatetransform.cxx"
@@ -21,6 +21,7 @@
 #include <qgsapplication.h>
 //header for class being tested
 #include <qgsdistancearea.h>
+#include <qgsgeometry.h>
 #include <qgspoint.h>
 #include "qgslogger.h"
 
@@ -33,6 +34,7 @@ class TestQgsDistanceArea: public QObject
     void basic();
     void test_distances();
     void unit_conversions();
+    void measureGeometry();
 };
 
 void TestQgsDistanceArea::initTestCase()
@@ -161,6 +163,40 @@ void TestQgsDistanceArea::unit_conversions()
   QVERIFY( myTxt.startsWith( expectedTxt ) ); // Ignore units for now.
 };
 
+void TestQgsDistanceArea::measureGeometry()
+{
+  // measure() walks the WKB, the results must match the point list variants
+  QgsPolyline exterior, interior, line;
+  exterior << QgsPoint( 10, 50 ) << QgsPoint( 12, 50 ) << QgsPoint( 12, 52 ) << QgsPoint( 10, 52 ) << QgsPoint( 10, 50 );
+  interior << QgsPoint( 10.5, 50.5 ) << QgsPoint( 11, 50.5 ) << QgsPoint( 11, 51 ) << QgsPoint( 10.5, 50.5 );
+  line << QgsPoint( 10, 50 ) << QgsPoint( 11, 51 ) << QgsPoint( 13, 50 );
+
+  QgsPolygon polygon;
+  polygon << exterior << interior;
+  QgsMultiPolyline multiLine;
+  multiLine << line << interior;
+
+  QgsGeometry* polygonGeometry = QgsGeometry::fromPolygon( polygon );
+  QgsGeometry* multiLineGeometry = QgsGeometry::fromMultiPolyline( multiLine );
+
+  QgsDistanceArea da;
+  for ( int ellipsoidal = 0; ellipsoidal < 2; ++ellipsoidal )
+  {
+    da.setSourceAuthId( "EPSG:4030" );
+    da.setEllipsoid( "WGS84" );
+    da.setEllipsoidalMode( ellipsoidal );
+
+    QList<QgsPoint> exteriorPoints = exterior.toList();
+    QList<QgsPoint> interiorPoints = interior.toList();
+    QCOMPARE( da.measure( polygonGeometry ), da.measurePolygon( exteriorPoints ) - da.measurePolygon( interiorPoints ) );
+    QCOMPARE( da.measurePerimeter( polygonGeometry ), da.measureLine( exteriorPoints ) );
+    QCOMPARE( da.measure( multiLineGeometry ), da.measureLine( line.toList() ) + da.measureLine( interiorPoints ) );
+  }
+
+  delete polygonGeometry;
+  delete multiLineGeometry;
+}
+
 QTEST_MAIN( TestQgsDistanceArea )
 #include "moc_testqgsdistancearea.cxx"
 
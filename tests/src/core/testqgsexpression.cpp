@@ -856,6 +856,95 @@ class TestQgsExpression: public QObject
       QgsExpression::unsetSpecialColumn( "$var1" );
     }
 
+    void eval_compiled_data()
+    {
+      QTest::addColumn<QString>( "string" );
+
+      QTest::newRow( "column" ) << "name";
+      QTest::newRow( "compare num" ) << "value > 10";
+      QTest::newRow( "compare num swapped" ) << "10 >= value";
+      QTest::newRow( "compare double" ) << "ratio < 0.75";
+      QTest::newRow( "compare str" ) << "name = 'second'";
+      QTest::newRow( "compare str swapped" ) << "'second' < name";
+      QTest::newRow( "compare numeric string" ) << "code = 5";
+      QTest::newRow( "compare null" ) << "empty = 3";
+      QTest::newRow( "constant folding" ) << "value > 2 * 3 + 1";
+      QTest::newRow( "and short-circuit" ) << "value > 10 and name = 'second'";
+      QTest::newRow( "or short-circuit" ) << "value > 10 or empty is null";
+      QTest::newRow( "and failing" ) << "value > 10 and value / name";
+      QTest::newRow( "or failing" ) << "value > 10 or 'x'";
+      QTest::newRow( "or failing column" ) << "value > 10 or name";
+      QTest::newRow( "and failing column" ) << "value < 10 and name";
+      QTest::newRow( "like" ) << "name like 'sec%'";
+      QTest::newRow( "not ilike" ) << "name not ilike 'F_RST'";
+      QTest::newRow( "regexp" ) << "name ~ 'ir'";
+      QTest::newRow( "in" ) << "value in (1, 20, 'abc')";
+      QTest::newRow( "not in null" ) << "name not in ('first', null)";
+      QTest::newRow( "in columns" ) << "value in (ratio, 20)";
+      QTest::newRow( "arithmetic" ) << "value * ratio + 1";
+      QTest::newRow( "unary" ) << "-value + 1";
+      QTest::newRow( "not" ) << "not ( value < 10 )";
+      QTest::newRow( "function" ) << "upper(name) || '-' || tostring(value)";
+      QTest::newRow( "function null" ) << "upper(empty)";
+      QTest::newRow( "coalesce" ) << "coalesce(empty, value, 1)";
+      QTest::newRow( "function error" ) << "toint(name)";
+      QTest::newRow( "case" ) << "case when value < 10 then 'small' when value < 50 then 'medium' end";
+      QTest::newRow( "case else" ) << "case when empty then 1 else value end";
+      QTest::newRow( "case error" ) << "case when name then 1 end";
+    }
+
+    void eval_compiled()
+    {
+      QFETCH( QString, string );
+
+      QgsFields fields;
+      fields.append( QgsField( "name", QVariant::String ) );
+      fields.append( QgsField( "value", QVariant::Int ) );
+      fields.append( QgsField( "ratio", QVariant::Double ) );
+      fields.append( QgsField( "code", QVariant::String ) );
+      fields.append( QgsField( "empty", QVariant::Int ) );
+
+      QgsFeatureList features;
+      for ( int i = 0; i < 3; ++i )
+      {
+        QgsFeature f( i );
+        f.initAttributes( 5 );
+        f.setAttribute( 0, ( QStringList() << "first" << "second" << "third" ).at( i ) );
+        f.setAttribute( 1, QVariant( i * 20 + 5 ) );
+        f.setAttribute( 2, QVariant( i * 0.5 ) );
+        f.setAttribute( 3, QVariant( QString::number( i * 5 ) ) );
+        f.setAttribute( 4, QVariant( QVariant::Int ) );
+        features << f;
+      }
+
+      QgsExpression interpreted( string );
+      QgsExpression compiled( string );
+      QCOMPARE( interpreted.hasParserError(), false );
+      QCOMPARE( interpreted.prepare( fields ), true );
+      QCOMPARE( compiled.prepare( fields ), true );
+      QCOMPARE( compiled.compile(), true );
+      QCOMPARE( compiled.isCompiled(), true );
+
+      foreach ( const QgsFeature& f, features )
+      {
+        QVariant expected = interpreted.evaluate( &f );
+        QVariant result = compiled.evaluate( &f );
+        QCOMPARE( compiled.hasEvalError(), interpreted.hasEvalError() );
+        QCOMPARE( compiled.evalErrorString(), interpreted.evalErrorString() );
+        QCOMPARE( result.type(), expected.type() );
+        QCOMPARE( result, expected );
+      }
+
+      QVariantList results = compiled.evaluateBatch( features );
+      QCOMPARE( results.count(), features.count() );
+      for ( int i = 0; i < features.count(); ++i )
+        QCOMPARE( results[i], interpreted.evaluate( &features[i] ) );
+
+      // preparing again drops the program
+      compiled.prepare( fields );
+      QCOMPARE( compiled.isCompiled(), false );
+    }
+
     void expression_from_expression()
     {
       {
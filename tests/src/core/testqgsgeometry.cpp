@@ -55,6 +55,8 @@ class TestQgsGeometry: public QObject
     void differenceCheck1();
     void differenceCheck2();
     void bufferCheck();
+    void preparedGeometryCheck();
+    void unaryUnionCheck();
 
   private:
     /** A helper method to do a render check to see if the geometry op is as expected */
@@ -320,6 +322,80 @@ bool TestQgsGeometry::renderCheck( QString theTestName, QString theComment )
   return myResultFlag;
 }
 
+void TestQgsGeometry::preparedGeometryCheck()
+{
+  QVERIFY( !mpPolygonGeometryA->isPrepared() );
+  QVERIFY( mpPolygonGeometryA->intersects( mpPolygonGeometryB ) );
+  // prepared automatically by the second predicate
+  QVERIFY( !mpPolygonGeometryA->intersects( mpPolygonGeometryC ) );
+  QVERIFY( mpPolygonGeometryA->isPrepared() );
+
+  QVERIFY( mpPolygonGeometryB->prepareGeometry() );
+  QVERIFY( mpPolygonGeometryB->isPrepared() );
+  QVERIFY( mpPolygonGeometryB->overlaps( mpPolygonGeometryA ) );
+  QVERIFY( !mpPolygonGeometryB->within( mpPolygonGeometryA ) );
+  QVERIFY( !mpPolygonGeometryB->disjoint( mpPolygonGeometryA ) );
+  QVERIFY( mpPolygonGeometryB->disjoint( mpPolygonGeometryC ) );
+  QgsPoint inside( 50.0, 50.0 );
+  QgsPoint outside( 10.0, 10.0 );
+  QVERIFY( mpPolygonGeometryB->contains( &inside ) );
+  QVERIFY( !mpPolygonGeometryB->contains( &outside ) );
+
+  // copies are not prepared
+  QgsGeometry copy( *mpPolygonGeometryB );
+  QVERIFY( !copy.isPrepared() );
+
+  // modifying the geometry drops the prepared geometry
+  QVERIFY( mpPolygonGeometryA->translate( 150.0, 150.0 ) == 0 );
+  QVERIFY( !mpPolygonGeometryA->isPrepared() );
+  QVERIFY( mpPolygonGeometryA->intersects( mpPolygonGeometryC ) );
+  QVERIFY( !mpPolygonGeometryA->intersects( mpPolygonGeometryB ) );
+  QVERIFY( mpPolygonGeometryA->isPrepared() );
+}
+
+void TestQgsGeometry::unaryUnionCheck()
+{
+  QList<QgsGeometry*> geometries;
+  for ( int i = 0; i < 10; ++i )
+  {
+    geometries << QgsGeometry::fromRect( QgsRectangle( i, 0, i + 2, 1 ) );
+  }
+  geometries << QgsGeometry::fromRect( QgsRectangle( 20, 0, 21, 1 ) );
+  geometries << 0;
+
+  QgsGeometry* unionGeometry = QgsGeometry::unaryUnion( geometries );
+  QVERIFY( unionGeometry );
+  QVERIFY( unionGeometry->isMultipart() );
+  QCOMPARE( unionGeometry->asMultiPolygon().size(), 2 );
+  QCOMPARE( unionGeometry->boundingBox(), QgsRectangle( 0, 0, 21, 1 ) );
+
+  // same result as combining one by one
+  QgsGeometry* combined = new QgsGeometry( *geometries[0] );
+  for ( int i = 1; i < 11; ++i )
+  {
+    QgsGeometry* tmp = combined->combine( geometries[i] );
+    delete combined;
+    combined = tmp;
+  }
+  QVERIFY( unionGeometry->equals( combined ) );
+  delete combined;
+  delete unionGeometry;
+  qDeleteAll( geometries );
+
+  QVERIFY( !QgsGeometry::unaryUnion( QList<QgsGeometry*>() ) );
+
+  // invalid (self-intersecting) polygons must not throw
+  QList<QgsGeometry*> invalidGeometries;
+  invalidGeometries << QgsGeometry::fromWkt( "POLYGON((0 0, 10 10, 10 0, 0 10, 0 0))" );
+  invalidGeometries << QgsGeometry::fromWkt( "POLYGON((5 5, 15 15, 15 5, 5 15, 5 5))" );
+  // and keep the union of what can be merged
+  QgsGeometry* invalidUnion = QgsGeometry::unaryUnion( invalidGeometries );
+  QVERIFY( invalidUnion );
+  QVERIFY( invalidUnion->area() > 0 );
+  delete invalidUnion;
+  qDeleteAll( invalidGeometries );
+}
+
 void TestQgsGeometry::dumpMultiPolygon( QgsMultiPolygon &theMultiPolygon )
 {
   qDebug( "Multipolygon Geometry Dump" );
@@ -0,0 +1,203 @@
+/***************************************************************************
+     testqgsgeometrycache.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+
+#include <qgsgeometrycache.h>
+
+class TestQgsGeometryCache: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void bands();
+    void entries();
+    void invalidate();
+    void sizeLimit();
+    void features();
+    void fillEntry();
+
+  private:
+    QgsMultiResolutionGeometryCache::Entry* createEntry( const QgsRectangle& extent, int count );
+};
+
+QgsMultiResolutionGeometryCache::Entry* TestQgsGeometryCache::createEntry( const QgsRectangle& extent, int count )
+{
+  QgsFields fields;
+  fields.append( QgsField( "id", QVariant::Int ) );
+
+  QgsMultiResolutionGeometryCache::Entry* entry = new QgsMultiResolutionGeometryCache::Entry;
+  entry->extent = extent;
+  entry->features.reset( fields, QgsAttributeList() << 0 );
+
+  for ( int i = 0; i < count; ++i )
+  {
+    QgsFeature f( fields, i );
+    f.setAttribute( 0, i );
+    f.setGeometry( QgsGeometry::fromPoint( QgsPoint( i, i ) ) );
+    entry->features.insert( f );
+    entry->boundingBoxes.append( f.geometry()->boundingBox() );
+  }
+  return entry;
+}
+
+void TestQgsGeometryCache::bands()
+{
+  QCOMPARE( QgsMultiResolutionGeometryCache::band( 1.0 ), 0 );
+  QCOMPARE( QgsMultiResolutionGeometryCache::band( 3.0 ), 1 );
+  QCOMPARE( QgsMultiResolutionGeometryCache::band( 0.3 ), -2 );
+
+  // cached geometries are never simplified more than requested
+  for ( double tol = 0.001; tol < 1000; tol *= 1.7 )
+  {
+    double bandTol = QgsMultiResolutionGeometryCache::bandTolerance( QgsMultiResolutionGeometryCache::band( tol ) );
+    QVERIFY( bandTol <= tol );
+    QVERIFY( bandTol * 2 > tol );
+  }
+}
+
+void TestQgsGeometryCache::entries()
+{
+  QgsMultiResolutionGeometryCache* cache = QgsMultiResolutionGeometryCache::instance();
+  QStringList attrs = QStringList() << "id";
+  int gen = cache->generation( "entries" );
+
+  cache->insertEntry( "entries", gen, 3, attrs, createEntry( QgsRectangle( 0, 0, 100, 100 ), 10 ) );
+
+  QVERIFY( cache->entry( "entries", 3, attrs, QgsRectangle( 10, 10, 20, 20 ) ) );
+  // finer band may be used for coarser request
+  QVERIFY( cache->entry( "entries", 4, attrs, QgsRectangle( 10, 10, 20, 20 ) ) );
+  QVERIFY( !cache->entry( "entries", 2, attrs, QgsRectangle( 10, 10, 20, 20 ) ) );
+  QVERIFY( !cache->entry( "entries", 5, attrs, QgsRectangle( 10, 10, 20, 20 ) ) );
+  // different extent or attributes
+  QVERIFY( !cache->entry( "entries", 3, attrs, QgsRectangle( 90, 90, 110, 110 ) ) );
+  QVERIFY( !cache->entry( "entries", 3, QStringList(), QgsRectangle( 10, 10, 20, 20 ) ) );
+  QVERIFY( !cache->entry( "other", 3, attrs, QgsRectangle( 10, 10, 20, 20 ) ) );
+
+  cache->invalidate( "entries" );
+}
+
+void TestQgsGeometryCache::invalidate()
+{
+  QgsMultiResolutionGeometryCache* cache = QgsMultiResolutionGeometryCache::instance();
+  QStringList attrs;
+  QgsRectangle extent( 0, 0, 100, 100 );
+
+  int gen = cache->generation( "inv" );
+  cache->insertEntry( "inv", gen, 0, attrs, createEntry( extent, 10 ) );
+  QVERIFY( cache->entry( "inv", 0, attrs, extent ) );
+
+  cache->invalidate( "inv" );
+  QVERIFY( !cache->entry( "inv", 0, attrs, extent ) );
+  QVERIFY( cache->generation( "inv" ) != gen );
+
+  // entries built from outdated data are not stored
+  QgsMultiResolutionGeometryCache::EntryPtr entry = cache->insertEntry( "inv", gen, 0, attrs, createEntry( extent, 10 ) );
+  QVERIFY( entry );
+  QVERIFY( !cache->entry( "inv", 0, attrs, extent ) );
+}
+
+void TestQgsGeometryCache::sizeLimit()
+{
+  QgsMultiResolutionGeometryCache* cache = QgsMultiResolutionGeometryCache::instance();
+  qint64 maxSize = cache->maximumSize();
+  QStringList attrs;
+  QgsRectangle extent( 0, 0, 100, 100 );
+
+  cache->insertEntry( "size", cache->generation( "size" ), 0, attrs, createEntry( extent, 1000 ) );
+  qint64 entrySize = cache->size();
+  QVERIFY( entrySize > 0 );
+
+  // least recently used entry is dropped
+  cache->setMaximumSize( entrySize * 3 / 2 );
+  cache->insertEntry( "size", cache->generation( "size" ), 1, attrs, createEntry( extent, 1000 ) );
+  QVERIFY( !cache->entry( "size", 0, attrs, extent ) );
+  QVERIFY( cache->entry( "size", 1, attrs, extent ) );
+  QVERIFY( cache->size() <= entrySize * 3 / 2 );
+
+  cache->invalidate( "size" );
+  QCOMPARE( cache->size(), ( qint64 ) 0 );
+  cache->setMaximumSize( maxSize );
+}
+
+void TestQgsGeometryCache::features()
+{
+  QgsMultiResolutionGeometryCache::EntryPtr entry( createEntry( QgsRectangle( 0, 0, 100, 100 ), 100 ) );
+
+  QgsFeatureIterator fit = QgsMultiResolutionGeometryCache::getFeatures( entry, QgsFeatureRequest().setFilterRect( QgsRectangle( 9.5, 9.5, 20.5, 20.5 ) ) );
+  QgsFeature f;
+  int count = 0;
+  while ( fit.nextFeature( f ) )
+  {
+    QVERIFY( f.id() >= 10 && f.id() <= 20 );
+    QCOMPARE( f.attribute( 0 ).toInt(), ( int ) f.id() );
+    QVERIFY( f.geometry() );
+    ++count;
+  }
+  QCOMPARE( count, 11 );
+
+  QgsFeatureIterator noGeomIt = QgsMultiResolutionGeometryCache::getFeatures( entry, QgsFeatureRequest().setFlags( QgsFeatureRequest::NoGeometry ) );
+  count = 0;
+  while ( noGeomIt.nextFeature( f ) )
+  {
+    QVERIFY( !f.geometry() );
+    ++count;
+  }
+  QCOMPARE( count, 100 );
+}
+
+void TestQgsGeometryCache::fillEntry()
+{
+  QgsMultiResolutionGeometryCache* cache = QgsMultiResolutionGeometryCache::instance();
+  QStringList attrs = QStringList() << "id";
+  QgsRectangle extent( 0, 0, 100, 100 );
+  QgsMultiResolutionGeometryCache::EntryPtr source( createEntry( extent, 100 ) );
+
+  // only one renderer builds an entry
+  QVERIFY( cache->reserveEntry( "fill", 0, attrs ) );
+  QVERIFY( !cache->reserveEntry( "fill", 0, attrs ) );
+
+  // the features within the filter rectangle are returned while the entry is filled
+  QgsMultiResolutionGeometryCache::Entry* entry = createEntry( extent, 0 );
+  QgsFeatureIterator fit = cache->fillEntry( "fill", cache->generation( "fill" ), 0, attrs, entry,
+                           QgsMultiResolutionGeometryCache::getFeatures( source, QgsFeatureRequest() ), QgsRectangle( 9.5, 9.5, 20.5, 20.5 ) );
+  QgsFeature f;
+  QVERIFY( fit.nextFeature( f ) );
+  QCOMPARE( f.id(), ( QgsFeatureId ) 10 );
+  QVERIFY( !cache->entry( "fill", 0, attrs, extent ) );
+  int count = 1;
+  while ( fit.nextFeature( f ) )
+    ++count;
+  QCOMPARE( count, 11 );
+
+  // the entry is stored once all features are collected
+  QgsMultiResolutionGeometryCache::EntryPtr stored = cache->entry( "fill", 0, attrs, extent );
+  QVERIFY( stored );
+  QCOMPARE( stored->features.count(), 100 );
+  QVERIFY( cache->reserveEntry( "fill", 0, attrs ) );
+
+  // an incomplete entry is dropped
+  cache->invalidate( "fill" );
+  fit = cache->fillEntry( "fill", cache->generation( "fill" ), 0, attrs, createEntry( extent, 0 ),
+                          QgsMultiResolutionGeometryCache::getFeatures( source, QgsFeatureRequest() ), extent );
+  QVERIFY( fit.nextFeature( f ) );
+  fit.close();
+  QVERIFY( !cache->entry( "fill", 0, attrs, extent ) );
+  QVERIFY( cache->reserveEntry( "fill", 0, attrs ) );
+  cache->abandonEntry( "fill", 0, attrs );
+}
+
+QTEST_MAIN( TestQgsGeometryCache )
+#include "moc_testqgsgeometrycache.cxx"
@@ -16,10 +16,14 @@
 #include <QtTest>
 #include <QObject>
 #include <QString>
+#include <QDir>
 #include <QObject>
 
+#include <qgsapplication.h>
 #include <qgsgeometry.h>
 #include <qgsspatialindex.h>
+#include <qgsvectordataprovider.h>
+#include <qgsvectorlayer.h>
 
 
 #if QT_VERSION < 0x40701
@@ -58,6 +62,17 @@ class TestQgsSpatialIndex : public QObject
 
   private slots:
 
+    void initTestCase()
+    {
+      QgsApplication::init();
+      QgsApplication::initQgis();
+    }
+
+    void cleanupTestCase()
+    {
+      QgsApplication::exitQgis();
+    }
+
     void testQuery()
     {
       QgsSpatialIndex index;
@@ -111,6 +126,68 @@ class TestQgsSpatialIndex : public QObject
       QVERIFY( fids[0] == 1 );
     }
 
+    void testBulkLoad()
+    {
+      QgsVectorLayer layer( "Point", "points", "memory" );
+      QgsFeatureList feats = _pointFeatures();
+      QVERIFY( layer.dataProvider()->addFeatures( feats ) );
+
+      QgsSpatialIndex index( layer.getFeatures() );
+
+      QList<QgsFeatureId> fids = index.intersects( QgsRectangle( 0, 0, 10, 10 ) );
+      QVERIFY( fids.count() == 1 );
+      QVERIFY( fids[0] == feats[0].id() );
+
+      QList<QgsFeatureId> fids2 = index.intersects( QgsRectangle( -10, -10, 0, 10 ) );
+      QVERIFY( fids2.count() == 2 );
+      QVERIFY( fids2.contains( feats[1].id() ) );
+      QVERIFY( fids2.contains( feats[2].id() ) );
+
+      // bulk loaded index can be modified
+      QVERIFY( index.deleteFeature( feats[0] ) );
+      QVERIFY( index.intersects( QgsRectangle( 0, 0, 10, 10 ) ).isEmpty() );
+
+      // empty iterator
+      QgsVectorLayer emptyLayer( "Point", "empty", "memory" );
+      QgsSpatialIndex emptyIndex( emptyLayer.getFeatures() );
+      QVERIFY( emptyIndex.intersects( QgsRectangle( -10, -10, 10, 10 ) ).isEmpty() );
+      QVERIFY( emptyIndex.insertFeature( feats[0] ) );
+      QVERIFY( emptyIndex.intersects( QgsRectangle( -10, -10, 10, 10 ) ).count() == 1 );
+    }
+
+    void testSaveLoad()
+    {
+      QgsSpatialIndex index;
+      for ( int i = 0; i < 1000; ++i )
+        index.insertFeature( _pointFeature( i, i % 100, i / 100 ) );
+
+      QString fileName = QDir::tempPath() + "/testqgsspatialindex.qsi";
+      QDateTime modified( QDate( 2014, 5, 1 ), QTime( 12, 0 ) );
+      QVERIFY( index.save( fileName, modified ) );
+
+      // out of date index is not used
+      QgsSpatialIndex outdated;
+      QVERIFY( !outdated.load( fileName, modified.addSecs( 1 ) ) );
+
+      QgsSpatialIndex loaded;
+      QVERIFY( loaded.load( fileName, modified ) );
+
+      QList<QgsFeatureId> fids = loaded.intersects( QgsRectangle( 9.5, 4.5, 10.5, 5.5 ) );
+      QVERIFY( fids.count() == 1 );
+      QVERIFY( fids[0] == 510 );
+      QVERIFY( loaded.intersects( QgsRectangle( -1, -1, 100, 10 ) ).count() == 1000 );
+
+      // changes to loaded index stay in memory
+      QVERIFY( loaded.insertFeature( _pointFeature( 2000, 200, 200 ) ) );
+      QVERIFY( loaded.intersects( QgsRectangle( 199, 199, 201, 201 ) ).count() == 1 );
+
+      QgsSpatialIndex reloaded;
+      QVERIFY( reloaded.load( fileName, modified ) );
+      QVERIFY( reloaded.intersects( QgsRectangle( 199, 199, 201, 201 ) ).isEmpty() );
+
+      QFile::remove( fileName );
+    }
+
     void benchmarkIntersect()
     {
       // add 50K features to the index
@@ -0,0 +1,117 @@
+/***************************************************************************
+     testqgssqlexpressioncompiler.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+
+#include <qgsapplication.h>
+#include <qgssqlexpressioncompiler.h>
+
+Q_DECLARE_METATYPE( QgsSqlExpressionCompiler::Result )
+
+class TestQgsSqlExpressionCompiler: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void compile_data();
+    void compile();
+    void looseStrings();
+};
+
+static QgsFields testFields()
+{
+  QgsFields fields;
+  fields.append( QgsField( "name", QVariant::String ) );
+  fields.append( QgsField( "value", QVariant::Int ) );
+  fields.append( QgsField( "ratio", QVariant::Double ) );
+  fields.append( QgsField( "day", QVariant::Date ) );
+  return fields;
+}
+
+void TestQgsSqlExpressionCompiler::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+}
+
+void TestQgsSqlExpressionCompiler::compile_data()
+{
+  QTest::addColumn<QString>( "expression" );
+  QTest::addColumn<QgsSqlExpressionCompiler::Result>( "result" );
+  QTest::addColumn<QString>( "sql" );
+
+  QTest::newRow( "numeric compare" ) << "value > 10" << QgsSqlExpressionCompiler::Complete << "(\"value\") > (10)";
+  QTest::newRow( "numeric string" ) << "ratio <= '0.5'" << QgsSqlExpressionCompiler::Complete << "(\"ratio\") <= (0.5)";
+  QTest::newRow( "string equality" ) << "name = 'it''s'" << QgsSqlExpressionCompiler::Complete << "(\"name\") = ('it''s')";
+  QTest::newRow( "string ordering" ) << "name < 'b'" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "string with number" ) << "name = '5'" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "string column with number" ) << "name = 5" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "arithmetic" ) << "value * 2 + 1 = ratio" << QgsSqlExpressionCompiler::Complete << "(((\"value\") * (2)) + (1)) = (\"ratio\")";
+  QTest::newRow( "division" ) << "value / 2 = 1" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "in" ) << "value in (1, 2, null)" << QgsSqlExpressionCompiler::Complete << "(\"value\") IN (1,2,NULL)";
+  QTest::newRow( "not in" ) << "name not in ('a', 'b')" << QgsSqlExpressionCompiler::Complete << "(\"name\") NOT IN ('a','b')";
+  QTest::newRow( "in mixed" ) << "name in ('a', 1)" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "like" ) << "name like 'a%'" << QgsSqlExpressionCompiler::Complete << "\"name\" LIKE 'a%'";
+  QTest::newRow( "not ilike" ) << "name not ilike 'a_'" << QgsSqlExpressionCompiler::Complete << "NOT (UPPER(\"name\") LIKE UPPER('a_'))";
+  QTest::newRow( "like backslash" ) << "name like 'a\\\\%'" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "is null" ) << "day is null" << QgsSqlExpressionCompiler::Complete << "(\"day\") IS NULL";
+  QTest::newRow( "is not null" ) << "name is not null" << QgsSqlExpressionCompiler::Complete << "(\"name\") IS NOT NULL";
+  QTest::newRow( "date compare" ) << "day = '2014-01-01'" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "boolean logic" ) << "not (value > 1 or ratio < 2)" << QgsSqlExpressionCompiler::Complete << "NOT (((\"value\") > (1)) OR ((\"ratio\") < (2)))";
+  QTest::newRow( "partial and" ) << "value > 1 and upper(name) = 'A'" << QgsSqlExpressionCompiler::Partial << "(\"value\") > (1)";
+  QTest::newRow( "partial or" ) << "value > 1 or upper(name) = 'A'" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "not partial" ) << "not (value > 1 and upper(name) = 'A')" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "unknown column" ) << "foo = 1" << QgsSqlExpressionCompiler::Fail << "";
+  QTest::newRow( "not boolean" ) << "value + 1" << QgsSqlExpressionCompiler::Fail << "";
+}
+
+void TestQgsSqlExpressionCompiler::compile()
+{
+  QFETCH( QString, expression );
+  QFETCH( QgsSqlExpressionCompiler::Result, result );
+  QFETCH( QString, sql );
+
+  QgsExpression exp( expression );
+  QVERIFY( !exp.hasParserError() );
+
+  QgsSqlExpressionCompiler compiler( testFields() );
+  QCOMPARE( compiler.compile( &exp ), result );
+  QCOMPARE( compiler.result(), sql );
+}
+
+void TestQgsSqlExpressionCompiler::looseStrings()
+{
+  QgsSqlExpressionCompiler compiler( testFields(), QgsSqlExpressionCompiler::LooseStringEquality );
+
+  // case insensitive collations match a superset
+  QgsExpression eq( "name = 'a'" );
+  QCOMPARE( compiler.compile( &eq ), QgsSqlExpressionCompiler::Partial );
+  QgsExpression in( "name in ('a', 'b')" );
+  QCOMPARE( compiler.compile( &in ), QgsSqlExpressionCompiler::Partial );
+
+  // ... but their negation a subset
+  QgsExpression ne( "name <> 'a'" );
+  QCOMPARE( compiler.compile( &ne ), QgsSqlExpressionCompiler::Fail );
+  QgsExpression notIn( "name not in ('a', 'b')" );
+  QCOMPARE( compiler.compile( &notIn ), QgsSqlExpressionCompiler::Fail );
+
+  // numbers are not affected
+  QgsExpression num( "value <> 1" );
+  QCOMPARE( compiler.compile( &num ), QgsSqlExpressionCompiler::Complete );
+}
+
+QTEST_MAIN( TestQgsSqlExpressionCompiler )
+#include "moc_testqgssqlexpressioncompiler.cxx"
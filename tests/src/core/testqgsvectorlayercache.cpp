@@ -45,6 +45,7 @@ class TestVectorLayerCache: public QObject
     void testCacheAttrActions(); // Test attribute add/ attribute delete
     void testFeatureActions();   // Test adding/removing features works
     void testSubsetRequest();
+    void testFullCache();        // Test features in full cache mode match the layer
 
     void onCommittedFeaturesAdded( QString, QgsFeatureList );
 
@@ -227,6 +228,51 @@ void TestVectorLayerCache::testSubsetRequest()
   QVERIFY( a == f.attribute( 3 ) );
 }
 
+void TestVectorLayerCache::testFullCache()
+{
+  mVectorLayerCache->setFullCache( true );
+
+  QgsFeature f;
+  QgsFeature cached;
+  int count = 0;
+  QgsFeatureIterator it = mPointsLayer->getFeatures();
+  while ( it.nextFeature( f ) )
+  {
+    QVERIFY( mVectorLayerCache->isFidCached( f.id() ) );
+    QVERIFY( mVectorLayerCache->featureAtId( f.id(), cached ) );
+    QCOMPARE( cached.attributes(), f.attributes() );
+    QVERIFY( cached.geometry() );
+    QCOMPARE( cached.geometry()->exportToWkt(), f.geometry()->exportToWkt() );
+    ++count;
+  }
+
+  // all features come from the cache
+  int cachedCount = 0;
+  QgsFeatureIterator cacheIt = mVectorLayerCache->getFeatures();
+  while ( cacheIt.nextFeature( f ) )
+    ++cachedCount;
+  QCOMPARE( cachedCount, count );
+
+  // subset without geometry
+  QgsFeatureIterator subsetIt = mVectorLayerCache->getFeatures( QgsFeatureRequest()
+                                .setFlags( QgsFeatureRequest::NoGeometry )
+                                .setSubsetOfAttributes( QgsAttributeList() << 0 ) );
+  QVERIFY( subsetIt.nextFeature( f ) );
+  QVERIFY( !f.geometry() );
+  QVERIFY( f.attribute( 0 ).isValid() );
+  QVERIFY( !f.attribute( 1 ).isValid() );
+
+  // edits are reflected
+  mPointsLayer->startEditing();
+  QVERIFY( mPointsLayer->changeAttributeValue( 1, 1, QVariant( "changed" ) ) );
+  QVERIFY( mVectorLayerCache->featureAtId( 1, f ) );
+  QCOMPARE( f.attribute( 1 ), QVariant( "changed" ) );
+
+  QVERIFY( mPointsLayer->deleteFeature( 2 ) );
+  QVERIFY( !mVectorLayerCache->isFidCached( 2 ) );
+  mPointsLayer->rollBack();
+}
+
 void TestVectorLayerCache::onCommittedFeaturesAdded( QString layerId, QgsFeatureList features )
 {
   Q_UNUSED( layerId )
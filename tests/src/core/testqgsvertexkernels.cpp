@@ -0,0 +1,210 @@
+/***************************************************************************
+     testqgsvertexkernels.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include <qgsgeometry.h>
+#include <qgsmaptopixel.h>
+#include <qgsmaptopixelgeometrysimplifier.h>
+#include <qgsvertexkernels.h>
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+class TestQgsVertexKernels: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void cleanup();
+
+    void mapToPixel();
+    void mapToPixelInterleaved();
+    void boundingBox();
+    void firstBeyondTolerance();
+    void simplifier();
+
+  private:
+    //! random coordinates with the given number of dimensions per vertex
+    static QVector<double> coordinates( int count, int dimensions );
+    static QList<QgsVertexKernels::InstructionSet> instructionSets();
+};
+
+QVector<double> TestQgsVertexKernels::coordinates( int count, int dimensions )
+{
+  qsrand( 42 );
+  QVector<double> values( count * dimensions );
+  for ( int i = 0; i < values.size(); ++i )
+    values[i] = 1000.0 * qrand() / RAND_MAX - 500.0;
+  return values;
+}
+
+QList<QgsVertexKernels::InstructionSet> TestQgsVertexKernels::instructionSets()
+{
+  QList<QgsVertexKernels::InstructionSet> sets;
+  for ( int set = QgsVertexKernels::Scalar; set <= QgsVertexKernels::supportedInstructionSet(); ++set )
+    sets << ( QgsVertexKernels::InstructionSet ) set;
+  return sets;
+}
+
+void TestQgsVertexKernels::cleanup()
+{
+  QgsVertexKernels::setInstructionSet( QgsVertexKernels::supportedInstructionSet() );
+}
+
+void TestQgsVertexKernels::mapToPixel()
+{
+  QgsMapToPixel mtp( 0.37, 480.0, -20.0, -110.0 );
+
+  // odd count to exercise the scalar tail
+  QVector<double> x = coordinates( 103, 1 );
+  QVector<double> y = x;
+  std::reverse( y.begin(), y.end() );
+
+  QVector<double> expectedX = x, expectedY = y;
+  for ( int i = 0; i < x.size(); ++i )
+    mtp.transformInPlace( expectedX[i], expectedY[i] );
+
+  foreach ( QgsVertexKernels::InstructionSet set, instructionSets() )
+  {
+    QgsVertexKernels::setInstructionSet( set );
+    QVector<double> resultX = x, resultY = y;
+    mtp.transformInPlace( resultX, resultY );
+    QCOMPARE( resultX, expectedX );
+    QCOMPARE( resultY, expectedY );
+  }
+}
+
+void TestQgsVertexKernels::mapToPixelInterleaved()
+{
+  QgsMapToPixel mtp( 2.5, 1000.0, 0.0, 100.0 );
+
+  for ( int dimensions = 2; dimensions <= 3; ++dimensions )
+  {
+    QVector<double> xyz = coordinates( 101, dimensions );
+
+    QVector<double> expected = xyz;
+    for ( int i = 0; i < expected.size(); i += dimensions )
+      mtp.transformInPlace( expected[i], expected[i + 1] );
+
+    foreach ( QgsVertexKernels::InstructionSet set, instructionSets() )
+    {
+      QgsVertexKernels::setInstructionSet( set );
+      QVector<double> result = xyz;
+      QgsVertexKernels::mapToPixel(( unsigned char* ) result.data(), result.size() / dimensions, dimensions * sizeof( double ), 2.5, 100.0, 0.0, 1000.0 );
+      QCOMPARE( result, expected );
+    }
+  }
+
+  // polygons use the interleaved kernel
+  QPolygonF poly;
+  poly << QPointF( 100.0, 0.0 ) << QPointF( 102.5, 2.5 ) << QPointF( 105.0, 1000.0 );
+  mtp.transformInPlace( poly );
+  QCOMPARE( poly.at( 0 ), QPointF( 0.0, 1000.0 ) );
+  QCOMPARE( poly.at( 1 ), QPointF( 1.0, 999.0 ) );
+  QCOMPARE( poly.at( 2 ), QPointF( 2.0, 600.0 ) );
+}
+
+void TestQgsVertexKernels::boundingBox()
+{
+  for ( int dimensions = 2; dimensions <= 3; ++dimensions )
+  {
+    QVector<double> xyz = coordinates( 77, dimensions );
+    // NaN vertices are ignored
+    xyz[ 5 * dimensions ] = std::numeric_limits<double>::quiet_NaN();
+
+    double expected[4] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max() };
+    for ( int i = 0; i < xyz.size(); i += dimensions )
+    {
+      if ( expected[0] > xyz[i] ) expected[0] = xyz[i];
+      if ( expected[1] > xyz[i + 1] ) expected[1] = xyz[i + 1];
+      if ( expected[2] < xyz[i] ) expected[2] = xyz[i];
+      if ( expected[3] < xyz[i + 1] ) expected[3] = xyz[i + 1];
+    }
+
+    foreach ( QgsVertexKernels::InstructionSet set, instructionSets() )
+    {
+      QgsVertexKernels::setInstructionSet( set );
+      double xMin = std::numeric_limits<double>::max(), yMin = std::numeric_limits<double>::max();
+      double xMax = -std::numeric_limits<double>::max(), yMax = -std::numeric_limits<double>::max();
+      QgsVertexKernels::boundingBox(( const unsigned char* ) xyz.constData(), xyz.size() / dimensions, dimensions * sizeof( double ), xMin, yMin, xMax, yMax );
+      QCOMPARE( xMin, expected[0] );
+      QCOMPARE( yMin, expected[1] );
+      QCOMPARE( xMax, expected[2] );
+      QCOMPARE( yMax, expected[3] );
+    }
+  }
+}
+
+void TestQgsVertexKernels::firstBeyondTolerance()
+{
+  // vertices walking away from the origin by 0.1 per step
+  QVector<double> xy;
+  for ( int i = 0; i < 50; ++i )
+    xy << i * 0.1 << 0.0;
+
+  foreach ( QgsVertexKernels::InstructionSet set, instructionSets() )
+  {
+    QgsVertexKernels::setInstructionSet( set );
+    const unsigned char* wkb = ( const unsigned char* ) xy.constData();
+    int stride = 2 * sizeof( double );
+
+    // distance 1.0 is not beyond a tolerance of 1.0, 1.1 is
+    QCOMPARE( QgsVertexKernels::firstBeyondTolerance( wkb, 50, stride, 0.0, 0.0, 1.0 ), 11 );
+    QCOMPARE( QgsVertexKernels::firstBeyondTolerance( wkb, 50, stride, 0.0, 0.0, 0.0 ), 1 );
+    QCOMPARE( QgsVertexKernels::firstBeyondTolerance( wkb, 50, stride, 0.0, 0.0, 100.0 ), 50 );
+    QCOMPARE( QgsVertexKernels::firstBeyondTolerance( wkb + 3 * stride, 47, stride, 0.3, 0.0, 0.25 ), 6 );
+    QCOMPARE( QgsVertexKernels::firstBeyondTolerance( wkb, 0, stride, 0.0, 0.0, 1.0 ), 0 );
+  }
+}
+
+void TestQgsVertexKernels::simplifier()
+{
+  QgsPolyline line;
+  QVector<double> values = coordinates( 2000, 1 );
+  for ( int i = 0; i < values.size(); ++i )
+    line << QgsPoint( i * 0.01, values[i] * 0.001 );
+
+  QgsPolygon polygon;
+  polygon << line;
+  polygon[0] << line.first();
+
+  QList<QgsGeometry*> geometries;
+  geometries << QgsGeometry::fromPolyline( line ) << QgsGeometry::fromPolygon( polygon );
+
+  foreach ( QgsGeometry* geometry, geometries )
+  {
+    QgsVertexKernels::setInstructionSet( QgsVertexKernels::Scalar );
+    QgsMapToPixelSimplifier simplifier( QgsMapToPixelSimplifier::SimplifyGeometry, 0.05 );
+    QgsGeometry* expected = simplifier.simplify( geometry );
+    QVERIFY( expected->wkbSize() < geometry->wkbSize() );
+
+    foreach ( QgsVertexKernels::InstructionSet set, instructionSets() )
+    {
+      QgsVertexKernels::setInstructionSet( set );
+      QgsGeometry* result = simplifier.simplify( geometry );
+      QCOMPARE( result->wkbSize(), expected->wkbSize() );
+      QVERIFY( memcmp( result->asWkb(), expected->asWkb(), expected->wkbSize() ) == 0 );
+      delete result;
+    }
+    delete expected;
+  }
+  qDeleteAll( geometries );
+}
+
+QTEST_MAIN( TestQgsVertexKernels )
+#include "moc_testqgsvertexkernels.cxx"
@@ -0,0 +1,195 @@
+/***************************************************************************
+     testqgswkbview.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <qgsapplication.h>
+#include <qgsgeometry.h>
+#include <qgswkbview.h>
+
+class TestQgsWkbView: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void compareWithGeometry();
+    void randomAccess();
+    void hasZValue();
+    void invalid();
+
+  private:
+    //! collects the vertices of all parts like asMultiPolygon() (points and lines as one ring)
+    static QgsMultiPolygon viewVertices( const QgsWkbView& view );
+    static QgsMultiPolygon geometryVertices( QgsGeometry* geometry );
+};
+
+QgsMultiPolygon TestQgsWkbView::viewVertices( const QgsWkbView& view )
+{
+  QgsMultiPolygon parts;
+  for ( QgsWkbView::const_iterator partIt = view.begin(); partIt != view.end(); ++partIt )
+  {
+    QgsWkbPart part = *partIt;
+    QgsPolygon rings;
+    for ( QgsWkbPart::const_iterator ringIt = part.begin(); ringIt != part.end(); ++ringIt )
+    {
+      QgsWkbRing ring = *ringIt;
+      QgsPolyline vertices;
+      for ( QgsWkbRing::const_iterator vIt = ring.begin(); vIt != ring.end(); ++vIt )
+        vertices << *vIt;
+      rings << vertices;
+    }
+    parts << rings;
+  }
+  return parts;
+}
+
+QgsMultiPolygon TestQgsWkbView::geometryVertices( QgsGeometry* geometry )
+{
+  QgsMultiPolygon parts;
+  switch ( geometry->wkbType() )
+  {
+    case QGis::WKBPoint:
+      parts << ( QgsPolygon() << ( QgsPolyline() << geometry->asPoint() ) );
+      break;
+    case QGis::WKBMultiPoint:
+      foreach ( const QgsPoint& point, geometry->asMultiPoint() )
+        parts << ( QgsPolygon() << ( QgsPolyline() << point ) );
+      break;
+    case QGis::WKBLineString:
+      parts << ( QgsPolygon() << geometry->asPolyline() );
+      break;
+    case QGis::WKBMultiLineString:
+      foreach ( const QgsPolyline& line, geometry->asMultiPolyline() )
+        parts << ( QgsPolygon() << line );
+      break;
+    case QGis::WKBPolygon:
+      parts << geometry->asPolygon();
+      break;
+    case QGis::WKBMultiPolygon:
+      parts = geometry->asMultiPolygon();
+      break;
+    default:
+      break;
+  }
+  return parts;
+}
+
+void TestQgsWkbView::compareWithGeometry()
+{
+  QStringList wkts;
+  wkts << "POINT(1 2)"
+  << "MULTIPOINT(1 2, 3 4, 5 6)"
+  << "LINESTRING(0 0, 10 0, 10 10)"
+  << "MULTILINESTRING((0 0, 1 1), (2 2, 3 3, 4 4))"
+  << "POLYGON((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 4 2, 4 4, 2 2), (6 6, 8 6, 8 8, 6 6))"
+  << "MULTIPOLYGON(((0 0, 1 0, 1 1, 0 0)), ((5 5, 9 5, 9 9, 5 9, 5 5), (6 6, 7 6, 7 7, 6 6)))";
+
+  foreach ( const QString& wkt, wkts )
+  {
+    QgsGeometry* geometry = QgsGeometry::fromWkt( wkt );
+    QVERIFY( geometry );
+
+    QgsWkbView view( geometry );
+    QVERIFY( view.isValid() );
+    QCOMPARE( view.wkbType(), geometry->wkbType() );
+    QCOMPARE( view.type(), geometry->type() );
+    QCOMPARE( view.isMultipart(), geometry->isMultipart() );
+    QVERIFY( !view.hasZValue() );
+
+    QgsMultiPolygon expected = geometryVertices( geometry );
+    QCOMPARE( view.partCount(), expected.size() );
+    QCOMPARE( viewVertices( view ), expected );
+
+    int vertexCount = 0;
+    foreach ( const QgsPolygon& rings, expected )
+      foreach ( const QgsPolyline& ring, rings )
+        vertexCount += ring.size();
+    QCOMPARE( view.vertexCount(), vertexCount );
+
+    // the last part ends at the end of the WKB
+    QCOMPARE( view.part( view.partCount() - 1 ).wkbEnd(), geometry->asWkb() + geometry->wkbSize() );
+
+    delete geometry;
+  }
+}
+
+void TestQgsWkbView::randomAccess()
+{
+  QgsGeometry* geometry = QgsGeometry::fromWkt( "MULTIPOLYGON(((0 0, 1 0, 1 1, 0 0)), ((5 5, 9 5, 9 9, 5 9, 5 5), (6 6, 7 6, 7 7, 6 6)))" );
+  QgsWkbView view( geometry );
+
+  QgsWkbPart part = view.part( 1 );
+  QCOMPARE( part.type(), QGis::Polygon );
+  QCOMPARE( part.ringCount(), 2 );
+
+  QgsWkbRing ring = part.ring( 1 );
+  QCOMPARE( ring.vertexCount(), 4 );
+  QCOMPARE( ring.stride(), ( int )( 2 * sizeof( double ) ) );
+  QCOMPARE( ring.vertex( 2 ), QgsPoint( 7, 7 ) );
+  QCOMPARE( ring.x( 1 ), 7.0 );
+  QCOMPARE( ring.y( 1 ), 6.0 );
+  QCOMPARE( ring.end() - ring.begin(), 4 );
+
+  // out of range
+  QCOMPARE( view.part( 2 ).ringCount(), 0 );
+  QCOMPARE( part.ring( 2 ).vertexCount(), 0 );
+
+  delete geometry;
+}
+
+void TestQgsWkbView::hasZValue()
+{
+  // LINESTRING Z (1 2 3, 4 5 6)
+  int wkbSize = 1 + 2 * sizeof( int ) + 6 * sizeof( double );
+  unsigned char* wkb = new unsigned char[wkbSize];
+  QgsWkbPtr wkbPtr( wkb );
+  wkbPtr << ( char ) QgsApplication::endian() << QGis::WKBLineString25D << 2;
+  wkbPtr << 1.0 << 2.0 << 3.0 << 4.0 << 5.0 << 6.0;
+
+  QgsWkbView view( wkb, wkbSize );
+  QVERIFY( view.hasZValue() );
+  QCOMPARE( view.type(), QGis::Line );
+
+  QgsWkbRing ring = view.part().ring();
+  QVERIFY( ring.hasZValue() );
+  QCOMPARE( ring.stride(), ( int )( 3 * sizeof( double ) ) );
+  QgsWkbRing::const_iterator it = ring.begin();
+  QCOMPARE( it.z(), 3.0 );
+  ++it;
+  QCOMPARE( *it, QgsPoint( 4, 5 ) );
+  QCOMPARE( it.z(), 6.0 );
+  ++it;
+  QVERIFY( it == ring.end() );
+  QCOMPARE( ring.coordinatesEnd(), ( const unsigned char* ) wkb + wkbSize );
+
+  delete [] wkb;
+}
+
+void TestQgsWkbView::invalid()
+{
+  QgsWkbView nullView( ( const QgsGeometry* ) 0 );
+  QVERIFY( !nullView.isValid() );
+  QCOMPARE( nullView.partCount(), 0 );
+  QVERIFY( nullView.begin() == nullView.end() );
+
+  QgsGeometry empty;
+  QgsWkbView emptyView( &empty );
+  QVERIFY( !emptyView.isValid() );
+  QCOMPARE( emptyView.vertexCount(), 0 );
+}
+
+QTEST_MAIN( TestQgsWkbView )
+#include "moc_testqgswkbview.cxx"
@@ -0,0 +1,112 @@
+/***************************************************************************
+     testqgswfsfeaturewriter.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QLocale>
+#include <QtTest>
+
+#include <locale.h>
+
+#include "qgsapplication.h"
+#include "qgscoordinatereferencesystem.h"
+#include "qgsgeometry.h"
+#include "qgswfsfeaturewriter.h"
+
+/** \ingroup UnitTests
+ * This is a unit test for the WFS GetFeature serialisation
+ */
+class TestQgsWFSFeatureWriter: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanup();
+
+    void appendDouble();
+    void commaLocale();
+
+  private:
+    //! switches LC_NUMERIC to a locale with a decimal comma, false if there is none
+    static bool setCommaLocale();
+};
+
+void TestQgsWFSFeatureWriter::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+}
+
+void TestQgsWFSFeatureWriter::cleanup()
+{
+  setlocale( LC_NUMERIC, "C" );
+  QLocale::setDefault( QLocale::c() );
+}
+
+bool TestQgsWFSFeatureWriter::setCommaLocale()
+{
+  const char* names[] = { "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "fr_FR", "German", 0 };
+  for ( int i = 0; names[i]; ++i )
+  {
+    if ( setlocale( LC_NUMERIC, names[i] ) && localeconv()->decimal_point[0] == ',' )
+    {
+      QLocale::setDefault( QLocale( QLocale::German, QLocale::Germany ) );
+      return true;
+    }
+  }
+  return false;
+}
+
+void TestQgsWFSFeatureWriter::appendDouble()
+{
+  QByteArray out;
+  QgsWFSFeatureWriter::appendDouble( out, 1.5 );
+  out += " ";
+  QgsWFSFeatureWriter::appendDouble( out, -100.0 );
+  out += " ";
+  QgsWFSFeatureWriter::appendDouble( out, 0.1 );
+  QCOMPARE( out, QByteArray( "1.5 -100 0.10000000000000001" ) );
+}
+
+void TestQgsWFSFeatureWriter::commaLocale()
+{
+  if ( !setCommaLocale() )
+  {
+    QSKIP( "no locale with a decimal comma available", SkipAll );
+  }
+
+  // coordinates are written with a dot whatever the locale of the server process is
+  QByteArray out;
+  QgsWFSFeatureWriter::appendDouble( out, 1.5 );
+  QCOMPARE( out, QByteArray( "1.5" ) );
+
+  QgsFeature feature( 1 );
+  feature.setGeometry( QgsGeometry::fromPoint( QgsPoint( 1.5, -2.25 ) ) );
+
+  QgsWFSFeatureWriter geoJSONWriter( QgsWFSFeatureWriter::GeoJSON, "points", QgsCoordinateReferenceSystem(), true,
+                                     QgsFields(), QgsAttributeList(), QSet<QString>() );
+  out.clear();
+  geoJSONWriter.writeFeature( feature, true, out );
+  QVERIFY( out.contains( "\"bbox\": [ 1.5, -2.25, 1.5, -2.25]" ) );
+  QVERIFY( out.contains( "[1.5, -2.25]" ) );
+
+  QgsWFSFeatureWriter gmlWriter( QgsWFSFeatureWriter::GML2, "points", QgsCoordinateReferenceSystem(), true,
+                                 QgsFields(), QgsAttributeList(), QSet<QString>() );
+  out.clear();
+  gmlWriter.writeFeature( feature, true, out );
+  QVERIFY( out.contains( "1.5,-2.25" ) );
+  QVERIFY( !out.contains( "1,5" ) );
+}
+
+QTEST_MAIN( TestQgsWFSFeatureWriter )
+#include "moc_testqgswfsfeaturewriter.cxx"
@@ -0,0 +1,93 @@
+/***************************************************************************
+     testqgswmstilecache.cpp
+     --------------------------------------
+    Date                 : May 2014
+    Copyright            : (C) 2014 by the QGIS project
+    Email                :
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QDir>
+#include <QMap>
+#include <QTemporaryFile>
+#include <QtTest>
+
+#include "qgsapplication.h"
+#include "qgswmstilecache.h"
+
+/** \ingroup UnitTests
+ * This is a unit test for the keys of the WMS tile cache
+ */
+class TestQgsWMSTileCache: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void bboxDecimals();
+    void differentTiles();
+
+  private:
+    QString key( const QString& bbox ) const;
+
+    QTemporaryFile* mProjectFile;
+};
+
+void TestQgsWMSTileCache::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  mProjectFile = new QTemporaryFile( QDir::tempPath() + "/tilecacheXXXXXX.qgs" );
+  QVERIFY( mProjectFile->open() );
+  mProjectFile->write( "<qgis><projectlayers/></qgis>" );
+  mProjectFile->flush();
+}
+
+void TestQgsWMSTileCache::cleanupTestCase()
+{
+  delete mProjectFile;
+}
+
+QString TestQgsWMSTileCache::key( const QString& bbox ) const
+{
+  QMap<QString, QString> parameters;
+  parameters.insert( "SERVICE", "WMS" );
+  parameters.insert( "REQUEST", "GetMap" );
+  parameters.insert( "LAYERS", "roads" );
+  parameters.insert( "CRS", "EPSG:3857" );
+  parameters.insert( "BBOX", bbox );
+  parameters.insert( "WIDTH", "256" );
+  parameters.insert( "HEIGHT", "256" );
+  parameters.insert( "FORMAT", "image/png" );
+  return QgsWMSTileCache::cacheKey( mProjectFile->fileName(), parameters );
+}
+
+void TestQgsWMSTileCache::bboxDecimals()
+{
+  // a client writing fewer decimals than the seeder hits the seeded tile
+  QString seeded = key( "2123456.7890123,5678901.2345678,2124068.2852386,5679512.7307941" );
+  QVERIFY( !seeded.isEmpty() );
+  QCOMPARE( key( "2123456.789,5678901.235,2124068.285,5679512.731" ), seeded );
+}
+
+void TestQgsWMSTileCache::differentTiles()
+{
+  QString tile = key( "0,0,1000,1000" );
+  QVERIFY( !tile.isEmpty() );
+  // the neighbour and the tile of the next zoom level
+  QVERIFY( key( "1000,0,2000,1000" ) != tile );
+  QVERIFY( key( "0,0,500,500" ) != tile );
+  // a shift of one pixel
+  QVERIFY( key( "3.90625,0,1003.90625,1000" ) != tile );
+}
+
+QTEST_MAIN( TestQgsWMSTileCache )
+#include "moc_testqgswmstilecache.cxx"